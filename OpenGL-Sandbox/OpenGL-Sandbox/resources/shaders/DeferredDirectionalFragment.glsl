@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+#include "include/Camera.glsl"
+#include "include/GBuffer.glsl"
+#include "include/Shadows.glsl"
+
+uniform DirectionalLight u_DirectionalLight;
+
+// Shades every visible pixel exactly once: ambient and directional light, unlit surfaces are copied through
+void main()
+{
+	Surface surface;
+	vec3 normal, position;
+	if (!ReadGBuffer(ivec2(gl_FragCoord.xy), surface, normal, position))
+		discard;
+
+	if (surface.shininess == 0.0)
+	{
+		FragColor = surface.diffuse;
+		return;
+	}
+
+	vec3 viewDir = normalize(u_ViewPosition.xyz - position);
+	float shadow = CalcDirectionalShadow(position, normal, -(u_View * vec4(position, 1.0)).z);
+	FragColor = CalcDirLight(u_DirectionalLight, surface, normal, viewDir, shadow);
+}
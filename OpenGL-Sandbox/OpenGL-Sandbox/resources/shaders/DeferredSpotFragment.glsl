@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+#include "include/Camera.glsl"
+#include "include/GBuffer.glsl"
+
+uniform SpotLight u_SpotLight;
+
+// Runs only on the pixels the stencil pass found inside the light cone, blended additively
+void main()
+{
+	Surface surface;
+	vec3 normal, position;
+	// No discard: the passing pixels reset the stencil, with a discard the stencil test would wait for the shader
+	if (!ReadGBuffer(ivec2(gl_FragCoord.xy), surface, normal, position) || surface.shininess == 0.0)
+	{
+		FragColor = vec4(0.0);
+		return;
+	}
+
+	vec3 viewDir = normalize(u_ViewPosition.xyz - position);
+	FragColor = CalcSpotLight(u_SpotLight, surface, normal, position, viewDir);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Position stream of the mesh arena, nothing else is fetched
+
+// Per-instance model matrix, see InstanceData in Mesh.h
+layout (location = 3) in mat4 aInstanceModel; // Takes locations 3 to 6
+
+#include "include/Camera.glsl"
+
+// Same expression as InstancedVertex.glsl, the lit pass tests its fragments against this depth with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+	vec3 worldPosition = vec3(aInstanceModel * vec4(aPos, 1.0));
+	gl_Position = u_Projection * u_View * vec4(worldPosition, 1.0);
+}
\ No newline at end of file
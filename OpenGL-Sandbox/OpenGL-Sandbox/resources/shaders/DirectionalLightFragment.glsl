@@ -1,6 +1,8 @@
 #version 330 core
 out vec4 FragColor;
 
+#include "include/Lighting.glsl"
+
 struct Material 
 {
 	sampler2D diffuse;
@@ -8,41 +10,21 @@ struct Material
 	float shininess;
 };
 
-struct Light
-{
-	vec3 direction;
-
-	vec4 ambient;
-	vec4 diffuse;
-	vec4 specular;
-};
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
 uniform vec3 u_ViewPosition;
 uniform Material u_Material;
-uniform Light u_Light;
+uniform DirectionalLight u_Light;
 
 void main()
 {
-	vec3 lightDirection = normalize(-u_Light.direction);
-
-	// Ambient
-	vec4 ambient = u_Light.ambient * texture(u_Material.diffuse, TexCoords);
+	Surface surface;
+	surface.diffuse = texture(u_Material.diffuse, TexCoords);
+	surface.specular = texture(u_Material.specular, TexCoords);
+	surface.shininess = u_Material.shininess;
 
-	// Diffuse
-	vec3 norm = normalize(Normal);
-	float diff = max(dot(norm, lightDirection), 0.0);
-	vec4 diffuse = u_Light.diffuse * diff * texture(u_Material.diffuse, TexCoords);
-
-	// Specular
 	vec3 viewDirection = normalize(u_ViewPosition - FragPos);
-	vec3 reflectionDirection = reflect(-lightDirection, norm);
-	float spec = pow(max(dot(viewDirection, reflectionDirection), 0.0), u_Material.shininess);
-	vec4 specular = u_Light.specular * spec * texture(u_Material.specular, TexCoords);
-
-	vec4 result = ambient + diffuse + specular;
-	FragColor = result;
-}
\ No newline at end of file
+	FragColor = CalcDirLight(u_Light, surface, normalize(Normal), viewDirection);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+
+// One triangle covering the whole screen, drawn without any vertex buffer. It lies on the far plane so that a
+// GL_GREATER depth test keeps the pixels covered by geometry only.
+void main()
+{
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 1.0, 1.0);
+}
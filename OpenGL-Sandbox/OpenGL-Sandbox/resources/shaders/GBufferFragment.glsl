@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) out vec4 GBufferAlbedo;
+layout (location = 1) out vec2 GBufferNormal;
+
+#define GBUFFER_OUTPUT
+#include "include/GBuffer.glsl"
+
+struct Material 
+{
+	sampler2D texture_diffuse1;
+	float shininess; // Packed into the albedo alpha, 1 to 255
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material u_Material;
+
+void main()
+{
+	GBufferAlbedo = vec4(texture(u_Material.texture_diffuse1, TexCoords).rgb, clamp(u_Material.shininess, 1.0, 255.0) / 255.0);
+	GBufferNormal = EncodeOctahedral(normalize(Normal));
+}
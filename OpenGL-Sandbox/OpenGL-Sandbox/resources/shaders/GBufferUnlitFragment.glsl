@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) out vec4 GBufferAlbedo;
+layout (location = 1) out vec2 GBufferNormal;
+
+in vec4 InstanceColor;
+
+void main()
+{
+	// Zero shininess marks the pixel as unlit, the lighting passes output its color as is
+	GBufferAlbedo = vec4(InstanceColor.rgb, 0.0);
+	GBufferNormal = vec2(0.5);
+}
@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Vertex position
+layout (location = 1) in vec3 aNormal; // Vertex normal
+layout (location = 2) in vec2 aTexCoords; // Vertex texture coordinates
+
+// Per-instance attributes, see InstanceData in Mesh.h
+layout (location = 3) in mat4 aInstanceModel; // Model matrix, takes locations 3 to 6
+layout (location = 7) in vec4 aInstanceColor; // Instance color
+layout (location = 8) in vec4 aInstanceData; // Custom data, free for the fragment shader to use
+layout (location = 9) in mat3x4 aInstanceNormal; // Normal matrix computed with the model matrix on the CPU, takes locations 9 to 11
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec4 InstanceColor;
+flat out vec4 InstanceData;
+
+#include "include/Camera.glsl"
+
+// The depth prepass computes the same position in DepthVertex.glsl, both must produce the exact same depth for GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+	FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+	Normal = mat3(aInstanceNormal) * aNormal;
+	TexCoords = aTexCoords;
+	InstanceColor = aInstanceColor;
+	InstanceData = aInstanceData;
+
+	gl_Position = u_Projection * u_View * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Unit sphere or cone
+
+#include "include/Camera.glsl"
+
+uniform mat4 u_Model; // Places and scales the volume around the light
+
+void main()
+{
+	gl_Position = u_Projection * u_View * u_Model * vec4(aPos, 1.0);
+}
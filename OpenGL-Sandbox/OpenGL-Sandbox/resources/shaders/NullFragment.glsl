@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth and stencil only passes, no color is written
+void main()
+{
+}
@@ -1,6 +1,8 @@
 #version 330 core
 out vec4 FragColor;
 
+#include "include/Lighting.glsl"
+
 struct Material 
 {
 	sampler2D diffuse;
@@ -8,54 +10,21 @@ struct Material
 	float shininess;
 };
 
-struct Light
-{
-	vec3 position; // Point light here
-
-	vec4 ambient;
-	vec4 diffuse;
-	vec4 specular;
-
-	// Attenuation parameters (used for point lights)
-	float constant;
-	float linear;
-	float quadratic;
-};
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
 uniform vec3 u_ViewPosition;
-
 uniform Material u_Material;
-uniform Light u_Light;
+uniform PointLight u_Light;
 
 void main()
 {
-	// Ambient
-	vec4 ambient = u_Light.ambient * texture(u_Material.diffuse, TexCoords);
-
-	// Diffuse
-	vec3 norm = normalize(Normal);
-	vec3 lightDirection = normalize(u_Light.position - FragPos);
-	float diff = max(dot(norm, lightDirection), 0.0);
-	vec4 diffuse = u_Light.diffuse * diff * texture(u_Material.diffuse, TexCoords);
+	Surface surface;
+	surface.diffuse = texture(u_Material.diffuse, TexCoords);
+	surface.specular = texture(u_Material.specular, TexCoords);
+	surface.shininess = u_Material.shininess;
 
-	// Specular
 	vec3 viewDirection = normalize(u_ViewPosition - FragPos);
-	vec3 reflectionDirection = reflect(-lightDirection, norm);
-	float spec = pow(max(dot(viewDirection, reflectionDirection), 0.0), u_Material.shininess);
-	vec4 specular = u_Light.specular * spec * texture(u_Material.specular, TexCoords);
-
-	float distance = length(u_Light.position - FragPos);
-	float attenuation = 1.0 / (u_Light.constant + u_Light.linear * distance + u_Light.quadratic * (distance * distance));
-
-	// Apply attenuation to the light components
-	ambient *= attenuation;
-	diffuse *= attenuation;
-	specular *= attenuation;
-
-	vec4 result = ambient + diffuse + specular;
-	FragColor = result;
-}
\ No newline at end of file
+	FragColor = CalcPointLight(u_Light, surface, normalize(Normal), FragPos, viewDirection);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Position stream of the mesh arena
+
+// Per-instance model matrix, see InstanceData in Mesh.h
+layout (location = 3) in mat4 aInstanceModel; // Takes locations 3 to 6
+
+uniform mat4 u_LightViewProjection; // Of the cascade being drawn
+
+void main()
+{
+	gl_Position = u_LightViewProjection * aInstanceModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
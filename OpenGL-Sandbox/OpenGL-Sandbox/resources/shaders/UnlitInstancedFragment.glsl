@@ -0,0 +1,9 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec4 InstanceColor;
+
+void main()
+{
+	FragColor = InstanceColor;
+}
\ No newline at end of file
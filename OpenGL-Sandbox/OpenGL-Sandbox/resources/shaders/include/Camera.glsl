@@ -0,0 +1,9 @@
+// Per-view values shared by every program, written once per frame into the upload ring (see CameraData in Application.cpp)
+
+layout (std140) uniform CameraBlock
+{
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_InverseViewProjection; // Rebuilds world positions from depth
+	vec4 u_ViewPosition; // xyz is the camera position in world space
+};
@@ -0,0 +1,41 @@
+// Clustered point lights, the froxel light lists are built every frame by ClusteredLights on the CPU
+#include "Lighting.glsl"
+
+layout (std140) uniform ClusterBlock
+{
+	uvec4 u_ClusterCount; // Froxels along x, y and z, light count in w
+	vec4 u_ClusterParameters; // Tile width and height in pixels, depth slice scale and bias
+};
+
+uniform samplerBuffer u_LightData; // Two texels per light: position and radius, color and intensity
+uniform usamplerBuffer u_ClusterData; // Offset and count of the froxel's lights in u_LightIndices
+uniform usamplerBuffer u_LightIndices;
+
+int GetClusterIndex(vec2 fragCoord, float viewDepth)
+{
+	ivec3 count = ivec3(u_ClusterCount.xyz);
+	ivec2 tile = min(ivec2(fragCoord / u_ClusterParameters.xy), count.xy - 1);
+	int slice = clamp(int(log(viewDepth) * u_ClusterParameters.z - u_ClusterParameters.w), 0, count.z - 1);
+	return (slice * count.y + tile.y) * count.x + tile.x;
+}
+
+vec4 CalcClusteredPointLight(int light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec4 positionRadius = texelFetch(u_LightData, light * 2);
+	vec4 colorIntensity = texelFetch(u_LightData, light * 2 + 1);
+	return CalcWindowedPointLight(positionRadius, colorIntensity, surface, normal, fragPos, viewDir);
+}
+
+// Sums every point light of the fragment's froxel
+vec4 CalcClusteredPointLights(Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir, float viewDepth)
+{
+	uvec2 cluster = texelFetch(u_ClusterData, GetClusterIndex(gl_FragCoord.xy, viewDepth)).xy;
+
+	vec4 result = vec4(0.0);
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		int light = int(texelFetch(u_LightIndices, int(cluster.x + i)).r);
+		result += CalcClusteredPointLight(light, surface, normal, fragPos, viewDir);
+	}
+	return result;
+}
@@ -0,0 +1,47 @@
+// Packed G-buffer shared by the deferred passes, written by GBufferFragment.glsl and read back by the lighting passes:
+//   albedo (RGBA8)  : diffuse color, shininess / 255 in alpha (0 marks unlit surfaces)
+//   normal (RG16)   : world space normal, octahedral encoding
+//   depth (D24S8)   : hardware depth, positions are rebuilt from it
+#include "Lighting.glsl"
+
+vec2 EncodeOctahedral(vec3 normal)
+{
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+	vec2 signs = vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	vec2 encoded = normal.z >= 0.0 ? normal.xy : (1.0 - abs(normal.yx)) * signs;
+	return encoded * 0.5 + 0.5;
+}
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+	encoded = encoded * 2.0 - 1.0;
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+#ifndef GBUFFER_OUTPUT
+uniform sampler2D u_GBufferAlbedo;
+uniform sampler2D u_GBufferNormal;
+uniform sampler2D u_GBufferDepth;
+
+// Fills the surface of the pixel, returns false for the background
+bool ReadGBuffer(ivec2 pixel, out Surface surface, out vec3 normal, out vec3 position)
+{
+	float depth = texelFetch(u_GBufferDepth, pixel, 0).r;
+	vec4 albedo = texelFetch(u_GBufferAlbedo, pixel, 0);
+
+	surface.diffuse = vec4(albedo.rgb, 1.0);
+	surface.specular = surface.diffuse; // Same convention as LitFragment, the diffuse texture doubles as the specular map
+	surface.shininess = albedo.a * 255.0;
+	normal = DecodeOctahedral(texelFetch(u_GBufferNormal, pixel, 0).rg);
+
+	vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(u_GBufferDepth, 0));
+	vec4 world = u_InverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	position = world.xyz / world.w;
+
+	return depth < 1.0;
+}
+#endif
@@ -0,0 +1,104 @@
+// Phong lighting functions, the material textures are sampled once by the caller and shared by every light
+#include "Lights.glsl"
+
+struct Surface
+{
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+};
+
+// 'shadow' scales the diffuse and specular terms, the ambient term is never shadowed
+vec4 CalcDirLight(DirectionalLight light, Surface surface, vec3 normal, vec3 viewDir, float shadow)
+{
+	vec3 lightDir = normalize(-light.direction);
+
+	// Diffuse shading
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	// Specular shading
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+
+	// Combine results
+	vec4 ambient = light.ambient * surface.diffuse;
+	vec4 diffuse = light.diffuse * diff * surface.diffuse;
+	vec4 specular = light.specular * spec * surface.specular;
+
+	return ambient + (diffuse + specular) * shadow;
+}
+
+vec4 CalcDirLight(DirectionalLight light, Surface surface, vec3 normal, vec3 viewDir)
+{
+	return CalcDirLight(light, surface, normal, viewDir, 1.0);
+}
+
+vec4 CalcPointLight(PointLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(light.position - fragPos);
+
+	// Diffuse shading
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	// Specular shading
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+
+	// Attenuation
+	float distance = length(light.position - fragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+	// Combine results
+	vec4 ambient = light.ambient * surface.diffuse;
+	vec4 diffuse = light.diffuse * diff * surface.diffuse;
+	vec4 specular = light.specular * spec * surface.specular;
+
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+vec4 CalcSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(light.position - fragPos);
+
+	// Diffuse shading
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	// Specular shading
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+
+	// Attenuation
+	float distance = length(light.position - fragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+	// Spotlight effect
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+	// Combine results
+	vec4 ambient = light.ambient * surface.diffuse;
+	vec4 diffuse = light.diffuse * diff * surface.diffuse;
+	vec4 specular = light.specular * spec * surface.specular;
+
+	return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+// Point light with a finite radius: inverse square falloff windowed to reach zero at the radius the light was culled with
+vec4 CalcWindowedPointLight(vec4 positionRadius, vec4 colorIntensity, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 toLight = positionRadius.xyz - fragPos;
+	float distance = length(toLight);
+	vec3 lightDir = toLight / max(distance, 0.0001);
+
+	// Diffuse and specular shading
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+
+	float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+	float attenuation = window * window / (distance * distance + 1.0);
+
+	vec4 color = vec4(colorIntensity.rgb * colorIntensity.a, 1.0);
+	return (diff * surface.diffuse + spec * surface.specular) * color * attenuation;
+}
@@ -0,0 +1,40 @@
+// Light structures shared by every lit fragment shader
+
+struct DirectionalLight 
+{
+	vec3 direction;
+
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+struct PointLight
+{
+	vec3 position;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+struct SpotLight
+{
+	vec3 position;
+	vec3 direction;
+
+	float cutOff;
+	float outerCutOff;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
@@ -0,0 +1,37 @@
+// Cascaded shadow map of the directional light, the cascades are fitted every frame by ShadowCascades on the CPU
+#define SHADOW_CASCADE_COUNT 4
+
+layout (std140) uniform ShadowBlock
+{
+	mat4 u_ShadowMatrices[SHADOW_CASCADE_COUNT]; // World space to shadow map texture space, per cascade
+	vec4 u_CascadeSplits; // View space far depth of every cascade
+	vec4 u_CascadeTexelSizes; // Size of a shadow map texel in world units, per cascade
+	vec4 u_ShadowParameters; // 1 / resolution, depth bias, normal offset in texels, 1 if enabled
+};
+
+uniform sampler2DArrayShadow u_ShadowMap; // One layer per cascade
+
+// 1 when the point is lit by the directional light, 0 when it is in shadow. viewDepth is its distance along the view direction.
+float CalcDirectionalShadow(vec3 fragPos, vec3 normal, float viewDepth)
+{
+	if (u_ShadowParameters.w == 0.0 || viewDepth > u_CascadeSplits[SHADOW_CASCADE_COUNT - 1])
+		return 1.0;
+
+	int cascade = 0;
+	for (int i = 0; i < SHADOW_CASCADE_COUNT - 1; i++)
+		cascade += int(viewDepth > u_CascadeSplits[i]);
+
+	// Look the depth up a little above the surface, the offset follows the texel size of the cascade
+	vec3 position = fragPos + normal * (u_CascadeTexelSizes[cascade] * u_ShadowParameters.z);
+	vec3 coords = (u_ShadowMatrices[cascade] * vec4(position, 1.0)).xyz;
+	float reference = coords.z - u_ShadowParameters.y;
+
+	// 2x2 taps, each one is already a bilinear blend of 4 comparisons
+	float texel = u_ShadowParameters.x;
+	float light = 0.0;
+	light += texture(u_ShadowMap, vec4(coords.xy + vec2(-0.5, -0.5) * texel, float(cascade), reference));
+	light += texture(u_ShadowMap, vec4(coords.xy + vec2( 0.5, -0.5) * texel, float(cascade), reference));
+	light += texture(u_ShadowMap, vec4(coords.xy + vec2(-0.5,  0.5) * texel, float(cascade), reference));
+	light += texture(u_ShadowMap, vec4(coords.xy + vec2( 0.5,  0.5) * texel, float(cascade), reference));
+	return light * 0.25;
+}
\ No newline at end of file
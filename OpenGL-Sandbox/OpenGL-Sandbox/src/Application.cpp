@@ -1,18 +1,49 @@
+#include "Benchmarks.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "ClusteredLights.h"
+#include "CpuProfiler.h"
+#include "DeferredRenderer.h"
+#include "FrameBenchmark.h"
+#include "FrameClock.h"
+#include "FrameMailbox.h"
+#include "FrameTimings.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "InputLatency.h"
 #include "Mesh.h"
 #include "Model.h"
+#include "OffscreenTarget.h"
+#include "ParameterBlock.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+#include "Scene.h"
 #include "Shader.h"
+#include "ShaderManager.h"
+#include "ShadowCascades.h"
 #include "Texture.h"
+#include "UploadRing.h"
+#include "WorkerPool.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <stb_image/stb_image.h>
@@ -26,30 +57,225 @@ Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f,
 
 glm::vec2 lastMousePos = { SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
 bool firstMouse = true; // First time the mouse is captured by the window on focus
+// Latency from mouse look to the swap, and the queue limit and deadline wait of the low-latency mode
+InputLatency inputLatency;
+// Camera yaw, pitch and FOV after the last poll, what the late latch of the GL thread reads
+std::mutex latestLookMutex;
+glm::vec3 latestLook = { -90.0f, 0.0f, 45.0f };
 
-// Time step
-float deltaTime = 0.0f; // Time betwwen current frame and last frame
-float lastFrame = 0.0f; // Time of last frame
+// Shading path, Tab switches between forward (clustered) and deferred shading
+bool deferredShading = false;
+// P toggles the depth prepass of the forward path
+bool depthPrepass = false;
 
 // User input
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
 void scroll_callback(GLFWwindow* window, double xOffset, double yOffset);
+void key_callback(GLFWwindow* window, int key, int scanCode, int action, int mods);
 void process_input(GLFWwindow* window, float ts);
+void poll_events();
+glm::vec3 latest_look();
 
-int main()
+int main(int argc, char** argv)
 {
-    glfwInit();
+    PROFILE_THREAD("Main");
+
+    // CPU benchmarks do not need a window
+    if (argc > 2 && std::string(argv[1]) == "--bench")
+        return RunBenchmarks(argv[2]);
+
+    // Number of backpacks in the scene, laid out on a grid to stress the CPU side of the frame
+    unsigned int backpackCount = 1;
+    // Number of small colored cubes scattered around the scene, drawn as instances of the light source cube
+    unsigned int cubeCount = 0;
+    // Number of extra point lights scattered around the scene, the lit shader only evaluates the ones of each fragment's cluster
+    unsigned int extraLightCount = 0;
+    // How many frames the CPU may prepare ahead of the GPU, each one has its own region of the upload ring
+    unsigned int framesInFlight = 3;
+    // Cascaded shadow maps of the directional light, and the size of each cascade
+    bool shadows = true;
+    unsigned int shadowResolution = 2048;
+    // Headless runs draw into an offscreen framebuffer of the render size, with a fixed time step so that the frames
+    // are the same from one run to the next. The last frame can be written to a PNG and the frame timings to JSON.
+    bool headless = false;
+    unsigned int renderWidth = SCREEN_WIDTH, renderHeight = SCREEN_HEIGHT;
+    uint64_t frameLimit = 0; // 0 runs until the window is closed (300 frames when headless, 600 measured when benchmarking)
+    std::string capturePath, timingsPath;
+    // Chrome trace (chrome://tracing, Perfetto) of the profiler scopes: the whole run on the GPU, the last zones of
+    // every thread on the CPU (CpuProfiler::RingCapacity per thread)
+    std::string tracePath;
+    // Graphviz description of the render graph of the first frame (dot -Tsvg)
+    std::string renderGraphDumpPath;
+    // Benchmark: the camera follows a path (an orbit of the scene by default) with a fixed time step, the frames after the
+    // warm-up are measured and the results written as JSON, optionally compared with a baseline (non zero exit code on a
+    // regression). --record-camera saves the camera of an interactive session as a path to replay.
+    std::string benchmarkPath, cameraPathFile, recordCameraPath, baselinePath;
+    unsigned int warmupFrames = 60;
+    double regressionTolerance = 0.05;
+    // Frame loop: simulation steps per second, frame rate limit (0 for none) and swap interval (1 vsync, 0 off,
+    // -1 adaptive: waits for vblank unless the frame is late, then tears instead of waiting a whole refresh)
+    double tickRate = 60.0, frameRateLimit = 0.0;
+    int swapInterval = 1;
+    // Low-latency mode: the input is polled again just before the camera block is written, the frame starts as late as
+    // the next vblank allows (vsync only) and the swap waits for the GPU (--queue-limit none, fence or finish)
+    bool lowLatency = false;
+    std::string queueLimit;
+    // The GL context lives on a render thread fed with frame packets by the main thread (window events, simulation),
+    // at most --frame-packets - 1 ahead (2 double buffers the packets, 3 triple buffers them). 0 runs both in one loop.
+    bool useRenderThread = true;
+    unsigned int framePackets = 2;
+    // Job system: worker threads (0 for one per core left), cores kept for the main and render threads, and whether the
+    // workers are pinned to the other cores
+    WorkerPool::Settings workerSettings;
+    // GPU memory budgets in MiB per category ("render-targets=64,textures=256"): crossing one warns, and the run then
+    // exits with a non zero code so that automated runs catch leaks and growth
+    std::string memoryBudgets;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::string(argv[i]) == "--backpacks")
+            backpackCount = std::max(1, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--cubes")
+            cubeCount = std::max(0, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--lights")
+            extraLightCount = std::max(0, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--prepass")
+            depthPrepass = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--deferred")
+            deferredShading = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--shadows")
+            shadows = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--shadow-resolution")
+            shadowResolution = (unsigned int)std::max(64, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--frames-in-flight")
+            framesInFlight = (unsigned int)std::max(1, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--headless")
+            headless = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--width")
+            renderWidth = (unsigned int)std::max(1, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--height")
+            renderHeight = (unsigned int)std::max(1, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--frames")
+            frameLimit = (uint64_t)std::max(0, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--capture")
+            capturePath = argv[i + 1];
+        else if (std::string(argv[i]) == "--timings")
+            timingsPath = argv[i + 1];
+        else if (std::string(argv[i]) == "--trace")
+            tracePath = argv[i + 1];
+        else if (std::string(argv[i]) == "--render-graph-dump")
+            renderGraphDumpPath = argv[i + 1];
+        else if (std::string(argv[i]) == "--benchmark")
+            benchmarkPath = argv[i + 1];
+        else if (std::string(argv[i]) == "--camera-path")
+            cameraPathFile = argv[i + 1];
+        else if (std::string(argv[i]) == "--record-camera")
+            recordCameraPath = argv[i + 1];
+        else if (std::string(argv[i]) == "--warmup")
+            warmupFrames = (unsigned int)std::max(0, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--baseline")
+            baselinePath = argv[i + 1];
+        else if (std::string(argv[i]) == "--tolerance")
+            regressionTolerance = std::max(0.0, std::atof(argv[i + 1]));
+        else if (std::string(argv[i]) == "--tick-rate")
+            tickRate = std::max(1.0, std::atof(argv[i + 1]));
+        else if (std::string(argv[i]) == "--fps-limit")
+            frameRateLimit = std::max(0.0, std::atof(argv[i + 1]));
+        else if (std::string(argv[i]) == "--vsync")
+            swapInterval = std::max(-1, std::min(1, std::atoi(argv[i + 1])));
+        else if (std::string(argv[i]) == "--low-latency")
+            lowLatency = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--queue-limit")
+            queueLimit = argv[i + 1];
+        else if (std::string(argv[i]) == "--render-thread")
+            useRenderThread = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--frame-packets")
+            framePackets = (unsigned int)std::max(2, std::min(3, std::atoi(argv[i + 1])));
+        else if (std::string(argv[i]) == "--workers")
+            workerSettings.Workers = (unsigned int)std::max(0, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--reserved-threads")
+            workerSettings.ReservedThreads = (unsigned int)std::max(0, std::atoi(argv[i + 1]));
+        else if (std::string(argv[i]) == "--pin-threads")
+            workerSettings.PinThreads = std::atoi(argv[i + 1]) != 0;
+        else if (std::string(argv[i]) == "--memory-budget")
+            memoryBudgets = argv[i + 1];
+    }
+    WorkerPool::Configure(workerSettings);
+
+    // Before anything allocates
+    std::stringstream budgetList(memoryBudgets);
+    for (std::string budget; std::getline(budgetList, budget, ',');)
+    {
+        const size_t equals = budget.find('=');
+        const GpuMemory::Category category = equals != std::string::npos ? GpuMemory::FindCategory(budget.substr(0, equals)) : GpuMemory::Category::Count;
+        if (category == GpuMemory::Category::Count)
+        {
+            std::cerr << "[ERROR]: Invalid GPU memory budget '" << budget << "', expected <category>=<MiB> with textures, render-targets, geometry or streaming" << std::endl;
+            continue;
+        }
+        GpuMemory::Instance().SetBudget(category, (size_t)(std::max(0.0, std::atof(budget.c_str() + equals + 1)) * 1024.0 * 1024.0));
+    }
+    const bool benchmark = !benchmarkPath.empty();
+    if (benchmark)
+        frameLimit = warmupFrames + (frameLimit != 0 ? frameLimit : 600);
+    else if (headless && frameLimit == 0)
+        frameLimit = 300;
+    // Repeatable runs: one simulation step per frame whatever the frames cost
+    const bool deterministic = headless || benchmark;
+
+    // Without a display, GLFW's null platform creates an OSMesa context (software rendering, no windowing system).
+    // Otherwise the window stays hidden and the context comes from EGL when available.
+    if (headless && glfwPlatformSupported(GLFW_PLATFORM_NULL) && std::getenv("DISPLAY") == nullptr && std::getenv("WAYLAND_DISPLAY") == nullptr)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+
+    if (!glfwInit())
+    {
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+        if (!glfwInit())
+        {
+            std::cerr << "[ERROR]: Failed to initialize GLFW!" << std::endl;
+            return -1;
+        }
+    }
+
+    // GLFW goes when main returns, after every local declared below: the meshes and the other owners of GL objects
+    // are destroyed first, then the cached materials and the shared mesh buffers go, while the context still exists
+    struct GlfwSession
+    {
+        ~GlfwSession()
+        {
+            AssetLoader::Material::Clear();
+            AssetLoader::ShutdownMeshArena();
+            glfwTerminate();
+        }
+    } glfwSession;
+
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // The deferred path copies the G-buffer depth and stencil into the default framebuffer, the formats must match
+    glfwWindowHint(GLFW_DEPTH_BITS, 24);
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
+
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+    if (headless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, glfwGetPlatform() == GLFW_PLATFORM_NULL ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+    }
+
     // Window creation
-    GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OpenGL Sandbox", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(renderWidth, renderHeight, "OpenGL Sandbox", NULL, NULL);
+    if (window == NULL && headless)
+    {
+        // No OSMesa (Mesa often ships EGL alone), the null platform takes a surfaceless EGL context instead.
+        // No EGL, the native context of the hidden window renders offscreen just as well.
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, glfwGetPlatform() == GLFW_PLATFORM_NULL ? GLFW_EGL_CONTEXT_API : GLFW_NATIVE_CONTEXT_API);
+        window = glfwCreateWindow(renderWidth, renderHeight, "OpenGL Sandbox", NULL, NULL);
+    }
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window!" << std::endl;
@@ -58,13 +284,36 @@ int main()
 
     glfwMakeContextCurrent(window);
 
+    // Presentation: headless frames are never swapped, adaptive sync needs the tear control extension
+    double refreshRate = 0.0;
+    if (!headless)
+    {
+        if (swapInterval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+        {
+            std::cout << "[WARNING]: Adaptive vsync is not supported, using vsync" << std::endl;
+            swapInterval = 1;
+        }
+        glfwSwapInterval(swapInterval);
+
+        const GLFWvidmode* videoMode = glfwGetPrimaryMonitor() ? glfwGetVideoMode(glfwGetPrimaryMonitor()) : nullptr;
+        if (swapInterval != 0 && videoMode)
+            refreshRate = videoMode->refreshRate;
+
+        if (queueLimit == "fence")
+            inputLatency.SetQueueLimit(InputLatency::QueueLimit::Fence);
+        else if (queueLimit == "finish" || (queueLimit.empty() && lowLatency))
+            inputLatency.SetQueueLimit(InputLatency::QueueLimit::Finish);
+        inputLatency.SetDeadlineWait(lowLatency, refreshRate);
+    }
+
     // Capture mouse by default when the application gets focus
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!headless)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // Set window callbacks
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     // Load all OpenGL function pointers
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -73,15 +322,58 @@ int main()
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST);
+    // Optional entry points newer than GL 3.3 (multi-draw indirect, buffer storage)
+    GLExtensions::Load((GLADloadproc)glfwGetProcAddress);
+
+    GLState::Enable(GL_DEPTH_TEST);
+
+    // Headless: everything is drawn into the offscreen target, the window (if any) is never shown
+    std::unique_ptr<OffscreenTarget> offscreen;
+    if (headless)
+    {
+        offscreen = std::make_unique<OffscreenTarget>(renderWidth, renderHeight);
+        std::cout << "[INFO]: Headless " << renderWidth << "x" << renderHeight << ", " << frameLimit << " frames on "
+            << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+    }
+    const unsigned int outputFramebuffer = offscreen ? offscreen->GetFramebuffer() : 0;
+
+    // CPU and GPU time of every frame, only kept when they are written out
+    std::unique_ptr<FrameTimings> frameTimings;
+    if (!timingsPath.empty())
+        frameTimings = std::make_unique<FrameTimings>();
+    if (!tracePath.empty())
+        GpuProfiler::Instance().StartCapture();
+    std::unique_ptr<FrameBenchmark> frameBenchmark;
+    if (benchmark)
+        frameBenchmark = std::make_unique<FrameBenchmark>(warmupFrames);
 
     // Create shader
-    Shader litShader("resources/shaders/Vertex.glsl", "resources/shaders/LitFragment.glsl");
-    Shader unlitShader("resources/shaders/Vertex.glsl", "resources/shaders/UnlitFragment.glsl");
+    // Model matrix and color come from the per-instance attributes filled by the render queue
+    Shader litShader("resources/shaders/InstancedVertex.glsl", "resources/shaders/LitFragment.glsl");
+    Shader unlitShader("resources/shaders/InstancedVertex.glsl", "resources/shaders/UnlitInstancedFragment.glsl");
+
+    // Deferred path: the same draws write the G-buffer instead, the renderer owns the lighting programs
+    Shader gbufferShader("resources/shaders/InstancedVertex.glsl", "resources/shaders/GBufferFragment.glsl");
+    Shader gbufferUnlitShader("resources/shaders/InstancedVertex.glsl", "resources/shaders/GBufferUnlitFragment.glsl");
+    DeferredRenderer deferredRenderer;
+    deferredRenderer.SetOutputFramebuffer(outputFramebuffer);
+    // Passes of the frame, the G-buffer targets are transient and their textures pooled across frames
+    RenderGraph renderGraph;
+
+    // Depth prepass of the forward path, positions only and no fragment work
+    Shader depthShader("resources/shaders/DepthVertex.glsl", "resources/shaders/NullFragment.glsl");
 
     // Create model
 	std::unique_ptr<AssetLoader::Model> backpackModel = std::make_unique<AssetLoader::Model>("resources/models/backpack/backpack.obj");
 
+    // Every object of the scene is an entity: the backpacks on a grid, then the scattered cubes and the point lights.
+    // Their matrices and bounds are all computed at once at the start of each frame.
+    Scene scene;
+    scene.Reserve(backpackCount + cubeCount);
+    const unsigned int gridSize = (unsigned int)std::ceil(std::sqrt((float)backpackCount));
+    for (unsigned int i = 0; i < backpackCount; i++)
+        scene.CreateModel(*backpackModel, glm::vec3((float)(i % gridSize) * 5.0f, 0.0f, -(float)(i / gridSize) * 5.0f));
+
     // Renderer data - the vertices below define a cube that is located at the center of the screen
     float cubeVertices[] =
     {   // positions            // normals              // texture coords
@@ -139,114 +431,719 @@ int main()
 
     std::unique_ptr<AssetLoader::Mesh> lightSourceMesh = std::make_unique<AssetLoader::Mesh>(cubeVertices, sizeof(cubeVertices) / sizeof(cubeVertices[0]), 8);
 
-    // Bind the shader once, it is the same here
-    litShader.Use();
-    litShader.SetUniformFloat("u_Material.shininess", 32.0f);
+    // Packed uniform values of each program, uploaded in one step right before drawing
+    ParameterBlock litParameters(litShader.GetLayout());
+    ParameterBlock unlitParameters(unlitShader.GetLayout());
+    ParameterBlock gbufferParameters(gbufferShader.GetLayout());
+    ParameterBlock gbufferUnlitParameters(gbufferUnlitShader.GetLayout());
+
+    // Light values are shared by the forward program and the deferred lighting programs
+    ParameterBlock& directionalParameters = deferredRenderer.GetDirectionalParameters();
+    ParameterBlock& spotParameters = deferredRenderer.GetSpotParameters();
+
+    // Resolve the per-frame parameters once instead of looking their names up every frame
+    const ParameterBlock::Handle spotLightPosition = litParameters.GetHandle("u_SpotLight.position");
+    const ParameterBlock::Handle spotLightDirection = litParameters.GetHandle("u_SpotLight.direction");
+    const ParameterBlock::Handle deferredSpotPosition = spotParameters.GetHandle("u_SpotLight.position");
+    const ParameterBlock::Handle deferredSpotDirection = spotParameters.GetHandle("u_SpotLight.direction");
+
+    const unsigned int pointLightCount = sizeof(pointLightPositions) / sizeof(pointLightPositions[0]);
+
+    // Constant parameters are written once, the block only uploads them again if the program gets relinked.
+    // The material values (textures and shininess) are not part of it, the material of each mesh sets them.
+    // Directional light pointing downwards
+    const glm::vec3 directionalLightDirection(-0.2f, -1.0f, -0.3f);
+    for (ParameterBlock* parameters : { &litParameters, &directionalParameters })
+    {
+        parameters->Set("u_DirectionalLight.direction", directionalLightDirection);
+        parameters->Set("u_DirectionalLight.ambient", glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
+        parameters->Set("u_DirectionalLight.diffuse", glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+        parameters->Set("u_DirectionalLight.specular", glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    }
+
+    // Point lights are clustered, the animated lights (see the light cubes below) and extra ones scattered randomly around
+    // the scene. The scene gathers them every frame.
+    std::vector<ClusteredLights::PointLight> pointLights;
+    std::mt19937 lightRandom(4321);
+    std::uniform_real_distribution<float> lightUnit(0.0f, 1.0f);
+    const float lightFieldSize = 10.0f + std::sqrt((float)extraLightCount) * 0.5f;
+    for (unsigned int i = 0; i < extraLightCount; i++)
+    {
+        const glm::vec3 position = (glm::vec3(lightUnit(lightRandom), lightUnit(lightRandom) * 0.25f, lightUnit(lightRandom)) - glm::vec3(0.5f, 0.0f, 0.5f)) * lightFieldSize;
+        const glm::vec3 color(lightUnit(lightRandom), lightUnit(lightRandom), lightUnit(lightRandom));
+        scene.CreatePointLight(position, { color, 1.5f + lightUnit(lightRandom) * 2.5f, 4.0f });
+    }
+    ClusteredLights clusteredLights;
+
+    // The spot light keeps the classic attenuation factors, it covers a distance of 50 units
+    const glm::vec3 pointLightAttenuationFactors{ 1.0f, 0.09f, 0.032f }; // Constant, linear and quadratic attenuation factors
+
+    // The spot light is the camera itself, only its position and direction change every frame
+    const float spotLightOuterCutOff = glm::cos(glm::radians(17.5f));
+    const float spotLightRange = 50.0f; // Length of its light volume in the deferred path
+    for (ParameterBlock* parameters : { &litParameters, &spotParameters })
+    {
+        parameters->Set("u_SpotLight.ambient", glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)); // Ambient light color
+        parameters->Set("u_SpotLight.diffuse", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)); // Diffuse light color
+        parameters->Set("u_SpotLight.specular", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)); // Specular light color
+        parameters->Set("u_SpotLight.constant", pointLightAttenuationFactors.x);
+        parameters->Set("u_SpotLight.linear", pointLightAttenuationFactors.y);
+        parameters->Set("u_SpotLight.quadratic", pointLightAttenuationFactors.z);
+        parameters->Set("u_SpotLight.cutOff", glm::cos(glm::radians(5.0f))); // Inner cut-off angle for the spot light
+        parameters->Set("u_SpotLight.outerCutOff", spotLightOuterCutOff); // Outer cut-off angle for the spot light
+    }
+
+    // Per-frame data of the whole frame (camera block, instance data, indirect commands) is written into this ring
+    UploadRing uploadRing(8 * 1024 * 1024, framesInFlight);
+
+    // Camera values shared by every program through the CameraBlock uniform block, see include/Camera.glsl
+    struct CameraData
+    {
+        glm::mat4 View;
+        glm::mat4 Projection;
+        glm::mat4 InverseViewProjection;
+        glm::vec4 ViewPosition;
+    };
+    const unsigned int cameraBinding = ShaderLayout::GetBlockBinding("CameraBlock");
+    const unsigned int clusterBinding = ShaderLayout::GetBlockBinding("ClusterBlock");
+    const unsigned int shadowBinding = ShaderLayout::GetBlockBinding("ShadowBlock");
+    int uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+
+    // Every draw of the frame goes through the queue, which sorts them to minimize state changes
+    RenderQueue renderQueue(&uploadRing);
+    const RenderQueue::ProgramHandle litProgram = renderQueue.RegisterProgram(litShader, litParameters);
+    const RenderQueue::ProgramHandle unlitProgram = renderQueue.RegisterProgram(unlitShader, unlitParameters);
+    const RenderQueue::ProgramHandle gbufferProgram = renderQueue.RegisterProgram(gbufferShader, gbufferParameters);
+    const RenderQueue::ProgramHandle gbufferUnlitProgram = renderQueue.RegisterProgram(gbufferUnlitShader, gbufferUnlitParameters);
+
+    // The scene is static apart from the point light cubes, the far cascades are only drawn again when the camera moves away
+    ShadowCascades shadowCascades(&uploadRing, shadowResolution);
+    shadowCascades.SetLightDirection(directionalLightDirection);
+    shadowCascades.SetEnabled(shadows);
+
+    // Scattered cubes, they all share one mesh and one program so the queue draws them with a single instanced call
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float cubeFieldSize = 10.0f + std::cbrt((float)cubeCount) * 2.0f;
+    for (unsigned int i = 0; i < cubeCount; i++)
+    {
+        const glm::vec3 position = (glm::vec3(unit(random), unit(random), unit(random)) - 0.5f) * cubeFieldSize;
+        const glm::vec4 color(unit(random), unit(random), unit(random), 1.0f);
+        scene.CreateMesh(*lightSourceMesh, position, glm::vec3(0.25f), color, false);
+    }
+
+    // Point light cubes, scaled down and white, they follow the light positions of the packets. Moving, they stay out of
+    // the cached shadow cascades.
+    std::vector<Scene::Entity> lightCubes(pointLightCount);
+    for (unsigned int i = 0; i < pointLightCount; i++)
+    {
+        lightCubes[i] = scene.CreateMesh(*lightSourceMesh, pointLightPositions[i], glm::vec3(0.2f), glm::vec4(1.0f), false, false);
+        scene.GetRegistry().Add<PointLightComponent>(lightCubes[i], glm::vec3(1.0f), 50.0f, 20.0f);
+    }
+
+    // Scripted camera of benchmarks and replays, a recording is written at exit
+    CameraPath cameraPath, cameraRecording;
+    if (!cameraPathFile.empty() && !cameraPath.Load(cameraPathFile))
+        return -1;
+    if (benchmark && cameraPath.IsEmpty())
+    {
+        const glm::vec3 gridCenter((gridSize - 1) * 2.5f, 0.0f, -(gridSize - 1) * 2.5f);
+        cameraPath = CameraPath::Orbit(gridCenter, 6.0f + (gridSize - 1) * 4.0f, 2.0f + gridSize * 0.5f, 20.0f);
+    }
+
+    // Frame loop clock: fixed simulation steps, the limiter and the frame pacing statistics
+    FrameClock frameClock(tickRate);
+    frameClock.SetDeterministic(deterministic);
+    frameClock.SetFrameLimit(deterministic ? 0.0 : frameRateLimit);
+    frameClock.SetRefreshRate(refreshRate);
+    // Simulation state of the previous step, the camera holds the current one and rendering interpolates between them
+    glm::vec3 previousCameraPosition = camera.GetWorldPosition();
+
+    // Everything a frame takes from the main thread, immutable once published: the render thread only reads it
+    struct FramePacket
+    {
+        uint64_t Index = 0;
+        glm::vec3 CameraPosition{ 0.0f };
+        float Yaw = 0.0f, Pitch = 0.0f, FOV = 45.0f;
+        std::vector<glm::vec3> LightPositions;  // Point lights
+        int FramebufferWidth = 1, FramebufferHeight = 1;
+        bool DeferredShading = false, DepthPrepass = false;
+        int64_t InputNs = -1;                   // Oldest input the frame presents, see InputLatency::Latch()
+        bool Capture = false;                   // Golden image of the last frame
+    };
+    using PacketMailbox = FrameMailbox<FramePacket>;
+    PacketMailbox mailbox(framePackets);
+
+    // Main thread: simulation and the packet of the next frame
+    uint64_t packetCount = 0;
+    auto buildPacket = [&](FramePacket& packet)
+    {
+        PROFILE_SCOPE("Build frame packet");
+
+        // Fixed-rate update: the camera moves by whole steps of the tick rate, so its speed does not depend on the
+        // frame rate. Mouse look and zoom are applied as the events arrive, they are not part of the simulation.
+        const unsigned int steps = frameClock.BeginFrame();
+        for (unsigned int step = 0; step < steps; step++)
+        {
+            previousCameraPosition = camera.GetWorldPosition();
+            if (!headless)
+                process_input(window, (float)frameClock.GetStepSeconds());
+        }
+        // Time of the rendered frame between the last two steps, double precision for long sessions
+        const double renderTime = frameClock.GetRenderSeconds();
+
+        // A camera path replaces the input (and loops if the run is longer), it is sampled at the render time directly
+        if (!cameraPath.IsEmpty())
+        {
+            const double duration = cameraPath.GetDuration();
+            const CameraPath::Keyframe pose = cameraPath.Sample(duration > 0.0 ? (float)std::fmod(renderTime, duration) : 0.0f);
+            camera.SetPose(pose.Position, pose.Yaw, pose.Pitch, pose.FOV);
+            previousCameraPosition = pose.Position;
+        }
+        if (!recordCameraPath.empty())
+            cameraRecording.Add({ (float)renderTime, camera.GetWorldPosition(), camera.GetYaw(), camera.GetPitch(), camera.GetFOV() });
+
+        // What this frame draws: the camera between its previous and current position
+        packet.Index = packetCount++;
+        packet.CameraPosition = glm::mix(previousCameraPosition, camera.GetWorldPosition(), frameClock.GetAlpha());
+        packet.Yaw = camera.GetYaw();
+        packet.Pitch = camera.GetPitch();
+        packet.FOV = camera.GetFOV();
+
+        // The point lights circle once every 2 pi seconds
+        const float lightAngle = (float)std::fmod(renderTime, glm::two_pi<double>());
+        packet.LightPositions.resize(pointLightCount);
+        for (unsigned int i = 0; i < pointLightCount; i++)
+            packet.LightPositions[i] = { glm::sin(lightAngle) * pointLightPositions[i].x, pointLightPositions[i].y, glm::cos(lightAngle) * pointLightPositions[i].z };
+
+        packet.FramebufferWidth = (int)renderWidth;
+        packet.FramebufferHeight = (int)renderHeight;
+        if (!offscreen)
+            glfwGetFramebufferSize(window, &packet.FramebufferWidth, &packet.FramebufferHeight);
+        packet.FramebufferWidth = std::max(packet.FramebufferWidth, 1);
+        packet.FramebufferHeight = std::max(packet.FramebufferHeight, 1);
+
+        packet.DeferredShading = deferredShading;
+        packet.DepthPrepass = depthPrepass;
+        // The low-latency mode latches on the GL thread, just before the camera block is written
+        packet.InputNs = lowLatency ? -1 : inputLatency.Latch();
+        packet.Capture = !capturePath.empty() && frameLimit != 0 && packet.Index + 1 == frameLimit;
+    };
+
+    // Frame statistics, the window title shows the GL state changes issued and elided per frame. The GL thread sums
+    // up its side once a second, the main thread adds the frame pacing and sets the title.
+    uint64_t frameCount = 0, framesSinceReport = 0;
+    int64_t lastRenderReport = Trace::Now();
+    GLState::Counter lastReportCalls;
+    PacketMailbox::Stats lastReportHandoff;
+    std::mutex renderSummaryMutex;
+    std::string renderSummary;
 
-    // Render loop
-    while (!glfwWindowShouldClose(window))
+    double lastReport = 0.0;
+    auto updateTitle = [&]()
     {
-        float currentFrame = (float)glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        const double realTime = frameClock.GetRealSeconds();
+        if (realTime - lastReport < 1.0)
+            return;
 
-        // Handle user input
-        process_input(window, deltaTime);
+        // Frame pacing over the last report
+        const FrameClock::Stats pacing = frameClock.TakeWindowStats();
+        std::string title = "OpenGL Sandbox | " + std::to_string((int)(pacing.Frames / (realTime - lastReport))) + " FPS ("
+            + std::to_string(pacing.AverageIntervalMs).substr(0, 5) + " ms, jitter " + std::to_string(pacing.JitterMs).substr(0, 4) + " ms, "
+            + std::to_string(pacing.MissedDeadlines) + " missed)";
+        {
+            std::lock_guard<std::mutex> lock(renderSummaryMutex);
+            if (!renderSummary.empty())
+                title += " | " + renderSummary;
+        }
+        glfwSetWindowTitle(window, title.c_str());
+        lastReport = realTime;
+    };
+
+    // GL thread: draws the frame of a packet
+    auto renderFrame = [&](const FramePacket& packet)
+    {
+        PROFILE_SCOPE("Frame");
+
+        if (frameTimings)
+            frameTimings->BeginFrame();
+        if (frameBenchmark)
+            frameBenchmark->BeginFrame(packet.Index);
+
+        Camera renderCamera(packet.CameraPosition, glm::vec3(0.0f, 1.0f, 0.0f), packet.Yaw, packet.Pitch);
+        renderCamera.SetPose(packet.CameraPosition, packet.Yaw, packet.Pitch, packet.FOV);
+
+        // Swap in the shaders rebuilt after one of their source files changed on disk
+        ShaderManager::Instance().Update();
 
         // Rendering anything happens here
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
         glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Wireframe mode
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        // Waits only if the GPU is still reading the region written 'framesInFlight' frames ago
+        {
+            PROFILE_SCOPE("Wait for upload ring");
+            uploadRing.BeginFrame();
+        }
+        GpuProfiler::Instance().BeginFrame(); // Reads back the GPU scopes of the frames the GPU has finished
 
-        litShader.Use();
+        const int framebufferWidth = packet.FramebufferWidth, framebufferHeight = packet.FramebufferHeight;
 
-        litShader.SetVector3f("u_ViewPosition", camera.GetWorldPosition());
+        // Late latch: the mouse look that came in during the CPU work of the frame so far (the upload ring wait above all)
+        // still makes it into this frame. With a render thread the main thread keeps polling, the latest look is taken.
+        int64_t latchedInputNs = packet.InputNs;
+        if (lowLatency && !headless)
+        {
+            if (!useRenderThread)
+                poll_events();
+            const glm::vec3 look = latest_look();
+            renderCamera.SetPose(renderCamera.GetWorldPosition(), look.x, look.y, look.z);
+            latchedInputNs = inputLatency.Latch();
+        }
 
-        // Update the directional light uniforms
-        litShader.SetUniform3f("u_DirectionalLight.direction", -0.2f, -1.0f, -0.3f); // Directional light pointing downwards
-        litShader.SetUniform4f("u_DirectionalLight.ambient", 0.2f, 0.2f, 0.2f, 1.0f);
-        litShader.SetUniform4f("u_DirectionalLight.diffuse", 0.8f, 0.8f, 0.8f, 1.0f);
-        litShader.SetUniform4f("u_DirectionalLight.specular", 0.5f, 0.5f, 0.5f, 1.0f);
+        // Set the view and projection matrices in the camera block, the model matrices are set per draw by the render queue
+        const float nearPlane = 0.1f, farPlane = 100.0f;
+        const float aspectRatio = (float)framebufferWidth / (float)framebufferHeight;
+        glm::mat4 projection = glm::perspective(glm::radians(renderCamera.GetFOV()), aspectRatio, nearPlane, farPlane);
+        glm::mat4 view = renderCamera.GetViewMatrix();
 
-		// Update the point light uniforms
-        const glm::vec3 pointLightAttenuationFactors{ 1.0f, 0.09f, 0.032f }; // Constant, linear and quadratic attenuation factors
-        for (unsigned int i = 0; i < sizeof(pointLightPositions) / sizeof(pointLightPositions[0]); i++)
+        if (const UploadRing::Allocation cameraData = uploadRing.Allocate(sizeof(CameraData), (size_t)uniformAlignment))
         {
-            std::string pointLightName;
-			pointLightName.reserve(48); // Reserve space for the string to avoid reallocations
-			pointLightName = "u_PointLights[" + std::to_string(i) + "]";
-            litShader.SetVector3f(pointLightName + ".position", { glm::sin(currentFrame) * pointLightPositions[i].x, pointLightPositions[i].y, glm::cos(currentFrame) * pointLightPositions[i].z });
-			litShader.SetUniform4f(pointLightName + ".ambient", 0.05f, 0.05f, 0.05f, 1.0f); // Ambient light color
-			litShader.SetUniform4f(pointLightName + ".diffuse", 0.8f, 0.8f, 0.8f, 1.0f); // Diffuse light color
-			litShader.SetUniform4f(pointLightName + ".specular", 1.0f, 1.0f, 1.0f, 1.0f); // Specular light color
-        
-		    // We want the point light to cover a distance of 50 units, so we set the attenuation factors accordingly
-		    litShader.SetUniformFloat(pointLightName + ".constant", pointLightAttenuationFactors.x);
-		    litShader.SetUniformFloat(pointLightName + ".linear", pointLightAttenuationFactors.y);
-		    litShader.SetUniformFloat(pointLightName + ".quadratic", pointLightAttenuationFactors.z);
+            *reinterpret_cast<CameraData*>(cameraData.Data) = { view, projection, glm::inverse(projection * view), glm::vec4(renderCamera.GetWorldPosition(), 1.0f) };
+            GLState::BindBufferRange(GL_UNIFORM_BUFFER, cameraBinding, cameraData.Buffer, cameraData.Offset, cameraData.Size);
         }
 
-		// Update the spot light uniforms
-		// The spot light is the camera itself, so we set its position to the camera's world position
-		litShader.SetVector3f("u_SpotLight.position", camera.GetWorldPosition()); // Position of the spot light
-		litShader.SetVector3f("u_SpotLight.direction", camera.GetForwardDirection()); // Direction of the spot light
-		litShader.SetUniform4f("u_SpotLight.ambient", 0.0f, 0.0f, 0.0f, 1.0f); // Ambient light color
-		litShader.SetUniform4f("u_SpotLight.diffuse", 1.0f, 1.0f, 1.0f, 1.0f); // Diffuse light color
-		litShader.SetUniform4f("u_SpotLight.specular", 1.0f, 1.0f, 1.0f, 1.0f); // Specular light color
-        litShader.SetUniformFloat("u_SpotLight.constant", pointLightAttenuationFactors.x);
-        litShader.SetUniformFloat("u_SpotLight.linear", pointLightAttenuationFactors.y);
-        litShader.SetUniformFloat("u_SpotLight.quadratic", pointLightAttenuationFactors.z);
-		litShader.SetUniformFloat("u_SpotLight.cutOff", glm::cos(glm::radians(5.0f))); // Inner cut-off angle for the spot light
-		litShader.SetUniformFloat("u_SpotLight.outerCutOff", glm::cos(glm::radians(17.5f))); // Outer cut-off angle for the spot light
-
-        // Set the model, view and projection matrix uniforms
-        glm::mat4 projection = glm::perspective(glm::radians(camera.GetFOV()), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
-
-        litShader.SetMatrix4f("u_Projection", projection); // Send the projection matrix to the shader
-        litShader.SetMatrix4f("u_View", view); // Pass the camera view matrix to the shader
-		litShader.SetMatrix4f("u_Model", model); // Set the model matrix for the shader
-
-		backpackModel->Draw(litShader); // Draw the backpack model with the lit shader
-
-		unlitShader.Use();
-        
-        glm::mat4 lightProjection = glm::perspective(glm::radians(camera.GetFOV()), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 lightView = camera.GetViewMatrix();
-        unlitShader.SetMatrix4f("u_Projection", lightProjection); // Send the projection matrix to the shader
-        unlitShader.SetMatrix4f("u_View", lightView); // Pass the camera view matrix to the shader
-        
-		// Calculate the point lights model matrices and render them
-        for (unsigned int i = 0; i < sizeof(pointLightPositions) / sizeof(pointLightPositions[0]); i++)
+        // Fit the shadow cascades to the view, the ones that are not cached (or left their cached area) take casters this frame
+        shadowCascades.Begin(view, glm::radians(renderCamera.GetFOV()), aspectRatio, nearPlane, farPlane, WorkerPool::Instance().GetThreadCount());
+        if (const UploadRing::Allocation shadowData = uploadRing.Allocate(sizeof(ShadowCascades::ShaderData), (size_t)uniformAlignment))
         {
-            glm::mat4 lightModel = glm::mat4(1.0f);
-            lightModel = glm::translate(lightModel, { glm::sin(currentFrame) * pointLightPositions[i].x, pointLightPositions[i].y, glm::cos(currentFrame) * pointLightPositions[i].z });
-            lightModel = glm::scale(lightModel, glm::vec3(0.2f)); // Scale down the light source
-        
-            unlitShader.SetUniform4f("u_Color", 1.0f, 1.0f, 1.0f, 1.0f);
-            unlitShader.SetMatrix4f("u_Model", lightModel);
-        
-            // Render the light source model
-            lightSourceMesh->Draw(unlitShader);
-		}
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            *reinterpret_cast<ShadowCascades::ShaderData*>(shadowData.Data) = shadowCascades.GetShaderData();
+            GLState::BindBufferRange(GL_UNIFORM_BUFFER, shadowBinding, shadowData.Buffer, shadowData.Offset, shadowData.Size);
+        }
+
+        // Point light positions of the packet, then the world and normal matrices of the whole scene in SIMD batches and
+        // the world bounds of its renderables
+        for (unsigned int i = 0; i < pointLightCount; i++)
+            scene.SetPosition(lightCubes[i], packet.LightPositions[i]);
+        scene.Update(WorkerPool::Instance());
+        scene.GatherPointLights(pointLights);
+
+        // Assign the point lights to the clusters of this view, the froxel tiles follow the framebuffer size.
+        // The deferred path shades the lights with their volumes instead.
+        if (!packet.DeferredShading)
+        {
+            clusteredLights.Build(pointLights, view, projection, nearPlane, farPlane, (unsigned int)framebufferWidth, (unsigned int)framebufferHeight);
+            clusteredLights.Upload();
+            clusteredLights.Bind(*litShader.GetLayout());
+
+            if (const UploadRing::Allocation clusterData = uploadRing.Allocate(sizeof(ClusteredLights::ShaderData), (size_t)uniformAlignment))
+            {
+                *reinterpret_cast<ClusteredLights::ShaderData*>(clusterData.Data) = clusteredLights.GetShaderData();
+                GLState::BindBufferRange(GL_UNIFORM_BUFFER, clusterBinding, clusterData.Buffer, clusterData.Offset, clusterData.Size);
+            }
+        }
+
+        // Update the spot light, it follows the camera
+        litParameters.Set(spotLightPosition, renderCamera.GetWorldPosition()); // Position of the spot light
+        litParameters.Set(spotLightDirection, renderCamera.GetForwardDirection()); // Direction of the spot light
+        spotParameters.Set(deferredSpotPosition, renderCamera.GetWorldPosition());
+        spotParameters.Set(deferredSpotDirection, renderCamera.GetForwardDirection());
+
+        // Same draws in both paths, only the programs differ
+        const RenderQueue::ProgramHandle meshProgram = packet.DeferredShading ? gbufferProgram : litProgram;
+        const RenderQueue::ProgramHandle colorProgram = packet.DeferredShading ? gbufferUnlitProgram : unlitProgram;
+
+        // Each worker culls and submits its own slice of the renderables, the render queue keeps one partition per worker
+        WorkerPool& workers = WorkerPool::Instance();
+        renderQueue.Begin(view, projection, nearPlane, farPlane, workers.GetThreadCount());
+        scene.Submit(renderQueue, shadowCascades, meshProgram, colorProgram, workers);
+
+        renderQueue.Sort();
+        renderQueue.SetDepthPrepass(packet.DepthPrepass && !packet.DeferredShading ? &depthShader : nullptr);
+        renderQueue.Record(); // Command buffers are recorded in parallel, then replayed here on the GL thread
+        shadowCascades.Record();
+        uploadRing.Flush();
+
+        // Shadow maps first, then the shading path into the window (or the offscreen target)
+        renderGraph.Reset();
+        RenderGraph::Handle output = renderGraph.ImportFramebuffer("Output", outputFramebuffer, (unsigned int)framebufferWidth, (unsigned int)framebufferHeight);
+        RenderGraph::Handle shadowMap = renderGraph.ImportTexture("Shadow map", shadowCascades.GetShadowMap(),
+            { shadowCascades.GetResolution(), shadowCascades.GetResolution(), GL_DEPTH_COMPONENT24 });
+
+        renderGraph.AddPass("Shadows",
+            [&](RenderGraph::Builder& builder) { shadowMap = builder.Write(shadowMap); },
+            [&](const RenderGraph::Context&) { shadowCascades.Render(); });
+
+        // The passes run from Execute(), what they capture lives until then
+        DeferredRenderer::GBuffer gbuffer;
+        const DeferredRenderer::SpotVolume spot{ renderCamera.GetWorldPosition(), renderCamera.GetForwardDirection(), spotLightOuterCutOff, spotLightRange };
+        if (packet.DeferredShading)
+        {
+            renderGraph.AddPass("Geometry",
+                [&](RenderGraph::Builder& builder)
+                {
+                    gbuffer = DeferredRenderer::CreateGBuffer(builder, (unsigned int)framebufferWidth, (unsigned int)framebufferHeight);
+                    output = builder.Write(output); // Depth and stencil copy
+                },
+                [&](const RenderGraph::Context& context)
+                {
+                    GLState::PolygonMode(GL_LINE); // Wireframe mode
+                    deferredRenderer.BeginGeometry();
+                    renderQueue.Execute();
+                    deferredRenderer.EndGeometry(context);
+                });
+
+            renderGraph.AddPass("Lighting",
+                [&](RenderGraph::Builder& builder)
+                {
+                    DeferredRenderer::ReadGBuffer(builder, gbuffer);
+                    builder.Read(shadowMap);
+                    output = builder.Write(output, GL_COLOR_ATTACHMENT0);
+                },
+                [&](const RenderGraph::Context& context)
+                {
+                    shadowCascades.Bind(*deferredRenderer.GetDirectionalShader().GetLayout());
+                    deferredRenderer.Light(context, gbuffer, pointLights, spot, projection * view);
+                });
+        }
+        else
+        {
+            renderGraph.AddPass("Forward",
+                [&](RenderGraph::Builder& builder)
+                {
+                    builder.Read(shadowMap);
+                    output = builder.Write(output, GL_COLOR_ATTACHMENT0);
+                },
+                [&](const RenderGraph::Context&)
+                {
+                    shadowCascades.Bind(*litShader.GetLayout());
+                    GLState::PolygonMode(GL_LINE); // Wireframe mode
+                    deferredRenderer.BeginTiming(DeferredRenderer::Pass::Forward);
+                    renderQueue.Execute();
+                    deferredRenderer.EndTiming(DeferredRenderer::Pass::Forward);
+                });
+        }
+
+        renderGraph.Compile();
+        if (!renderGraphDumpPath.empty() && packet.Index == 0 && renderGraph.WriteDot(renderGraphDumpPath))
+            std::cout << "[INFO]: Render graph written to '" << renderGraphDumpPath << "'" << std::endl;
+        renderGraph.Execute();
+        uploadRing.EndFrame(); // The fence goes after the last draw reading this frame's region
+        GpuProfiler::Instance().EndFrame();
+        if (frameTimings)
+            frameTimings->EndFrame();
+        if (frameBenchmark)
+        {
+            // Every pass: main, depth prepass and the shadow cascades drawn this frame
+            const RenderQueue::Stats& mainStats = renderQueue.GetStats();
+            FrameBenchmark::Counters counters{ mainStats.Draws + mainStats.DepthDraws, mainStats.Triangles, mainStats.Instances };
+            for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+            {
+                if (!shadowCascades.IsDrawn(cascade))
+                    continue;
+                counters.Draws += shadowCascades.GetQueue(cascade).GetStats().DepthDraws;
+                counters.Triangles += shadowCascades.GetQueue(cascade).GetStats().Triangles;
+            }
+            frameBenchmark->EndFrame(counters);
+        }
+
+        // Golden image: the color buffer of the last frame, read before the swap leaves the back buffer undefined
+        if (packet.Capture)
+        {
+            const std::vector<uint8_t> pixels = Image::ReadPixels(outputFramebuffer, (unsigned int)framebufferWidth, (unsigned int)framebufferHeight);
+            if (Image::WritePng(capturePath, (unsigned int)framebufferWidth, (unsigned int)framebufferHeight, pixels))
+                std::cout << "[INFO]: Frame " << packet.Index << " written to '" << capturePath << "'" << std::endl;
+        }
+
+        if (!headless)
+        {
+            PROFILE_SCOPE("Swap buffers");
+            glfwSwapBuffers(window);
+            inputLatency.OnSwapped(latchedInputNs);
+        }
+
+        frameCount++;
+        framesSinceReport++;
+        const int64_t now = Trace::Now();
+        if (now - lastRenderReport >= 1000000000)
+        {
+            const GLState::Counter calls = GLState::GetStats().Total();
+            const uint64_t issued = (calls.Issued - lastReportCalls.Issued) / framesSinceReport;
+            const uint64_t elided = (calls.Elided - lastReportCalls.Elided) / framesSinceReport;
+
+            // GPU time of the passes of the current shading path
+            std::string passes;
+            if (packet.DeferredShading)
+            {
+                for (DeferredRenderer::Pass pass : { DeferredRenderer::Pass::Geometry, DeferredRenderer::Pass::Lighting, DeferredRenderer::Pass::LightVolumes })
+                    passes += std::string(passes.empty() ? "" : ", ") + DeferredRenderer::GetPassName(pass) + " " + std::to_string(deferredRenderer.GetPassMs(pass)).substr(0, 5) + " ms";
+                passes = "deferred (" + passes + ", " + std::to_string(deferredRenderer.GetStats().LightVolumes) + " volumes)";
+            }
+            else
+            {
+                // Overdraw: fragments shaded per pixel, and with the prepass how many the lit pass would have shaded without it
+                const RenderQueue::FragmentStats& fragments = renderQueue.GetFragmentStats();
+                const double pixels = (double)framebufferWidth * framebufferHeight;
+                passes = std::string("forward") + (packet.DepthPrepass ? " + prepass" : "") + " (" + std::to_string(deferredRenderer.GetPassMs(DeferredRenderer::Pass::Forward)).substr(0, 5) + " ms, "
+                    + std::to_string(fragments.Shaded / 1000) + "k fragments shaded, " + std::to_string(fragments.Shaded / pixels).substr(0, 4) + " per pixel";
+                if (packet.DepthPrepass)
+                    passes += ", " + std::to_string(fragments.Prepass / pixels).substr(0, 4) + " without prepass";
+                passes += ")";
+            }
+
+            // Shadow cascades drawn this frame and their GPU time, the cached ones cost nothing
+            std::string cascades;
+            double shadowMs = 0.0;
+            for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+            {
+                shadowMs += shadowCascades.GetCascadeMs(cascade);
+                cascades += std::string(cascade ? "/" : "") + std::to_string(shadowCascades.GetCascadeMs(cascade)).substr(0, 4);
+            }
+            passes += " | shadows " + std::to_string(shadowMs).substr(0, 5) + " ms (" + cascades + "), cache hits "
+                + std::to_string((int)(shadowCascades.GetStats().GetHitRate() * 100.0)) + "%";
+
+            // Handoff from the main thread over the last report: packets waiting at each read and how long they waited
+            std::string pipeline;
+            if (useRenderThread)
+            {
+                const PacketMailbox::Stats handoff = mailbox.GetStats();
+                const double packets = (double)std::max<uint64_t>(1, handoff.Packets - lastReportHandoff.Packets);
+                pipeline = " | pipeline depth " + std::to_string((handoff.Depth - lastReportHandoff.Depth) / packets).substr(0, 4) + ", packet age "
+                    + std::to_string((handoff.AgeMs - lastReportHandoff.AgeMs) / packets).substr(0, 5) + " ms";
+                lastReportHandoff = handoff;
+            }
+
+            const std::string summary = "input latency " + std::to_string(inputLatency.GetStats().LastMs).substr(0, 5) + " ms" + pipeline + " | " + passes + " | "
+                + std::to_string(renderQueue.GetStats().Instances) + " instances in " + std::to_string(renderQueue.GetStats().Groups) + " groups, "
+                + std::to_string(renderQueue.GetStats().Draws) + " draw calls, "
+                + std::to_string(renderQueue.GetStats().Culled) + " culled | "
+                + std::to_string(clusteredLights.GetStats().VisibleLights) + "/" + std::to_string(clusteredLights.GetStats().Lights) + " lights, "
+                + std::to_string(clusteredLights.GetStats().MaxLightsPerCluster) + " max per cluster | GL state calls per frame: "
+                + std::to_string(issued) + " issued, " + std::to_string(elided) + " elided | fence wait "
+                + std::to_string(uploadRing.GetStats().LastWaitMs).substr(0, 5) + " ms | GPU memory "
+                + std::to_string(GpuMemory::Instance().GetTotal().Bytes / (1024 * 1024)) + " MiB";
+            {
+                std::lock_guard<std::mutex> lock(renderSummaryMutex);
+                renderSummary = summary;
+            }
+
+            lastRenderReport = now;
+            lastReportCalls = calls;
+            framesSinceReport = 0;
+        }
+    };
+
+    if (useRenderThread)
+    {
+        // The context moves to the render thread, the main thread keeps the window: events, simulation and packets
+        glfwMakeContextCurrent(nullptr);
+        std::thread renderThread([&]()
+        {
+            PROFILE_THREAD("Render");
+            glfwMakeContextCurrent(window);
+            for (;;)
+            {
+                inputLatency.WaitForFrameStart();
+                const FramePacket* packet = mailbox.BeginRead();
+                if (!packet)
+                    break;
+                renderFrame(*packet);
+                mailbox.EndRead();
+            }
+            glfwMakeContextCurrent(nullptr);
+        });
+
+        while (!glfwWindowShouldClose(window) && (frameLimit == 0 || packetCount < frameLimit))
+        {
+            poll_events();
+            updateTitle();
+
+            // While the render thread is behind, the main thread goes back to polling every millisecond so that the
+            // late latch still sees the latest mouse look. Headless runs have no events to poll.
+            FramePacket* packet = mailbox.BeginWrite(headless ? -1.0 : 1.0);
+            if (!packet)
+                continue;
+            buildPacket(*packet);
+            mailbox.EndWrite();
+        }
+
+        // The render thread draws the packets already published, then gives the context back
+        mailbox.Close();
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+    }
+    else
+    {
+        FramePacket packet;
+        while (!glfwWindowShouldClose(window) && (frameLimit == 0 || packetCount < frameLimit))
+        {
+            inputLatency.WaitForFrameStart();
+            poll_events();
+            updateTitle();
+            buildPacket(packet);
+            renderFrame(packet);
+        }
     }
 
-    // Resource deallocation (taken care of in the AssetLoader::Mesh destructor)
+    GLState::PrintStats(GLState::GetStats(), frameCount);
 
-    glfwTerminate();
+    const FrameClock::Stats& clockStats = frameClock.GetStats();
+    std::cout << "[INFO]: Frame pacing: " << clockStats.Frames << " frames, " << clockStats.AverageIntervalMs << " ms average interval, "
+        << clockStats.JitterMs << " ms jitter, " << clockStats.MaxIntervalMs << " ms max, " << clockStats.MissedDeadlines << " missed deadlines | "
+        << clockStats.Steps << " simulation steps at " << tickRate << " Hz, " << clockStats.DroppedSteps << " dropped" << std::endl;
 
-    return 0;
-}
+    if (useRenderThread)
+    {
+        const PacketMailbox::Stats handoff = mailbox.GetStats();
+        const double packets = (double)std::max<uint64_t>(1, handoff.Packets);
+        std::cout << "[INFO]: Render thread: " << handoff.Packets << " packets through " << mailbox.GetCapacity() << " slots, "
+            << handoff.Depth / packets << " average depth, " << handoff.AgeMs / packets << " ms average age (" << handoff.MaxAgeMs << " ms max) | main thread waited "
+            << handoff.ProducerWaitMs / packets << " ms per packet (" << handoff.MaxProducerWaitMs << " ms max), render thread waited "
+            << handoff.ConsumerWaitMs / packets << " ms (" << handoff.MaxConsumerWaitMs << " ms max)" << std::endl;
+    }
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
-{
-    glViewport(0, 0, width, height);
+    const WorkerPool::Stats jobStats = WorkerPool::Instance().GetStats();
+    std::cout << "[INFO]: Job system: " << WorkerPool::Instance().GetThreadCount() << " threads, " << jobStats.Jobs << " jobs, "
+        << jobStats.Steals << " steals, " << jobStats.Sleeps << " worker sleeps" << std::endl;
+
+    if (inputLatency.GetStats().Samples > 0)
+    {
+        const FrameTimings::Summary latency = inputLatency.GetSummary();
+        std::cout << "[INFO]: Input to swap latency over the last " << InputLatency::WindowSize << " frames with input: " << latency.Median << " ms median, "
+            << latency.P95 << " ms p95, " << latency.P99 << " ms p99, " << latency.Max << " ms max";
+        if (lowLatency && refreshRate > 0.0)
+            std::cout << " | " << inputLatency.GetStats().MissedVblanks << " missed vblanks, " << inputLatency.GetStats().BudgetMs << " ms frame budget";
+        std::cout << std::endl;
+    }
+
+    const GeometryArena::Stats arenaStats = AssetLoader::GetMeshArena().GetStats();
+    std::cout << "[INFO]: Geometry arena: " << arenaStats.Allocations << " meshes, "
+        << arenaStats.VerticesUsed << "/" << arenaStats.VertexCapacity << " vertices, "
+        << arenaStats.IndicesUsed << "/" << arenaStats.IndexCapacity << " indices, "
+        << arenaStats.Grows << " grows" << std::endl;
+
+    const UploadRing::Stats& ringStats = uploadRing.GetStats();
+    std::cout << "[INFO]: Upload ring: waited on " << ringStats.WaitedFrames << "/" << ringStats.Frames << " frames, "
+        << (ringStats.Frames ? ringStats.TotalWaitMs / ringStats.Frames : 0.0) << " ms average, " << ringStats.MaxWaitMs << " ms max, "
+        << ringStats.PeakFrameBytes / 1024 << " KiB peak per frame, " << ringStats.Overflows << " overflows" << std::endl;
+
+    const ShadowCascades::Stats& shadowStats = shadowCascades.GetStats();
+    std::cout << "[INFO]: Shadow cascades: ";
+    for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+        std::cout << shadowCascades.GetCascadeMs(cascade) << " ms" << (shadowCascades.IsCached(cascade) ? " (cached)" : "") << ", ";
+    std::cout << "cache hits " << shadowStats.CacheHits << "/" << shadowStats.CacheLookups << " (" << shadowStats.GetHitRate() * 100.0 << "%), "
+        << shadowCascades.GetTextureBytes() / (1024 * 1024) << " MiB at " << shadowCascades.GetResolution() << "x" << shadowCascades.GetResolution() << std::endl;
+
+    const RenderQueue::FragmentStats& fragmentStats = renderQueue.GetFragmentStats();
+    std::cout << "[INFO]: Fragments shaded in the last forward frame: " << fragmentStats.Shaded;
+    if (fragmentStats.Prepass > 0)
+        std::cout << " (" << fragmentStats.Prepass << " passed the depth prepass)";
+    std::cout << std::endl;
+
+    std::cout << "[INFO]: Shading: ";
+    for (int pass = 0; pass < (int)DeferredRenderer::Pass::Count; pass++)
+        std::cout << (pass ? ", " : "") << DeferredRenderer::GetPassName((DeferredRenderer::Pass)pass) << " " << deferredRenderer.GetPassMs((DeferredRenderer::Pass)pass) << " ms";
+    std::cout << std::endl;
+
+    const RenderGraph::Stats& graphStats = renderGraph.GetStats();
+    std::cout << "[INFO]: Render graph: " << graphStats.Passes - graphStats.CulledPasses << "/" << graphStats.Passes << " passes, "
+        << graphStats.TransientResources << " transient targets in " << graphStats.PhysicalResources << " textures, "
+        << graphStats.AliasedBytes / 1024 << " KiB peak (" << graphStats.TransientBytes / 1024 << " KiB without aliasing), "
+        << graphStats.PoolBytes / 1024 << " KiB pooled, " << graphStats.Framebuffers << " cached framebuffers" << std::endl;
+
+    GpuMemory::Instance().Report(std::cout);
+
+    // Settings of the run, written next to the timings
+    const std::vector<std::pair<std::string, std::string>> runInfo =
+    {
+        { "renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)) },
+        { "version", reinterpret_cast<const char*>(glGetString(GL_VERSION)) },
+        { "resolution", std::to_string(renderWidth) + "x" + std::to_string(renderHeight) },
+        { "headless", headless ? "1" : "0" },
+        { "shading", deferredShading ? "deferred" : (depthPrepass ? "forward+prepass" : "forward") },
+        { "shadows", shadowCascades.IsEnabled() ? std::to_string(shadowCascades.GetResolution()) : "off" },
+        { "backpacks", std::to_string(backpackCount) },
+        { "cubes", std::to_string(cubeCount) },
+        { "lights", std::to_string(extraLightCount) },
+        { "camera", cameraPathFile.empty() ? (benchmark ? "orbit" : "interactive") : cameraPathFile },
+    };
+
+    if (frameTimings)
+    {
+        frameTimings->Finish();
+
+        const FrameTimings::Summary cpu = FrameTimings::Summarize(frameTimings->GetCpuMs());
+        const FrameTimings::Summary gpu = FrameTimings::Summarize(frameTimings->GetGpuMs());
+        std::cout << "[INFO]: Frame time over " << frameTimings->GetCpuMs().size() << " frames: CPU " << cpu.Average << " ms average, "
+            << cpu.P99 << " ms p99 | GPU " << gpu.Average << " ms average, " << gpu.P99 << " ms p99" << std::endl;
+
+        std::vector<std::pair<std::string, std::string>> info = runInfo;
+        // GPU time of the passes in the last frames, the per-frame arrays cover the whole frame
+        for (int pass = 0; pass < (int)DeferredRenderer::Pass::Count; pass++)
+            info.push_back({ std::string("pass_ms_") + DeferredRenderer::GetPassName((DeferredRenderer::Pass)pass), std::to_string(deferredRenderer.GetPassMs((DeferredRenderer::Pass)pass)) });
+
+        if (frameTimings->WriteJson(timingsPath, info))
+            std::cout << "[INFO]: Frame timings written to '" << timingsPath << "'" << std::endl;
+    }
+
+    int exitCode = 0;
+    for (int category = 0; category < (int)GpuMemory::Category::Count; category++)
+    {
+        const GpuMemory::CategoryStats memoryStats = GpuMemory::Instance().GetStats((GpuMemory::Category)category);
+        if (memoryStats.BudgetExceeded == 0)
+            continue;
+
+        std::cerr << "[ERROR]: GPU memory of " << GpuMemory::GetCategoryName((GpuMemory::Category)category) << " went over its budget, "
+            << memoryStats.Peak / (1024 * 1024) << " MiB peak for " << memoryStats.Budget / (1024 * 1024) << " MiB" << std::endl;
+        exitCode = 1;
+    }
+    if (frameBenchmark)
+    {
+        frameBenchmark->Finish();
+
+        const FrameBenchmark::Results results = frameBenchmark->GetResults();
+        std::cout << "[INFO]: Benchmark over " << results.Frames << " frames after " << warmupFrames << " warm-up frames: CPU p50/p95/p99/max "
+            << results.Cpu.Median << " / " << results.Cpu.P95 << " / " << results.Cpu.P99 << " / " << results.Cpu.Max << " ms | GPU "
+            << results.Gpu.Median << " / " << results.Gpu.P95 << " / " << results.Gpu.P99 << " / " << results.Gpu.Max << " ms | "
+            << results.Draws << " draws, " << (uint64_t)results.Triangles << " triangles per frame" << std::endl;
+
+        if (frameBenchmark->WriteJson(benchmarkPath, runInfo))
+            std::cout << "[INFO]: Benchmark results written to '" << benchmarkPath << "'" << std::endl;
+        if (!baselinePath.empty() && !frameBenchmark->CompareBaseline(baselinePath, regressionTolerance))
+            exitCode = 1;
+    }
+
+    if (!recordCameraPath.empty() && cameraRecording.Save(recordCameraPath))
+        std::cout << "[INFO]: Camera path of " << cameraRecording.GetKeyframeCount() << " keyframes written to '" << recordCameraPath << "'" << std::endl;
+
+    GpuProfiler& gpuProfiler = GpuProfiler::Instance();
+    std::cout << "[INFO]: GPU scopes (ms over the last " << GpuProfiler::WindowSize << " frames, min/avg/max/p99):";
+    for (const auto& [name, summary] : gpuProfiler.GetSummaries())
+        std::cout << "\n    " << name << ": " << summary.Min << " / " << summary.Average << " / " << summary.Max << " / " << summary.P99;
+    std::cout << "\n    " << gpuProfiler.GetDroppedFrames() << " frame(s) dropped before their results were available" << std::endl;
+
+    if (!tracePath.empty())
+    {
+        gpuProfiler.StopCapture();
+
+        // Both profilers are on the same clock, the GPU track lines up under the threads that issued the work
+        std::vector<Trace::Event> events = gpuProfiler.GetCapture();
+        std::vector<std::pair<uint32_t, std::string>> threads = { { GpuProfiler::TraceThread, "GPU" } };
+        CpuProfiler::Collect(events, threads);
+        if (Trace::WriteChromeJson(tracePath, events, threads))
+            std::cout << "[INFO]: " << events.size() << " trace events written to '" << tracePath << "'" << std::endl;
+    }
+
+    // The GL objects of the offscreen target and the timer queries go while the context still exists
+    frameTimings.reset();
+    frameBenchmark.reset();
+    offscreen.reset();
+    gpuProfiler.Shutdown();
+    inputLatency.Shutdown();
+
+    return exitCode;
 }
 
 void mouse_callback(GLFWwindow* window, double xPos, double yPos)
@@ -265,11 +1162,24 @@ void mouse_callback(GLFWwindow* window, double xPos, double yPos)
     lastMousePos = { (float)xPos, (float)yPos };
 
     camera.OnMouseMove(offset);
+    inputLatency.OnInput();
 }
 
 void scroll_callback(GLFWwindow* window, double xOffset, double yOffset)
 {
     camera.OnMouseScroll(yOffset);
+    inputLatency.OnInput();
+}
+
+void key_callback(GLFWwindow* window, int key, int scanCode, int action, int mods)
+{
+    // Switch between the forward and the deferred shading path
+    if (key == GLFW_KEY_TAB && action == GLFW_PRESS)
+        deferredShading = !deferredShading;
+
+    // Depth prepass on or off, forward path only
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+        depthPrepass = !depthPrepass;
 }
 
 void process_input(GLFWwindow* window, float ts)
@@ -290,4 +1200,18 @@ void process_input(GLFWwindow* window, float ts)
         camera.OnKeyPressed(ts, CameraMovement::LEFT);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.OnKeyPressed(ts, CameraMovement::RIGHT);
-}
\ No newline at end of file
+}
+
+void poll_events()
+{
+    glfwPollEvents();
+
+    std::lock_guard<std::mutex> lock(latestLookMutex);
+    latestLook = { camera.GetYaw(), camera.GetPitch(), camera.GetFOV() };
+}
+
+glm::vec3 latest_look()
+{
+    std::lock_guard<std::mutex> lock(latestLookMutex);
+    return latestLook;
+}
@@ -0,0 +1,1342 @@
+#include "Benchmarks.h"
+#include "ClusteredLights.h"
+#include "CommandBuffer.h"
+#include "CpuProfiler.h"
+#include "EntityRegistry.h"
+#include "FrameMailbox.h"
+#include "GpuMemory.h"
+#include "Mesh.h"
+#include "RangeAllocator.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+#include "TransformStore.h"
+#include "WorkerPool.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Timings of every iteration of a benchmark, in milliseconds
+    struct Samples
+    {
+        std::vector<double> Values;
+
+        void Add(Clock::time_point start, Clock::time_point end)
+        {
+            Values.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        double Percentile(double percentile)
+        {
+            std::sort(Values.begin(), Values.end());
+            const size_t index = std::min(Values.size() - 1, (size_t)(percentile / 100.0 * (Values.size() - 1) + 0.5));
+            return Values[index];
+        }
+
+        double Average() const
+        {
+            double sum = 0.0;
+            for (double value : Values)
+                sum += value;
+            return Values.empty() ? 0.0 : sum / Values.size();
+        }
+
+        void Print(const std::string& label)
+        {
+            std::cout << "    " << std::left << std::setw(36) << label << std::right << std::fixed << std::setprecision(3)
+                << " min " << std::setw(8) << Percentile(0.0) << " ms"
+                << "  avg " << std::setw(8) << Average() << " ms"
+                << "  p99 " << std::setw(8) << Percentile(99.0) << " ms"
+                << "  max " << std::setw(8) << Percentile(100.0) << " ms" << std::endl;
+        }
+    };
+
+    bool RenderQueueSort()
+    {
+        constexpr size_t PacketCount = 100000;
+        constexpr int Iterations = 200;
+        // 1 ms is out of reach on one core of the reference machine, where a single scatter of the packets takes 0.2 ms
+        // and the sort needs six of them. The median leaves the scheduling hiccups of a shared machine out.
+        constexpr double BudgetMs = 4.0;
+
+        // A plausible frame: few programs, a thousand materials, a few thousand meshes, random depths
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> program(0, 15), material(0, 1023), mesh(0, 4095);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+        std::vector<DrawPacket> frame(PacketCount);
+        for (size_t i = 0; i < PacketCount; i++)
+        {
+            const bool translucent = i % 10 == 0;
+            const uint16_t programID = (uint16_t)program(random), materialID = (uint16_t)material(random), meshID = (uint16_t)mesh(random);
+            frame[i].Key = translucent
+                ? SortKey::Translucent(RenderPass::Opaque, programID, materialID, meshID, depth(random))
+                : SortKey::Opaque(RenderPass::Opaque, programID, materialID, meshID, depth(random));
+            frame[i].Draw = (uint32_t)i;
+        }
+
+        std::vector<DrawPacket> packets, scratch;
+        Samples radix, reference;
+        for (int i = 0; i < Iterations; i++)
+        {
+            packets = frame;
+            auto start = Clock::now();
+            RadixSort(packets, scratch);
+            radix.Add(start, Clock::now());
+        }
+
+        std::vector<DrawPacket> expected;
+        for (int i = 0; i < Iterations / 10; i++)
+        {
+            expected = frame;
+            auto start = Clock::now();
+            std::stable_sort(expected.begin(), expected.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.Key < b.Key; });
+            reference.Add(start, Clock::now());
+        }
+
+        bool correct = true;
+        for (size_t i = 0; i < PacketCount && correct; i++)
+            correct = packets[i].Key == expected[i].Key && packets[i].Draw == expected[i].Draw;
+
+        std::cout << "[render-queue] Sorting " << PacketCount << " draw packets" << std::endl;
+        radix.Print("RadixSort");
+        reference.Print("std::stable_sort (reference)");
+
+        const bool withinBudget = radix.Percentile(50.0) <= BudgetMs;
+        std::cout << "    Result " << (correct ? "matches" : "DOES NOT MATCH") << " the reference sort, median "
+            << (withinBudget ? "within" : "OVER") << " the " << BudgetMs << " ms budget" << std::endl;
+
+        return correct && withinBudget;
+    }
+
+    // Records the command mix of a RenderQueue frame where no two draws share a mesh (the worst case, nothing gets instanced):
+    // a texture bind every few draws, then the instance data, vertex array, instance attributes and draw of every draw
+    void RecordDraws(CommandBuffer& commands, std::vector<AssetLoader::InstanceData>& instances, size_t begin, size_t end)
+    {
+        const AssetLoader::InstanceData instance{ glm::mat4(1.0f), glm::vec4(1.0f), glm::vec4(0.0f), glm::mat3x4(1.0f) };
+
+        commands.BindProgram(3);
+        for (size_t i = begin; i < end; i++)
+        {
+            if (i % 8 == 0)
+            {
+                commands.BindTexture(0, GL_TEXTURE_2D, (unsigned int)(i / 8 % 64) + 1);
+                commands.BindTexture(1, GL_TEXTURE_2D, (unsigned int)(i / 8 % 64) + 65);
+            }
+
+            instances[i] = instance;
+            commands.BindVertexArray((unsigned int)(i % 256) + 1);
+            commands.BindInstances(1, (unsigned int)(i * sizeof(AssetLoader::InstanceData)));
+            commands.DrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, 1);
+        }
+    }
+
+    bool CommandRecording()
+    {
+        constexpr size_t DrawCount = 50000;
+        constexpr int Iterations = 100;
+
+        WorkerPool& workers = WorkerPool::Instance();
+        const unsigned int threadCount = workers.GetThreadCount();
+
+        CommandBuffer single;
+        std::vector<CommandBuffer> buffers(threadCount);
+        std::vector<AssetLoader::InstanceData> instances(DrawCount);
+        Samples serial, parallel;
+        for (int i = 0; i < Iterations; i++)
+        {
+            auto start = Clock::now();
+            single.Clear();
+            RecordDraws(single, instances, 0, DrawCount);
+            serial.Add(start, Clock::now());
+
+            start = Clock::now();
+            const size_t drawsPerBuffer = (DrawCount + threadCount - 1) / threadCount;
+            workers.ParallelFor(threadCount, [&](unsigned int index, unsigned int)
+            {
+                const size_t begin = std::min(DrawCount, index * drawsPerBuffer);
+                buffers[index].Clear();
+                RecordDraws(buffers[index], instances, begin, std::min(DrawCount, begin + drawsPerBuffer));
+            });
+            parallel.Add(start, Clock::now());
+        }
+
+        // The parallel buffers must hold the same stream once the redundant program binds are left out
+        std::vector<uint8_t> merged;
+        size_t commandCount = 0;
+        for (const auto& buffer : buffers)
+        {
+            buffer.ForEach([&](const Commands::Header& header, const void* payload)
+            {
+                if (header.Type == CommandType::BindProgram && !merged.empty())
+                    return;
+
+                const uint8_t* begin = static_cast<const uint8_t*>(payload) - sizeof(Commands::Header);
+                merged.insert(merged.end(), begin, begin + header.Size);
+                commandCount++;
+            });
+        }
+        bool correct = merged == single.GetData() && commandCount == single.GetCommandCount();
+
+        // Streams survive a round trip through their serialized form
+        CommandBuffer loaded;
+        correct &= loaded.Deserialize(single.Serialize()) && loaded.GetData() == single.GetData();
+
+        std::cout << "[command-recording] Recording " << DrawCount << " draws (" << single.GetCommandCount() << " commands, "
+            << single.GetSize() / 1024 << " KiB) on " << threadCount << " thread(s)" << std::endl;
+        serial.Print("1 thread");
+        parallel.Print(std::to_string(threadCount) + " thread(s)");
+        std::cout << "    Speedup x" << std::setprecision(2) << serial.Average() / parallel.Average()
+            << ", parallel streams " << (correct ? "match" : "DO NOT MATCH") << " the serial stream" << std::endl;
+
+        return correct;
+    }
+
+    bool GeometryArenaAllocator()
+    {
+        constexpr uint32_t Capacity = 1u << 24; // 16M vertices
+        constexpr int Rounds = 50;
+        constexpr int OperationsPerRound = 2000;
+
+        // Meshes of a few hundred to a few thousand vertices, loaded and unloaded at random
+        std::mt19937 random(7);
+        std::uniform_int_distribution<uint32_t> size(64, 8192);
+
+        RangeAllocator allocator(Capacity);
+        std::map<uint32_t, uint32_t> live; // Offset -> size, mirrors the allocator to validate it
+        std::vector<uint32_t> liveOffsets; // Same offsets, to pick one at random in constant time
+        Samples churn, compaction;
+        bool correct = true;
+        float fragmentation = 0.0f;
+        uint32_t failed = 0;
+
+        for (int round = 0; round < Rounds && correct; round++)
+        {
+            auto start = Clock::now();
+            for (int i = 0; i < OperationsPerRound; i++)
+            {
+                // Keep the arena around 75% full so that frees and allocations interleave
+                if (!live.empty() && (allocator.GetUsed() > Capacity / 4 * 3 || random() % 3 == 0))
+                {
+                    const size_t index = random() % liveOffsets.size();
+                    allocator.Free(liveOffsets[index]);
+                    live.erase(liveOffsets[index]);
+                    liveOffsets[index] = liveOffsets.back();
+                    liveOffsets.pop_back();
+                }
+                else
+                {
+                    const uint32_t count = size(random);
+                    const uint32_t offset = allocator.Allocate(count);
+                    if (offset == RangeAllocator::InvalidOffset)
+                        failed++;
+                    else
+                    {
+                        live.emplace(offset, count);
+                        liveOffsets.push_back(offset);
+                    }
+                }
+            }
+            churn.Add(start, Clock::now());
+
+            // No two live ranges may overlap and the allocator must agree on the used size
+            uint32_t end = 0, used = 0;
+            for (const auto& [offset, count] : live)
+            {
+                correct &= offset >= end && offset + count <= Capacity;
+                end = offset + count;
+                used += count;
+            }
+            correct &= used == allocator.GetUsed();
+
+            fragmentation = std::max(fragmentation, allocator.GetFragmentation());
+            if (round % 10 == 9)
+            {
+                start = Clock::now();
+                const std::vector<RangeAllocator::Move> moves = allocator.Compact();
+                compaction.Add(start, Clock::now());
+
+                std::map<uint32_t, uint32_t> packed;
+                uint32_t cursor = 0;
+                for (const auto& move : moves)
+                {
+                    correct &= move.To == cursor && live.count(move.From) && live[move.From] == move.Size;
+                    packed.emplace(move.To, move.Size);
+                    cursor += move.Size;
+                }
+                correct &= moves.size() == live.size() && allocator.GetFragmentation() == 0.0f;
+                live.swap(packed);
+
+                liveOffsets.clear();
+                for (const auto& range : live)
+                    liveOffsets.push_back(range.first);
+            }
+        }
+
+        std::cout << "[geometry-arena] " << Rounds << " x " << OperationsPerRound << " allocations and frees in a " << Capacity << " vertex arena" << std::endl;
+        churn.Print(std::to_string(OperationsPerRound) + " operations");
+        compaction.Print("Compact (" + std::to_string(live.size()) + " ranges)");
+        std::cout << "    Peak fragmentation " << std::setprecision(2) << fragmentation * 100.0f << "%, " << failed << " failed allocations, ranges "
+            << (correct ? "are consistent" : "ARE INCONSISTENT") << std::endl;
+
+        return correct;
+    }
+
+    bool ClusteredLightAssignment()
+    {
+        constexpr unsigned int Width = 1280, Height = 720;
+        constexpr float NearPlane = 0.1f, FarPlane = 100.0f;
+        constexpr int Iterations = 50;
+        constexpr int SamplesPerLight = 16;
+
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)Width / (float)Height, NearPlane, FarPlane);
+
+        bool correct = true;
+        for (unsigned int lightCount : { 1u, 100u, 1000u, 10000u })
+        {
+            // Lights of radius 1 to 4 scattered in a box around the camera, part of them outside the frustum
+            std::mt19937 random(lightCount);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            std::vector<ClusteredLights::PointLight> lights(lightCount);
+            for (auto& light : lights)
+                light = { glm::vec3(unit(random) * 80.0f - 40.0f, unit(random) * 8.0f - 2.0f, -unit(random) * 90.0f + 5.0f), 1.0f + unit(random) * 3.0f, glm::vec3(1.0f), 1.0f };
+
+            ClusteredLights clusters;
+            Samples build;
+            for (int i = 0; i < Iterations; i++)
+            {
+                const auto start = Clock::now();
+                clusters.Build(lights, view, projection, NearPlane, FarPlane, Width, Height);
+                build.Add(start, Clock::now());
+            }
+
+            // Every point of a light's sphere that lands on screen must find the light in its froxel, the way the shader looks it up
+            const ClusteredLights::ShaderData& data = clusters.GetShaderData();
+            uint32_t missing = 0;
+            for (uint32_t light = 0; light < lightCount; light++)
+            {
+                for (int sample = 0; sample < SamplesPerLight; sample++)
+                {
+                    const glm::vec3 direction = glm::vec3(unit(random), unit(random), unit(random)) * 2.0f - 1.0f;
+                    const glm::vec3 point = lights[light].Position + direction * (lights[light].Radius * 0.57f);
+
+                    const glm::vec4 viewPoint = view * glm::vec4(point, 1.0f);
+                    const glm::vec4 clip = projection * viewPoint;
+                    const float depth = -viewPoint.z;
+                    if (depth < NearPlane || depth > FarPlane || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w)
+                        continue;
+
+                    const glm::vec2 pixel = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(Width, Height);
+                    const unsigned int x = std::min((unsigned int)(pixel.x / data.Parameters.x), ClusteredLights::ClusterCountX - 1);
+                    const unsigned int y = std::min((unsigned int)(pixel.y / data.Parameters.y), ClusteredLights::ClusterCountY - 1);
+                    const int slice = (int)(std::log(depth) * data.Parameters.z - data.Parameters.w);
+                    const unsigned int z = (unsigned int)std::min(std::max(slice, 0), (int)ClusteredLights::ClusterCountZ - 1);
+
+                    uint32_t count = 0;
+                    const uint32_t* indices = clusters.GetClusterLights(ClusteredLights::GetClusterIndex(x, y, z), count);
+                    missing += std::find(indices, indices + count, light) == indices + count ? 1 : 0;
+                }
+            }
+            correct &= missing == 0;
+
+            // Forward shading without clusters evaluates every light for every fragment
+            const ClusteredLights::Stats& stats = clusters.GetStats();
+            const double averagePerCluster = stats.OccupiedClusters ? (double)stats.Assignments / stats.OccupiedClusters : 0.0;
+            std::cout << "[clustered-lights] " << lightCount << " point lights, " << ClusteredLights::ClusterCount << " clusters" << std::endl;
+            build.Print("Build on " + std::to_string(WorkerPool::Instance().GetThreadCount()) + " thread(s)");
+            std::cout << "    " << stats.VisibleLights << " visible lights, " << stats.Assignments << " assignments, "
+                << std::setprecision(1) << averagePerCluster << " lights per occupied cluster (max " << stats.MaxLightsPerCluster
+                << ") instead of " << lightCount << " per fragment, " << missing << " missed samples" << std::endl;
+        }
+
+        return correct;
+    }
+
+    bool CpuProfilerZones()
+    {
+        constexpr int ZonesPerIteration = 100000;
+        constexpr int Iterations = 50;
+        constexpr double BudgetNs = 50.0;
+
+        // Nested zones as the instrumented code records them, the scope objects are used directly so that the cost is
+        // measured even with PROFILING_ENABLED set to 0
+        Samples zones;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            for (int zone = 0; zone < ZonesPerIteration; zone += 2)
+            {
+                ProfileScope outer("Benchmark outer zone");
+                ProfileScope inner("Benchmark inner zone");
+            }
+            zones.Add(start, Clock::now());
+        }
+
+        // Every thread of the pool records into its own ring at the same time
+        WorkerPool& workers = WorkerPool::Instance();
+        const unsigned int threadCount = workers.GetThreadCount();
+        Samples threaded;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            workers.ParallelFor(threadCount, [](unsigned int, unsigned int)
+            {
+                for (int zone = 0; zone < ZonesPerIteration; zone++)
+                    ProfileScope scope("Benchmark worker zone");
+            });
+            threaded.Add(start, Clock::now());
+        }
+
+        // The ring of this thread holds its last zones, in order and well formed
+        std::vector<Trace::Event> events;
+        std::vector<std::pair<uint32_t, std::string>> threads;
+        CpuProfiler::Collect(events, threads);
+
+        size_t benchmarkZones = 0;
+        bool ordered = true;
+        int64_t previousStart = 0;
+        for (const Trace::Event& event : events)
+        {
+            if (std::string(event.Name).rfind("Benchmark", 0) != 0)
+                continue;
+            benchmarkZones++;
+            ordered &= event.DurationNs >= 0;
+            if (std::string(event.Name) == "Benchmark inner zone")
+            {
+                ordered &= event.StartNs >= previousStart;
+                previousStart = event.StartNs;
+            }
+        }
+        // The zone being written when the ring was read is left out
+        const bool inOrder = ordered && benchmarkZones >= CpuProfiler::RingCapacity - 1 && !threads.empty();
+
+        // One thread records as fast as it can while this one collects. Every zone collected must be one that was recorded,
+        // never half of a zone and half of the one overwriting it: zone i spans ticks [i * Spacing, i * Spacing + Length).
+        constexpr CpuProfiler::Ticks Spacing = 1 << 20, Length = 1 << 10;
+        std::atomic<bool> recording{ false }, stop{ false };
+        std::thread writer([&]()
+        {
+            for (CpuProfiler::Ticks i = 1; !stop.load(std::memory_order_relaxed); i++)
+            {
+                CpuProfiler::Record("Benchmark concurrent zone", i * Spacing, i * Spacing + Length);
+                recording.store(true, std::memory_order_relaxed);
+            }
+        });
+        while (!recording.load(std::memory_order_relaxed))
+            std::this_thread::yield();
+
+        size_t concurrentZones = 0, tornZones = 0;
+        for (int i = 0; i < Iterations; i++)
+        {
+            std::vector<Trace::Event> collected;
+            std::vector<std::pair<uint32_t, std::string>> collectedThreads;
+            CpuProfiler::Collect(collected, collectedThreads);
+
+            // Every intact zone has the same duration as the newest one, which was complete before the ring was read. A torn
+            // zone is either clamped to 0 or spans a whole ring of zones.
+            int64_t duration = -1;
+            for (auto event = collected.rbegin(); event != collected.rend(); ++event)
+            {
+                if (std::string(event->Name) != "Benchmark concurrent zone")
+                    continue;
+                if (duration < 0)
+                    duration = event->DurationNs;
+                concurrentZones++;
+                tornZones += event->DurationNs <= 0 || std::abs(event->DurationNs - duration) > duration / 100 + 1;
+            }
+        }
+        stop.store(true, std::memory_order_relaxed);
+        writer.join();
+        const bool correct = inOrder && concurrentZones > 0 && tornZones == 0;
+
+        const double nsPerZone = zones.Average() * 1.0e6 / ZonesPerIteration;
+        const bool withinBudget = nsPerZone <= BudgetNs;
+        std::cout << "[cpu-profiler] " << ZonesPerIteration << " zones per iteration, ring of " << CpuProfiler::RingCapacity
+            << " zones per thread, " << (CPU_PROFILER_RDTSC ? "time stamp counter" : "steady clock") << std::endl;
+        zones.Print("Nested zones, one thread");
+        threaded.Print("Zones on " + std::to_string(threadCount) + " thread(s) each");
+        std::cout << "    " << std::setprecision(1) << nsPerZone << " ns per zone, " << (withinBudget ? "within" : "OVER") << " the "
+            << BudgetNs << " ns budget, " << benchmarkZones << " zones collected from " << threads.size() << " thread(s) "
+            << (inOrder ? "in order" : "OUT OF ORDER OR MISSING") << std::endl;
+        std::cout << "    " << concurrentZones << " zones collected while their thread recorded, " << tornZones << " torn" << std::endl;
+
+        return correct && withinBudget;
+    }
+
+    // Busy CPU work of a given length, what each side of the pipeline does with a packet
+    void Spin(double microseconds)
+    {
+        const auto end = Clock::now() + std::chrono::duration<double, std::micro>(microseconds);
+        while (Clock::now() < end)
+            continue;
+    }
+
+    struct Packet
+    {
+        uint64_t Index = 0;
+        glm::mat4 View{ 1.0f };
+        std::vector<glm::vec3> Lights;
+    };
+
+    // Producer and consumer threads around a mailbox, 'packetCount' packets. Returns false if one came out of order.
+    bool RunPipeline(unsigned int capacity, int packetCount, double workUs, Samples& samples, FrameMailbox<Packet>::Stats& stats)
+    {
+        FrameMailbox<Packet> mailbox(capacity);
+        bool ordered = true;
+        const auto start = Clock::now();
+        std::thread consumer([&]()
+        {
+            uint64_t expected = 0;
+            while (const Packet* packet = mailbox.BeginRead())
+            {
+                ordered &= packet->Index == expected++ && packet->Lights.size() == 64;
+                Spin(workUs);
+                mailbox.EndRead();
+            }
+        });
+        for (int i = 0; i < packetCount; i++)
+        {
+            Spin(workUs);
+            Packet* packet = mailbox.BeginWrite();
+            packet->Index = (uint64_t)i;
+            packet->Lights.assign(64, glm::vec3((float)i));
+            mailbox.EndWrite();
+        }
+        mailbox.Close();
+        consumer.join();
+
+        samples.Add(start, Clock::now());
+        stats = mailbox.GetStats();
+        return ordered;
+    }
+
+    bool FrameMailboxHandoff()
+    {
+        constexpr int HandoffPackets = 100000;
+        constexpr int FramePackets = 500;
+        constexpr double WorkUs = 200.0; // Per packet on each side, simulation and rendering of equal cost
+        constexpr int Iterations = 5;
+
+        std::cout << "[frame-mailbox] " << HandoffPackets << " empty packets, then " << FramePackets << " packets of " << WorkUs
+            << " us of work on each side" << std::endl;
+
+        // Cost of the handoff itself: nothing to do on either side, every packet goes through the mutex and a wake-up
+        bool correct = true;
+        for (unsigned int capacity : { 2u, 3u })
+        {
+            Samples handoff;
+            FrameMailbox<Packet>::Stats stats;
+            for (int i = 0; i < Iterations; i++)
+                correct &= RunPipeline(capacity, HandoffPackets, 0.0, handoff, stats);
+            handoff.Print("Handoff, " + std::to_string(capacity) + " slots");
+            std::cout << "    " << std::setprecision(1) << handoff.Average() * 1.0e6 / HandoffPackets << " ns per packet" << std::endl;
+        }
+
+        // Overlap: on two cores the pipeline takes about the time of one side, one thread takes the sum of both
+        Samples serial;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            for (int packet = 0; packet < FramePackets; packet++)
+            {
+                Spin(WorkUs);
+                Spin(WorkUs);
+            }
+            serial.Add(start, Clock::now());
+        }
+        serial.Print("One thread");
+
+        double bestSpeedup = 0.0;
+        for (unsigned int capacity : { 2u, 3u })
+        {
+            Samples pipelined;
+            FrameMailbox<Packet>::Stats stats;
+            for (int i = 0; i < Iterations; i++)
+                correct &= RunPipeline(capacity, FramePackets, WorkUs, pipelined, stats);
+            pipelined.Print("Pipelined, " + std::to_string(capacity) + " slots");
+
+            const double speedup = serial.Average() / pipelined.Average();
+            bestSpeedup = std::max(bestSpeedup, speedup);
+            std::cout << "    " << std::setprecision(2) << speedup << "x, depth " << (double)stats.Depth / stats.Packets << ", age "
+                << std::setprecision(3) << stats.AgeMs / stats.Packets << " ms, producer waited " << stats.ProducerWaitMs / stats.Packets
+                << " ms and consumer " << stats.ConsumerWaitMs / stats.Packets << " ms per packet" << std::endl;
+        }
+
+        // Only a machine with a second core can overlap the two sides
+        const bool overlapped = std::thread::hardware_concurrency() < 2 || bestSpeedup > 1.5;
+        std::cout << "    " << (correct ? "in order" : "OUT OF ORDER") << ", " << (overlapped ? "overlapped" : "NOT OVERLAPPED") << std::endl;
+        return correct && overlapped;
+    }
+
+    // The pool of the application, or one with a worker if it has none (single core): the jobs have to go through the deques
+    WorkerPool& GetJobBenchmarkPool()
+    {
+        if (WorkerPool::Instance().GetThreadCount() > 1)
+            return WorkerPool::Instance();
+
+        static WorkerPool pool(WorkerPool::Settings{ 1, 0, false });
+        return pool;
+    }
+
+    bool JobOverhead()
+    {
+        constexpr int JobCount = 100000;
+        constexpr unsigned int IndexCount = 1000000;
+        constexpr int Iterations = 20;
+
+        WorkerPool& workers = GetJobBenchmarkPool();
+        std::cout << "[job-overhead] Scheduling cost on " << workers.GetThreadCount() << " thread(s): " << JobCount
+            << " empty jobs, then a parallel for over " << IndexCount << " empty indices" << std::endl;
+
+        // One job per call, all of them from this thread, stolen by the others
+        std::atomic<int> ran{ 0 };
+        Samples jobs;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            WorkerPool::Counter counter;
+            for (int job = 0; job < JobCount; job++)
+                workers.Run(counter, [&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+            workers.Wait(counter);
+            jobs.Add(start, Clock::now());
+        }
+
+        // The splitting of a parallel for, with the default grain and with one index per job
+        std::vector<uint8_t> visited(IndexCount, 0);
+        Samples coarse, fine;
+        for (int i = 0; i < Iterations; i++)
+        {
+            auto start = Clock::now();
+            workers.ParallelFor(IndexCount, [&](unsigned int index, unsigned int) { visited[index]++; });
+            coarse.Add(start, Clock::now());
+
+            start = Clock::now();
+            workers.ParallelFor(IndexCount / 10, [&](unsigned int index, unsigned int) { visited[index]++; }, 1);
+            fine.Add(start, Clock::now());
+        }
+
+        bool correct = ran.load() == JobCount * Iterations;
+        for (unsigned int index = 0; index < IndexCount && correct; index++)
+            correct = visited[index] == (index < IndexCount / 10 ? 2 * Iterations : Iterations);
+
+        jobs.Print("Run + Wait, " + std::to_string(JobCount) + " jobs");
+        coarse.Print("ParallelFor, default grain");
+        fine.Print("ParallelFor, grain 1 (" + std::to_string(IndexCount / 10) + ")");
+        const WorkerPool::Stats stats = workers.GetStats();
+        std::cout << "    " << std::setprecision(1) << jobs.Average() * 1.0e6 / JobCount << " ns per job, "
+            << coarse.Average() * 1.0e6 / IndexCount << " ns per index, " << fine.Average() * 1.0e7 / IndexCount << " ns per index at grain 1 | "
+            << stats.Steals << " steals, " << stats.Sleeps << " sleeps so far, every job " << (correct ? "ran once" : "DID NOT RUN ONCE") << std::endl;
+        return correct;
+    }
+
+    bool JobForkJoin()
+    {
+        constexpr int Iterations = 10000;
+
+        // One empty task per thread: the time from the fork to the last of them joining, what a frame pays per parallel step
+        WorkerPool& workers = GetJobBenchmarkPool();
+        const unsigned int threadCount = workers.GetThreadCount();
+        std::vector<unsigned int> counts(threadCount, 0);
+        Samples latency;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            workers.ParallelFor(threadCount, [&](unsigned int index, unsigned int) { counts[index]++; }, 1);
+            latency.Add(start, Clock::now());
+        }
+
+        // Nested: every task forks again, jobs wait on jobs
+        Samples nested;
+        std::atomic<unsigned int> inner{ 0 };
+        for (int i = 0; i < Iterations / 10; i++)
+        {
+            const auto start = Clock::now();
+            workers.ParallelFor(threadCount, [&](unsigned int, unsigned int)
+            {
+                workers.ParallelFor(16, [&](unsigned int, unsigned int) { inner.fetch_add(1, std::memory_order_relaxed); }, 1);
+            }, 1);
+            nested.Add(start, Clock::now());
+        }
+
+        bool correct = inner.load() == threadCount * 16 * (Iterations / 10);
+        for (unsigned int count : counts)
+            correct &= count == Iterations;
+
+        std::cout << "[job-fork-join] " << Iterations << " forks of " << threadCount << " empty task(s)" << std::endl;
+        latency.Print("Fork-join");
+        nested.Print("Nested fork-join, 16 per task");
+        std::cout << "    " << std::setprecision(2) << "p50 " << latency.Percentile(50.0) * 1000.0 << " us, p99 "
+            << latency.Percentile(99.0) * 1000.0 << " us, " << (correct ? "every task joined" : "TASKS MISSING") << std::endl;
+        return correct;
+    }
+
+    bool JobScaling()
+    {
+        constexpr unsigned int ItemCount = 4096;
+        constexpr unsigned int WorkPerItem = 2000;
+        constexpr int Iterations = 5;
+
+        // Uneven items (the cost grows with the index) so that the threads finishing early have to steal
+        auto work = [](unsigned int index)
+        {
+            uint32_t value = index * 2654435761u + 1;
+            const unsigned int rounds = WorkPerItem / 2 + WorkPerItem * (index % 64) / 64;
+            for (unsigned int i = 0; i < rounds; i++)
+            {
+                value ^= value << 13;
+                value ^= value >> 17;
+                value ^= value << 5;
+            }
+            return value;
+        };
+
+        std::vector<uint32_t> expected(ItemCount);
+        for (unsigned int index = 0; index < ItemCount; index++)
+            expected[index] = work(index);
+
+        const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << "[job-scaling] " << ItemCount << " uneven items on pools of 1 to 64 threads, " << cores << " core(s)" << std::endl;
+
+        // One thread is the plain loop, Workers = 0 would mean one per core
+        std::vector<uint32_t> results(ItemCount);
+        Samples serial;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            for (unsigned int index = 0; index < ItemCount; index++)
+                results[index] = work(index);
+            serial.Add(start, Clock::now());
+        }
+        serial.Print("1 thread (serial loop)");
+
+        bool correct = results == expected;
+        for (unsigned int threads = 2; threads <= 64; threads *= 2)
+        {
+            WorkerPool::Settings settings;
+            settings.Workers = threads - 1;
+            settings.ReservedThreads = 0;
+            WorkerPool pool(settings);
+            correct &= pool.GetThreadCount() == threads;
+
+            Samples samples;
+            for (int i = 0; i < Iterations; i++)
+            {
+                std::fill(results.begin(), results.end(), 0u);
+                const auto start = Clock::now();
+                pool.ParallelFor(ItemCount, [&](unsigned int index, unsigned int) { results[index] = work(index); });
+                samples.Add(start, Clock::now());
+            }
+            correct &= results == expected;
+
+            const WorkerPool::Stats stats = pool.GetStats();
+            samples.Print(std::to_string(threads) + " thread(s)" + (threads > cores ? " (oversubscribed)" : ""));
+            std::cout << "    " << std::setprecision(2) << serial.Average() / samples.Average() << "x, " << stats.Steals << " steals, "
+                << stats.Sleeps << " sleeps" << std::endl;
+        }
+
+        std::cout << "    Results " << (correct ? "match" : "DO NOT MATCH") << " the serial run" << std::endl;
+        return correct;
+    }
+
+    bool TransformUpdate()
+    {
+        constexpr size_t TransformCount = 1000000;
+        constexpr int Iterations = 20;
+        constexpr double BudgetMs = 1000.0 / 60.0; // A frame at 60 Hz, on one core
+
+        // Random translations, rotations and scales. Objects of a kind are created together, as in the scene, and most keep
+        // their proportions: the last eighth of the transforms is stretched and needs its own normal matrices.
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f), scale(0.25f, 4.0f);
+        TransformStore transforms;
+        transforms.Reserve(TransformCount);
+        for (size_t i = 0; i < TransformCount; i++)
+        {
+            const glm::quat rotation(unit(random), unit(random), unit(random), unit(random));
+            const glm::vec3 scales = i >= TransformCount / 8 * 7 ? glm::vec3(scale(random), scale(random), scale(random)) : glm::vec3(scale(random));
+            transforms.Create(glm::vec3(unit(random), unit(random), unit(random)) * 100.0f, rotation, scales);
+        }
+        const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+            * glm::lookAt(glm::vec3(0.0f, 50.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        // The matrices glm gives for a sample of the transforms
+        std::vector<size_t> checked;
+        for (size_t i = 0; i < TransformCount; i += 997)
+            checked.push_back(i);
+        std::vector<glm::mat4> expectedWorld, expectedNormal, expectedWorldViewProjection;
+        for (size_t i : checked)
+        {
+            const TransformStore::Handle handle = (TransformStore::Handle)i;
+            const glm::mat4 world = glm::scale(glm::translate(glm::mat4(1.0f), transforms.GetPosition(handle)) * glm::mat4_cast(transforms.GetRotation(handle)), transforms.GetScale(handle));
+            expectedWorld.push_back(world);
+            expectedNormal.push_back(glm::mat4(glm::transpose(glm::inverse(glm::mat3(world)))));
+            expectedWorldViewProjection.push_back(viewProjection * world);
+        }
+        auto matches = [&]()
+        {
+            auto close = [](const glm::mat4& a, const glm::mat4& b)
+            {
+                for (int column = 0; column < 4; column++)
+                    for (int row = 0; row < 4; row++)
+                        if (std::abs(a[column][row] - b[column][row]) > 1e-4f * std::max(1.0f, std::abs(b[column][row])))
+                            return false;
+                return true;
+            };
+            bool correct = true;
+            for (size_t sample = 0; sample < checked.size() && correct; sample++)
+            {
+                const TransformStore::Handle handle = (TransformStore::Handle)checked[sample];
+                const glm::mat3x4 normal = transforms.GetNormal(handle);
+                correct = close(transforms.GetWorld(handle), expectedWorld[sample])
+                    && close(glm::mat4(glm::mat3(glm::vec3(normal[0]), glm::vec3(normal[1]), glm::vec3(normal[2]))), expectedNormal[sample])
+                    && close(transforms.GetWorldViewProjection(handle), expectedWorldViewProjection[sample]);
+            }
+            return correct;
+        };
+
+        std::cout << "[transforms] " << TransformCount << " transforms, world, normal and world-view-projection matrices, "
+            << TransformStore::GetSimdName(TransformStore::GetSupportedSimd()) << " supported" << std::endl;
+
+        // The first update allocates the matrices, and faults their pages in
+        transforms.Update(&viewProjection);
+
+        bool correct = true;
+        double bestWorld = 0.0, bestAll = 0.0;
+        for (TransformStore::Simd simd : { TransformStore::Simd::Scalar, TransformStore::Simd::SSE, TransformStore::Simd::AVX2 })
+        {
+            if (simd > TransformStore::GetSupportedSimd())
+                continue;
+            transforms.SetSimd(simd);
+
+            Samples worldOnly, all;
+            for (int i = 0; i < Iterations; i++)
+            {
+                auto start = Clock::now();
+                transforms.Update();
+                worldOnly.Add(start, Clock::now());
+
+                start = Clock::now();
+                transforms.Update(&viewProjection);
+                all.Add(start, Clock::now());
+            }
+            correct &= matches();
+            bestWorld = worldOnly.Average();
+            bestAll = all.Average();
+
+            const std::string name = TransformStore::GetSimdName(simd);
+            worldOnly.Print(name + ", world and normal");
+            all.Print(name + ", with world-view-projection");
+        }
+
+        // The widest path again, spread across the worker pool
+        WorkerPool& workers = WorkerPool::Instance();
+        transforms.SetSimd(TransformStore::GetSupportedSimd());
+        Samples parallel;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            transforms.Update(&viewProjection, &workers);
+            parallel.Add(start, Clock::now());
+        }
+        correct &= matches();
+        parallel.Print("Worker pool, " + std::to_string(workers.GetThreadCount()) + " thread(s)");
+
+        // The instance data only needs the world and normal matrices, the world-view-projection ones are optional
+        const bool withinBudget = bestWorld <= BudgetMs;
+        std::cout << "    " << std::setprecision(1) << bestWorld * 1.0e6 / TransformCount << " ns per transform on one core ("
+            << bestAll * 1.0e6 / TransformCount << " ns with world-view-projection), " << (withinBudget ? "within" : "OVER") << " the "
+            << std::setprecision(2) << BudgetMs << " ms frame, results " << (correct ? "match" : "DO NOT MATCH") << " glm" << std::endl;
+        return correct && withinBudget;
+    }
+
+    // Components of the entity registry benchmark, the sizes of the scene's (a handle, a sphere, a light)
+    struct EcsPosition { glm::vec3 Value; };
+    struct EcsVelocity { glm::vec3 Value; };
+    struct EcsBounds { glm::vec3 Center; float Radius; };
+
+    bool EntityRegistryAccess()
+    {
+        constexpr size_t EntityCount = 1000000;
+        constexpr int Iterations = 10;
+        constexpr float Step = 1.0f / 60.0f;
+
+        std::cout << "[ecs] " << EntityCount << " entities with a position and a velocity, every other one with bounds" << std::endl;
+
+        // Creation with components, into a fresh registry each time
+        Samples creation;
+        std::unique_ptr<EntityRegistry> registry;
+        std::vector<EntityRegistry::Entity> entities(EntityCount);
+        for (int i = 0; i < Iterations; i++)
+        {
+            registry = std::make_unique<EntityRegistry>();
+            const auto start = Clock::now();
+            registry->Reserve(EntityCount);
+            for (size_t e = 0; e < EntityCount; e++)
+            {
+                entities[e] = registry->Create();
+                registry->Add<EcsPosition>(entities[e], glm::vec3((float)e, 0.0f, 0.0f));
+                registry->Add<EcsVelocity>(entities[e], glm::vec3(1.0f, (float)(e & 7), 0.0f));
+                if (e % 2 == 0)
+                    registry->Add<EcsBounds>(entities[e], glm::vec3(0.0f), 1.0f);
+            }
+            creation.Add(start, Clock::now());
+        }
+        creation.Print("Create, 2.5M components");
+        bool correct = registry->GetCount() == EntityCount && registry->GetPool<EcsBounds>().GetSize() == EntityCount / 2;
+
+        // One component, walked in dense order
+        Samples single;
+        float sum = 0.0f;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            float x = 0.0f;
+            registry->Each<EcsVelocity>([&x](EntityRegistry::Entity, const EcsVelocity& velocity) { x += velocity.Value.y; });
+            single.Add(start, Clock::now());
+            sum = x;
+        }
+        correct &= sum == 3.5f * EntityCount;
+        single.Print("Each<Velocity>");
+
+        // Two components, the second one looked up through the sparse array
+        Samples pair;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            registry->Each<EcsPosition, EcsVelocity>([Step](EntityRegistry::Entity, EcsPosition& position, const EcsVelocity& velocity)
+            {
+                position.Value += velocity.Value * Step;
+            });
+            pair.Add(start, Clock::now());
+        }
+        pair.Print("Each<Position, Velocity>");
+
+        // The smaller pool drives the loop
+        Samples sparse;
+        size_t visited = 0;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            visited = 0;
+            registry->Each<EcsPosition, EcsBounds>([&visited](EntityRegistry::Entity, const EcsPosition& position, EcsBounds& bounds)
+            {
+                bounds.Center = position.Value;
+                visited++;
+            });
+            sparse.Add(start, Clock::now());
+        }
+        correct &= visited == EntityCount / 2;
+        sparse.Print("Each<Position, Bounds>, half match");
+
+        WorkerPool& workers = WorkerPool::Instance();
+        Samples parallel;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            registry->ParallelEach<EcsPosition, EcsVelocity>(workers, [Step](EntityRegistry::Entity, EcsPosition& position, const EcsVelocity& velocity, unsigned int)
+            {
+                position.Value += velocity.Value * Step;
+            });
+            parallel.Add(start, Clock::now());
+        }
+        parallel.Print("ParallelEach, " + std::to_string(workers.GetThreadCount()) + " thread(s)");
+
+        // Both loops moved every entity by 2 * Iterations steps of its velocity
+        for (size_t e = 0; e < EntityCount && correct; e += 997)
+        {
+            const glm::vec3 expected = glm::vec3((float)e, 0.0f, 0.0f) + glm::vec3(1.0f, (float)(e & 7), 0.0f) * (Step * 2 * Iterations);
+            const glm::vec3 value = registry->Get<EcsPosition>(entities[e]).Value;
+            correct = glm::all(glm::lessThanEqual(glm::abs(value - expected), glm::vec3(1e-3f * std::max(1.0f, (float)e))));
+        }
+
+        // Random access by handle, in shuffled order
+        std::vector<EntityRegistry::Entity> shuffled = entities;
+        std::mt19937 random(11);
+        std::shuffle(shuffled.begin(), shuffled.end(), random);
+        Samples lookups;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            float y = 0.0f;
+            for (EntityRegistry::Entity entity : shuffled)
+                y += registry->Get<EcsVelocity>(entity).Value.y;
+            lookups.Add(start, Clock::now());
+            sum = y;
+        }
+        correct &= sum == 3.5f * EntityCount;
+        lookups.Print("Get<Velocity>, random order");
+
+        // Destroy a random half, then create as many again: the indices are reused and the old handles stay dead
+        Samples churn;
+        const size_t half = EntityCount / 2;
+        for (int i = 0; i < Iterations; i++)
+        {
+            std::shuffle(entities.begin(), entities.end(), random);
+            const auto start = Clock::now();
+            for (size_t e = 0; e < half; e++)
+                registry->Destroy(entities[e]);
+            for (size_t e = 0; e < half; e++)
+            {
+                const EntityRegistry::Entity stale = entities[e];
+                entities[e] = registry->Create();
+                registry->Add<EcsPosition>(entities[e], glm::vec3(0.0f));
+                registry->Add<EcsVelocity>(entities[e], glm::vec3(0.0f));
+                correct &= !registry->IsAlive(stale);
+            }
+            churn.Add(start, Clock::now());
+        }
+        churn.Print("Destroy and create 50%");
+
+        uint32_t highestIndex = 0;
+        for (EntityRegistry::Entity entity : entities)
+        {
+            correct &= registry->IsAlive(entity) && registry->Has<EcsVelocity>(entity);
+            highestIndex = std::max(highestIndex, EntityRegistry::GetIndex(entity));
+        }
+        correct &= registry->GetCount() == EntityCount && highestIndex < EntityCount
+            && registry->GetPool<EcsPosition>().GetSize() == EntityCount;
+
+        std::cout << "    " << std::setprecision(1) << pair.Average() * 1.0e6 / EntityCount << " ns per entity iterated, "
+            << lookups.Average() * 1.0e6 / EntityCount << " ns per random lookup, "
+            << creation.Average() * 1.0e6 / EntityCount << " ns per entity created, results " << (correct ? "match" : "DO NOT MATCH") << std::endl;
+        return correct;
+    }
+
+    // A frame of a bigger renderer than the sandbox: shadows, depth prepass, G-buffer, SSAO, deferred lighting, a bloom
+    // chain and post-processing into the window, plus a debug view nothing reads. Only declares passes, nothing runs.
+    void DeclareFrame(RenderGraph& graph, unsigned int width, unsigned int height)
+    {
+        auto none = [](const RenderGraph::Context&) {};
+
+        RenderGraph::Handle output = graph.ImportFramebuffer("Output", 0, width, height);
+        RenderGraph::Handle shadowMap = graph.ImportTexture("Shadow map", 1, { 2048, 2048, GL_DEPTH_COMPONENT24 });
+        RenderGraph::Handle depth, albedo, normal, ssao, occlusion, hdr, tonemapped;
+
+        graph.AddPass("Shadows", [&](RenderGraph::Builder& b) { shadowMap = b.Write(shadowMap, GL_DEPTH_ATTACHMENT); }, none);
+        graph.AddPass("Depth prepass", [&](RenderGraph::Builder& b)
+        {
+            depth = b.Write(b.Create("Depth", { width, height, GL_DEPTH24_STENCIL8 }), GL_DEPTH_STENCIL_ATTACHMENT);
+        }, none);
+        graph.AddPass("G-buffer", [&](RenderGraph::Builder& b)
+        {
+            depth = b.Write(depth, GL_DEPTH_STENCIL_ATTACHMENT);
+            albedo = b.Write(b.Create("Albedo", { width, height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+            normal = b.Write(b.Create("Normal", { width, height, GL_RG16 }), GL_COLOR_ATTACHMENT1);
+        }, none);
+        graph.AddPass("SSAO", [&](RenderGraph::Builder& b)
+        {
+            b.Read(depth);
+            b.Read(normal);
+            ssao = b.Write(b.Create("SSAO", { width, height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+        }, none);
+        graph.AddPass("SSAO blur", [&](RenderGraph::Builder& b)
+        {
+            b.Read(ssao);
+            occlusion = b.Write(b.Create("Occlusion", { width, height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+        }, none);
+        graph.AddPass("Debug normals", [&](RenderGraph::Builder& b)
+        {
+            b.Read(normal);
+            b.Write(b.Create("Debug view", { width, height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+        }, none);
+        graph.AddPass("Lighting", [&](RenderGraph::Builder& b)
+        {
+            b.Read(albedo);
+            b.Read(normal);
+            b.Read(depth);
+            b.Read(occlusion);
+            b.Read(shadowMap);
+            hdr = b.Write(b.Create("HDR", { width, height, GL_RGBA16F }), GL_COLOR_ATTACHMENT0);
+        }, none);
+
+        // Down to 1/16, then back up, each level blended into the one above
+        constexpr int BloomLevels = 4;
+        RenderGraph::Handle down[BloomLevels];
+        for (int level = 0; level < BloomLevels; level++)
+        {
+            graph.AddPass("Bloom down " + std::to_string(level), [&](RenderGraph::Builder& b)
+            {
+                b.Read(level == 0 ? hdr : down[level - 1]);
+                down[level] = b.Write(b.Create("Bloom " + std::to_string(level), { width >> (level + 1), height >> (level + 1), GL_RGBA16F }), GL_COLOR_ATTACHMENT0);
+            }, none);
+        }
+        RenderGraph::Handle bloom = down[BloomLevels - 1];
+        for (int level = BloomLevels - 2; level >= 0; level--)
+        {
+            graph.AddPass("Bloom up " + std::to_string(level), [&](RenderGraph::Builder& b)
+            {
+                b.Read(bloom);
+                bloom = b.Write(b.Create("Bloom up " + std::to_string(level), { width >> (level + 1), height >> (level + 1), GL_RGBA16F }), GL_COLOR_ATTACHMENT0);
+            }, none);
+        }
+
+        graph.AddPass("Tonemap", [&](RenderGraph::Builder& b)
+        {
+            b.Read(hdr);
+            b.Read(bloom);
+            tonemapped = b.Write(b.Create("Tonemapped", { width, height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+        }, none);
+        graph.AddPass("FXAA", [&](RenderGraph::Builder& b)
+        {
+            b.Read(tonemapped);
+            output = b.Write(output, GL_COLOR_ATTACHMENT0);
+        }, none);
+    }
+
+    bool RenderGraphCompile()
+    {
+        constexpr unsigned int Width = 1920, Height = 1080;
+        constexpr int Iterations = 100;
+        constexpr int FramesPerIteration = 100;
+
+        RenderGraph graph;
+        std::cout << "[render-graph] 16 passes at " << Width << "x" << Height << ", declared and compiled every frame" << std::endl;
+
+        // Without aliasing every transient target has its own texture
+        graph.SetAliasing(false);
+        DeclareFrame(graph, Width, Height);
+        graph.Compile();
+        const RenderGraph::Stats separate = graph.GetStats();
+
+        graph.SetAliasing(true);
+        Samples compile;
+        for (int i = 0; i < Iterations; i++)
+        {
+            const auto start = Clock::now();
+            for (int frame = 0; frame < FramesPerIteration; frame++)
+            {
+                graph.Reset();
+                DeclareFrame(graph, Width, Height);
+                graph.Compile();
+            }
+            compile.Add(start, Clock::now());
+        }
+        compile.Print("Declare and compile, x" + std::to_string(FramesPerIteration));
+        const RenderGraph::Stats& aliased = graph.GetStats();
+
+        // The debug view is culled, every other pass runs after the passes it reads from
+        std::map<std::string, size_t> position;
+        for (size_t i = 0; i < graph.GetOrder().size(); i++)
+            position[graph.GetPassName(graph.GetOrder()[i])] = i;
+        bool correct = aliased.Passes == 16 && aliased.CulledPasses == 1 && position.count("Debug normals") == 0;
+        const std::pair<const char*, const char*> dependencies[] =
+        {
+            { "Depth prepass", "G-buffer" }, { "G-buffer", "SSAO" }, { "SSAO", "SSAO blur" }, { "SSAO blur", "Lighting" },
+            { "Shadows", "Lighting" }, { "Lighting", "Bloom down 0" }, { "Bloom down 3", "Bloom up 2" }, { "Bloom up 0", "Tonemap" },
+            { "Tonemap", "FXAA" },
+        };
+        for (const auto& [before, after] : dependencies)
+            correct &= position.count(before) && position.count(after) && position[before] < position[after];
+
+        // Same targets either way, fewer textures when their lifetimes allow it
+        correct &= separate.TransientResources == aliased.TransientResources && separate.PhysicalResources == separate.TransientResources
+            && separate.AliasedBytes == separate.TransientBytes && aliased.TransientBytes == separate.TransientBytes
+            && aliased.PhysicalResources < aliased.TransientResources && aliased.AliasedBytes < aliased.TransientBytes;
+
+        // A pass culled for writing nothing must not take the writer of what it read along, another pass still reads it
+        RenderGraph shared;
+        RenderGraph::Handle sharedOutput = shared.ImportFramebuffer("Output", 0, Width, Height);
+        RenderGraph::Handle x, y;
+        shared.AddPass("A", [&](RenderGraph::Builder& b)
+        {
+            x = b.Write(b.Create("X", { Width, Height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+            y = b.Write(b.Create("Y", { Width, Height, GL_RGBA8 }), GL_COLOR_ATTACHMENT1);
+        }, nullptr);
+        shared.AddPass("B", [&](RenderGraph::Builder& b) { b.Read(x); }, nullptr);
+        shared.AddPass("C", [&](RenderGraph::Builder& b) { b.Read(y); sharedOutput = b.Write(sharedOutput, GL_COLOR_ATTACHMENT0); }, nullptr);
+        shared.Compile();
+        correct &= shared.GetOrder() == std::vector<uint32_t>{ 0, 2 } && shared.IsCulled(1) && shared.GetStats().CulledPasses == 1;
+
+        // A chain whose last reader writes nothing goes as a whole, one pass after the other. When the last link also writes
+        // what the output pass reads, only the reader goes.
+        for (bool sideOutput : { false, true })
+        {
+            RenderGraph chain;
+            RenderGraph::Handle chainOutput = chain.ImportFramebuffer("Output", 0, Width, Height);
+            RenderGraph::Handle link, side;
+            chain.AddPass("Chain 0", [&](RenderGraph::Builder& b) { link = b.Write(b.Create("Link 0", { Width, Height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0); }, nullptr);
+            for (int i = 1; i < 4; i++)
+            {
+                chain.AddPass("Chain " + std::to_string(i), [&](RenderGraph::Builder& b)
+                {
+                    b.Read(link);
+                    link = b.Write(b.Create("Link " + std::to_string(i), { Width, Height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+                    if (sideOutput && i == 3)
+                        side = b.Write(b.Create("Side", { Width, Height, GL_RGBA8 }), GL_COLOR_ATTACHMENT1);
+                }, nullptr);
+            }
+            chain.AddPass("Chain reader", [&](RenderGraph::Builder& b) { b.Read(link); }, nullptr);
+            chain.AddPass("Output", [&](RenderGraph::Builder& b)
+            {
+                if (sideOutput)
+                    b.Read(side);
+                chainOutput = b.Write(chainOutput, GL_COLOR_ATTACHMENT0);
+            }, nullptr);
+            chain.Compile();
+            const std::vector<uint32_t> order = sideOutput ? std::vector<uint32_t>{ 0, 1, 2, 3, 5 } : std::vector<uint32_t>{ 5 };
+            correct &= chain.GetOrder() == order && chain.GetStats().CulledPasses == 6 - order.size() && chain.IsCulled(4);
+        }
+
+        std::cout << "    " << std::setprecision(1) << compile.Average() * 1.0e3 / FramesPerIteration << " us per frame, "
+            << aliased.TransientResources << " transient targets in " << aliased.PhysicalResources << " textures, "
+            << aliased.AliasedBytes / (1024 * 1024) << " MiB instead of " << aliased.TransientBytes / (1024 * 1024) << " MiB, results "
+            << (correct ? "match" : "DO NOT MATCH") << std::endl;
+        return correct;
+    }
+
+    bool GpuMemoryAccounting()
+    {
+        constexpr unsigned int ObjectCount = 100000;
+        constexpr int Iterations = 20;
+        constexpr size_t BufferBytes = 64 * 1024;
+
+        // Names far above what the driver hands out in a run, the registry is shared with the rest of the process
+        constexpr unsigned int FirstName = 1u << 30;
+        GpuMemory& memory = GpuMemory::Instance();
+        std::cout << "[gpu-memory] " << ObjectCount << " buffers and textures over 100 assets, allocated, respecified and released" << std::endl;
+
+        // One crossing per iteration: the budget sits between the first allocations and the respecified ones
+        const GpuMemory::CategoryStats before = memory.GetStats(GpuMemory::Category::Streaming);
+        uint32_t crossings = 0;
+        memory.SetBudget(GpuMemory::Category::Streaming, before.Bytes + (size_t)ObjectCount / 2 * BufferBytes + BufferBytes / 2);
+        memory.SetBudgetCallback([&crossings](GpuMemory::Category, size_t, size_t) { crossings++; });
+
+        std::vector<std::string> assets;
+        for (int asset = 0; asset < 100; asset++)
+            assets.push_back("Benchmark asset " + std::to_string(asset));
+
+        Samples allocate, respecify, release;
+        bool correct = true;
+        for (int i = 0; i < Iterations; i++)
+        {
+            // Even names are streaming buffers, odd names mipmapped textures
+            auto start = Clock::now();
+            for (unsigned int object = 0; object < ObjectCount; object++)
+            {
+                if (object % 2 == 0)
+                    memory.OnBufferAllocated(FirstName + object, BufferBytes, GpuMemory::Category::Streaming, assets[object % 100]);
+                else
+                    memory.OnTextureAllocated(FirstName + object, GpuMemory::GetTextureBytes(GL_RGBA8, 256, 256, 1, true), GL_RGBA8, GpuMemory::Category::Textures, assets[object % 100]);
+            }
+            allocate.Add(start, Clock::now());
+
+            // Orphaned with twice the size, the buffers keep their asset
+            start = Clock::now();
+            for (unsigned int object = 0; object < ObjectCount; object += 2)
+                memory.OnBufferAllocated(FirstName + object, BufferBytes * 2, GpuMemory::Category::Streaming, assets[object % 100]);
+            respecify.Add(start, Clock::now());
+
+            const GpuMemory::CategoryStats streaming = memory.GetStats(GpuMemory::Category::Streaming);
+            correct &= streaming.Bytes == before.Bytes + (size_t)ObjectCount / 2 * BufferBytes * 2 && streaming.Objects == before.Objects + ObjectCount / 2;
+
+            start = Clock::now();
+            for (unsigned int object = 0; object < ObjectCount; object++)
+            {
+                if (object % 2 == 0)
+                    memory.OnBufferDeleted(FirstName + object);
+                else
+                    memory.OnTextureDeleted(FirstName + object);
+            }
+            release.Add(start, Clock::now());
+        }
+        allocate.Print("Allocate");
+        respecify.Print("Respecify 50%");
+        release.Print("Release");
+
+        // Back to where it was, with the high-water mark of the respecified buffers
+        const GpuMemory::CategoryStats after = memory.GetStats(GpuMemory::Category::Streaming);
+        correct &= after.Bytes == before.Bytes && after.Objects == before.Objects && after.Peak >= before.Bytes + (size_t)ObjectCount / 2 * BufferBytes * 2
+            && crossings == (uint32_t)Iterations && after.BudgetExceeded == before.BudgetExceeded + Iterations;
+
+        // 256x256 with its mip chain: (4^9 - 1) / 3 texels
+        correct &= GpuMemory::GetTextureBytes(GL_RGBA8, 256, 256, 1, true) == 87381 * 4 && GpuMemory::GetTextureBytes(GL_DEPTH_COMPONENT24, 2048, 2048, 4) == (size_t)2048 * 2048 * 16;
+
+        // Even assets own buffers only, odd ones textures only
+        for (const GpuMemory::AssetStats& asset : memory.GetAssets())
+        {
+            if (asset.Name.compare(0, 16, "Benchmark asset ") != 0)
+                continue;
+
+            const size_t objectBytes = std::atoi(asset.Name.c_str() + 16) % 2 == 0 ? BufferBytes * 2 : GpuMemory::GetTextureBytes(GL_RGBA8, 256, 256, 1, true);
+            correct &= asset.Bytes == 0 && asset.Objects == 0 && asset.Peak == ObjectCount / 100 * objectBytes;
+        }
+
+        memory.SetBudgetCallback(nullptr);
+        memory.SetBudget(GpuMemory::Category::Streaming, 0);
+
+        std::cout << "    " << std::setprecision(1) << (allocate.Average() + respecify.Average() + release.Average()) * 1.0e6 / (ObjectCount * 2.5)
+            << " ns per registry update, results " << (correct ? "match" : "DO NOT MATCH") << std::endl;
+        return correct;
+    }
+
+    struct Benchmark
+    {
+        const char* Name;
+        std::function<bool()> Run;
+    };
+
+    const std::vector<Benchmark>& GetBenchmarks()
+    {
+        static const std::vector<Benchmark> benchmarks =
+        {
+            { "render-queue", RenderQueueSort },
+            { "command-recording", CommandRecording },
+            { "geometry-arena", GeometryArenaAllocator },
+            { "clustered-lights", ClusteredLightAssignment },
+            { "cpu-profiler", CpuProfilerZones },
+            { "frame-mailbox", FrameMailboxHandoff },
+            { "job-overhead", JobOverhead },
+            { "job-fork-join", JobForkJoin },
+            { "job-scaling", JobScaling },
+            { "transforms", TransformUpdate },
+            { "ecs", EntityRegistryAccess },
+            { "render-graph", RenderGraphCompile },
+            { "gpu-memory", GpuMemoryAccounting },
+        };
+        return benchmarks;
+    }
+}
+
+int RunBenchmarks(const std::string& name)
+{
+    bool found = false, success = true;
+    for (const auto& benchmark : GetBenchmarks())
+    {
+        if (name != "all" && name != benchmark.Name)
+            continue;
+
+        found = true;
+        success &= benchmark.Run();
+    }
+
+    if (!found)
+    {
+        std::cerr << "[ERROR]: Unknown benchmark '" << name << "', available benchmarks:";
+        for (const auto& benchmark : GetBenchmarks())
+            std::cerr << " " << benchmark.Name;
+        std::cerr << " all" << std::endl;
+        return 1;
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// CPU micro benchmarks of the engine systems, they do not need a window or a GL context.
+// Run with "OpenGL-Sandbox --bench <name>" or "--bench all", returns a non zero exit code if a result is wrong.
+int RunBenchmarks(const std::string& name);
@@ -51,6 +51,15 @@ void Camera::OnMouseScroll(float yOffset)
         m_FOV = 45.0f;
 }
 
+void Camera::SetPose(const glm::vec3& position, float yaw, float pitch, float fov)
+{
+    m_Position = position;
+    m_Yaw = yaw;
+    m_Pitch = pitch;
+    m_FOV = fov;
+    UpdateProjection();
+}
+
 void Camera::UpdateProjection()
 {
     glm::vec3 direction{};
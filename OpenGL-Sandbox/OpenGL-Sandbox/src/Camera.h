@@ -27,6 +27,9 @@ public:
     void OnKeyPressed(float deltaTime, CameraMovement direction);
     void OnMouseMove(glm::vec2 offset, bool constrainPitch = true);
     void OnMouseScroll(float yOffset);
+
+    // Replaces the pose, for scripted cameras (benchmark paths)
+    void SetPose(const glm::vec3& position, float yaw, float pitch, float fov);
 private:
     void UpdateProjection();
 private:
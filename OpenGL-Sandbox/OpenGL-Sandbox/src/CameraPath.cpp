@@ -0,0 +1,118 @@
+#include "CameraPath.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bool CameraPath::Load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "[ERROR]: Could not open camera path '" << path << "'" << std::endl;
+        return false;
+    }
+
+    m_Keyframes.clear();
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        Keyframe keyframe;
+        std::istringstream values(line);
+        if (!(values >> keyframe.Time >> keyframe.Position.x >> keyframe.Position.y >> keyframe.Position.z >> keyframe.Yaw >> keyframe.Pitch >> keyframe.FOV))
+        {
+            std::cerr << "[ERROR]: " << path << ":" << lineNumber << ": expected \"time x y z yaw pitch fov\"" << std::endl;
+            return false;
+        }
+        if (!m_Keyframes.empty() && keyframe.Time <= m_Keyframes.back().Time)
+        {
+            std::cerr << "[ERROR]: " << path << ":" << lineNumber << ": keyframe times must increase" << std::endl;
+            return false;
+        }
+        m_Keyframes.push_back(keyframe);
+    }
+
+    if (m_Keyframes.empty())
+        std::cout << "[WARNING]: Camera path '" << path << "' has no keyframes" << std::endl;
+    return true;
+}
+
+bool CameraPath::Save(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "[ERROR]: Could not open '" << path << "' for writing" << std::endl;
+        return false;
+    }
+
+    // Times are written from the first keyframe, a recording then replays from the start of the run
+    file << "# time x y z yaw pitch fov\n" << std::setprecision(7);
+    for (const Keyframe& keyframe : m_Keyframes)
+    {
+        file << keyframe.Time - m_Keyframes.front().Time << " " << keyframe.Position.x << " " << keyframe.Position.y << " " << keyframe.Position.z << " "
+            << keyframe.Yaw << " " << keyframe.Pitch << " " << keyframe.FOV << "\n";
+    }
+    return (bool)file;
+}
+
+CameraPath::Keyframe CameraPath::Sample(float time) const
+{
+    if (m_Keyframes.empty())
+        return Keyframe();
+    if (time <= m_Keyframes.front().Time)
+        return m_Keyframes.front();
+    if (time >= m_Keyframes.back().Time)
+        return m_Keyframes.back();
+
+    // Segment [i, i + 1] holding 'time', its outer neighbours shape the curve
+    const auto next = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), time, [](float t, const Keyframe& keyframe) { return t < keyframe.Time; });
+    const size_t i = (size_t)(next - m_Keyframes.begin()) - 1;
+    const Keyframe& k1 = m_Keyframes[i];
+    const Keyframe& k2 = m_Keyframes[i + 1];
+    const Keyframe& k0 = m_Keyframes[i > 0 ? i - 1 : i];
+    const Keyframe& k3 = m_Keyframes[std::min(i + 2, m_Keyframes.size() - 1)];
+
+    const float t = (time - k1.Time) / (k2.Time - k1.Time);
+    const float t2 = t * t, t3 = t2 * t;
+
+    Keyframe sample;
+    sample.Time = time;
+    sample.Position = 0.5f * ((2.0f * k1.Position) + (k2.Position - k0.Position) * t
+        + (2.0f * k0.Position - 5.0f * k1.Position + 4.0f * k2.Position - k3.Position) * t2
+        + (3.0f * k1.Position - k0.Position - 3.0f * k2.Position + k3.Position) * t3);
+    sample.Yaw = k1.Yaw + (k2.Yaw - k1.Yaw) * t;
+    sample.Pitch = k1.Pitch + (k2.Pitch - k1.Pitch) * t;
+    sample.FOV = k1.FOV + (k2.FOV - k1.FOV) * t;
+    return sample;
+}
+
+CameraPath CameraPath::Orbit(const glm::vec3& center, float radius, float height, float period, unsigned int keyframeCount)
+{
+    CameraPath path;
+    keyframeCount = std::max(keyframeCount, 4u);
+    const float pitch = glm::degrees(-std::atan2(height, radius));
+    for (unsigned int i = 0; i <= keyframeCount; i++)
+    {
+        const float angle = glm::two_pi<float>() * i / keyframeCount;
+        Keyframe keyframe;
+        keyframe.Time = period * i / keyframeCount;
+        keyframe.Position = center + glm::vec3(std::cos(angle) * radius, height, std::sin(angle) * radius);
+        // Yaw keeps increasing past 360 so that the linear interpolation never turns the long way round
+        keyframe.Yaw = glm::degrees(angle) + 180.0f;
+        keyframe.Pitch = pitch;
+        path.Add(keyframe);
+    }
+    return path;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Camera poses over time for repeatable runs (benchmarks, golden images). Keyframes are written by hand or recorded
+// from an interactive session, positions follow a Catmull-Rom spline through them and the angles are interpolated
+// linearly. Text file, one keyframe per line: "time x y z yaw pitch fov", '#' starts a comment.
+class CameraPath
+{
+public:
+    struct Keyframe
+    {
+        float Time = 0.0f; // Seconds, increasing
+        glm::vec3 Position{ 0.0f };
+        float Yaw = -90.0f, Pitch = 0.0f, FOV = 45.0f;
+    };
+
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    // Keyframes must be added in time order
+    void Add(const Keyframe& keyframe) { m_Keyframes.push_back(keyframe); }
+
+    // Pose at 'time', clamped to the ends of the path
+    Keyframe Sample(float time) const;
+
+    bool IsEmpty() const { return m_Keyframes.empty(); }
+    float GetDuration() const { return m_Keyframes.empty() ? 0.0f : m_Keyframes.back().Time - m_Keyframes.front().Time; }
+    size_t GetKeyframeCount() const { return m_Keyframes.size(); }
+
+    // Circle of 'radius' around 'center' at 'height' above it, looking at the center, once per 'period' seconds
+    static CameraPath Orbit(const glm::vec3& center, float radius, float height, float period, unsigned int keyframeCount = 16);
+private:
+    std::vector<Keyframe> m_Keyframes;
+};
@@ -0,0 +1,334 @@
+#include "ClusteredLights.h"
+#include "CpuProfiler.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "ShaderLayout.h"
+#include "WorkerPool.h"
+
+#include <glad/glad.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLUSTERED_LIGHTS_SSE 1
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    // Smaller chunks do not pay for waking the workers up
+    constexpr size_t MinLightsPerChunk = 256;
+
+    const char* const SamplerNames[] = { "u_LightData", "u_ClusterData", "u_LightIndices" };
+    const GLenum TextureFormats[] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+}
+
+ClusteredLights::~ClusteredLights()
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if (m_Textures[i] == 0)
+            continue;
+
+        GLState::OnTextureDeleted(m_Textures[i]);
+        GLState::OnBufferDeleted(m_Buffers[i]);
+        GpuMemory::Instance().OnBufferDeleted(m_Buffers[i]);
+        glDeleteTextures(1, &m_Textures[i]);
+        glDeleteBuffers(1, &m_Buffers[i]);
+    }
+}
+
+void ClusteredLights::Build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+    PROFILE_SCOPE("Cluster lights");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Froxel bounds only depend on the projection, they are rebuilt when it changes (FOV zoom, resize)
+    if (projection != m_BoundsProjection || nearPlane != m_BoundsNear || farPlane != m_BoundsFar)
+        BuildClusterBounds(projection, nearPlane, farPlane);
+
+    m_Projection = projection;
+    m_NearPlane = nearPlane;
+    m_FarPlane = farPlane;
+
+    m_ViewLights.resize(lights.size());
+    m_LightData.resize(lights.size() * 2);
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        const PointLight& light = lights[i];
+        m_ViewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(light.Position, 1.0f)), light.Radius);
+        m_LightData[i * 2] = glm::vec4(light.Position, light.Radius);
+        m_LightData[i * 2 + 1] = glm::vec4(light.Color, light.Intensity);
+    }
+
+    // Contiguous chunks of lights are tested in parallel, each one writes its own pairs
+    WorkerPool& workers = WorkerPool::Instance();
+    const size_t maxChunks = (size_t)workers.GetThreadCount() * 4;
+    const size_t chunkCount = std::max<size_t>(1, std::min(maxChunks, (lights.size() + MinLightsPerChunk - 1) / MinLightsPerChunk));
+    const size_t lightsPerChunk = (lights.size() + chunkCount - 1) / chunkCount;
+
+    if (m_ChunkPairs.size() < chunkCount)
+        m_ChunkPairs.resize(chunkCount);
+    m_ChunkVisibleLights.assign(chunkCount, 0);
+
+    workers.ParallelFor((unsigned int)chunkCount, [&](unsigned int chunk, unsigned int)
+    {
+        const size_t begin = std::min(lights.size(), chunk * lightsPerChunk);
+        const size_t end = std::min(lights.size(), begin + lightsPerChunk);
+
+        m_ChunkPairs[chunk].clear();
+        m_ChunkVisibleLights[chunk] = AssignLights(begin, end, m_ChunkPairs[chunk]);
+    });
+
+    // Counting sort of the pairs by froxel: count, prefix sum, then scatter (the counts are rebuilt while scattering)
+    m_Clusters.assign(ClusterCount * 2, 0);
+    uint32_t assignments = 0;
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        const std::vector<uint32_t>& pairs = m_ChunkPairs[chunk];
+        for (size_t i = 0; i < pairs.size(); i += 2)
+            m_Clusters[pairs[i] * 2 + 1]++;
+        assignments += (uint32_t)(pairs.size() / 2);
+    }
+
+    m_Stats = Stats();
+    uint32_t offset = 0;
+    for (unsigned int cluster = 0; cluster < ClusterCount; cluster++)
+    {
+        const uint32_t count = m_Clusters[cluster * 2 + 1];
+        m_Stats.MaxLightsPerCluster = std::max(m_Stats.MaxLightsPerCluster, count);
+        m_Stats.OccupiedClusters += count > 0 ? 1 : 0;
+
+        m_Clusters[cluster * 2] = offset;
+        m_Clusters[cluster * 2 + 1] = 0;
+        offset += count;
+    }
+
+    m_LightIndices.resize(assignments);
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        const std::vector<uint32_t>& pairs = m_ChunkPairs[chunk];
+        for (size_t i = 0; i < pairs.size(); i += 2)
+        {
+            uint32_t* cluster = &m_Clusters[pairs[i] * 2];
+            m_LightIndices[cluster[0] + cluster[1]++] = pairs[i + 1];
+        }
+    }
+
+    m_ShaderData.ClusterCount = glm::uvec4(ClusterCountX, ClusterCountY, ClusterCountZ, (unsigned int)lights.size());
+    m_ShaderData.Parameters = glm::vec4((float)viewportWidth / ClusterCountX, (float)viewportHeight / ClusterCountY, m_SliceScale, m_SliceBias);
+
+    m_Stats.Lights = (uint32_t)lights.size();
+    m_Stats.Assignments = assignments;
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+        m_Stats.VisibleLights += m_ChunkVisibleLights[chunk];
+    m_Stats.BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ClusteredLights::BuildClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+    m_BoundsProjection = projection;
+    m_BoundsNear = nearPlane;
+    m_BoundsFar = farPlane;
+
+    // Exponential slices keep the froxels roughly cubic: slice = log(depth) * scale - bias
+    const float depthRatio = std::log(farPlane / nearPlane);
+    m_SliceScale = ClusterCountZ / depthRatio;
+    m_SliceBias = ClusterCountZ * std::log(nearPlane) / depthRatio;
+
+    for (auto* bounds : { &m_MinX, &m_MinY, &m_MinZ, &m_MaxX, &m_MaxY, &m_MaxZ })
+        bounds->resize(ClusterCount);
+
+    // Direction of the view ray through every tile corner, scaled so that its depth is 1
+    const glm::mat4 inverseProjection = glm::inverse(projection);
+    glm::vec3 corners[ClusterCountY + 1][ClusterCountX + 1];
+    for (unsigned int y = 0; y <= ClusterCountY; y++)
+    {
+        for (unsigned int x = 0; x <= ClusterCountX; x++)
+        {
+            const glm::vec4 ndc(-1.0f + 2.0f * x / ClusterCountX, -1.0f + 2.0f * y / ClusterCountY, -1.0f, 1.0f);
+            glm::vec4 point = inverseProjection * ndc;
+            point /= point.w;
+            corners[y][x] = glm::vec3(point) / -point.z;
+        }
+    }
+
+    for (unsigned int z = 0; z < ClusterCountZ; z++)
+    {
+        const float nearDepth = nearPlane * std::pow(farPlane / nearPlane, (float)z / ClusterCountZ);
+        const float farDepth = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / ClusterCountZ);
+
+        for (unsigned int y = 0; y < ClusterCountY; y++)
+        {
+            for (unsigned int x = 0; x < ClusterCountX; x++)
+            {
+                glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+                for (const glm::vec3& corner : { corners[y][x], corners[y][x + 1], corners[y + 1][x], corners[y + 1][x + 1] })
+                {
+                    for (float depth : { nearDepth, farDepth })
+                    {
+                        minimum = glm::min(minimum, corner * depth);
+                        maximum = glm::max(maximum, corner * depth);
+                    }
+                }
+
+                const unsigned int cluster = GetClusterIndex(x, y, z);
+                m_MinX[cluster] = minimum.x; m_MinY[cluster] = minimum.y; m_MinZ[cluster] = minimum.z;
+                m_MaxX[cluster] = maximum.x; m_MaxY[cluster] = maximum.y; m_MaxZ[cluster] = maximum.z;
+            }
+        }
+    }
+}
+
+uint32_t ClusteredLights::AssignLights(size_t begin, size_t end, std::vector<uint32_t>& pairs) const
+{
+    auto getSlice = [this](float depth)
+    {
+        const int slice = (int)std::floor(std::log(depth) * m_SliceScale - m_SliceBias);
+        return (unsigned int)std::min(std::max(slice, 0), (int)ClusterCountZ - 1);
+    };
+
+    uint32_t visibleLights = 0;
+    for (size_t light = begin; light < end; light++)
+    {
+        const glm::vec3 center = glm::vec3(m_ViewLights[light]);
+        const float radius = m_ViewLights[light].w;
+        const float depth = -center.z;
+        if (depth + radius < m_NearPlane || depth - radius > m_FarPlane)
+            continue;
+
+        const unsigned int z0 = getSlice(std::max(depth - radius, m_NearPlane));
+        const unsigned int z1 = getSlice(std::min(depth + radius, m_FarPlane));
+
+        // Narrow the tiles down to the screen rectangle of the sphere's bounding box, unless the box crosses the near plane
+        unsigned int x0 = 0, x1 = ClusterCountX - 1, y0 = 0, y1 = ClusterCountY - 1;
+        if (depth - radius > m_NearPlane)
+        {
+            // The projection is linear, the corners are the projected center plus the projected axes scaled by the radius
+            const glm::vec4 clipCenter = m_Projection * glm::vec4(center, 1.0f);
+            const glm::vec4 axisX = m_Projection[0] * radius, axisY = m_Projection[1] * radius, axisZ = m_Projection[2] * radius;
+
+            glm::vec2 minimum(FLT_MAX), maximum(-FLT_MAX);
+            for (int corner = 0; corner < 8; corner++)
+            {
+                const glm::vec4 clip = clipCenter + ((corner & 1) ? axisX : -axisX) + ((corner & 2) ? axisY : -axisY) + ((corner & 4) ? axisZ : -axisZ);
+                const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                minimum = glm::min(minimum, ndc);
+                maximum = glm::max(maximum, ndc);
+            }
+
+            if (maximum.x < -1.0f || maximum.y < -1.0f || minimum.x > 1.0f || minimum.y > 1.0f)
+                continue;
+
+            auto toTile = [](float ndc, unsigned int count)
+            {
+                const int tile = (int)std::floor((ndc * 0.5f + 0.5f) * count);
+                return (unsigned int)std::min(std::max(tile, 0), (int)count - 1);
+            };
+            x0 = toTile(minimum.x, ClusterCountX); x1 = toTile(maximum.x, ClusterCountX);
+            y0 = toTile(minimum.y, ClusterCountY); y1 = toTile(maximum.y, ClusterCountY);
+        }
+
+        const size_t pairCount = pairs.size();
+        const float radiusSquared = radius * radius;
+
+#ifdef CLUSTERED_LIGHTS_SSE
+        const __m128 centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+        const __m128 radius2 = _mm_set1_ps(radiusSquared);
+        const __m128 zero = _mm_setzero_ps();
+#endif
+
+        for (unsigned int z = z0; z <= z1; z++)
+        {
+            for (unsigned int y = y0; y <= y1; y++)
+            {
+                const unsigned int row = GetClusterIndex(0, y, z);
+                for (unsigned int x = x0 & ~3u; x <= x1; x += 4)
+                {
+                    // Sphere against 4 froxel boxes: squared distance from the center to the closest point of each box
+                    const unsigned int first = row + x;
+#ifdef CLUSTERED_LIGHTS_SSE
+                    const __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinX[first]), centerX), zero), _mm_max_ps(_mm_sub_ps(centerX, _mm_loadu_ps(&m_MaxX[first])), zero));
+                    const __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinY[first]), centerY), zero), _mm_max_ps(_mm_sub_ps(centerY, _mm_loadu_ps(&m_MaxY[first])), zero));
+                    const __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinZ[first]), centerZ), zero), _mm_max_ps(_mm_sub_ps(centerZ, _mm_loadu_ps(&m_MaxZ[first])), zero));
+                    const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                    const int mask = _mm_movemask_ps(_mm_cmple_ps(distance, radius2));
+#else
+                    int mask = 0;
+                    for (unsigned int lane = 0; lane < 4; lane++)
+                    {
+                        const unsigned int cluster = first + lane;
+                        const float dx = std::max(m_MinX[cluster] - center.x, 0.0f) + std::max(center.x - m_MaxX[cluster], 0.0f);
+                        const float dy = std::max(m_MinY[cluster] - center.y, 0.0f) + std::max(center.y - m_MaxY[cluster], 0.0f);
+                        const float dz = std::max(m_MinZ[cluster] - center.z, 0.0f) + std::max(center.z - m_MaxZ[cluster], 0.0f);
+                        mask |= (dx * dx + dy * dy + dz * dz <= radiusSquared) ? 1 << lane : 0;
+                    }
+#endif
+                    if (mask == 0)
+                        continue;
+
+                    for (unsigned int lane = 0; lane < 4; lane++)
+                    {
+                        if ((mask & (1 << lane)) && x + lane >= x0 && x + lane <= x1)
+                        {
+                            pairs.push_back(first + lane);
+                            pairs.push_back((uint32_t)light);
+                        }
+                    }
+                }
+            }
+        }
+
+        visibleLights += pairs.size() != pairCount ? 1 : 0;
+    }
+
+    return visibleLights;
+}
+
+void ClusteredLights::Upload()
+{
+    const void* data[3] = { m_LightData.data(), m_Clusters.data(), m_LightIndices.data() };
+    const size_t sizes[3] = { m_LightData.size() * sizeof(glm::vec4), m_Clusters.size() * sizeof(uint32_t), m_LightIndices.size() * sizeof(uint32_t) };
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if (m_Textures[i] == 0)
+        {
+            glGenBuffers(1, &m_Buffers[i]);
+            glGenTextures(1, &m_Textures[i]);
+        }
+
+        // Orphan and refill, an empty list still gets storage so that the texture is complete
+        const size_t size = std::max<size_t>(sizes[i], 16);
+        const bool grown = size > m_Capacities[i];
+        if (grown)
+            m_Capacities[i] = size + size / 2;
+
+        GLState::BindBuffer(GL_TEXTURE_BUFFER, m_Buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, m_Capacities[i], nullptr, GL_STREAM_DRAW);
+        if (sizes[i] > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+
+        // The texture keeps pointing at the buffer object, whatever storage it currently has
+        if (grown)
+        {
+            GpuMemory::Instance().OnBufferAllocated(m_Buffers[i], m_Capacities[i], GpuMemory::Category::Streaming, "Clustered lights");
+            GLState::BindTexture(GLState::GetActiveTextureUnit(), GL_TEXTURE_BUFFER, m_Textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, TextureFormats[i], m_Buffers[i]);
+        }
+    }
+}
+
+void ClusteredLights::Bind(const ShaderLayout& layout) const
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        const int parameter = layout.Find(SamplerNames[i]);
+        if (parameter >= 0)
+            GLState::BindTexture(layout.GetParameter(parameter).SamplerUnit, GL_TEXTURE_BUFFER, m_Textures[i]);
+    }
+}
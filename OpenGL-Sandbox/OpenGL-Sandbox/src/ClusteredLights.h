@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class ShaderLayout;
+
+// Clustered light culling for forward shading. The view frustum is split into froxels (screen tiles x exponential depth
+// slices), every froxel gets the list of the point lights whose sphere touches it, and the lit fragment shader only
+// evaluates the lights of its own froxel (see include/Clusters.glsl).
+// Lists are built on the CPU, spread across the worker pool and tested four froxels at a time with SSE. The context is
+// GL 3.3 core (no compute shaders, no storage buffers), so the lights, the froxel ranges and the light indices are
+// read from texture buffers.
+class ClusteredLights
+{
+public:
+    struct PointLight
+    {
+        glm::vec3 Position; // World space
+        float Radius;       // The light has no effect past this distance
+        glm::vec3 Color;
+        float Intensity;
+    };
+
+    // std140 layout of the ClusterBlock uniform block
+    struct ShaderData
+    {
+        glm::uvec4 ClusterCount;  // x, y, z, light count
+        glm::vec4 Parameters;     // Tile width and height in pixels, depth slice scale and bias
+    };
+
+    struct Stats
+    {
+        uint32_t Lights = 0;
+        uint32_t VisibleLights = 0;     // Lights touching at least one froxel
+        uint32_t Assignments = 0;       // Light indices written, a light is counted once per froxel it touches
+        uint32_t MaxLightsPerCluster = 0;
+        uint32_t OccupiedClusters = 0;
+        double BuildMs = 0.0;
+    };
+
+    static constexpr unsigned int ClusterCountX = 16; // Multiple of 4, a row of froxels is tested 4 at a time
+    static constexpr unsigned int ClusterCountY = 9;
+    static constexpr unsigned int ClusterCountZ = 24;
+    static constexpr unsigned int ClusterCount = ClusterCountX * ClusterCountY * ClusterCountZ;
+
+    ClusteredLights() = default;
+    ~ClusteredLights();
+
+    ClusteredLights(const ClusteredLights&) = delete;
+    ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+    // Assigns the lights to the froxels of this view, any thread (no GL calls)
+    void Build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, unsigned int viewportWidth, unsigned int viewportHeight);
+
+    // Uploads the light data and the froxel lists of the last Build(), GL thread only
+    void Upload();
+
+    // Binds the texture buffers to the units the program assigned to its samplers, GL thread only
+    void Bind(const ShaderLayout& layout) const;
+
+    const ShaderData& GetShaderData() const { return m_ShaderData; }
+    const Stats& GetStats() const { return m_Stats; }
+
+    // Lights of a froxel (see GetClusterIndex()), for inspection and validation
+    const uint32_t* GetClusterLights(unsigned int cluster, uint32_t& count) const
+    {
+        count = m_Clusters[cluster * 2 + 1];
+        return m_LightIndices.data() + m_Clusters[cluster * 2];
+    }
+
+    // View space bounds of a froxel
+    glm::vec3 GetClusterMin(unsigned int cluster) const { return { m_MinX[cluster], m_MinY[cluster], m_MinZ[cluster] }; }
+    glm::vec3 GetClusterMax(unsigned int cluster) const { return { m_MaxX[cluster], m_MaxY[cluster], m_MaxZ[cluster] }; }
+
+    static unsigned int GetClusterIndex(unsigned int x, unsigned int y, unsigned int z) { return (z * ClusterCountY + y) * ClusterCountX + x; }
+private:
+    void BuildClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+    // Appends a (cluster, light) pair for every froxel touched by the lights in [begin, end), returns how many lights touched one
+    uint32_t AssignLights(size_t begin, size_t end, std::vector<uint32_t>& pairs) const;
+private:
+    // Froxel bounds in view space, structure of arrays so that a row of froxels loads straight into SIMD registers
+    std::vector<float> m_MinX, m_MinY, m_MinZ, m_MaxX, m_MaxY, m_MaxZ;
+    glm::mat4 m_BoundsProjection{ 0.0f };
+    float m_BoundsNear = 0.0f, m_BoundsFar = 0.0f;
+
+    // View space light spheres of the frame
+    std::vector<glm::vec4> m_ViewLights;
+    glm::mat4 m_Projection{ 1.0f };
+    float m_NearPlane = 0.1f, m_FarPlane = 100.0f;
+    float m_SliceScale = 0.0f, m_SliceBias = 0.0f;
+
+    // (cluster, light) pairs found by each chunk of lights, merged in chunk order so the lists do not depend on the threads
+    std::vector<std::vector<uint32_t>> m_ChunkPairs;
+    std::vector<uint32_t> m_ChunkVisibleLights;
+
+    std::vector<uint32_t> m_Clusters;       // Offset and count in m_LightIndices of every froxel
+    std::vector<uint32_t> m_LightIndices;
+    std::vector<glm::vec4> m_LightData;     // Two texels per light: position and radius, color and intensity
+
+    ShaderData m_ShaderData{};
+    Stats m_Stats;
+
+    // Texture buffers and their backing buffers: light data (RGBA32F), froxels (RG32UI), light indices (R32UI)
+    unsigned int m_Buffers[3] = {};
+    unsigned int m_Textures[3] = {};
+    size_t m_Capacities[3] = {};
+};
@@ -0,0 +1,314 @@
+#include "CommandBuffer.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "Mesh.h"
+#include "ShaderLayout.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    constexpr uint32_t SerializedMagic = 0x42444D43; // "CMDB"
+    constexpr uint32_t SerializedVersion = 3;
+
+    struct SerializedHeader
+    {
+        uint32_t Magic, Version, CommandCount, DataSize;
+    };
+
+    size_t GetPayloadSize(CommandType type)
+    {
+        switch (type)
+        {
+        case CommandType::BindProgram:      return sizeof(Commands::BindProgram);
+        case CommandType::BindVertexArray:  return sizeof(Commands::BindVertexArray);
+        case CommandType::BindTexture:      return sizeof(Commands::BindTexture);
+        case CommandType::SetUniform:       return sizeof(Commands::SetUniform);
+        case CommandType::BindInstances:    return sizeof(Commands::BindInstances);
+        case CommandType::DrawElements:     return sizeof(Commands::DrawElements);
+        case CommandType::DrawArrays:       return sizeof(Commands::DrawArrays);
+        case CommandType::MultiDrawIndirect:return sizeof(Commands::MultiDrawIndirect);
+        default:                            return 0;
+        }
+    }
+}
+
+void* CommandBuffer::Allocate(CommandType type, size_t payloadSize)
+{
+    // Every command starts 4 byte aligned, which is enough for all of the payloads
+    const size_t size = (sizeof(Commands::Header) + payloadSize + 3) & ~size_t(3);
+    const size_t offset = m_Data.size();
+    m_Data.resize(offset + size);
+
+    auto* header = reinterpret_cast<Commands::Header*>(m_Data.data() + offset);
+    header->Type = type;
+    header->Size = (uint16_t)size;
+
+    m_CommandCount++;
+    return m_Data.data() + offset + sizeof(Commands::Header);
+}
+
+void CommandBuffer::BindProgram(unsigned int program)
+{
+    auto* command = static_cast<Commands::BindProgram*>(Allocate(CommandType::BindProgram, sizeof(Commands::BindProgram)));
+    command->Program = program;
+}
+
+void CommandBuffer::BindVertexArray(unsigned int vertexArray)
+{
+    auto* command = static_cast<Commands::BindVertexArray*>(Allocate(CommandType::BindVertexArray, sizeof(Commands::BindVertexArray)));
+    command->VertexArray = vertexArray;
+}
+
+void CommandBuffer::BindTexture(unsigned int unit, unsigned int target, unsigned int texture)
+{
+    auto* command = static_cast<Commands::BindTexture*>(Allocate(CommandType::BindTexture, sizeof(Commands::BindTexture)));
+    *command = { unit, target, texture };
+}
+
+void CommandBuffer::SetUniform(unsigned int type, int location, int count, const void* value)
+{
+    if (location < 0)
+        return;
+
+    const size_t valueSize = ShaderLayout::GetTypeSize(type) * count;
+    if (sizeof(Commands::Header) + sizeof(Commands::SetUniform) + valueSize > 0xFFFF)
+    {
+        std::cerr << "[ERROR]: Uniform at location " << location << " is too large for a command (" << valueSize << " bytes)" << std::endl;
+        return;
+    }
+
+    auto* command = static_cast<Commands::SetUniform*>(Allocate(CommandType::SetUniform, sizeof(Commands::SetUniform) + valueSize));
+    *command = { type, location, count };
+    memcpy(command + 1, value, valueSize);
+}
+
+void CommandBuffer::BindInstances(unsigned int buffer, unsigned int offset)
+{
+    auto* command = static_cast<Commands::BindInstances*>(Allocate(CommandType::BindInstances, sizeof(Commands::BindInstances)));
+    *command = { buffer, offset };
+}
+
+void CommandBuffer::DrawElements(unsigned int mode, unsigned int count, unsigned int indexType, unsigned int offset, unsigned int instanceCount, int baseVertex)
+{
+    auto* command = static_cast<Commands::DrawElements*>(Allocate(CommandType::DrawElements, sizeof(Commands::DrawElements)));
+    *command = { mode, count, indexType, offset, instanceCount, baseVertex };
+}
+
+void CommandBuffer::DrawArrays(unsigned int mode, int first, unsigned int count, unsigned int instanceCount)
+{
+    auto* command = static_cast<Commands::DrawArrays*>(Allocate(CommandType::DrawArrays, sizeof(Commands::DrawArrays)));
+    *command = { mode, first, count, instanceCount };
+}
+
+void CommandBuffer::MultiDrawIndirect(unsigned int buffer, unsigned int mode, unsigned int indexType, unsigned int offset, unsigned int drawCount)
+{
+    auto* command = static_cast<Commands::MultiDrawIndirect*>(Allocate(CommandType::MultiDrawIndirect, sizeof(Commands::MultiDrawIndirect)));
+    *command = { buffer, mode, indexType, offset, drawCount };
+}
+
+void CommandBuffer::Execute() const
+{
+    ForEach([](const Commands::Header& header, const void* payload)
+    {
+        switch (header.Type)
+        {
+        case CommandType::BindProgram:
+        {
+            GLState::UseProgram(static_cast<const Commands::BindProgram*>(payload)->Program);
+            break;
+        }
+        case CommandType::BindVertexArray:
+        {
+            GLState::BindVertexArray(static_cast<const Commands::BindVertexArray*>(payload)->VertexArray);
+            break;
+        }
+        case CommandType::BindTexture:
+        {
+            const auto* command = static_cast<const Commands::BindTexture*>(payload);
+            GLState::BindTexture(command->Unit, command->Target, command->Texture);
+            break;
+        }
+        case CommandType::SetUniform:
+        {
+            const auto* command = static_cast<const Commands::SetUniform*>(payload);
+            ShaderLayout::UploadValue(command->Type, command->Location, command->Count, command + 1);
+            break;
+        }
+        case CommandType::BindInstances:
+        {
+            const auto* command = static_cast<const Commands::BindInstances*>(payload);
+            AssetLoader::SetupInstanceAttributes(command->Buffer, command->Offset);
+            break;
+        }
+        case CommandType::DrawElements:
+        {
+            const auto* command = static_cast<const Commands::DrawElements*>(payload);
+            glDrawElementsInstancedBaseVertex(command->Mode, command->Count, command->IndexType, (const void*)(uintptr_t)command->Offset, command->InstanceCount, command->BaseVertex);
+            break;
+        }
+        case CommandType::DrawArrays:
+        {
+            const auto* command = static_cast<const Commands::DrawArrays*>(payload);
+            glDrawArraysInstanced(command->Mode, command->First, command->Count, command->InstanceCount);
+            break;
+        }
+        case CommandType::MultiDrawIndirect:
+        {
+            const auto* command = static_cast<const Commands::MultiDrawIndirect*>(payload);
+            GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, command->Buffer);
+            GLExtensions::MultiDrawElementsIndirect(command->Mode, command->IndexType, (const void*)(uintptr_t)command->Offset, command->DrawCount, 0);
+            break;
+        }
+        default:
+            break;
+        }
+    });
+}
+
+std::vector<uint8_t> CommandBuffer::Serialize() const
+{
+    const SerializedHeader header{ SerializedMagic, SerializedVersion, m_CommandCount, (uint32_t)m_Data.size() };
+
+    std::vector<uint8_t> data(sizeof(header) + m_Data.size());
+    memcpy(data.data(), &header, sizeof(header));
+    if (!m_Data.empty())
+        memcpy(data.data() + sizeof(header), m_Data.data(), m_Data.size());
+    return data;
+}
+
+bool CommandBuffer::Deserialize(const std::vector<uint8_t>& data)
+{
+    SerializedHeader header{};
+    if (data.size() < sizeof(header))
+    {
+        std::cerr << "[ERROR]: Command stream is too small (" << data.size() << " bytes)" << std::endl;
+        return false;
+    }
+
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.Magic != SerializedMagic || header.Version != SerializedVersion || header.DataSize != data.size() - sizeof(header))
+    {
+        std::cerr << "[ERROR]: Command stream has an invalid header (version " << header.Version << ", " << header.DataSize << " bytes)" << std::endl;
+        return false;
+    }
+
+    // Walk the stream once before accepting it, a corrupted size would make Execute() read out of bounds
+    const uint8_t* commands = data.data() + sizeof(header);
+    uint32_t count = 0;
+    size_t offset = 0;
+    while (offset < header.DataSize)
+    {
+        Commands::Header command;
+        if (header.DataSize - offset < sizeof(command))
+            break;
+
+        memcpy(&command, commands + offset, sizeof(command));
+        size_t minimumSize = sizeof(command) + GetPayloadSize(command.Type);
+        if (command.Type == CommandType::SetUniform && offset + minimumSize <= header.DataSize)
+        {
+            Commands::SetUniform uniform;
+            memcpy(&uniform, commands + offset + sizeof(command), sizeof(uniform));
+            minimumSize += (size_t)ShaderLayout::GetTypeSize(uniform.Type) * (uniform.Count > 0 ? uniform.Count : 0);
+        }
+
+        if (command.Type >= CommandType::Count || command.Size < minimumSize || command.Size % 4 != 0 || offset + command.Size > header.DataSize)
+        {
+            std::cerr << "[ERROR]: Command stream is corrupted at byte " << offset << std::endl;
+            return false;
+        }
+
+        offset += command.Size;
+        count++;
+    }
+
+    if (offset != header.DataSize || count != header.CommandCount)
+    {
+        std::cerr << "[ERROR]: Command stream holds " << count << " commands, " << header.CommandCount << " expected" << std::endl;
+        return false;
+    }
+
+    m_Data.assign(commands, commands + header.DataSize);
+    m_CommandCount = count;
+    return true;
+}
+
+std::string CommandBuffer::ToString() const
+{
+    std::ostringstream stream;
+    size_t offset = 0;
+    ForEach([&](const Commands::Header& header, const void* payload)
+    {
+        stream << offset << ": " << GetCommandName(header.Type);
+        switch (header.Type)
+        {
+        case CommandType::BindProgram:
+            stream << " program=" << static_cast<const Commands::BindProgram*>(payload)->Program;
+            break;
+        case CommandType::BindVertexArray:
+            stream << " vao=" << static_cast<const Commands::BindVertexArray*>(payload)->VertexArray;
+            break;
+        case CommandType::BindTexture:
+        {
+            const auto* command = static_cast<const Commands::BindTexture*>(payload);
+            stream << " unit=" << command->Unit << " target=0x" << std::hex << command->Target << std::dec << " texture=" << command->Texture;
+            break;
+        }
+        case CommandType::SetUniform:
+        {
+            const auto* command = static_cast<const Commands::SetUniform*>(payload);
+            stream << " location=" << command->Location << " type=0x" << std::hex << command->Type << std::dec << " count=" << command->Count;
+            break;
+        }
+        case CommandType::BindInstances:
+        {
+            const auto* command = static_cast<const Commands::BindInstances*>(payload);
+            stream << " buffer=" << command->Buffer << " offset=" << command->Offset;
+            break;
+        }
+        case CommandType::DrawElements:
+        {
+            const auto* command = static_cast<const Commands::DrawElements*>(payload);
+            stream << " mode=" << command->Mode << " count=" << command->Count << " offset=" << command->Offset << " instances=" << command->InstanceCount << " baseVertex=" << command->BaseVertex;
+            break;
+        }
+        case CommandType::DrawArrays:
+        {
+            const auto* command = static_cast<const Commands::DrawArrays*>(payload);
+            stream << " mode=" << command->Mode << " first=" << command->First << " count=" << command->Count << " instances=" << command->InstanceCount;
+            break;
+        }
+        case CommandType::MultiDrawIndirect:
+        {
+            const auto* command = static_cast<const Commands::MultiDrawIndirect*>(payload);
+            stream << " buffer=" << command->Buffer << " mode=" << command->Mode << " offset=" << command->Offset << " draws=" << command->DrawCount;
+            break;
+        }
+        default:
+            break;
+        }
+        stream << "\n";
+        offset += header.Size;
+    });
+    return stream.str();
+}
+
+const char* CommandBuffer::GetCommandName(CommandType type)
+{
+    switch (type)
+    {
+    case CommandType::BindProgram:      return "BindProgram";
+    case CommandType::BindVertexArray:  return "BindVertexArray";
+    case CommandType::BindTexture:      return "BindTexture";
+    case CommandType::SetUniform:       return "SetUniform";
+    case CommandType::BindInstances:    return "BindInstances";
+    case CommandType::DrawElements:     return "DrawElements";
+    case CommandType::DrawArrays:       return "DrawArrays";
+    case CommandType::MultiDrawIndirect:return "MultiDrawIndirect";
+    default:                            return "Unknown";
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compact stream of plain-old-data render commands. Any thread can record one (no GL calls are made while
+// recording), the GL thread replays it with Execute(). Every command is a header followed by its payload,
+// padded to 4 bytes, so a stream can be copied, saved to disk and inspected as is.
+enum class CommandType : uint16_t
+{
+    BindProgram = 0,
+    BindVertexArray,
+    BindTexture,
+    SetUniform,
+    BindInstances,
+    DrawElements,
+    DrawArrays,
+    MultiDrawIndirect,
+    Count
+};
+
+namespace Commands
+{
+    struct Header
+    {
+        CommandType Type;
+        uint16_t Size; // Size of the whole command (header, payload and padding) in bytes
+    };
+
+    struct BindProgram { uint32_t Program; };
+    struct BindVertexArray { uint32_t VertexArray; };
+    struct BindTexture { uint32_t Unit, Target, Texture; };
+    struct SetUniform { uint32_t Type; int32_t Location, Count; }; // Followed by the value
+    struct BindInstances { uint32_t Buffer, Offset; }; // Points the instance attributes of the bound vertex array at Offset
+    struct DrawElements { uint32_t Mode, Count, IndexType, Offset, InstanceCount; int32_t BaseVertex; };
+    struct DrawArrays { uint32_t Mode; int32_t First; uint32_t Count, InstanceCount; };
+    struct MultiDrawIndirect { uint32_t Buffer, Mode, IndexType, Offset, DrawCount; }; // Offset of the first command in the buffer, in bytes
+}
+
+class CommandBuffer
+{
+public:
+    void Clear() { m_Data.clear(); m_CommandCount = 0; }
+
+    void BindProgram(unsigned int program);
+    void BindVertexArray(unsigned int vertexArray);
+    void BindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+    void SetUniform(unsigned int type, int location, int count, const void* value); // Skipped if location is -1
+    void BindInstances(unsigned int buffer, unsigned int offset);
+    void DrawElements(unsigned int mode, unsigned int count, unsigned int indexType, unsigned int offset, unsigned int instanceCount = 1, int baseVertex = 0);
+    void DrawArrays(unsigned int mode, int first, unsigned int count, unsigned int instanceCount = 1);
+    // Needs GLExtensions::HasMultiDrawIndirect(), 'buffer' holds tightly packed DrawElementsIndirectCommand
+    void MultiDrawIndirect(unsigned int buffer, unsigned int mode, unsigned int indexType, unsigned int offset, unsigned int drawCount);
+
+    // Replays every command, GL thread only
+    void Execute() const;
+
+    // Calls visitor(const Commands::Header&, const void* payload) for every command, in recording order
+    template<typename Visitor>
+    void ForEach(Visitor&& visitor) const
+    {
+        size_t offset = 0;
+        while (offset < m_Data.size())
+        {
+            const auto* header = reinterpret_cast<const Commands::Header*>(m_Data.data() + offset);
+            visitor(*header, m_Data.data() + offset + sizeof(Commands::Header));
+            offset += header->Size;
+        }
+    }
+
+    // Stream with a small versioned header, Deserialize() validates every command before accepting it
+    std::vector<uint8_t> Serialize() const;
+    bool Deserialize(const std::vector<uint8_t>& data);
+
+    // One line per command, for debugging
+    std::string ToString() const;
+
+    static const char* GetCommandName(CommandType type);
+
+    uint32_t GetCommandCount() const { return m_CommandCount; }
+    size_t GetSize() const { return m_Data.size(); }
+    const std::vector<uint8_t>& GetData() const { return m_Data; }
+private:
+    void* Allocate(CommandType type, size_t payloadSize);
+private:
+    std::vector<uint8_t> m_Data;
+    uint32_t m_CommandCount = 0;
+};
@@ -0,0 +1,114 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    struct Zone
+    {
+        const char* Name;
+        CpuProfiler::Ticks Start, End;
+    };
+
+    struct ThreadRing
+    {
+        uint32_t Thread = 0;
+        std::string Name;
+        std::atomic<uint64_t> Head{ 0 }; // Zones written since the start, the next one goes to Head % RingCapacity
+        std::unique_ptr<Zone[]> Zones = std::make_unique<Zone[]>(CpuProfiler::RingCapacity);
+    };
+
+    // Rings outlive their threads, the zones of a finished thread still show up in the trace
+    struct Registry
+    {
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<ThreadRing>> Rings;
+
+        // Time base of the tick to Trace::Now() conversion
+        CpuProfiler::Ticks BaseTicks = CpuProfiler::Now();
+        int64_t BaseNs = Trace::Now();
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local ThreadRing* t_Ring = nullptr;
+
+    // Taken once per thread, on its first zone
+    ThreadRing& GetThreadRing()
+    {
+        if (t_Ring)
+            return *t_Ring;
+
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.Mutex);
+        registry.Rings.push_back(std::make_unique<ThreadRing>());
+        t_Ring = registry.Rings.back().get();
+        t_Ring->Thread = (uint32_t)registry.Rings.size();
+        t_Ring->Name = "Thread " + std::to_string(t_Ring->Thread);
+        return *t_Ring;
+    }
+}
+
+namespace CpuProfiler
+{
+    void Record(const char* name, Ticks start, Ticks end)
+    {
+        ThreadRing& ring = GetThreadRing();
+        const uint64_t head = ring.Head.load(std::memory_order_relaxed);
+        ring.Zones[head & (RingCapacity - 1)] = { name, start, end };
+        ring.Head.store(head + 1, std::memory_order_release);
+    }
+
+    void SetThreadName(const std::string& name)
+    {
+        ThreadRing& ring = GetThreadRing();
+        std::lock_guard<std::mutex> lock(GetRegistry().Mutex);
+        ring.Name = name;
+    }
+
+    void Collect(std::vector<Trace::Event>& events, std::vector<std::pair<uint32_t, std::string>>& threads)
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.Mutex);
+
+        // Ticks to nanoseconds, measured over the whole run so far
+        const Ticks nowTicks = Now();
+        const int64_t nowNs = Trace::Now();
+        const double nsPerTick = nowTicks > registry.BaseTicks ? (double)(nowNs - registry.BaseNs) / (double)(nowTicks - registry.BaseTicks) : 1.0;
+        auto toNs = [&](Ticks ticks) { return registry.BaseNs + (int64_t)((double)(int64_t)(ticks - registry.BaseTicks) * nsPerTick); };
+
+        std::vector<Zone> zones;
+        for (const auto& ring : registry.Rings)
+        {
+            const uint64_t head = ring->Head.load(std::memory_order_acquire);
+            if (head == 0)
+                continue;
+
+            const uint64_t first = head > RingCapacity ? head - RingCapacity : 0;
+            zones.clear();
+            for (uint64_t i = first; i < head; i++)
+                zones.push_back(ring->Zones[i & (RingCapacity - 1)]);
+
+            // The owner kept writing while the zones were copied, the oldest ones may have been replaced meanwhile. It may
+            // also be writing zone 'after' right now, in the slot of zone 'after - RingCapacity'.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t after = ring->Head.load(std::memory_order_relaxed);
+            const uint64_t valid = after >= RingCapacity ? after - RingCapacity + 1 : 0;
+            const size_t skipped = (size_t)(std::max(valid, first) - first);
+
+            for (size_t i = skipped; i < zones.size(); i++)
+            {
+                const int64_t start = toNs(zones[i].Start);
+                events.push_back({ zones[i].Name, "cpu", ring->Thread, start, std::max<int64_t>(0, toNs(zones[i].End) - start) });
+            }
+            threads.emplace_back(ring->Thread, ring->Name);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Trace.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+    #include <intrin.h>
+    #define CPU_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define CPU_PROFILER_RDTSC 1
+#else
+    #define CPU_PROFILER_RDTSC 0
+#endif
+
+// CPU time of named zones on any thread. Every thread records its zones into a ring buffer of its own, only the
+// thread writes to it and it never takes a lock, so a zone costs two time stamp counter reads and one store. The rings
+// keep the last RingCapacity zones of every thread, Collect() turns them into trace events (see Trace.h) that line up
+// with the ones of the GpuProfiler.
+//
+//     PROFILE_SCOPE("Culling");      // Until the end of the enclosing block, 'name' must be a string literal
+//     PROFILE_THREAD("Worker 1");    // Track name of the calling thread in the trace
+namespace CpuProfiler
+{
+    constexpr size_t RingCapacity = 1 << 16; // Zones kept per thread, a power of two
+
+    using Ticks = uint64_t;
+
+    // Time stamp counter where available (a few nanoseconds to read), steady clock nanoseconds otherwise
+    inline Ticks Now()
+    {
+#if CPU_PROFILER_RDTSC
+        return __rdtsc();
+#else
+        return (Ticks)Trace::Now();
+#endif
+    }
+
+    void Record(const char* name, Ticks start, Ticks end);
+    void SetThreadName(const std::string& name);
+
+    // Appends the zones held by the rings and the track of every thread that recorded any. Any thread, the zones a
+    // thread overwrites while they are copied are left out.
+    void Collect(std::vector<Trace::Event>& events, std::vector<std::pair<uint32_t, std::string>>& threads);
+}
+
+// Times the rest of the enclosing block on the calling thread
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+        : m_Name(name), m_Start(CpuProfiler::Now())
+    {
+    }
+
+    ~ProfileScope() { CpuProfiler::Record(m_Name, m_Start, CpuProfiler::Now()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+    const char* m_Name;
+    CpuProfiler::Ticks m_Start;
+};
+
+#if PROFILING_ENABLED
+    #define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+    #define PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+    #define PROFILE_SCOPE(name) ((void)0)
+    #define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,332 @@
+#include "DeferredRenderer.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    constexpr unsigned int SphereRings = 8, SphereSegments = 12;
+    constexpr unsigned int ConeSegments = 16;
+
+    // The volumes are tessellated, they are scaled up to enclose the shape they approximate
+    const float SphereScale = 1.0f / std::cos(glm::pi<float>() / SphereSegments) / std::cos(glm::pi<float>() / (SphereRings * 2));
+    const float ConeScale = 1.0f / std::cos(glm::pi<float>() / ConeSegments);
+
+    void CreateSphere(std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+    {
+        for (unsigned int ring = 0; ring <= SphereRings; ring++)
+        {
+            const float theta = glm::pi<float>() * ring / SphereRings;
+            for (unsigned int segment = 0; segment <= SphereSegments; segment++)
+            {
+                const float phi = glm::two_pi<float>() * segment / SphereSegments;
+                vertices.emplace_back(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            }
+        }
+
+        // Counter clockwise seen from outside
+        for (unsigned int ring = 0; ring < SphereRings; ring++)
+        {
+            for (unsigned int segment = 0; segment < SphereSegments; segment++)
+            {
+                const unsigned int current = ring * (SphereSegments + 1) + segment;
+                const unsigned int below = current + SphereSegments + 1;
+                indices.insert(indices.end(), { current, current + 1, below, current + 1, below + 1, below });
+            }
+        }
+    }
+
+    // Apex at the origin, opening towards -Z, base of radius 1 at z = -1
+    void CreateCone(std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+    {
+        vertices.emplace_back(0.0f, 0.0f, 0.0f);
+        vertices.emplace_back(0.0f, 0.0f, -1.0f);
+        for (unsigned int segment = 0; segment < ConeSegments; segment++)
+        {
+            const float phi = glm::two_pi<float>() * segment / ConeSegments;
+            vertices.emplace_back(std::cos(phi), std::sin(phi), -1.0f);
+        }
+
+        for (unsigned int segment = 0; segment < ConeSegments; segment++)
+        {
+            const unsigned int current = 2 + segment;
+            const unsigned int next = 2 + (segment + 1) % ConeSegments;
+            indices.insert(indices.end(), { 0u, current, next }); // Side
+            indices.insert(indices.end(), { 1u, next, current }); // Base
+        }
+    }
+}
+
+DeferredRenderer::DeferredRenderer()
+    : m_DirectionalShader("resources/shaders/FullscreenVertex.glsl", "resources/shaders/DeferredDirectionalFragment.glsl"),
+      m_StencilShader("resources/shaders/LightVolumeVertex.glsl", "resources/shaders/NullFragment.glsl"),
+      m_PointShader("resources/shaders/LightVolumeVertex.glsl", "resources/shaders/DeferredPointFragment.glsl"),
+      m_SpotShader("resources/shaders/LightVolumeVertex.glsl", "resources/shaders/DeferredSpotFragment.glsl"),
+      m_DirectionalParameters(m_DirectionalShader.GetLayout()),
+      m_StencilParameters(m_StencilShader.GetLayout()),
+      m_PointParameters(m_PointShader.GetLayout()),
+      m_SpotParameters(m_SpotShader.GetLayout())
+{
+    m_StencilModel = m_StencilParameters.GetHandle("u_Model");
+    m_PointModel = m_PointParameters.GetHandle("u_Model");
+    m_SpotModel = m_SpotParameters.GetHandle("u_Model");
+    m_PointPositionRadius = m_PointParameters.GetHandle("u_LightPositionRadius");
+    m_PointColorIntensity = m_PointParameters.GetHandle("u_LightColorIntensity");
+
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    CreateSphere(vertices, indices);
+    m_Sphere = CreateVolume(vertices, indices);
+
+    vertices.clear();
+    indices.clear();
+    CreateCone(vertices, indices);
+    m_Cone = CreateVolume(vertices, indices);
+
+    glGenVertexArrays(1, &m_EmptyVertexArray);
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+    DestroyVolume(m_Sphere);
+    DestroyVolume(m_Cone);
+
+    GLState::OnVertexArrayDeleted(m_EmptyVertexArray);
+    glDeleteVertexArrays(1, &m_EmptyVertexArray);
+}
+
+DeferredRenderer::GBuffer DeferredRenderer::CreateGBuffer(RenderGraph::Builder& builder, unsigned int width, unsigned int height)
+{
+    // RGBA8 albedo and shininess, RG16 octahedral normal, D24S8 depth sampled by the lighting passes
+    GBuffer gbuffer;
+    gbuffer.Albedo = builder.Write(builder.Create("G-buffer albedo", { width, height, GL_RGBA8 }), GL_COLOR_ATTACHMENT0);
+    gbuffer.Normal = builder.Write(builder.Create("G-buffer normal", { width, height, GL_RG16 }), GL_COLOR_ATTACHMENT1);
+    gbuffer.Depth = builder.Write(builder.Create("G-buffer depth", { width, height, GL_DEPTH24_STENCIL8 }), GL_DEPTH_STENCIL_ATTACHMENT);
+    return gbuffer;
+}
+
+void DeferredRenderer::ReadGBuffer(RenderGraph::Builder& builder, const GBuffer& gbuffer)
+{
+    builder.Read(gbuffer.Albedo);
+    builder.Read(gbuffer.Normal);
+    builder.Read(gbuffer.Depth);
+}
+
+void DeferredRenderer::BeginGeometry()
+{
+    BeginTiming(Pass::Geometry);
+    GLState::DepthMask(true);
+
+    // Albedo alpha 0 is unlit, the background is told apart by its depth
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClearStencil(0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void DeferredRenderer::EndGeometry(const RenderGraph::Context& context)
+{
+    // The lighting passes test against a copy of the depth and stencil, the G-buffer depth stays free to be sampled
+    const int width = (int)context.GetWidth(), height = (int)context.GetHeight();
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, context.GetFramebuffer());
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, m_OutputFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, m_OutputFramebuffer);
+
+    EndTiming(Pass::Geometry);
+}
+
+void DeferredRenderer::Light(const RenderGraph::Context& context, const GBuffer& gbuffer, const std::vector<ClusteredLights::PointLight>& pointLights, const SpotVolume& spot, const glm::mat4& viewProjection)
+{
+    m_Stats = Stats();
+    const unsigned int textures[] = { context.GetTexture(gbuffer.Albedo), context.GetTexture(gbuffer.Normal), context.GetTexture(gbuffer.Depth) };
+
+    // Light volumes are always filled, whatever polygon mode the geometry was drawn with
+    GLState::PolygonMode(GL_FILL);
+    GLState::DepthMask(false);
+
+    // Ambient and directional light, every pixel once. The background fails the depth test before it gets shaded.
+    BeginTiming(Pass::Lighting);
+    GLState::Enable(GL_DEPTH_TEST);
+    GLState::DepthFunc(GL_GREATER);
+    GLState::Disable(GL_STENCIL_TEST);
+    GLState::Disable(GL_BLEND);
+    GLState::Disable(GL_CULL_FACE);
+
+    m_DirectionalShader.Use();
+    BindGBuffer(m_DirectionalShader, textures);
+    m_DirectionalShader.Upload(m_DirectionalParameters);
+    GLState::BindVertexArray(m_EmptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GLState::DepthFunc(GL_LESS);
+    EndTiming(Pass::Lighting);
+
+    BeginTiming(Pass::LightVolumes);
+    GLState::Enable(GL_STENCIL_TEST);
+    GLState::Enable(GL_DEPTH_CLAMP); // Volumes crossing the far plane keep their back faces
+    GLState::BlendFunc(GL_ONE, GL_ONE);
+
+    // Frustum planes (Gribb-Hartmann), the volumes of point lights outside of it are skipped
+    glm::vec4 planes[6];
+    const glm::mat4 transposed = glm::transpose(viewProjection);
+    for (int i = 0; i < 3; i++)
+    {
+        planes[i * 2] = transposed[3] + transposed[i];
+        planes[i * 2 + 1] = transposed[3] - transposed[i];
+    }
+    for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    BindGBuffer(m_PointShader, textures);
+    for (const auto& light : pointLights)
+    {
+        bool visible = true;
+        for (const auto& plane : planes)
+            visible &= glm::dot(glm::vec3(plane), light.Position) + plane.w >= -light.Radius;
+
+        if (!visible)
+        {
+            m_Stats.CulledLights++;
+            continue;
+        }
+
+        const glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), light.Position), glm::vec3(light.Radius * SphereScale));
+        m_PointParameters.Set(m_PointPositionRadius, glm::vec4(light.Position, light.Radius));
+        m_PointParameters.Set(m_PointColorIntensity, glm::vec4(light.Color, light.Intensity));
+        DrawVolume(m_Sphere, m_PointShader, m_PointParameters, model, m_PointModel);
+    }
+
+    // The cone looks down its -Z axis, the view matrix of the spot light gives its orientation
+    const glm::vec3 up = std::abs(spot.Direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    const float baseRadius = spot.Range * std::tan(std::acos(glm::clamp(spot.OuterCutOff, 0.01f, 1.0f))) * ConeScale;
+    const glm::mat4 spotModel = glm::inverse(glm::lookAt(spot.Position, spot.Position + spot.Direction, up)) * glm::scale(glm::mat4(1.0f), glm::vec3(baseRadius, baseRadius, spot.Range));
+    BindGBuffer(m_SpotShader, textures);
+    DrawVolume(m_Cone, m_SpotShader, m_SpotParameters, spotModel, m_SpotModel);
+
+    GLState::Disable(GL_STENCIL_TEST);
+    GLState::Disable(GL_DEPTH_CLAMP);
+    GLState::Disable(GL_BLEND);
+    GLState::Disable(GL_CULL_FACE);
+    GLState::CullFace(GL_BACK);
+    GLState::ColorMask(true);
+    GLState::Enable(GL_DEPTH_TEST);
+    GLState::DepthMask(true);
+    EndTiming(Pass::LightVolumes);
+}
+
+void DeferredRenderer::DrawVolume(const Volume& volume, const Shader& shader, ParameterBlock& parameters, const glm::mat4& model, ParameterBlock::Handle modelHandle)
+{
+    GLState::BindVertexArray(volume.VertexArray);
+
+    // Stencil pass: the pixels whose geometry lies between the front and back faces of the volume end up non zero.
+    // Depth-fail counting also works when the camera is inside the volume.
+    GLState::ColorMask(false);
+    GLState::Enable(GL_DEPTH_TEST);
+    GLState::Disable(GL_CULL_FACE);
+    GLState::Disable(GL_BLEND);
+    GLState::StencilFunc(GL_ALWAYS, 0, 0xFF);
+    GLState::StencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+    GLState::StencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+
+    m_StencilShader.Use();
+    m_StencilParameters.Set(m_StencilModel, model);
+    m_StencilShader.Upload(m_StencilParameters);
+    glDrawElements(GL_TRIANGLES, volume.IndexCount, GL_UNSIGNED_INT, nullptr);
+
+    // Lighting pass: back faces only so that each pixel is shaded once, the stencil is reset to zero behind it
+    GLState::ColorMask(true);
+    GLState::Disable(GL_DEPTH_TEST);
+    GLState::Enable(GL_CULL_FACE);
+    GLState::CullFace(GL_FRONT);
+    GLState::Enable(GL_BLEND);
+    GLState::StencilFunc(GL_NOTEQUAL, 0, 0xFF);
+    GLState::StencilOpSeparate(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_ZERO);
+
+    shader.Use();
+    parameters.Set(modelHandle, model);
+    shader.Upload(parameters);
+    glDrawElements(GL_TRIANGLES, volume.IndexCount, GL_UNSIGNED_INT, nullptr);
+
+    m_Stats.LightVolumes++;
+}
+
+void DeferredRenderer::BindGBuffer(const Shader& shader, const unsigned int textures[3]) const
+{
+    const char* const names[] = { "u_GBufferAlbedo", "u_GBufferNormal", "u_GBufferDepth" };
+    for (int i = 0; i < 3; i++)
+    {
+        const int unit = shader.GetSamplerUnit(names[i]);
+        if (unit >= 0)
+            GLState::BindTexture(unit, GL_TEXTURE_2D, textures[i]);
+    }
+}
+
+void DeferredRenderer::BeginTiming(Pass pass)
+{
+    GpuProfiler::Instance().Begin(GetPassName(pass));
+}
+
+void DeferredRenderer::EndTiming(Pass)
+{
+    GpuProfiler::Instance().End();
+}
+
+double DeferredRenderer::GetPassMs(Pass pass) const
+{
+    const GpuProfiler::Summary summary = GpuProfiler::Instance().GetSummary(GetPassName(pass));
+    return summary.Active ? summary.Average : 0.0;
+}
+
+const char* DeferredRenderer::GetPassName(Pass pass)
+{
+    switch (pass)
+    {
+    case Pass::Geometry:        return "Geometry";
+    case Pass::Lighting:        return "Lighting";
+    case Pass::LightVolumes:    return "Light volumes";
+    case Pass::Forward:         return "Forward";
+    default:                    return "Unknown";
+    }
+}
+
+DeferredRenderer::Volume DeferredRenderer::CreateVolume(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+    Volume volume;
+    volume.IndexCount = (unsigned int)indices.size();
+
+    glGenVertexArrays(1, &volume.VertexArray);
+    glGenBuffers(1, &volume.VertexBuffer);
+    glGenBuffers(1, &volume.IndexBuffer);
+
+    GLState::BindVertexArray(volume.VertexArray);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, volume.VertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, volume.IndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    GpuMemory::Instance().OnBufferAllocated(volume.VertexBuffer, vertices.size() * sizeof(glm::vec3), GpuMemory::Category::Geometry, "Light volumes");
+    GpuMemory::Instance().OnBufferAllocated(volume.IndexBuffer, indices.size() * sizeof(unsigned int), GpuMemory::Category::Geometry, "Light volumes");
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+
+    GLState::BindVertexArray(0);
+    return volume;
+}
+
+void DeferredRenderer::DestroyVolume(Volume& volume)
+{
+    GLState::OnVertexArrayDeleted(volume.VertexArray);
+    GLState::OnBufferDeleted(volume.VertexBuffer);
+    GLState::OnBufferDeleted(volume.IndexBuffer);
+    GpuMemory::Instance().OnBufferDeleted(volume.VertexBuffer);
+    GpuMemory::Instance().OnBufferDeleted(volume.IndexBuffer);
+    glDeleteVertexArrays(1, &volume.VertexArray);
+    glDeleteBuffers(1, &volume.VertexBuffer);
+    glDeleteBuffers(1, &volume.IndexBuffer);
+    volume = Volume();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ClusteredLights.h"
+#include "ParameterBlock.h"
+#include "RenderGraph.h"
+#include "Shader.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Deferred shading path, an alternative to the forward LitFragment path. The geometry pass writes a packed G-buffer
+// (see include/GBuffer.glsl), then a fullscreen pass shades every visible pixel exactly once with the ambient and
+// directional light, and every point and spot light only shades the pixels inside its volume: a stencil pass marks them,
+// the lighting pass draws the volume's back faces where the stencil is set and clears it for the next light.
+// Lighting is done in the default framebuffer, its depth and stencil are a copy of the G-buffer's so that the
+// lighting passes can test against them while sampling the G-buffer depth. The G-buffer targets are transient
+// resources of the render graph, they only take memory while the deferred path runs.
+class DeferredRenderer
+{
+public:
+    enum class Pass
+    {
+        Geometry = 0,
+        Lighting,       // Fullscreen ambient and directional pass
+        LightVolumes,   // Stencil-culled point and spot lights
+        Forward,        // The whole forward path, for comparison
+        Count
+    };
+
+    // Only the spot light's cone is needed here, its shading parameters are set on GetSpotParameters()
+    struct SpotVolume
+    {
+        glm::vec3 Position;
+        glm::vec3 Direction;
+        float OuterCutOff; // Cosine of the outer angle
+        float Range;
+    };
+
+    struct Stats
+    {
+        uint32_t LightVolumes = 0;  // Point and spot lights drawn last frame
+        uint32_t CulledLights = 0;  // Point lights outside of the frustum
+    };
+
+    DeferredRenderer();
+    ~DeferredRenderer();
+
+    DeferredRenderer(const DeferredRenderer&) = delete;
+    DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+    // G-buffer targets of a frame
+    struct GBuffer
+    {
+        RenderGraph::Handle Albedo = RenderGraph::InvalidHandle;
+        RenderGraph::Handle Normal = RenderGraph::InvalidHandle;
+        RenderGraph::Handle Depth = RenderGraph::InvalidHandle;
+    };
+
+    // Creates the G-buffer targets of the given size as the attachments of the pass being set up
+    static GBuffer CreateGBuffer(RenderGraph::Builder& builder, unsigned int width, unsigned int height);
+    // The lighting pass samples every target
+    static void ReadGBuffer(RenderGraph::Builder& builder, const GBuffer& gbuffer);
+
+    // Clears the G-buffer the graph bound, the geometry drawn until EndGeometry() must use G-buffer programs (GBufferFragment.glsl)
+    void BeginGeometry();
+    // Copies the depth and stencil of the G-buffer pass into the output framebuffer
+    void EndGeometry(const RenderGraph::Context& context);
+
+    // Framebuffer the G-buffer is shaded into, 0 (default framebuffer) unless rendering offscreen. It needs a
+    // DEPTH24_STENCIL8 depth/stencil attachment of the size of the G-buffer.
+    void SetOutputFramebuffer(unsigned int framebuffer) { m_OutputFramebuffer = framebuffer; }
+    unsigned int GetOutputFramebuffer() const { return m_OutputFramebuffer; }
+
+    // Shades the G-buffer into the output framebuffer, the camera block must be bound
+    void Light(const RenderGraph::Context& context, const GBuffer& gbuffer, const std::vector<ClusteredLights::PointLight>& pointLights, const SpotVolume& spot, const glm::mat4& viewProjection);
+
+    // GPU time of a pass, a GpuProfiler scope named after it. GetPassMs() is the rolling average, 0 when the pass did
+    // not run in the last frame read back.
+    void BeginTiming(Pass pass);
+    void EndTiming(Pass pass);
+    double GetPassMs(Pass pass) const;
+    static const char* GetPassName(Pass pass);
+
+    // Parameters of the lighting programs that are not set by the renderer (u_DirectionalLight, u_SpotLight)
+    ParameterBlock& GetDirectionalParameters() { return m_DirectionalParameters; }
+    ParameterBlock& GetSpotParameters() { return m_SpotParameters; }
+    // To bind the extra inputs of the directional pass (shadow map)
+    const Shader& GetDirectionalShader() const { return m_DirectionalShader; }
+
+    const Stats& GetStats() const { return m_Stats; }
+private:
+    struct Volume
+    {
+        unsigned int VertexArray = 0, VertexBuffer = 0, IndexBuffer = 0;
+        unsigned int IndexCount = 0;
+    };
+
+    void BindGBuffer(const Shader& shader, const unsigned int textures[3]) const;
+    void DrawVolume(const Volume& volume, const Shader& shader, ParameterBlock& parameters, const glm::mat4& model, ParameterBlock::Handle modelHandle);
+
+    static Volume CreateVolume(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+    static void DestroyVolume(Volume& volume);
+private:
+    unsigned int m_OutputFramebuffer = 0;
+
+    Shader m_DirectionalShader, m_StencilShader, m_PointShader, m_SpotShader;
+    ParameterBlock m_DirectionalParameters, m_StencilParameters, m_PointParameters, m_SpotParameters;
+    ParameterBlock::Handle m_StencilModel, m_PointModel, m_SpotModel;
+    ParameterBlock::Handle m_PointPositionRadius, m_PointColorIntensity;
+
+    Volume m_Sphere, m_Cone;
+    unsigned int m_EmptyVertexArray = 0; // Core profile draws need a vertex array, even without attributes
+
+    Stats m_Stats;
+};
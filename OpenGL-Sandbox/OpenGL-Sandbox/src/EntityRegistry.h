@@ -0,0 +1,248 @@
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Entity-component storage with one sparse set per component type. An entity is an index with a generation. Each pool
+// keeps its components packed in a dense array, in the order of a dense array of their entities, plus a sparse array
+// from entity index to dense position: adding, removing and looking a component up are O(1), and iterating a component
+// type walks contiguous memory with nothing in between. Removal moves the last component into the hole, so the dense
+// order changes. Entities and components are added and removed from one thread. Lookups and Each()/ParallelEach() can
+// run on any number of threads as long as nothing is added or removed in the meantime.
+//
+//     EntityRegistry::Entity entity = registry.Create();
+//     registry.Add<Bounds>(entity, center, radius);
+//     registry.Each<Transform, Bounds>([](EntityRegistry::Entity, Transform& transform, Bounds& bounds) { ... });
+class EntityRegistry
+{
+public:
+    // Index in the low bits, generation in the high bits: a destroyed entity's handle stops matching once its index is reused
+    using Entity = uint32_t;
+    static constexpr Entity Null = ~0u;
+    static constexpr unsigned int IndexBits = 24;   // Up to 16M entities alive at once, 256 generations per index
+    static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+
+    static uint32_t GetIndex(Entity entity) { return entity & IndexMask; }
+    static uint32_t GetGeneration(Entity entity) { return entity >> IndexBits; }
+
+    // Entities with a component of some type, its dense array of entities and their positions in it
+    class PoolBase
+    {
+    public:
+        virtual ~PoolBase() = default;
+
+        size_t GetSize() const { return m_Entities.size(); }
+        const std::vector<Entity>& GetEntities() const { return m_Entities; }
+
+        bool Has(Entity entity) const
+        {
+            const uint32_t index = GetIndex(entity);
+            return index < m_Sparse.size() && m_Sparse[index] != Absent && m_Entities[m_Sparse[index]] == entity;
+        }
+
+        virtual void Remove(Entity entity) = 0;
+    protected:
+        static constexpr uint32_t Absent = ~0u;
+
+        std::vector<uint32_t> m_Sparse;   // By entity index, position in the dense arrays
+        std::vector<Entity> m_Entities;   // Dense
+    };
+
+    template<typename T>
+    class Pool : public PoolBase
+    {
+    public:
+        // The entity must have the component, see Has()
+        T& Get(Entity entity) { return m_Components[m_Sparse[GetIndex(entity)]]; }
+        const T& Get(Entity entity) const { return m_Components[m_Sparse[GetIndex(entity)]]; }
+        T* TryGet(Entity entity) { return Has(entity) ? &Get(entity) : nullptr; }
+
+        // Dense components, in the order of GetEntities()
+        std::vector<T>& GetComponents() { return m_Components; }
+        const std::vector<T>& GetComponents() const { return m_Components; }
+
+        // Replaces the component if the entity has one already
+        template<typename... Args>
+        T& Emplace(Entity entity, Args&&... args)
+        {
+            if (Has(entity))
+                return Get(entity) = T{ std::forward<Args>(args)... };
+
+            const uint32_t index = GetIndex(entity);
+            if (index >= m_Sparse.size())
+                m_Sparse.resize(std::max<size_t>(index + 1, m_Sparse.size() * 2), Absent);
+            m_Sparse[index] = (uint32_t)m_Entities.size();
+            m_Entities.push_back(entity);
+            m_Components.push_back(T{ std::forward<Args>(args)... });
+            return m_Components.back();
+        }
+
+        void Remove(Entity entity) override
+        {
+            if (!Has(entity))
+                return;
+
+            // The last component fills the hole
+            const uint32_t position = m_Sparse[GetIndex(entity)];
+            const Entity last = m_Entities.back();
+            m_Entities[position] = last;
+            m_Components[position] = std::move(m_Components.back());
+            m_Sparse[GetIndex(last)] = position;
+            m_Sparse[GetIndex(entity)] = Absent;
+            m_Entities.pop_back();
+            m_Components.pop_back();
+        }
+
+        void Reserve(size_t count)
+        {
+            m_Entities.reserve(count);
+            m_Components.reserve(count);
+        }
+    private:
+        std::vector<T> m_Components;
+    };
+
+    EntityRegistry() = default;
+    EntityRegistry(const EntityRegistry&) = delete;
+    EntityRegistry& operator=(const EntityRegistry&) = delete;
+
+    void Reserve(size_t count) { m_Generations.reserve(count); }
+
+    Entity Create()
+    {
+        uint32_t index;
+        if (!m_Free.empty())
+        {
+            index = m_Free.back();
+            m_Free.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)m_Generations.size();
+            m_Generations.push_back(0);
+        }
+        m_Alive++;
+        return index | (m_Generations[index] << IndexBits);
+    }
+
+    // Removes every component of the entity, its handle no longer matches anything
+    void Destroy(Entity entity)
+    {
+        if (!IsAlive(entity))
+            return;
+
+        for (auto& pool : m_Pools)
+        {
+            if (pool)
+                pool->Remove(entity);
+        }
+
+        const uint32_t index = GetIndex(entity);
+        m_Generations[index] = (m_Generations[index] + 1) & (0xFFFFFFFFu >> IndexBits);
+        m_Free.push_back(index);
+        m_Alive--;
+    }
+
+    bool IsAlive(Entity entity) const
+    {
+        const uint32_t index = GetIndex(entity);
+        return entity != Null && index < m_Generations.size() && m_Generations[index] == GetGeneration(entity);
+    }
+
+    size_t GetCount() const { return m_Alive; }
+
+    template<typename T, typename... Args>
+    T& Add(Entity entity, Args&&... args) { return GetPool<T>().Emplace(entity, std::forward<Args>(args)...); }
+    template<typename T>
+    void Remove(Entity entity) { GetPool<T>().Remove(entity); }
+
+    template<typename T>
+    bool Has(Entity entity) { return GetPool<T>().Has(entity); }
+    template<typename T>
+    T& Get(Entity entity) { return GetPool<T>().Get(entity); }
+    template<typename T>
+    T* TryGet(Entity entity) { return GetPool<T>().TryGet(entity); }
+
+    // Created on first use, from the thread that adds and removes
+    template<typename T>
+    Pool<T>& GetPool()
+    {
+        const uint32_t type = GetTypeIndex<T>();
+        if (type >= m_Pools.size())
+            m_Pools.resize(type + 1);
+        if (!m_Pools[type])
+            m_Pools[type] = std::make_unique<Pool<T>>();
+        return static_cast<Pool<T>&>(*m_Pools[type]);
+    }
+
+    // Calls function(entity, components...) for every entity with all of the components. Goes through the smallest pool
+    // in dense order and looks the other components up.
+    template<typename... Ts, typename Function>
+    void Each(Function&& function)
+    {
+        std::tuple<Pool<Ts>&...> pools(GetPool<Ts>()...);
+        const std::vector<Entity>& entities = GetSmallest(std::get<Pool<Ts>&>(pools)...).GetEntities();
+        for (size_t i = 0; i < entities.size(); i++)
+        {
+            const Entity entity = entities[i];
+            if ((std::get<Pool<Ts>&>(pools).Has(entity) && ...))
+                function(entity, std::get<Pool<Ts>&>(pools).Get(entity)...);
+        }
+    }
+
+    // Same across the worker pool, function(entity, components..., thread) is called from any of its threads.
+    // The entities go by 'grain' (0 picks one), each job walks its part of the dense arrays.
+    template<typename... Ts, typename Function>
+    void ParallelEach(WorkerPool& workers, Function&& function, unsigned int grain = 0)
+    {
+        std::tuple<Pool<Ts>&...> pools(GetPool<Ts>()...);
+        const std::vector<Entity>& entities = GetSmallest(std::get<Pool<Ts>&>(pools)...).GetEntities();
+        const size_t count = entities.size();
+        if (grain == 0)
+            grain = (unsigned int)std::max<size_t>(EntitiesPerJob, count / (workers.GetThreadCount() * 8));
+
+        const unsigned int jobCount = (unsigned int)((count + grain - 1) / grain);
+        workers.ParallelFor(jobCount, [&](unsigned int job, unsigned int thread)
+        {
+            const size_t end = std::min(count, (size_t)(job + 1) * grain);
+            for (size_t i = (size_t)job * grain; i < end; i++)
+            {
+                const Entity entity = entities[i];
+                if ((std::get<Pool<Ts>&>(pools).Has(entity) && ...))
+                    function(entity, std::get<Pool<Ts>&>(pools).Get(entity)..., thread);
+            }
+        }, 1);
+    }
+private:
+    // Smaller jobs do not pay for the scheduling
+    static constexpr size_t EntitiesPerJob = 1024;
+
+    template<typename T>
+    static uint32_t GetTypeIndex()
+    {
+        static const uint32_t index = s_NextType.fetch_add(1);
+        return index;
+    }
+
+    template<typename First, typename... Rest>
+    static const PoolBase& GetSmallest(const First& first, const Rest&... rest)
+    {
+        const PoolBase* smallest = &first;
+        ((smallest = rest.GetSize() < smallest->GetSize() ? static_cast<const PoolBase*>(&rest) : smallest), ...);
+        return *smallest;
+    }
+private:
+    inline static std::atomic<uint32_t> s_NextType{ 0 };
+
+    std::vector<uint32_t> m_Generations;    // By entity index
+    std::vector<uint32_t> m_Free;           // Indices of destroyed entities, reused first
+    size_t m_Alive = 0;
+    std::vector<std::unique_ptr<PoolBase>> m_Pools; // By component type
+};
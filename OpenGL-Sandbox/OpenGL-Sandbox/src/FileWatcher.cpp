@@ -0,0 +1,141 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::string NormalizePath(const std::filesystem::path& path)
+    {
+        return path.lexically_normal().generic_string();
+    }
+
+    // Editors usually emit several events for a single save, wait a bit so they are reported once
+    constexpr auto CoalesceDelay = std::chrono::milliseconds(50);
+}
+
+FileWatcher::FileWatcher(Callback callback)
+    : m_Callback(std::move(callback))
+{
+#ifdef __linux__
+    m_INotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_INotifyFD < 0)
+    {
+        std::cerr << "[ERROR]: Failed to initialize inotify, shader hot reload is disabled!" << std::endl;
+        return;
+    }
+#endif
+
+    m_Thread = std::thread(&FileWatcher::Run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    m_Running = false;
+    if (m_Thread.joinable())
+        m_Thread.join();
+
+#ifdef __linux__
+    if (m_INotifyFD >= 0)
+        close(m_INotifyFD);
+#endif
+}
+
+void FileWatcher::Watch(const std::string& filePath)
+{
+    const std::string path = NormalizePath(filePath);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+#ifdef __linux__
+    if (m_INotifyFD < 0 || !m_Files.insert(path).second)
+        return;
+
+    std::string directory = std::filesystem::path(path).parent_path().generic_string();
+    if (directory.empty())
+        directory = ".";
+
+    // Watching the same directory twice returns the same descriptor
+    int wd = inotify_add_watch(m_INotifyFD, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+    {
+        std::cerr << "[ERROR]: Failed to watch directory '" << directory << "'" << std::endl;
+        return;
+    }
+    m_Directories[wd] = directory;
+#else
+    if (m_Files.count(path))
+        return;
+
+    std::error_code error;
+    m_Files[path] = std::filesystem::last_write_time(path, error);
+#endif
+}
+
+void FileWatcher::Run()
+{
+    while (m_Running)
+    {
+        std::vector<std::string> changedFiles;
+
+#ifdef __linux__
+        pollfd descriptor{ m_INotifyFD, POLLIN, 0 };
+        if (poll(&descriptor, 1, 100) <= 0)
+            continue;
+
+        std::this_thread::sleep_for(CoalesceDelay);
+
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(m_INotifyFD, buffer, sizeof(buffer))) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (char* cursor = buffer; cursor < buffer + length; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+                cursor += sizeof(inotify_event) + event->len;
+
+                auto directory = m_Directories.find(event->wd);
+                if (event->len == 0 || directory == m_Directories.end())
+                    continue;
+
+                const std::string path = NormalizePath(std::filesystem::path(directory->second) / event->name);
+                if (m_Files.count(path) && std::find(changedFiles.begin(), changedFiles.end(), path) == changedFiles.end())
+                    changedFiles.push_back(path);
+            }
+        }
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (auto& [path, lastWriteTime] : m_Files)
+            {
+                std::error_code error;
+                auto writeTime = std::filesystem::last_write_time(path, error);
+                if (!error && writeTime != lastWriteTime)
+                {
+                    lastWriteTime = writeTime;
+                    changedFiles.push_back(path);
+                }
+            }
+        }
+
+        if (!changedFiles.empty())
+            std::this_thread::sleep_for(CoalesceDelay);
+#endif
+
+        Notify(changedFiles);
+    }
+}
+
+void FileWatcher::Notify(const std::vector<std::string>& changedFiles)
+{
+    for (const auto& path : changedFiles)
+        m_Callback(path);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Watches a set of files from a background thread and reports modifications through a callback.
+// Linux uses inotify on the parent directories (editors often save by renaming a temporary file),
+// other platforms fall back to polling the last write time.
+class FileWatcher
+{
+public:
+    using Callback = std::function<void(const std::string& filePath)>;
+
+    FileWatcher(Callback callback);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void Watch(const std::string& filePath);
+private:
+    void Run();
+    void Notify(const std::vector<std::string>& changedFiles);
+private:
+    Callback m_Callback;
+    std::thread m_Thread;
+    std::atomic<bool> m_Running{ true };
+    std::mutex m_Mutex;
+
+#ifdef __linux__
+    int m_INotifyFD = -1;
+    std::unordered_map<int, std::string> m_Directories;  // inotify watch descriptor -> watched directory
+    std::unordered_set<std::string> m_Files;             // Watched file paths
+#else
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_Files; // Watched file path -> last seen write time
+#endif
+};
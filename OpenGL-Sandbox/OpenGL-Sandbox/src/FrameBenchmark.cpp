@@ -0,0 +1,172 @@
+#include "FrameBenchmark.h"
+#include "Trace.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // Value of "key": <number> in the flat results object, the only JSON this has to read back
+    bool ReadNumber(const std::string& json, const std::string& key, double& value)
+    {
+        const std::string pattern = "\"" + key + "\":";
+        const size_t position = json.find(pattern);
+        if (position == std::string::npos)
+            return false;
+
+        const char* start = json.c_str() + position + pattern.size();
+        char* end = nullptr;
+        value = std::strtod(start, &end);
+        return end != start;
+    }
+
+    using Results = FrameBenchmark::Results;
+
+    struct Metric
+    {
+        const char* Key;
+        double (*Get)(const Results& results);
+    };
+
+    // Timings gate the comparison, the counters only explain it (they change whenever the scene does)
+    const Metric TimingMetrics[] =
+    {
+        { "cpu_ms_p50", [](const Results& results) { return results.Cpu.Median; } },
+        { "cpu_ms_p95", [](const Results& results) { return results.Cpu.P95; } },
+        { "cpu_ms_p99", [](const Results& results) { return results.Cpu.P99; } },
+        { "gpu_ms_p50", [](const Results& results) { return results.Gpu.Median; } },
+        { "gpu_ms_p95", [](const Results& results) { return results.Gpu.P95; } },
+        { "gpu_ms_p99", [](const Results& results) { return results.Gpu.P99; } },
+    };
+
+    const Metric CounterMetrics[] =
+    {
+        { "draws", [](const Results& results) { return results.Draws; } },
+        { "triangles", [](const Results& results) { return results.Triangles; } },
+        { "instances", [](const Results& results) { return results.Instances; } },
+    };
+}
+
+FrameBenchmark::FrameBenchmark(unsigned int warmupFrames)
+    : m_WarmupFrames(warmupFrames)
+{
+}
+
+void FrameBenchmark::BeginFrame(uint64_t frameIndex)
+{
+    m_Recording = frameIndex >= m_WarmupFrames;
+    if (m_Recording)
+        m_Timings.BeginFrame();
+}
+
+void FrameBenchmark::EndFrame(const Counters& counters)
+{
+    if (!m_Recording)
+        return;
+
+    m_Timings.EndFrame();
+    m_Counters.push_back(counters);
+}
+
+void FrameBenchmark::Finish()
+{
+    m_Timings.Finish();
+}
+
+FrameBenchmark::Results FrameBenchmark::GetResults() const
+{
+    Results results;
+    results.Frames = m_Counters.size();
+    results.Cpu = FrameTimings::Summarize(m_Timings.GetCpuMs());
+    results.Gpu = FrameTimings::Summarize(m_Timings.GetGpuMs());
+
+    for (const Counters& counters : m_Counters)
+    {
+        results.Draws += counters.Draws;
+        results.Triangles += (double)counters.Triangles;
+        results.Instances += counters.Instances;
+    }
+    if (results.Frames > 0)
+    {
+        results.Draws /= results.Frames;
+        results.Triangles /= results.Frames;
+        results.Instances /= results.Frames;
+    }
+    return results;
+}
+
+bool FrameBenchmark::WriteJson(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info) const
+{
+    // The per-frame timings go to a file of their own, the results stay small enough to read and diff
+    const std::string timingsPath = path + ".frames.json";
+    if (!m_Timings.WriteJson(timingsPath, info))
+        return false;
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "[ERROR]: Could not open '" << path << "' for writing" << std::endl;
+        return false;
+    }
+
+    const Results results = GetResults();
+    file << std::fixed << std::setprecision(4) << "{\n";
+    for (const auto& [key, value] : info)
+        file << "  \"" << Trace::EscapeJson(key) << "\": \"" << Trace::EscapeJson(value) << "\",\n";
+    file << "  \"warmup_frames\":" << m_WarmupFrames << ",\n";
+    file << "  \"frames\":" << results.Frames << ",\n";
+    for (const Metric& metric : TimingMetrics)
+        file << "  \"" << metric.Key << "\":" << metric.Get(results) << ",\n";
+    file << "  \"cpu_ms_max\":" << results.Cpu.Max << ",\n";
+    file << "  \"gpu_ms_max\":" << results.Gpu.Max << ",\n";
+    for (const Metric& metric : CounterMetrics)
+        file << "  \"" << metric.Key << "\":" << metric.Get(results) << ",\n";
+    file << "  \"frame_timings\": \"" << timingsPath.substr(timingsPath.find_last_of("/\\") + 1) << "\"\n}\n";
+    return (bool)file;
+}
+
+bool FrameBenchmark::CompareBaseline(const std::string& path, double tolerance) const
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "[ERROR]: Could not open baseline '" << path << "'" << std::endl;
+        return false;
+    }
+    std::stringstream json;
+    json << file.rdbuf();
+
+    const Results results = GetResults();
+    bool passed = true;
+    std::cout << "[INFO]: Comparison with '" << path << "' (" << tolerance * 100.0 << " % tolerance):" << std::endl;
+
+    auto compare = [&](const Metric& metric, bool gate)
+    {
+        double baseline = 0.0;
+        if (!ReadNumber(json.str(), metric.Key, baseline))
+        {
+            std::cout << "    " << std::left << std::setw(12) << metric.Key << " missing from the baseline" << std::endl;
+            return;
+        }
+
+        const double current = metric.Get(results);
+        const double change = baseline > 0.0 ? (current - baseline) / baseline : 0.0;
+        const bool regressed = gate && change > tolerance;
+        passed &= !regressed;
+
+        std::cout << "    " << std::left << std::setw(12) << metric.Key << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << baseline << " -> " << std::setw(12) << current << std::showpos << std::setw(9) << change * 100.0
+            << std::noshowpos << " %" << (regressed ? "  REGRESSION" : "") << std::endl;
+    };
+
+    for (const Metric& metric : TimingMetrics)
+        compare(metric, true);
+    for (const Metric& metric : CounterMetrics)
+        compare(metric, false);
+
+    std::cout << "[INFO]: " << (passed ? "No regression" : "Regression against the baseline") << std::endl;
+    return passed;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "FrameTimings.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Frame benchmark of the whole renderer: after a warm-up, records the CPU and GPU time and the draw counts of every
+// frame, writes them as JSON and compares them with the results of an earlier run. The run itself has to be
+// repeatable (fixed time step, scripted camera, see CameraPath), only then do two results compare.
+class FrameBenchmark
+{
+public:
+    struct Counters
+    {
+        uint32_t Draws = 0;         // Draw API calls, every pass
+        uint64_t Triangles = 0;     // Every pass
+        uint32_t Instances = 0;     // Main pass
+    };
+
+    // Frame statistics of a run, as written to and read from the results
+    struct Results
+    {
+        uint64_t Frames = 0;
+        FrameTimings::Summary Cpu, Gpu;
+        double Draws = 0.0, Triangles = 0.0, Instances = 0.0; // Averages per frame
+    };
+
+    explicit FrameBenchmark(unsigned int warmupFrames);
+
+    // GL thread, around all the commands of a frame. Frames of the warm-up are not recorded.
+    void BeginFrame(uint64_t frameIndex);
+    void EndFrame(const Counters& counters);
+    // Collects the timings still in flight, after the last frame
+    void Finish();
+
+    Results GetResults() const;
+    bool WriteJson(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info) const;
+
+    // Reads results written by WriteJson(). Returns false if any timing percentile got slower than the baseline by more
+    // than 'tolerance' (0.05 for 5 %), or if the baseline cannot be read.
+    bool CompareBaseline(const std::string& path, double tolerance) const;
+private:
+    unsigned int m_WarmupFrames;
+    bool m_Recording = false;
+    FrameTimings m_Timings;
+    std::vector<Counters> m_Counters;
+};
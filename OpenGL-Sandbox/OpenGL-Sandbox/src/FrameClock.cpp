@@ -0,0 +1,122 @@
+#include "FrameClock.h"
+#include "CpuProfiler.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    // Sleeps wake up late by up to a scheduler quantum, the end of a wait spins
+    constexpr int64_t SpinNs = 1500000;
+}
+
+FrameClock::FrameClock(double tickRate, unsigned int maxStepsPerFrame)
+    : m_StepNs(std::max<int64_t>(1, (int64_t)std::llround(1e9 / std::max(tickRate, 1.0)))), m_MaxStepsPerFrame(std::max(maxStepsPerFrame, 1u)),
+    m_StartNs(Trace::Now())
+{
+}
+
+void FrameClock::SetFrameLimit(double framesPerSecond)
+{
+    m_LimitNs = framesPerSecond > 0.0 ? (int64_t)std::llround(1e9 / framesPerSecond) : 0;
+}
+
+void FrameClock::SetRefreshRate(double refreshRate)
+{
+    m_RefreshNs = refreshRate > 0.0 ? (int64_t)std::llround(1e9 / refreshRate) : 0;
+}
+
+double FrameClock::GetRealSeconds() const
+{
+    return (Trace::Now() - m_StartNs) * 1e-9;
+}
+
+unsigned int FrameClock::BeginFrame()
+{
+    if (m_LimitNs > 0 && m_LastFrameNs >= 0)
+    {
+        PROFILE_SCOPE("Frame limiter");
+        WaitUntil(m_NextFrameNs);
+    }
+
+    const int64_t now = Trace::Now();
+    if (m_LimitNs > 0)
+    {
+        // Next slot one period after this one, or after now if the frame came in more than a period late (no burst of
+        // short frames to catch up)
+        m_NextFrameNs = std::max(m_NextFrameNs + m_LimitNs, now);
+    }
+
+    unsigned int steps = 1;
+    if (m_LastFrameNs >= 0)
+    {
+        const double intervalMs = (now - m_LastFrameNs) * 1e-6;
+        const int64_t deadlineNs = m_LimitNs > 0 ? m_LimitNs : m_RefreshNs;
+        const bool missed = deadlineNs > 0 && intervalMs * 1e6 > deadlineNs * 1.5;
+        m_Pacing.Add(intervalMs, missed);
+        m_WindowPacing.Add(intervalMs, missed);
+
+        if (!m_Deterministic)
+        {
+            m_Accumulator += now - m_LastFrameNs;
+            steps = (unsigned int)std::min<int64_t>(m_Accumulator / m_StepNs, m_MaxStepsPerFrame);
+            const int64_t pending = m_Accumulator / m_StepNs - steps;
+            m_Stats.DroppedSteps += (uint64_t)pending;
+            m_Accumulator -= (steps + pending) * m_StepNs;
+        }
+    }
+    m_LastFrameNs = now;
+
+    // The first frame takes one step, there is a previous and a current state from then on
+    m_Alpha = m_Deterministic ? 0.0f : (float)((double)m_Accumulator / m_StepNs);
+    m_Steps += steps;
+    m_Stats.Steps += steps;
+    m_Stats.Frames++;
+    m_Pacing.Fill(m_Stats);
+    return steps;
+}
+
+FrameClock::Stats FrameClock::TakeWindowStats()
+{
+    Stats window;
+    window.Frames = m_Stats.Frames - m_WindowStart.Frames;
+    window.Steps = m_Stats.Steps - m_WindowStart.Steps;
+    window.DroppedSteps = m_Stats.DroppedSteps - m_WindowStart.DroppedSteps;
+    m_WindowPacing.Fill(window);
+
+    m_WindowStart = m_Stats;
+    m_WindowPacing = Pacing();
+    return window;
+}
+
+void FrameClock::Pacing::Add(double intervalMs, bool missed)
+{
+    Intervals++;
+    Missed += missed ? 1 : 0;
+    SumMs += intervalMs;
+    SumSquaresMs += intervalMs * intervalMs;
+    MaxMs = std::max(MaxMs, intervalMs);
+}
+
+void FrameClock::Pacing::Fill(Stats& stats) const
+{
+    stats.MissedDeadlines = Missed;
+    stats.MaxIntervalMs = MaxMs;
+    if (Intervals == 0)
+        return;
+
+    stats.AverageIntervalMs = SumMs / Intervals;
+    stats.JitterMs = std::sqrt(std::max(0.0, SumSquaresMs / Intervals - stats.AverageIntervalMs * stats.AverageIntervalMs));
+}
+
+void FrameClock::WaitUntil(int64_t deadlineNs) const
+{
+    int64_t remaining = deadlineNs - Trace::Now();
+    if (remaining > SpinNs)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - SpinNs));
+    while (Trace::Now() < deadlineNs)
+        std::this_thread::yield();
+}
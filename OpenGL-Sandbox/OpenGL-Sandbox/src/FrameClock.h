@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+// Frame loop timing: the simulation advances in fixed steps on a monotonic nanosecond clock, whatever the frame rate,
+// and rendering interpolates between the last two simulation states (GetAlpha()). Optionally limits the frame rate,
+// and measures the frame pacing: the jitter of the frame intervals and the frames that missed their deadline (the
+// limiter period, or the refresh period with vsync).
+class FrameClock
+{
+public:
+    struct Stats
+    {
+        uint64_t Frames = 0;
+        uint64_t Steps = 0;             // Simulation steps run
+        uint64_t DroppedSteps = 0;      // Steps skipped after a stall, the simulation slows down instead of spiralling
+        uint64_t MissedDeadlines = 0;   // Frame intervals longer than 1.5 deadline periods, a vblank or a limiter slot lost
+        double AverageIntervalMs = 0.0;
+        double JitterMs = 0.0;          // Standard deviation of the frame intervals
+        double MaxIntervalMs = 0.0;
+    };
+
+    // 'tickRate' simulation steps per second
+    explicit FrameClock(double tickRate = 60.0, unsigned int maxStepsPerFrame = 8);
+
+    // Deterministic runs (headless, benchmarks): one step per frame whatever the time it took. The alpha stays 0, so frame N
+    // (from 1) runs step N and renders the previous state, the simulation at N - 1 steps
+    void SetDeterministic(bool deterministic) { m_Deterministic = deterministic; }
+    // Frames per second the limiter holds the loop to, 0 turns it off
+    void SetFrameLimit(double framesPerSecond);
+    // Refresh rate of the display when presentation waits for vsync, the deadline when the limiter is off
+    void SetRefreshRate(double refreshRate);
+
+    // Start of a frame: waits for the limiter, then returns the number of simulation steps to run before rendering
+    unsigned int BeginFrame();
+
+    // Seconds of one simulation step, and the simulation time after the steps of this frame
+    double GetStepSeconds() const { return m_StepNs * 1e-9; }
+    double GetSimulationSeconds() const { return (double)m_Steps * m_StepNs * 1e-9; }
+    // How far rendering is between the previous (0) and the current (1) simulation state
+    float GetAlpha() const { return m_Alpha; }
+    // Simulation time of the rendered frame, interpolated like the states
+    double GetRenderSeconds() const { return ((double)m_Steps - 1.0 + m_Alpha) * m_StepNs * 1e-9; }
+    // Monotonic time since the clock was created
+    double GetRealSeconds() const;
+
+    const Stats& GetStats() const { return m_Stats; }
+    // Statistics since the previous call, for periodic reports
+    Stats TakeWindowStats();
+private:
+    struct Pacing
+    {
+        uint64_t Intervals = 0, Missed = 0;
+        double SumMs = 0.0, SumSquaresMs = 0.0, MaxMs = 0.0;
+
+        void Add(double intervalMs, bool missed);
+        void Fill(Stats& stats) const;
+    };
+
+    void WaitUntil(int64_t deadlineNs) const;
+private:
+    int64_t m_StepNs;
+    unsigned int m_MaxStepsPerFrame;
+    bool m_Deterministic = false;
+    int64_t m_LimitNs = 0, m_RefreshNs = 0;
+
+    int64_t m_StartNs;
+    int64_t m_LastFrameNs = -1;
+    int64_t m_NextFrameNs = 0;          // Limiter slot of the next frame
+    int64_t m_Accumulator = 0;          // Real time not yet simulated
+    uint64_t m_Steps = 0;
+    float m_Alpha = 1.0f;
+
+    Stats m_Stats, m_WindowStart;
+    Pacing m_Pacing, m_WindowPacing;
+};
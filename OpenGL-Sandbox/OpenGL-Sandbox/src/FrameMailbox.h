@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Hands frame packets from the thread that builds them to the thread that renders them, one producer and one consumer.
+// The packets live in 'capacity' slots (2 for double buffering, up to MaxCapacity), a slot is written by the producer,
+// published, read by the consumer and only then written again: the producer can be at most capacity - 1 packets ahead
+// of the one being rendered, and waits when it gets there. Packets are rendered in order, none is dropped.
+//
+//     Producer: if (T* packet = mailbox.BeginWrite()) { fill *packet; mailbox.EndWrite(); }
+//     Consumer: while (const T* packet = mailbox.BeginRead()) { render *packet; mailbox.EndRead(); }
+template<typename T, unsigned int MaxCapacity = 3>
+class FrameMailbox
+{
+public:
+    // Totals since the start, in milliseconds
+    struct Stats
+    {
+        uint64_t Packets = 0;           // Read by the consumer
+        double ProducerWaitMs = 0.0;    // The consumer was too far behind, pipeline full
+        double ConsumerWaitMs = 0.0;    // Nothing published yet, the consumer starved
+        double MaxProducerWaitMs = 0.0, MaxConsumerWaitMs = 0.0;
+        double AgeMs = 0.0;             // From publication to the start of the read, the time a packet waits in the pipeline
+        double MaxAgeMs = 0.0;
+        uint64_t Depth = 0;             // Sum of the packets waiting at each read, this one included
+    };
+
+    explicit FrameMailbox(unsigned int capacity = 2)
+        : m_Capacity(std::clamp(capacity, 2u, MaxCapacity))
+    {
+    }
+
+    FrameMailbox(const FrameMailbox&) = delete;
+    FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+    unsigned int GetCapacity() const { return m_Capacity; }
+
+    // Producer: the next free slot, after waiting for one up to 'timeoutMs' (negative waits as long as it takes).
+    // nullptr on timeout or once the mailbox is closed.
+    T* BeginWrite(double timeoutMs = -1.0)
+    {
+        const int64_t start = Trace::Now();
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        auto hasSlot = [this] { return m_Closed || m_Used < m_Capacity; };
+        if (timeoutMs < 0.0)
+            m_SlotFreed.wait(lock, hasSlot);
+        else
+            m_SlotFreed.wait_for(lock, std::chrono::duration<double, std::milli>(timeoutMs), hasSlot);
+
+        const double waitMs = (Trace::Now() - start) * 1e-6;
+        m_Stats.ProducerWaitMs += waitMs;
+        m_Stats.MaxProducerWaitMs = std::max(m_Stats.MaxProducerWaitMs, waitMs);
+        if (m_Closed || m_Used == m_Capacity)
+            return nullptr;
+        return &m_Slots[(m_Head + m_Used) % m_Capacity].Value;
+    }
+
+    // Producer: publishes the slot of BeginWrite(), it is not touched again until the consumer is done with it
+    void EndWrite()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Slots[(m_Head + m_Used) % m_Capacity].PublishedNs = Trace::Now();
+            m_Used++;
+        }
+        m_Published.notify_one();
+    }
+
+    // Consumer: the oldest published packet, after waiting for one. nullptr once the mailbox is closed and empty.
+    const T* BeginRead()
+    {
+        const int64_t start = Trace::Now();
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Published.wait(lock, [this] { return m_Closed || m_Used > 0; });
+
+        const int64_t now = Trace::Now();
+        const double waitMs = (now - start) * 1e-6;
+        m_Stats.ConsumerWaitMs += waitMs;
+        m_Stats.MaxConsumerWaitMs = std::max(m_Stats.MaxConsumerWaitMs, waitMs);
+        if (m_Used == 0)
+            return nullptr;
+
+        const double ageMs = (now - m_Slots[m_Head].PublishedNs) * 1e-6;
+        m_Stats.Packets++;
+        m_Stats.AgeMs += ageMs;
+        m_Stats.MaxAgeMs = std::max(m_Stats.MaxAgeMs, ageMs);
+        m_Stats.Depth += m_Used;
+        return &m_Slots[m_Head].Value;
+    }
+
+    // Consumer: frees the slot of BeginRead() for the producer
+    void EndRead()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Head = (m_Head + 1) % m_Capacity;
+            m_Used--;
+        }
+        m_SlotFreed.notify_one();
+    }
+
+    // No more packets: the producer gets nullptr, the consumer reads what was published and then gets nullptr
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Closed = true;
+        }
+        m_SlotFreed.notify_all();
+        m_Published.notify_all();
+    }
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Stats;
+    }
+private:
+    struct Slot
+    {
+        T Value{};
+        int64_t PublishedNs = 0;
+    };
+
+    unsigned int m_Capacity;
+    std::array<Slot, MaxCapacity> m_Slots;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_SlotFreed, m_Published;
+    unsigned int m_Head = 0;    // Oldest slot in use: being read, or the next to be
+    unsigned int m_Used = 0;    // Published slots, the one being read included
+    bool m_Closed = false;
+    Stats m_Stats;
+};
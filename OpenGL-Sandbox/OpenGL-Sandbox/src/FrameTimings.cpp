@@ -0,0 +1,131 @@
+#include "FrameTimings.h"
+#include "Trace.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace
+{
+    void WriteArray(std::ofstream& file, const std::vector<double>& values)
+    {
+        file << "[";
+        for (size_t i = 0; i < values.size(); i++)
+            file << (i ? ", " : "") << values[i];
+        file << "]";
+    }
+
+    void WriteSummary(std::ofstream& file, const FrameTimings::Summary& summary)
+    {
+        file << "{ \"min\": " << summary.Min << ", \"avg\": " << summary.Average << ", \"p50\": " << summary.Median
+            << ", \"p95\": " << summary.P95 << ", \"p99\": " << summary.P99 << ", \"max\": " << summary.Max << " }";
+    }
+}
+
+FrameTimings::FrameTimings()
+{
+    glGenQueries(QueryLatency * 2, &m_Queries[0][0]);
+    std::fill(std::begin(m_QueryFrame), std::end(m_QueryFrame), -1);
+}
+
+FrameTimings::~FrameTimings()
+{
+    glDeleteQueries(QueryLatency * 2, &m_Queries[0][0]);
+}
+
+void FrameTimings::BeginFrame()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (m_Started)
+        m_CpuMs.push_back(std::chrono::duration<double, std::milli>(now - m_FrameStart).count());
+    m_FrameStart = now;
+    m_Started = true;
+
+    m_FrameIndex++;
+    const unsigned int slot = (unsigned int)(m_FrameIndex % QueryLatency);
+    Resolve(slot);
+
+    glQueryCounter(m_Queries[slot][0], GL_TIMESTAMP);
+    m_QueryFrame[slot] = m_FrameIndex;
+}
+
+void FrameTimings::EndFrame()
+{
+    glQueryCounter(m_Queries[m_FrameIndex % QueryLatency][1], GL_TIMESTAMP);
+}
+
+void FrameTimings::Finish()
+{
+    // The last frame has no next BeginFrame(), it ends now
+    if (m_Started)
+    {
+        m_CpuMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_FrameStart).count());
+        m_Started = false;
+    }
+
+    for (int64_t frame = m_FrameIndex - QueryLatency + 1; frame <= m_FrameIndex; frame++)
+    {
+        if (frame >= 0)
+            Resolve((unsigned int)(frame % QueryLatency));
+    }
+}
+
+void FrameTimings::Resolve(unsigned int slot)
+{
+    if (m_QueryFrame[slot] < 0)
+        return;
+
+    // Slots are resolved in frame order, so the results line up with the CPU times
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(m_Queries[slot][0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(m_Queries[slot][1], GL_QUERY_RESULT, &end);
+    m_GpuMs.push_back(end > begin ? (end - begin) / 1e6 : 0.0);
+    m_QueryFrame[slot] = -1;
+}
+
+FrameTimings::Summary FrameTimings::Summarize(std::vector<double> values)
+{
+    Summary summary;
+    if (values.empty())
+        return summary;
+
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) { return values[(size_t)(p * (values.size() - 1) + 0.5)]; };
+
+    summary.Min = values.front();
+    summary.Max = values.back();
+    summary.Average = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    summary.Median = percentile(0.5);
+    summary.P95 = percentile(0.95);
+    summary.P99 = percentile(0.99);
+    return summary;
+}
+
+bool FrameTimings::WriteJson(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "[ERROR]: Could not open '" << path << "' for writing" << std::endl;
+        return false;
+    }
+
+    file << "{\n";
+    for (const auto& [key, value] : info)
+        file << "  \"" << Trace::EscapeJson(key) << "\": \"" << Trace::EscapeJson(value) << "\",\n";
+
+    file << "  \"frames\": " << m_CpuMs.size() << ",\n";
+    file << "  \"cpu_ms_summary\": ";
+    WriteSummary(file, Summarize(m_CpuMs));
+    file << ",\n  \"gpu_ms_summary\": ";
+    WriteSummary(file, Summarize(m_GpuMs));
+    file << ",\n  \"cpu_ms\": ";
+    WriteArray(file, m_CpuMs);
+    file << ",\n  \"gpu_ms\": ";
+    WriteArray(file, m_GpuMs);
+    file << "\n}\n";
+    return (bool)file;
+}
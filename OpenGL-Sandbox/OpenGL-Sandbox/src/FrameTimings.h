@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Records the CPU and GPU time of every frame of a run, to be written as JSON at the end (headless benchmarks).
+// The CPU time is the wall clock time between two BeginFrame() calls. The GPU time is measured with timestamp queries
+// around the frame's commands, so it also works while other passes use GL_TIME_ELAPSED queries, and it is read back a
+// few frames later; reading a query that is not available yet waits for it rather than dropping the frame.
+class FrameTimings
+{
+public:
+    struct Summary
+    {
+        double Min = 0.0, Average = 0.0, Median = 0.0, P95 = 0.0, P99 = 0.0, Max = 0.0;
+    };
+
+    FrameTimings();
+    ~FrameTimings();
+
+    FrameTimings(const FrameTimings&) = delete;
+    FrameTimings& operator=(const FrameTimings&) = delete;
+
+    // GL thread only, around all the commands of a frame (EndFrame() before the swap)
+    void BeginFrame();
+    void EndFrame();
+    // Collects the queries still in flight, before reading the results
+    void Finish();
+
+    const std::vector<double>& GetCpuMs() const { return m_CpuMs; }
+    const std::vector<double>& GetGpuMs() const { return m_GpuMs; }
+    static Summary Summarize(std::vector<double> values);
+
+    // The 'info' pairs are written as strings next to the timings (renderer, settings...)
+    bool WriteJson(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info) const;
+private:
+    void Resolve(unsigned int slot);
+private:
+    static constexpr unsigned int QueryLatency = 4;
+    unsigned int m_Queries[QueryLatency][2] = {}; // Begin and end timestamps
+    int64_t m_QueryFrame[QueryLatency] = {};      // Frame whose timestamps a slot holds, -1 when free
+    int64_t m_FrameIndex = -1;
+
+    std::chrono::steady_clock::time_point m_FrameStart;
+    bool m_Started = false;
+
+    std::vector<double> m_CpuMs, m_GpuMs;
+};
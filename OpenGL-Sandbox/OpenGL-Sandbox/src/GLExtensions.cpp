@@ -0,0 +1,52 @@
+#include "GLExtensions.h"
+
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+namespace GLExtensions
+{
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+    PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+    namespace
+    {
+        std::unordered_set<std::string> s_Extensions;
+        bool s_MultiDrawIndirect = false;
+        bool s_BufferStorage = false;
+    }
+
+    void Load(GLADloadproc loader)
+    {
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++)
+            s_Extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+
+        if (IsSupported("GL_ARB_multi_draw_indirect") && IsSupported("GL_ARB_base_instance"))
+            MultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+        s_MultiDrawIndirect = MultiDrawElementsIndirect != nullptr;
+
+        if (IsSupported("GL_ARB_buffer_storage"))
+            BufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+        s_BufferStorage = BufferStorage != nullptr;
+
+        std::cout << "[INFO]: Multi-draw indirect " << (s_MultiDrawIndirect ? "available" : "not available, using one draw call per mesh") << std::endl;
+        std::cout << "[INFO]: Buffer storage " << (s_BufferStorage ? "available" : "not available, dynamic data goes through orphaned buffers") << std::endl;
+    }
+
+    bool IsSupported(const char* extension)
+    {
+        return s_Extensions.count(extension) != 0;
+    }
+
+    bool HasMultiDrawIndirect()
+    {
+        return s_MultiDrawIndirect;
+    }
+
+    bool HasBufferStorage()
+    {
+        return s_BufferStorage;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// The loader only covers GL 3.3 core, the newer entry points used as optional fast paths are loaded here.
+// Every feature is checked against the extension string, so callers keep a 3.3 fallback for when it is missing.
+#ifndef GL_DRAW_INDIRECT_BUFFER
+    #define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+    #define GL_MAP_PERSISTENT_BIT 0x0040
+    #define GL_MAP_COHERENT_BIT 0x0080
+    #define GL_DYNAMIC_STORAGE_BIT 0x0100
+    #define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+namespace GLExtensions
+{
+    // Layout of one glMultiDrawElementsIndirect command, as read from GL_DRAW_INDIRECT_BUFFER
+    struct DrawElementsIndirectCommand
+    {
+        unsigned int Count;
+        unsigned int InstanceCount;
+        unsigned int FirstIndex;
+        int BaseVertex;
+        unsigned int BaseInstance;
+    };
+
+    // Must be called once the context is current, with the same loader that was given to GLAD
+    void Load(GLADloadproc loader);
+
+    bool IsSupported(const char* extension);
+
+    // GL_ARB_multi_draw_indirect with GL_ARB_base_instance (core in 4.3)
+    bool HasMultiDrawIndirect();
+
+    // GL_ARB_buffer_storage (core in 4.4), needed for persistently mapped buffers
+    bool HasBufferStorage();
+
+    extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+    extern PFNGLBUFFERSTORAGEPROC BufferStorage;
+}
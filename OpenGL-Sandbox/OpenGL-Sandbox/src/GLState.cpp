@@ -0,0 +1,493 @@
+#include "GLState.h"
+#include "GLExtensions.h"
+
+#include <glad/glad.h>
+
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+    constexpr unsigned int Unknown = 0xFFFFFFFF;
+    constexpr unsigned int MaxTextureUnits = 32;
+    constexpr unsigned int MaxBufferBindings = 32;
+
+    // Texture targets that are tracked per unit, other targets are always issued
+    constexpr unsigned int TextureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER, GL_TEXTURE_3D };
+    constexpr unsigned int TextureTargetCount = sizeof(TextureTargets) / sizeof(TextureTargets[0]);
+
+    constexpr unsigned int BufferTargets[] = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_TEXTURE_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_DRAW_INDIRECT_BUFFER };
+    constexpr unsigned int BufferTargetCount = sizeof(BufferTargets) / sizeof(BufferTargets[0]);
+
+    constexpr unsigned int Capabilities[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_STENCIL_TEST, GL_SCISSOR_TEST, GL_POLYGON_OFFSET_FILL, GL_DEPTH_CLAMP, GL_FRAMEBUFFER_SRGB, GL_MULTISAMPLE, GL_PROGRAM_POINT_SIZE };
+    constexpr unsigned int CapabilityCount = sizeof(Capabilities) / sizeof(Capabilities[0]);
+
+    struct State
+    {
+        unsigned int Program;
+        unsigned int VertexArray;
+        unsigned int ActiveTexture;
+        unsigned int Textures[MaxTextureUnits][TextureTargetCount];
+        unsigned int Buffers[BufferTargetCount];
+        unsigned int UniformBuffers[MaxBufferBindings];
+        size_t UniformOffsets[MaxBufferBindings], UniformSizes[MaxBufferBindings]; // Bound range, 0 and 0 for a whole buffer
+        unsigned int DrawFramebuffer, ReadFramebuffer;
+        unsigned int CapabilityStates[CapabilityCount]; // 0 = disabled, 1 = enabled, Unknown
+        unsigned int PolygonMode;
+        unsigned int DepthFunc;
+        unsigned int DepthMask;
+        unsigned int CullFace;
+        unsigned int BlendSource, BlendDestination;
+        unsigned int ColorMask;
+        unsigned int StencilFunction, StencilMask;
+        int StencilReference;
+        unsigned int StencilOps[2][3]; // Front and back: stencil fail, depth fail, depth pass
+        float PolygonOffset[2]; // Factor and units
+        bool PolygonOffsetKnown;
+        int Viewport[4];
+
+        State() { Reset(); }
+
+        void Reset()
+        {
+            Program = VertexArray = ActiveTexture = Unknown;
+            for (auto& unit : Textures)
+                for (auto& texture : unit)
+                    texture = Unknown;
+            for (auto& buffer : Buffers)
+                buffer = Unknown;
+            for (auto& buffer : UniformBuffers)
+                buffer = Unknown;
+            for (unsigned int i = 0; i < MaxBufferBindings; i++)
+                UniformOffsets[i] = UniformSizes[i] = 0;
+            DrawFramebuffer = ReadFramebuffer = Unknown;
+            for (auto& capability : CapabilityStates)
+                capability = Unknown;
+            PolygonMode = DepthFunc = DepthMask = CullFace = ColorMask = Unknown;
+            BlendSource = BlendDestination = Unknown;
+            StencilFunction = StencilMask = Unknown;
+            StencilReference = -1;
+            for (auto& face : StencilOps)
+                face[0] = face[1] = face[2] = Unknown;
+            PolygonOffset[0] = PolygonOffset[1] = 0.0f;
+            PolygonOffsetKnown = false;
+            Viewport[0] = Viewport[1] = Viewport[2] = Viewport[3] = -1;
+        }
+    };
+
+    State s_State;
+    GLState::Stats s_Stats;
+
+    // Returns true if the call has to be issued, and updates the cached value
+    inline bool Update(unsigned int& cached, unsigned int value, GLState::Call call)
+    {
+        GLState::Counter& counter = s_Stats.Calls[(int)call];
+        if (cached == value)
+        {
+            counter.Elided++;
+            return false;
+        }
+
+        cached = value;
+        counter.Issued++;
+        return true;
+    }
+
+    template<size_t N>
+    inline int IndexOf(const unsigned int (&values)[N], unsigned int value)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            if (values[i] == value)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    void SetCapability(unsigned int capability, bool enabled)
+    {
+        const int index = IndexOf(Capabilities, capability);
+        if (index < 0)
+            s_Stats.Calls[(int)GLState::Call::Capability].Issued++;
+        else if (!Update(s_State.CapabilityStates[index], enabled ? 1 : 0, GLState::Call::Capability))
+            return;
+
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    template<typename T, size_t N>
+    inline void Forget(T (&cached)[N], unsigned int name)
+    {
+        for (auto& value : cached)
+        {
+            if (value == name)
+                value = Unknown;
+        }
+    }
+}
+
+namespace GLState
+{
+    Counter Stats::Total() const
+    {
+        Counter total;
+        for (const auto& counter : Calls)
+        {
+            total.Issued += counter.Issued;
+            total.Elided += counter.Elided;
+        }
+        return total;
+    }
+
+    const char* GetCallName(Call call)
+    {
+        switch (call)
+        {
+        case Call::UseProgram:      return "UseProgram";
+        case Call::BindVertexArray: return "BindVertexArray";
+        case Call::ActiveTexture:   return "ActiveTexture";
+        case Call::BindTexture:     return "BindTexture";
+        case Call::BindBuffer:      return "BindBuffer";
+        case Call::BindBufferBase:  return "BindBufferBase";
+        case Call::BindBufferRange: return "BindBufferRange";
+        case Call::BindFramebuffer: return "BindFramebuffer";
+        case Call::Capability:      return "Enable/Disable";
+        case Call::PolygonMode:     return "PolygonMode";
+        case Call::DepthFunc:       return "DepthFunc";
+        case Call::DepthMask:       return "DepthMask";
+        case Call::CullFace:        return "CullFace";
+        case Call::BlendFunc:       return "BlendFunc";
+        case Call::ColorMask:       return "ColorMask";
+        case Call::StencilFunc:     return "StencilFunc";
+        case Call::StencilOp:       return "StencilOp";
+        case Call::PolygonOffset:   return "PolygonOffset";
+        case Call::Viewport:        return "Viewport";
+        default:                    return "Unknown";
+        }
+    }
+
+    const Stats& GetStats()
+    {
+        return s_Stats;
+    }
+
+    void ResetStats()
+    {
+        s_Stats = Stats();
+    }
+
+    void PrintStats(const Stats& stats, uint64_t frameCount)
+    {
+        if (frameCount == 0)
+            frameCount = 1;
+
+        std::cout << "[INFO]: GL state changes over " << frameCount << " frames (per frame average)" << std::endl;
+        std::cout << "    " << std::left << std::setw(18) << "Call" << std::right << std::setw(12) << "Issued" << std::setw(12) << "Elided" << std::endl;
+        for (int i = 0; i < (int)Call::Count; i++)
+        {
+            const Counter& counter = stats.Calls[i];
+            std::cout << "    " << std::left << std::setw(18) << GetCallName((Call)i) << std::right
+                << std::setw(12) << counter.Issued / frameCount << std::setw(12) << counter.Elided / frameCount << std::endl;
+        }
+
+        const Counter total = stats.Total();
+        const uint64_t calls = total.Issued + total.Elided;
+        std::cout << "    " << std::left << std::setw(18) << "Total" << std::right
+            << std::setw(12) << total.Issued / frameCount << std::setw(12) << total.Elided / frameCount
+            << "  (" << (calls ? total.Elided * 100 / calls : 0) << "% elided)" << std::endl;
+    }
+
+    void Invalidate()
+    {
+        s_State.Reset();
+    }
+
+    void UseProgram(unsigned int program)
+    {
+        if (Update(s_State.Program, program, Call::UseProgram))
+            glUseProgram(program);
+    }
+
+    void BindVertexArray(unsigned int vertexArray)
+    {
+        if (Update(s_State.VertexArray, vertexArray, Call::BindVertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    void BindTexture(unsigned int unit, unsigned int target, unsigned int texture)
+    {
+        const int targetIndex = IndexOf(TextureTargets, target);
+        if (unit < MaxTextureUnits && targetIndex >= 0 && s_State.Textures[unit][targetIndex] == texture)
+        {
+            s_Stats.Calls[(int)Call::BindTexture].Elided++;
+            return;
+        }
+
+        // The active unit only has to change when a bind is actually issued
+        if (Update(s_State.ActiveTexture, unit, Call::ActiveTexture))
+            glActiveTexture(GL_TEXTURE0 + unit);
+
+        s_Stats.Calls[(int)Call::BindTexture].Issued++;
+        if (unit < MaxTextureUnits && targetIndex >= 0)
+            s_State.Textures[unit][targetIndex] = texture;
+
+        glBindTexture(target, texture);
+    }
+
+    unsigned int GetActiveTextureUnit()
+    {
+        return s_State.ActiveTexture == Unknown ? 0 : s_State.ActiveTexture;
+    }
+
+    void BindBuffer(unsigned int target, unsigned int buffer)
+    {
+        const int index = IndexOf(BufferTargets, target);
+        if (index < 0)
+            s_Stats.Calls[(int)Call::BindBuffer].Issued++;
+        else if (!Update(s_State.Buffers[index], buffer, Call::BindBuffer))
+            return;
+
+        glBindBuffer(target, buffer);
+    }
+
+    void BindBufferBase(unsigned int target, unsigned int index, unsigned int buffer)
+    {
+        if (target != GL_UNIFORM_BUFFER || index >= MaxBufferBindings)
+            s_Stats.Calls[(int)Call::BindBufferBase].Issued++;
+        else
+        {
+            // A range of the same buffer is a different binding
+            if (s_State.UniformSizes[index] != 0)
+                s_State.UniformBuffers[index] = Unknown;
+            s_State.UniformOffsets[index] = s_State.UniformSizes[index] = 0;
+
+            if (!Update(s_State.UniformBuffers[index], buffer, Call::BindBufferBase))
+                return;
+        }
+
+        // Binding an indexed target also binds the generic one
+        const int generic = IndexOf(BufferTargets, target);
+        if (generic >= 0)
+            s_State.Buffers[generic] = buffer;
+
+        glBindBufferBase(target, index, buffer);
+    }
+
+    void BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, size_t offset, size_t size)
+    {
+        GLState::Counter& counter = s_Stats.Calls[(int)Call::BindBufferRange];
+        if (target == GL_UNIFORM_BUFFER && index < MaxBufferBindings)
+        {
+            if (s_State.UniformBuffers[index] == buffer && s_State.UniformOffsets[index] == offset && s_State.UniformSizes[index] == size)
+            {
+                counter.Elided++;
+                return;
+            }
+
+            s_State.UniformBuffers[index] = buffer;
+            s_State.UniformOffsets[index] = offset;
+            s_State.UniformSizes[index] = size;
+        }
+        counter.Issued++;
+
+        const int generic = IndexOf(BufferTargets, target);
+        if (generic >= 0)
+            s_State.Buffers[generic] = buffer;
+
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    void BindFramebuffer(unsigned int target, unsigned int framebuffer)
+    {
+        bool issue = false;
+        if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+            issue |= s_State.DrawFramebuffer != framebuffer;
+        if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+            issue |= s_State.ReadFramebuffer != framebuffer;
+
+        Counter& counter = s_Stats.Calls[(int)Call::BindFramebuffer];
+        if (!issue)
+        {
+            counter.Elided++;
+            return;
+        }
+
+        if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+            s_State.DrawFramebuffer = framebuffer;
+        if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+            s_State.ReadFramebuffer = framebuffer;
+
+        counter.Issued++;
+        glBindFramebuffer(target, framebuffer);
+    }
+
+    void Enable(unsigned int capability)
+    {
+        SetCapability(capability, true);
+    }
+
+    void Disable(unsigned int capability)
+    {
+        SetCapability(capability, false);
+    }
+
+    void PolygonMode(unsigned int mode)
+    {
+        if (Update(s_State.PolygonMode, mode, Call::PolygonMode))
+            glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+
+    void DepthFunc(unsigned int function)
+    {
+        if (Update(s_State.DepthFunc, function, Call::DepthFunc))
+            glDepthFunc(function);
+    }
+
+    void DepthMask(bool enabled)
+    {
+        if (Update(s_State.DepthMask, enabled ? 1 : 0, Call::DepthMask))
+            glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+
+    void CullFace(unsigned int face)
+    {
+        if (Update(s_State.CullFace, face, Call::CullFace))
+            glCullFace(face);
+    }
+
+    void BlendFunc(unsigned int source, unsigned int destination)
+    {
+        Counter& counter = s_Stats.Calls[(int)Call::BlendFunc];
+        if (s_State.BlendSource == source && s_State.BlendDestination == destination)
+        {
+            counter.Elided++;
+            return;
+        }
+
+        s_State.BlendSource = source;
+        s_State.BlendDestination = destination;
+        counter.Issued++;
+        glBlendFunc(source, destination);
+    }
+
+    void ColorMask(bool enabled)
+    {
+        if (Update(s_State.ColorMask, enabled ? 1 : 0, Call::ColorMask))
+        {
+            const GLboolean value = enabled ? GL_TRUE : GL_FALSE;
+            glColorMask(value, value, value, value);
+        }
+    }
+
+    void StencilFunc(unsigned int function, int reference, unsigned int mask)
+    {
+        Counter& counter = s_Stats.Calls[(int)Call::StencilFunc];
+        if (s_State.StencilFunction == function && s_State.StencilReference == reference && s_State.StencilMask == mask)
+        {
+            counter.Elided++;
+            return;
+        }
+
+        s_State.StencilFunction = function;
+        s_State.StencilReference = reference;
+        s_State.StencilMask = mask;
+        counter.Issued++;
+        glStencilFunc(function, reference, mask);
+    }
+
+    void StencilOpSeparate(unsigned int face, unsigned int stencilFail, unsigned int depthFail, unsigned int depthPass)
+    {
+        const unsigned int operations[3] = { stencilFail, depthFail, depthPass };
+        bool issue = false;
+        for (int side = 0; side < 2; side++)
+        {
+            if ((side == 0 && face == GL_BACK) || (side == 1 && face == GL_FRONT))
+                continue;
+
+            for (int i = 0; i < 3; i++)
+            {
+                issue |= s_State.StencilOps[side][i] != operations[i];
+                s_State.StencilOps[side][i] = operations[i];
+            }
+        }
+
+        Counter& counter = s_Stats.Calls[(int)Call::StencilOp];
+        if (!issue)
+        {
+            counter.Elided++;
+            return;
+        }
+
+        counter.Issued++;
+        glStencilOpSeparate(face, stencilFail, depthFail, depthPass);
+    }
+
+    void PolygonOffset(float factor, float units)
+    {
+        Counter& counter = s_Stats.Calls[(int)Call::PolygonOffset];
+        if (s_State.PolygonOffsetKnown && s_State.PolygonOffset[0] == factor && s_State.PolygonOffset[1] == units)
+        {
+            counter.Elided++;
+            return;
+        }
+
+        s_State.PolygonOffset[0] = factor;
+        s_State.PolygonOffset[1] = units;
+        s_State.PolygonOffsetKnown = true;
+        counter.Issued++;
+        glPolygonOffset(factor, units);
+    }
+
+    void Viewport(int x, int y, int width, int height)
+    {
+        Counter& counter = s_Stats.Calls[(int)Call::Viewport];
+        int* viewport = s_State.Viewport;
+        if (viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height)
+        {
+            counter.Elided++;
+            return;
+        }
+
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+        counter.Issued++;
+        glViewport(x, y, width, height);
+    }
+
+    void OnProgramDeleted(unsigned int program)
+    {
+        if (s_State.Program == program)
+            s_State.Program = Unknown;
+    }
+
+    void OnVertexArrayDeleted(unsigned int vertexArray)
+    {
+        if (s_State.VertexArray == vertexArray)
+            s_State.VertexArray = Unknown;
+    }
+
+    void OnTextureDeleted(unsigned int texture)
+    {
+        for (auto& unit : s_State.Textures)
+            Forget(unit, texture);
+    }
+
+    void OnBufferDeleted(unsigned int buffer)
+    {
+        Forget(s_State.Buffers, buffer);
+        Forget(s_State.UniformBuffers, buffer);
+    }
+
+    void OnFramebufferDeleted(unsigned int framebuffer)
+    {
+        if (s_State.DrawFramebuffer == framebuffer)
+            s_State.DrawFramebuffer = Unknown;
+        if (s_State.ReadFramebuffer == framebuffer)
+            s_State.ReadFramebuffer = Unknown;
+    }
+}
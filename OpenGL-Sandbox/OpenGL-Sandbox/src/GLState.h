@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Thin shadow of the GL context state. Every bind and state change goes through here so that
+// calls setting a value that is already current never reach the driver.
+// Must only be used from the thread owning the GL context.
+namespace GLState
+{
+    enum class Call
+    {
+        UseProgram,
+        BindVertexArray,
+        ActiveTexture,
+        BindTexture,
+        BindBuffer,
+        BindBufferBase,
+        BindBufferRange,
+        BindFramebuffer,
+        Capability,
+        PolygonMode,
+        DepthFunc,
+        DepthMask,
+        CullFace,
+        BlendFunc,
+        ColorMask,
+        StencilFunc,
+        StencilOp,
+        PolygonOffset,
+        Viewport,
+        Count
+    };
+
+    struct Counter
+    {
+        uint64_t Issued = 0; // Calls forwarded to the driver
+        uint64_t Elided = 0; // Calls dropped because the state was already current
+    };
+
+    struct Stats
+    {
+        Counter Calls[(int)Call::Count];
+
+        Counter Total() const;
+    };
+
+    const char* GetCallName(Call call);
+    const Stats& GetStats();
+    void ResetStats();
+    void PrintStats(const Stats& stats, uint64_t frameCount);
+
+    // Forgets everything, the next call of each kind is always issued (e.g. after third-party code touched the context)
+    void Invalidate();
+
+    void UseProgram(unsigned int program);
+    void BindVertexArray(unsigned int vertexArray);
+    void BindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+    unsigned int GetActiveTextureUnit();
+
+    // GL_ELEMENT_ARRAY_BUFFER is part of the vertex array state, it is always issued
+    void BindBuffer(unsigned int target, unsigned int buffer);
+    void BindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+    void BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, size_t offset, size_t size);
+    void BindFramebuffer(unsigned int target, unsigned int framebuffer);
+
+    void Enable(unsigned int capability);
+    void Disable(unsigned int capability);
+    void PolygonMode(unsigned int mode); // Applied to GL_FRONT_AND_BACK
+    void DepthFunc(unsigned int function);
+    void DepthMask(bool enabled);
+    void CullFace(unsigned int face);
+    void BlendFunc(unsigned int source, unsigned int destination);
+    void ColorMask(bool enabled); // All four channels
+    void StencilFunc(unsigned int function, int reference, unsigned int mask); // Applied to both faces
+    void StencilOpSeparate(unsigned int face, unsigned int stencilFail, unsigned int depthFail, unsigned int depthPass);
+    void PolygonOffset(float factor, float units); // GL_POLYGON_OFFSET_FILL is enabled separately
+    void Viewport(int x, int y, int width, int height);
+
+    // Deleted names can be handed out again by the driver, they must not be considered bound anymore
+    void OnProgramDeleted(unsigned int program);
+    void OnVertexArrayDeleted(unsigned int vertexArray);
+    void OnTextureDeleted(unsigned int texture);
+    void OnBufferDeleted(unsigned int buffer);
+    void OnFramebufferDeleted(unsigned int framebuffer);
+}
@@ -0,0 +1,258 @@
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    constexpr uint32_t FreeRange = 0xFFFFFFFF; // BaseVertex of a handle that is not in use
+    constexpr unsigned int PositionStride = 3 * sizeof(float);
+    // The meshes share the buffers, the GPU memory registry sees one asset (GetStats() has the ranges)
+    const char* const AssetName = "Geometry arena";
+
+    // Allocator moves are in elements, buffer copies in bytes
+    std::vector<RangeAllocator::Move> ToBytes(std::vector<RangeAllocator::Move> moves, unsigned int elementSize)
+    {
+        for (auto& move : moves)
+            move = { move.From * elementSize, move.To * elementSize, move.Size * elementSize };
+        return moves;
+    }
+}
+
+GeometryArena::GeometryArena(unsigned int vertexStride, std::function<void()> setupAttributes, uint32_t vertexCapacity, uint32_t indexCapacity, int positionOffset)
+    : m_VertexStride(vertexStride), m_PositionOffset(positionOffset), m_SetupAttributes(std::move(setupAttributes)), m_Vertices(vertexCapacity), m_Indices(indexCapacity)
+{
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glGenBuffers(1, &m_EBO);
+
+    GpuMemory& memory = GpuMemory::Instance();
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t)vertexCapacity * m_VertexStride, nullptr, GL_STATIC_DRAW);
+    memory.OnBufferAllocated(m_VBO, (size_t)vertexCapacity * m_VertexStride, GpuMemory::Category::Geometry, AssetName);
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t)indexCapacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+    memory.OnBufferAllocated(m_EBO, (size_t)indexCapacity * sizeof(uint32_t), GpuMemory::Category::Geometry, AssetName);
+
+    if (m_PositionOffset >= 0)
+    {
+        glGenVertexArrays(1, &m_PositionVAO);
+        glGenBuffers(1, &m_PositionVBO);
+
+        GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_PositionVBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, (size_t)vertexCapacity * PositionStride, nullptr, GL_STATIC_DRAW);
+        memory.OnBufferAllocated(m_PositionVBO, (size_t)vertexCapacity * PositionStride, GpuMemory::Category::Geometry, AssetName);
+    }
+
+    SetupVertexArrays();
+}
+
+GeometryArena::~GeometryArena()
+{
+    GLState::OnVertexArrayDeleted(m_VAO);
+    GLState::OnBufferDeleted(m_VBO);
+    GLState::OnBufferDeleted(m_EBO);
+    GpuMemory::Instance().OnBufferDeleted(m_VBO);
+    GpuMemory::Instance().OnBufferDeleted(m_EBO);
+
+    glDeleteVertexArrays(1, &m_VAO);
+    glDeleteBuffers(1, &m_VBO);
+    glDeleteBuffers(1, &m_EBO);
+
+    if (m_PositionVAO != 0)
+    {
+        GLState::OnVertexArrayDeleted(m_PositionVAO);
+        GLState::OnBufferDeleted(m_PositionVBO);
+        GpuMemory::Instance().OnBufferDeleted(m_PositionVBO);
+
+        glDeleteVertexArrays(1, &m_PositionVAO);
+        glDeleteBuffers(1, &m_PositionVBO);
+    }
+}
+
+GeometryArena::Handle GeometryArena::Allocate(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+    if (vertexCount == 0 || indexCount == 0)
+    {
+        std::cerr << "[ERROR]: Geometry arena allocations need vertices and indices (" << vertexCount << " vertices, " << indexCount << " indices)" << std::endl;
+        return InvalidHandle;
+    }
+
+    std::vector<RangeAllocator::Move> moves;
+    bool grown = false;
+    if (Reserve(m_Vertices, vertexCount, moves))
+    {
+        ReplaceBuffer(m_VBO, (size_t)m_Vertices.GetCapacity() * m_VertexStride, ToBytes(moves, m_VertexStride));
+        if (m_PositionVBO != 0)
+            ReplaceBuffer(m_PositionVBO, (size_t)m_Vertices.GetCapacity() * PositionStride, ToBytes(moves, PositionStride));
+        grown = true;
+    }
+    if (Reserve(m_Indices, indexCount, moves))
+    {
+        ReplaceBuffer(m_EBO, (size_t)m_Indices.GetCapacity() * sizeof(uint32_t), ToBytes(moves, sizeof(uint32_t)));
+        grown = true;
+    }
+    if (grown)
+        SetupVertexArrays();
+
+    const Range range{ m_Vertices.Allocate(vertexCount), vertexCount, m_Indices.Allocate(indexCount), indexCount };
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, (size_t)range.BaseVertex * m_VertexStride, (size_t)vertexCount * m_VertexStride, vertices);
+
+    if (m_PositionVBO != 0)
+    {
+        // Gather the positions out of the interleaved vertices
+        std::vector<float> positions((size_t)vertexCount * 3);
+        const uint8_t* source = static_cast<const uint8_t*>(vertices) + m_PositionOffset;
+        for (uint32_t i = 0; i < vertexCount; i++)
+            std::memcpy(&positions[(size_t)i * 3], source + (size_t)i * m_VertexStride, PositionStride);
+
+        GLState::BindBuffer(GL_ARRAY_BUFFER, m_PositionVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)range.BaseVertex * PositionStride, (size_t)vertexCount * PositionStride, positions.data());
+    }
+
+    // The element buffer binding belongs to the vertex array, upload through the copy target instead of binding the vertex array
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)range.FirstIndex * sizeof(uint32_t), (size_t)indexCount * sizeof(uint32_t), indices);
+
+    Handle handle;
+    if (!m_FreeHandles.empty())
+    {
+        handle = m_FreeHandles.back();
+        m_FreeHandles.pop_back();
+        m_Ranges[handle] = range;
+    }
+    else
+    {
+        handle = (Handle)m_Ranges.size();
+        m_Ranges.push_back(range);
+    }
+    return handle;
+}
+
+void GeometryArena::Free(Handle handle)
+{
+    if (handle >= m_Ranges.size() || m_Ranges[handle].BaseVertex == FreeRange)
+    {
+        std::cerr << "[ERROR]: Freeing invalid geometry handle " << handle << std::endl;
+        return;
+    }
+
+    Range& range = m_Ranges[handle];
+    m_Vertices.Free(range.BaseVertex);
+    m_Indices.Free(range.FirstIndex);
+
+    range = { FreeRange, 0, FreeRange, 0 };
+    m_FreeHandles.push_back(handle);
+}
+
+void GeometryArena::Defragment()
+{
+    const std::vector<RangeAllocator::Move> vertexMoves = m_Vertices.Compact();
+    const std::vector<RangeAllocator::Move> indexMoves = m_Indices.Compact();
+
+    ReplaceBuffer(m_VBO, (size_t)m_Vertices.GetCapacity() * m_VertexStride, ToBytes(vertexMoves, m_VertexStride));
+    if (m_PositionVBO != 0)
+        ReplaceBuffer(m_PositionVBO, (size_t)m_Vertices.GetCapacity() * PositionStride, ToBytes(vertexMoves, PositionStride));
+    ReplaceBuffer(m_EBO, (size_t)m_Indices.GetCapacity() * sizeof(uint32_t), ToBytes(indexMoves, sizeof(uint32_t)));
+    SetupVertexArrays();
+
+    std::unordered_map<uint32_t, uint32_t> vertexOffsets, indexOffsets;
+    for (const auto& move : vertexMoves)
+        vertexOffsets.emplace(move.From, move.To);
+    for (const auto& move : indexMoves)
+        indexOffsets.emplace(move.From, move.To);
+
+    for (auto& range : m_Ranges)
+    {
+        if (range.BaseVertex == FreeRange)
+            continue;
+
+        range.BaseVertex = vertexOffsets[range.BaseVertex];
+        range.FirstIndex = indexOffsets[range.FirstIndex];
+    }
+
+    m_Defragmentations++;
+}
+
+GeometryArena::Stats GeometryArena::GetStats() const
+{
+    Stats stats;
+    stats.Allocations = m_Vertices.GetAllocationCount();
+    stats.VertexCapacity = m_Vertices.GetCapacity();
+    stats.VerticesUsed = m_Vertices.GetUsed();
+    stats.IndexCapacity = m_Indices.GetCapacity();
+    stats.IndicesUsed = m_Indices.GetUsed();
+    stats.VertexFragmentation = m_Vertices.GetFragmentation();
+    stats.IndexFragmentation = m_Indices.GetFragmentation();
+    stats.Grows = m_Grows;
+    stats.Defragmentations = m_Defragmentations;
+    return stats;
+}
+
+bool GeometryArena::Reserve(RangeAllocator& allocator, uint32_t count, std::vector<RangeAllocator::Move>& moves)
+{
+    moves.clear();
+    if (allocator.GetLargestFreeBlock() >= count)
+        return false;
+
+    // Double the capacity, existing ranges are copied to the same offsets in the new buffer
+    const uint32_t capacity = std::max(allocator.GetCapacity() * 2, allocator.GetCapacity() + count);
+
+    if (allocator.GetCapacity() > 0)
+        moves.push_back({ 0, 0, allocator.GetCapacity() });
+
+    allocator.Grow(capacity);
+    m_Grows++;
+    return true;
+}
+
+void GeometryArena::ReplaceBuffer(unsigned int& buffer, size_t size, const std::vector<RangeAllocator::Move>& moves)
+{
+    unsigned int replacement;
+    glGenBuffers(1, &replacement);
+
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    GpuMemory::Instance().OnBufferAllocated(replacement, size, GpuMemory::Category::Geometry, AssetName);
+
+    // The copy happens on the GPU, nothing comes back to the CPU
+    GLState::BindBuffer(GL_COPY_READ_BUFFER, buffer);
+    for (const auto& move : moves)
+    {
+        if (move.Size > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.From, move.To, move.Size);
+    }
+
+    GLState::OnBufferDeleted(buffer);
+    GpuMemory::Instance().OnBufferDeleted(buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = replacement;
+}
+
+void GeometryArena::SetupVertexArrays()
+{
+    GLState::BindVertexArray(m_VAO);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    m_SetupAttributes();
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+
+    if (m_PositionVAO != 0)
+    {
+        // Same indices and base vertices, only the vertex buffer differs
+        GLState::BindVertexArray(m_PositionVAO);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, m_PositionVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, PositionStride, (void*)0);
+        GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    }
+
+    GLState::BindVertexArray(0);
+}
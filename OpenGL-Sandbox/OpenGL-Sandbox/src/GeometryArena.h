@@ -0,0 +1,75 @@
+#pragma once
+
+#include "RangeAllocator.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Large vertex and index buffers shared by every mesh of one vertex format. A mesh owns a range of each instead of
+// its own buffers, so all of them draw from a single vertex array (base vertex + first index) and can be submitted
+// together with multi-draw calls. Indices are relative to the mesh's first vertex.
+// Optionally the arena keeps a copy of the vertex positions in a tightly packed stream with its own vertex array, for
+// the passes that only need positions (depth prepass): they fetch 12 bytes per vertex instead of the whole vertex.
+class GeometryArena
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle InvalidHandle = 0xFFFFFFFF;
+
+    struct Range
+    {
+        uint32_t BaseVertex, VertexCount;
+        uint32_t FirstIndex, IndexCount;
+    };
+
+    struct Stats
+    {
+        uint32_t Allocations = 0;
+        uint32_t VertexCapacity = 0, VerticesUsed = 0;
+        uint32_t IndexCapacity = 0, IndicesUsed = 0;
+        float VertexFragmentation = 0.0f, IndexFragmentation = 0.0f;
+        uint32_t Grows = 0, Defragmentations = 0;
+    };
+
+    // 'setupAttributes' is called with the vertex array and vertex buffer bound, every time the vertex buffer is replaced.
+    // With a 'positionOffset', the vec3 found at that offset in every vertex also goes into the position stream.
+    GeometryArena(unsigned int vertexStride, std::function<void()> setupAttributes, uint32_t vertexCapacity, uint32_t indexCapacity, int positionOffset = -1);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // Buffers grow as needed, existing ranges keep their offsets
+    Handle Allocate(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+    void Free(Handle handle);
+
+    // Packs every range at the start of the buffers, handles stay valid but their ranges move
+    void Defragment();
+
+    const Range& GetRange(Handle handle) const { return m_Ranges[handle]; }
+    unsigned int GetVertexArray() const { return m_VAO; }
+    // Position stream at attribute 0 with the same indices, 0 if the arena has none
+    unsigned int GetPositionVertexArray() const { return m_PositionVAO; }
+    Stats GetStats() const;
+private:
+    // Moves the content of 'buffer' to a new buffer of 'size' bytes, at the offsets given by 'moves' (in bytes)
+    void ReplaceBuffer(unsigned int& buffer, size_t size, const std::vector<RangeAllocator::Move>& moves);
+    // Grows the allocator if it has no room for 'count' elements, 'moves' gets the elements to copy into the new buffers
+    bool Reserve(RangeAllocator& allocator, uint32_t count, std::vector<RangeAllocator::Move>& moves);
+    // Points the vertex arrays at the current buffers
+    void SetupVertexArrays();
+private:
+    unsigned int m_VAO = 0, m_VBO = 0, m_EBO = 0;
+    unsigned int m_PositionVAO = 0, m_PositionVBO = 0;
+    unsigned int m_VertexStride;
+    int m_PositionOffset;
+    std::function<void()> m_SetupAttributes;
+
+    RangeAllocator m_Vertices, m_Indices;
+
+    std::vector<Range> m_Ranges;
+    std::vector<Handle> m_FreeHandles;
+
+    uint32_t m_Grows = 0, m_Defragmentations = 0;
+};
@@ -0,0 +1,285 @@
+#include "GpuMemory.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+    // "12.34 MiB", without touching the formatting state of the stream
+    std::string FormatMiB(size_t bytes)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f MiB", bytes / (1024.0 * 1024.0));
+        return text;
+    }
+}
+
+GpuMemory& GpuMemory::Instance()
+{
+    // Never destroyed, objects that outlive main() may still report their deletion
+    static GpuMemory* memory = new GpuMemory();
+    return *memory;
+}
+
+void GpuMemory::OnBufferAllocated(unsigned int buffer, size_t bytes, Category category, const std::string& asset)
+{
+    Allocate(Object::Buffer, buffer, bytes, 0, category, asset);
+}
+
+void GpuMemory::OnTextureAllocated(unsigned int texture, size_t bytes, unsigned int format, Category category, const std::string& asset)
+{
+    Allocate(Object::Texture, texture, bytes, format, category, asset);
+}
+
+void GpuMemory::OnRenderbufferAllocated(unsigned int renderbuffer, size_t bytes, unsigned int format, Category category, const std::string& asset)
+{
+    Allocate(Object::Renderbuffer, renderbuffer, bytes, format, category, asset);
+}
+
+void GpuMemory::Add(Usage& usage, size_t bytes)
+{
+    usage.Bytes += bytes;
+    usage.Peak = std::max(usage.Peak, usage.Bytes);
+}
+
+void GpuMemory::Allocate(Object object, unsigned int name, size_t bytes, unsigned int format, Category category, const std::string& asset)
+{
+    if (name == 0 || category >= Category::Count)
+        return;
+
+    size_t categoryBytes = 0, budget = 0;
+    bool crossed = false;
+    BudgetCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        // Respecified storage replaces the previous one, the object keeps its category and asset
+        auto [it, inserted] = m_Allocations.try_emplace(GetKey(object, name));
+        Allocation& allocation = it->second;
+        if (!inserted)
+        {
+            m_Categories[(size_t)allocation.Type].Bytes -= allocation.Bytes;
+            m_Assets[allocation.Asset].Bytes -= allocation.Bytes;
+            m_Total.Bytes -= allocation.Bytes;
+        }
+        else
+        {
+            auto [assetIt, newAsset] = m_AssetsByName.try_emplace(asset, (uint32_t)m_Assets.size());
+            if (newAsset)
+            {
+                AssetStats stats;
+                stats.Name = asset;
+                stats.Type = category;
+                m_Assets.push_back(std::move(stats));
+            }
+
+            allocation.Type = category;
+            allocation.Asset = assetIt->second;
+            m_Categories[(size_t)category].Objects++;
+            m_Assets[allocation.Asset].Objects++;
+            m_Total.Objects++;
+        }
+
+        allocation.Bytes = bytes;
+        CategoryStats& stats = m_Categories[(size_t)allocation.Type];
+        Add(stats, bytes);
+        Add(m_Assets[allocation.Asset], bytes);
+        Add(m_Total, bytes);
+        if (format != 0)
+            m_Assets[allocation.Asset].Format = format;
+
+        // Once per crossing, a category hovering around its budget does not warn every frame
+        const size_t index = (size_t)allocation.Type;
+        const bool over = stats.Budget != 0 && stats.Bytes > stats.Budget;
+        crossed = over && !m_OverBudget[index];
+        m_OverBudget[index] = over;
+        if (crossed)
+        {
+            stats.BudgetExceeded++;
+            category = allocation.Type;
+            categoryBytes = stats.Bytes;
+            budget = stats.Budget;
+            callback = m_BudgetCallback;
+        }
+    }
+
+    // Outside of the lock, the callback may look at the registry
+    if (!crossed)
+        return;
+
+    if (callback)
+        callback(category, categoryBytes, budget);
+    else
+        std::cout << "[WARNING]: GPU memory of " << GetCategoryName(category) << " over budget, " << FormatMiB(categoryBytes)
+            << " for " << FormatMiB(budget) << std::endl;
+}
+
+void GpuMemory::Release(Object object, unsigned int name)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Allocations.find(GetKey(object, name));
+    if (it == m_Allocations.end())
+        return;
+
+    const Allocation& allocation = it->second;
+    CategoryStats& stats = m_Categories[(size_t)allocation.Type];
+    stats.Bytes -= allocation.Bytes;
+    stats.Objects--;
+    m_Assets[allocation.Asset].Bytes -= allocation.Bytes;
+    m_Assets[allocation.Asset].Objects--;
+    m_Total.Bytes -= allocation.Bytes;
+    m_Total.Objects--;
+
+    const size_t index = (size_t)allocation.Type;
+    m_OverBudget[index] = stats.Budget != 0 && stats.Bytes > stats.Budget;
+    m_Allocations.erase(it);
+}
+
+void GpuMemory::SetBudget(Category category, size_t bytes)
+{
+    if (category >= Category::Count)
+        return;
+
+    // Checked from the next allocation on
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Categories[(size_t)category].Budget = bytes;
+    m_OverBudget[(size_t)category] = false;
+}
+
+void GpuMemory::SetBudgetCallback(BudgetCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_BudgetCallback = std::move(callback);
+}
+
+GpuMemory::CategoryStats GpuMemory::GetStats(Category category) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return category < Category::Count ? m_Categories[(size_t)category] : CategoryStats();
+}
+
+GpuMemory::Usage GpuMemory::GetTotal() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Total;
+}
+
+std::vector<GpuMemory::AssetStats> GpuMemory::GetAssets() const
+{
+    std::vector<AssetStats> assets;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        assets = m_Assets;
+    }
+
+    std::sort(assets.begin(), assets.end(), [](const AssetStats& a, const AssetStats& b)
+    {
+        return a.Bytes != b.Bytes ? a.Bytes > b.Bytes : a.Peak > b.Peak;
+    });
+    return assets;
+}
+
+void GpuMemory::Report(std::ostream& out, size_t assetCount) const
+{
+    const Usage total = GetTotal();
+    const std::vector<AssetStats> assets = GetAssets();
+
+    out << "[INFO]: GPU memory: " << FormatMiB(total.Bytes) << " in " << total.Objects << " objects, " << FormatMiB(total.Peak) << " peak";
+    for (int category = 0; category < (int)Category::Count; category++)
+    {
+        const CategoryStats stats = GetStats((Category)category);
+        out << "\n    " << GetCategoryName((Category)category) << ": " << FormatMiB(stats.Bytes) << " in " << stats.Objects << " objects, "
+            << FormatMiB(stats.Peak) << " peak";
+        if (stats.Budget != 0)
+            out << ", budget " << FormatMiB(stats.Budget) << " exceeded " << stats.BudgetExceeded << " time(s)";
+    }
+
+    // Assets that released everything stay listed with their peak, a leak shows up as one that keeps growing
+    const size_t count = std::min(assetCount, assets.size());
+    if (count > 0)
+        out << "\n    Largest assets:";
+    for (size_t i = 0; i < count; i++)
+    {
+        const AssetStats& asset = assets[i];
+        out << "\n        " << asset.Name << " (" << GetCategoryName(asset.Type);
+        if (asset.Format != 0)
+            out << ", " << GetFormatName(asset.Format);
+        out << "): " << FormatMiB(asset.Bytes) << " in " << asset.Objects << " objects, " << FormatMiB(asset.Peak) << " peak";
+    }
+    out << std::endl;
+}
+
+const char* GpuMemory::GetCategoryName(Category category)
+{
+    switch (category)
+    {
+    case Category::Textures:        return "textures";
+    case Category::RenderTargets:   return "render-targets";
+    case Category::Geometry:        return "geometry";
+    case Category::Streaming:       return "streaming";
+    default:                        return "unknown";
+    }
+}
+
+GpuMemory::Category GpuMemory::FindCategory(const std::string& name)
+{
+    for (int category = 0; category < (int)Category::Count; category++)
+    {
+        if (name == GetCategoryName((Category)category))
+            return (Category)category;
+    }
+    return Category::Count;
+}
+
+const char* GpuMemory::GetFormatName(unsigned int format)
+{
+    switch (format)
+    {
+    case GL_R8:                 return "R8";
+    case GL_RG8:                return "RG8";
+    case GL_RGB:
+    case GL_RGB8:               return "RGB8";
+    case GL_RGBA:
+    case GL_RGBA8:              return "RGBA8";
+    case GL_RG16:               return "RG16";
+    case GL_R16F:               return "R16F";
+    case GL_RG16F:              return "RG16F";
+    case GL_RGBA16F:            return "RGBA16F";
+    case GL_R11F_G11F_B10F:     return "R11F_G11F_B10F";
+    case GL_R32F:               return "R32F";
+    case GL_RGBA32F:            return "RGBA32F";
+    case GL_DEPTH_COMPONENT24:  return "D24";
+    case GL_DEPTH_COMPONENT32F: return "D32F";
+    case GL_DEPTH24_STENCIL8:   return "D24S8";
+    default:                    return "?";
+    }
+}
+
+size_t GpuMemory::GetFormatBytes(unsigned int format)
+{
+    switch (format)
+    {
+    case GL_R8:                 return 1;
+    case GL_RG8:
+    case GL_R16F:               return 2;
+    case GL_RGBA16F:            return 8;
+    case GL_RGBA32F:            return 16;
+    default:                    return 4; // RGB(A)8, RG16, RG16F, R11F_G11F_B10F, R32F and the depth formats
+    }
+}
+
+size_t GpuMemory::GetTextureBytes(unsigned int format, unsigned int width, unsigned int height, unsigned int layers, bool mipmaps)
+{
+    size_t texels = (size_t)width * height;
+    while (mipmaps && (width > 1 || height > 1))
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        texels += (size_t)width * height;
+    }
+
+    return texels * layers * GetFormatBytes(format);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// GPU memory of every GL buffer, texture and renderbuffer the sandbox allocates, by category and by owning asset.
+// Owners report the storage right after specifying it (again when they respecify it, orphaning included) and before
+// deleting the object, the way they tell GLState. Sizes are what the formats need, drivers pad, compress and keep
+// orphaned storage alive a few frames on top of that.
+//
+//     GpuMemory::Instance().OnTextureAllocated(texture, GpuMemory::GetTextureBytes(GL_RGBA8, w, h), GL_RGBA8, GpuMemory::Category::Textures, path);
+//     GpuMemory::Instance().OnTextureDeleted(texture);
+//
+// A category over its budget warns once each time it crosses it, or calls the budget callback instead.
+class GpuMemory
+{
+public:
+    enum class Category
+    {
+        Textures,       // Loaded from asset files
+        RenderTargets,  // Framebuffer attachments: shadow maps, G-buffer, offscreen target
+        Geometry,       // Static vertex and index data
+        Streaming,      // Respecified every frame or so: upload ring, instances, light lists
+        Count
+    };
+
+    struct Usage
+    {
+        size_t Bytes = 0;
+        size_t Peak = 0;            // High-water mark since the start
+        uint32_t Objects = 0;
+    };
+
+    struct CategoryStats : Usage
+    {
+        size_t Budget = 0;          // 0 for none
+        uint32_t BudgetExceeded = 0; // Times the budget was crossed
+    };
+
+    struct AssetStats : Usage
+    {
+        std::string Name;
+        Category Type = Category::Textures;
+        unsigned int Format = 0;    // Of the last texture or renderbuffer allocated, 0 for buffers
+    };
+
+    // Called on the thread that allocated, with the category, its bytes and its budget
+    using BudgetCallback = std::function<void(Category, size_t, size_t)>;
+
+    static GpuMemory& Instance();
+
+    GpuMemory(const GpuMemory&) = delete;
+    GpuMemory& operator=(const GpuMemory&) = delete;
+
+    // Replace the previous size of the object when it is already known
+    void OnBufferAllocated(unsigned int buffer, size_t bytes, Category category, const std::string& asset);
+    void OnTextureAllocated(unsigned int texture, size_t bytes, unsigned int format, Category category, const std::string& asset);
+    void OnRenderbufferAllocated(unsigned int renderbuffer, size_t bytes, unsigned int format, Category category, const std::string& asset);
+    // Unknown objects are ignored
+    void OnBufferDeleted(unsigned int buffer) { Release(Object::Buffer, buffer); }
+    void OnTextureDeleted(unsigned int texture) { Release(Object::Texture, texture); }
+    void OnRenderbufferDeleted(unsigned int renderbuffer) { Release(Object::Renderbuffer, renderbuffer); }
+
+    void SetBudget(Category category, size_t bytes);
+    void SetBudgetCallback(BudgetCallback callback);
+
+    CategoryStats GetStats(Category category) const;
+    Usage GetTotal() const;
+    // Assets that own memory or did, largest first
+    std::vector<AssetStats> GetAssets() const;
+
+    // Categories with their high-water marks and budgets, then the 'assetCount' largest assets
+    void Report(std::ostream& out, size_t assetCount = 10) const;
+
+    static const char* GetCategoryName(Category category);
+    // Category from its name ("textures", "render-targets", "geometry", "streaming"), Count if there is none
+    static Category FindCategory(const std::string& name);
+    static const char* GetFormatName(unsigned int format);
+    // Bytes per texel of a sized internal format (unsized GL_RGB and GL_RGBA are stored as 4 bytes by every driver)
+    static size_t GetFormatBytes(unsigned int format);
+    // Every layer and, with 'mipmaps', the whole chain down to 1x1
+    static size_t GetTextureBytes(unsigned int format, unsigned int width, unsigned int height, unsigned int layers = 1, bool mipmaps = false);
+private:
+    GpuMemory() = default;
+
+    // GL names are only unique per object type
+    enum class Object : uint8_t { Buffer, Texture, Renderbuffer };
+
+    struct Allocation
+    {
+        Category Type;
+        size_t Bytes;
+        uint32_t Asset;     // Index in m_Assets
+    };
+
+    static uint64_t GetKey(Object object, unsigned int name) { return (uint64_t)object << 32 | name; }
+
+    void Allocate(Object object, unsigned int name, size_t bytes, unsigned int format, Category category, const std::string& asset);
+    void Release(Object object, unsigned int name);
+    static void Add(Usage& usage, size_t bytes);
+private:
+    mutable std::mutex m_Mutex;
+    std::unordered_map<uint64_t, Allocation> m_Allocations;
+    std::vector<AssetStats> m_Assets;
+    std::unordered_map<std::string, uint32_t> m_AssetsByName;
+    CategoryStats m_Categories[(size_t)Category::Count];
+    Usage m_Total;
+    bool m_OverBudget[(size_t)Category::Count] = {};
+    BudgetCallback m_BudgetCallback;
+};
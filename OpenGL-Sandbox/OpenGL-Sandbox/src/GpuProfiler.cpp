@@ -0,0 +1,235 @@
+#include "GpuProfiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+GpuProfiler& GpuProfiler::Instance()
+{
+    static GpuProfiler profiler;
+    return profiler;
+}
+
+void GpuProfiler::BeginFrame()
+{
+    if (m_InFrame)
+        EndFrame();
+
+    // Read back every finished frame, oldest first, and stop at the first one the GPU is still working on
+    for (unsigned int i = 1; i <= FrameLatency; i++)
+    {
+        Frame& frame = m_Frames[(m_CurrentFrame + i) % FrameLatency];
+        if (!frame.Pending)
+            continue;
+        if (!IsAvailable(frame))
+            break;
+        Resolve(frame);
+    }
+
+    // The slot written FrameLatency frames ago is reused now, whatever the GPU did with it
+    m_CurrentFrame = (m_CurrentFrame + 1) % FrameLatency;
+    Frame& frame = m_Frames[m_CurrentFrame];
+    if (frame.Pending)
+    {
+        Release(frame);
+        m_DroppedFrames++;
+    }
+
+    if (m_Capturing)
+    {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        frame.GpuToCpuNs = gpuNow - Trace::Now();
+    }
+
+    m_InFrame = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+    if (!m_InFrame)
+        return;
+
+    if (!m_OpenZones.empty())
+    {
+        std::cout << "[WARNING]: " << m_OpenZones.size() << " GPU scope(s) still open at the end of the frame, innermost '"
+            << m_Frames[m_CurrentFrame].Zones[m_OpenZones.back()].Name << "'" << std::endl;
+        while (!m_OpenZones.empty())
+            End();
+    }
+
+    Frame& frame = m_Frames[m_CurrentFrame];
+    frame.Pending = !frame.Zones.empty();
+    m_InFrame = false;
+}
+
+void GpuProfiler::Begin(const char* name)
+{
+    if (!m_InFrame)
+        return;
+
+    Frame& frame = m_Frames[m_CurrentFrame];
+    const Zone zone = { name, AcquireQuery(), AcquireQuery() };
+    glQueryCounter(zone.BeginQuery, GL_TIMESTAMP);
+    frame.LastQuery = zone.BeginQuery;
+
+    m_OpenZones.push_back(frame.Zones.size());
+    frame.Zones.push_back(zone);
+}
+
+void GpuProfiler::End()
+{
+    if (!m_InFrame || m_OpenZones.empty())
+        return;
+
+    Frame& frame = m_Frames[m_CurrentFrame];
+    const Zone& zone = frame.Zones[m_OpenZones.back()];
+    m_OpenZones.pop_back();
+
+    glQueryCounter(zone.EndQuery, GL_TIMESTAMP);
+    frame.LastQuery = zone.EndQuery;
+}
+
+GpuProfiler::Summary GpuProfiler::GetSummary(const std::string& name) const
+{
+    Summary summary;
+    auto it = m_ScopesByName.find(name);
+    if (it == m_ScopesByName.end())
+        return summary;
+
+    const Scope& scope = m_Scopes[it->second];
+    summary.Last = scope.Last;
+    summary.Active = scope.Active;
+    summary.Samples = scope.SampleCount;
+    if (scope.SampleCount == 0)
+        return summary;
+
+    std::vector<double> samples(scope.Samples, scope.Samples + scope.SampleCount);
+    std::sort(samples.begin(), samples.end());
+    summary.Min = samples.front();
+    summary.Max = samples.back();
+    summary.Average = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    summary.P99 = samples[(size_t)(0.99 * (samples.size() - 1) + 0.5)];
+    return summary;
+}
+
+std::vector<std::pair<std::string, GpuProfiler::Summary>> GpuProfiler::GetSummaries() const
+{
+    std::vector<std::pair<std::string, Summary>> summaries;
+    for (const Scope& scope : m_Scopes)
+        summaries.emplace_back(scope.Name, GetSummary(scope.Name));
+    return summaries;
+}
+
+void GpuProfiler::StartCapture()
+{
+    m_Capture.clear();
+    m_Capturing = true;
+}
+
+void GpuProfiler::Shutdown()
+{
+    for (Frame& frame : m_Frames)
+    {
+        frame.Zones.clear();
+        frame.Pending = false;
+    }
+    m_OpenZones.clear();
+    m_InFrame = false;
+
+    if (!m_AllQueries.empty())
+        glDeleteQueries((GLsizei)m_AllQueries.size(), m_AllQueries.data());
+    m_AllQueries.clear();
+    m_FreeQueries.clear();
+}
+
+unsigned int GpuProfiler::AcquireQuery()
+{
+    if (m_FreeQueries.empty())
+    {
+        // Grows by a batch, a frame rarely needs more than a few dozen
+        const size_t batch = std::max<size_t>(32, m_AllQueries.size() / 2);
+        m_FreeQueries.resize(batch);
+        glGenQueries((GLsizei)batch, m_FreeQueries.data());
+        m_AllQueries.insert(m_AllQueries.end(), m_FreeQueries.begin(), m_FreeQueries.end());
+    }
+
+    const unsigned int query = m_FreeQueries.back();
+    m_FreeQueries.pop_back();
+    return query;
+}
+
+size_t GpuProfiler::FindScope(const char* name)
+{
+    auto it = m_ScopesByPointer.find(name);
+    if (it != m_ScopesByPointer.end())
+        return it->second;
+
+    auto [named, inserted] = m_ScopesByName.emplace(name, m_Scopes.size());
+    if (inserted)
+    {
+        m_Scopes.emplace_back();
+        m_Scopes.back().Name = name;
+    }
+
+    m_ScopesByPointer.emplace(name, named->second);
+    return named->second;
+}
+
+bool GpuProfiler::IsAvailable(const Frame& frame) const
+{
+    GLint available = 0;
+    glGetQueryObjectiv(frame.LastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available != 0;
+}
+
+void GpuProfiler::Resolve(Frame& frame)
+{
+    for (const Zone& zone : frame.Zones)
+    {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(zone.BeginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(zone.EndQuery, GL_QUERY_RESULT, &end);
+        const int64_t durationNs = end > begin ? (int64_t)(end - begin) : 0;
+
+        Scope& scope = m_Scopes[FindScope(zone.Name)];
+        scope.FrameMs += durationNs / 1.0e6;
+        scope.Touched = true;
+
+        if (m_Capturing)
+            m_Capture.push_back({ zone.Name, "gpu", TraceThread, (int64_t)begin - frame.GpuToCpuNs, durationNs });
+    }
+
+    for (Scope& scope : m_Scopes)
+    {
+        scope.Active = scope.Touched;
+        if (scope.Touched)
+        {
+            scope.Last = scope.FrameMs;
+            scope.Samples[scope.NextSample] = scope.FrameMs;
+            scope.NextSample = (scope.NextSample + 1) % WindowSize;
+            scope.SampleCount = std::min(scope.SampleCount + 1, WindowSize);
+        }
+        else
+        {
+            scope.Last = 0.0;
+        }
+        scope.FrameMs = 0.0;
+        scope.Touched = false;
+    }
+
+    Release(frame);
+}
+
+void GpuProfiler::Release(Frame& frame)
+{
+    for (const Zone& zone : frame.Zones)
+    {
+        m_FreeQueries.push_back(zone.BeginQuery);
+        m_FreeQueries.push_back(zone.EndQuery);
+    }
+    frame.Zones.clear();
+    frame.Pending = false;
+}
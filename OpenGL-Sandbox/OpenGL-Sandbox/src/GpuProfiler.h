@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Trace.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// GPU time of named scopes, GL thread only. Every scope writes a timestamp query when it begins and one when it ends,
+// so scopes nest freely and do not conflict with GL_TIME_ELAPSED or occlusion queries. The queries come from a pool
+// and are read back up to FrameLatency - 1 frames later without ever waiting: a frame whose results are still not
+// available when its slot is needed again is dropped. Scopes with the same name in one frame add up.
+//
+//     GPU_SCOPE("Forward");               // Until the end of the enclosing block
+//     GpuProfiler::Instance().Begin("Geometry"); ... GpuProfiler::Instance().End();
+class GpuProfiler
+{
+public:
+    static constexpr unsigned int FrameLatency = 4;
+    static constexpr unsigned int WindowSize = 120;     // Frames the rolling statistics cover
+    static constexpr uint32_t TraceThread = 1000;       // Track of the GPU scopes in the trace
+
+    // Rolling statistics of a scope over the last frames it ran in, in milliseconds
+    struct Summary
+    {
+        double Last = 0.0, Min = 0.0, Average = 0.0, Max = 0.0, P99 = 0.0;
+        uint32_t Samples = 0;
+        bool Active = false;    // The scope ran in the last frame read back
+    };
+
+    static GpuProfiler& Instance();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Scopes are only recorded between BeginFrame() and EndFrame(), BeginFrame() also reads back the finished frames
+    void BeginFrame();
+    void EndFrame();
+
+    // 'name' must outlive the profiler (string literal)
+    void Begin(const char* name);
+    void End();
+
+    Summary GetSummary(const std::string& name) const;
+    // Every scope seen so far, in the order they first appeared
+    std::vector<std::pair<std::string, Summary>> GetSummaries() const;
+    uint64_t GetDroppedFrames() const { return m_DroppedFrames; }
+
+    // While capturing, the scopes read back are kept as trace events on the CPU clock (Trace::Now())
+    void StartCapture();
+    void StopCapture() { m_Capturing = false; }
+    const std::vector<Trace::Event>& GetCapture() const { return m_Capture; }
+
+    // Deletes the queries, before the context goes away
+    void Shutdown();
+private:
+    GpuProfiler() = default;
+
+    struct Zone
+    {
+        const char* Name;
+        unsigned int BeginQuery, EndQuery;
+    };
+
+    struct Frame
+    {
+        std::vector<Zone> Zones;
+        unsigned int LastQuery = 0;     // Timestamps complete in order, the frame is done when this one is
+        bool Pending = false;
+        int64_t GpuToCpuNs = 0;         // Subtracted from GPU timestamps to get Trace::Now() times
+    };
+
+    struct Scope
+    {
+        std::string Name;
+        double Samples[WindowSize] = {};
+        uint32_t SampleCount = 0, NextSample = 0;
+        double Last = 0.0;
+        double FrameMs = 0.0;   // Sum over the frame being read back
+        bool Touched = false;
+        bool Active = false;
+    };
+
+    unsigned int AcquireQuery();
+    size_t FindScope(const char* name);
+    bool IsAvailable(const Frame& frame) const;
+    void Resolve(Frame& frame);
+    void Release(Frame& frame);
+private:
+    Frame m_Frames[FrameLatency];
+    unsigned int m_CurrentFrame = 0;
+    bool m_InFrame = false;
+    std::vector<size_t> m_OpenZones;    // Indices in the current frame's zones
+
+    std::vector<unsigned int> m_FreeQueries;
+    std::vector<unsigned int> m_AllQueries;
+
+    std::vector<Scope> m_Scopes;
+    std::unordered_map<const char*, size_t> m_ScopesByPointer;
+    std::unordered_map<std::string, size_t> m_ScopesByName; // The same literal can have several addresses
+
+    bool m_Capturing = false;
+    std::vector<Trace::Event> m_Capture;
+    uint64_t m_DroppedFrames = 0;
+};
+
+// Times the rest of the enclosing block on the GPU
+class GpuScope
+{
+public:
+    explicit GpuScope(const char* name) { GpuProfiler::Instance().Begin(name); }
+    ~GpuScope() { GpuProfiler::Instance().End(); }
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+};
+
+#if PROFILING_ENABLED
+    #define GPU_SCOPE(name) GpuScope PROFILE_CONCAT(gpuScope, __LINE__)(name)
+#else
+    #define GPU_SCOPE(name) ((void)0)
+#endif
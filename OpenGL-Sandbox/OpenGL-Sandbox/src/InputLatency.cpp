@@ -0,0 +1,114 @@
+#include "InputLatency.h"
+#include "CpuProfiler.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    // Sleeps wake up late by up to a scheduler quantum, the end of a wait spins
+    constexpr int64_t SpinNs = 1500000;
+}
+
+void InputLatency::SetDeadlineWait(bool enabled, double refreshRate)
+{
+    m_RefreshNs = enabled && refreshRate > 0.0 ? (int64_t)std::llround(1e9 / refreshRate) : 0;
+    // Starts with most of a refresh for the frame, the budget then settles on what the frames need
+    m_BudgetNs = m_RefreshNs * 3 / 4;
+    m_Stats.BudgetMs = m_BudgetNs * 1e-6;
+}
+
+void InputLatency::OnInput()
+{
+    // Only the first event after a latch counts, it is the one that waits the longest
+    int64_t none = -1;
+    m_PendingInputNs.compare_exchange_strong(none, Trace::Now());
+}
+
+void InputLatency::WaitForFrameStart()
+{
+    // The vblanks are only known from swaps that returned on one
+    m_TargetVblankNs = -1;
+    if (m_RefreshNs == 0 || m_QueueLimit != QueueLimit::Finish || m_VblankNs < 0)
+        return;
+
+    PROFILE_SCOPE("Wait for frame deadline");
+
+    // First vblank the frame can make if it starts now, then start as late as the budget allows
+    const int64_t now = Trace::Now();
+    const int64_t periods = std::max<int64_t>(1, (now + m_BudgetNs - m_VblankNs + m_RefreshNs - 1) / m_RefreshNs);
+    m_TargetVblankNs = m_VblankNs + periods * m_RefreshNs;
+
+    const int64_t start = m_TargetVblankNs - m_BudgetNs;
+    if (start - now > SpinNs)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(start - now - SpinNs));
+    while (Trace::Now() < start)
+        std::this_thread::yield();
+}
+
+int64_t InputLatency::Latch()
+{
+    return m_PendingInputNs.exchange(-1);
+}
+
+void InputLatency::OnSwapped(int64_t latchedInputNs)
+{
+    if (m_QueueLimit == QueueLimit::Fence)
+    {
+        PROFILE_SCOPE("Queue limit");
+        // The previous frame's fence, this frame may still be queued behind it
+        if (m_Fence)
+        {
+            while (glClientWaitSync(m_Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) // 1 ms
+                continue;
+            glDeleteSync(m_Fence);
+        }
+        m_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else if (m_QueueLimit == QueueLimit::Finish)
+    {
+        PROFILE_SCOPE("Queue limit");
+        glFinish();
+    }
+
+    const int64_t now = Trace::Now();
+    if (m_QueueLimit == QueueLimit::Finish)
+        m_VblankNs = now;
+
+    // A frame that made its vblank can start a little later next time, a miss gives the following frames more time
+    if (m_TargetVblankNs >= 0)
+    {
+        if (now > m_TargetVblankNs + m_RefreshNs / 2)
+        {
+            m_Stats.MissedVblanks++;
+            m_BudgetNs += m_RefreshNs / 4;
+        }
+        else
+            m_BudgetNs -= m_RefreshNs / 64;
+        m_BudgetNs = std::clamp(m_BudgetNs, m_RefreshNs / 8, 2 * m_RefreshNs);
+        m_Stats.BudgetMs = m_BudgetNs * 1e-6;
+    }
+
+    if (latchedInputNs >= 0)
+    {
+        const double latencyMs = (now - latchedInputNs) * 1e-6;
+        if (m_Latencies.size() < WindowSize)
+            m_Latencies.push_back(latencyMs);
+        else
+            m_Latencies[m_NextLatency] = latencyMs;
+        m_NextLatency = (m_NextLatency + 1) % WindowSize;
+
+        m_Stats.Samples++;
+        m_Stats.LastMs = latencyMs;
+    }
+}
+
+void InputLatency::Shutdown()
+{
+    if (m_Fence)
+        glDeleteSync(m_Fence);
+    m_Fence = nullptr;
+}
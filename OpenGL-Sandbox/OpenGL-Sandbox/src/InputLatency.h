@@ -0,0 +1,70 @@
+#pragma once
+
+#include "FrameTimings.h"
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Motion-to-photon latency: measures the time from an input event to the swap of the first frame that used it, and
+// keeps the driver from queueing frames behind the one being presented. With vsync, the start of each frame can also
+// be pushed back until just enough time is left before the next vblank for the work of a frame (the budget adapts to
+// the frames that make or miss their vblank), so that the input is read as late as possible. GL thread only, apart
+// from OnInput() and Latch() which any thread may call.
+class InputLatency
+{
+public:
+    enum class QueueLimit
+    {
+        None,   // The driver queues as many frames as it wants
+        Fence,  // Waits until the GPU has finished the previous frame, at most one frame queued
+        Finish  // glFinish after the swap, nothing queued and the swap returns at the vblank
+    };
+
+    struct Stats
+    {
+        uint64_t Samples = 0;           // Frames that presented input
+        uint64_t MissedVblanks = 0;     // Frames that started late, deadline wait only
+        double LastMs = 0.0;
+        double BudgetMs = 0.0;          // Time left before the vblank when the frame starts, deadline wait only
+    };
+
+    static constexpr unsigned int WindowSize = 240;    // Latencies the summary covers
+
+    void SetQueueLimit(QueueLimit limit) { m_QueueLimit = limit; }
+    // Enables the deadline wait, needs a refresh rate (vsync on) and QueueLimit::Finish to find the vblanks
+    void SetDeadlineWait(bool enabled, double refreshRate);
+
+    // An input event came in, from the GLFW callbacks. The events are delivered by glfwPollEvents(), so this is the
+    // time they are polled, later than the event itself by up to one poll interval.
+    void OnInput();
+
+    // Before anything of the frame, sleeps until the predicted start when the deadline wait is on
+    void WaitForFrameStart();
+    // Where the input is read for a frame: the events received so far are presented by it. Returns the time of the
+    // oldest of them, or -1 if there was none, for OnSwapped() of the same frame.
+    int64_t Latch();
+    // Right after the swap: limits the queue, then measures the latency of the events the frame latched
+    void OnSwapped(int64_t latchedInputNs);
+
+    const Stats& GetStats() const { return m_Stats; }
+    FrameTimings::Summary GetSummary() const { return FrameTimings::Summarize(m_Latencies); }
+
+    // Releases the fence, while the context still exists
+    void Shutdown();
+private:
+    QueueLimit m_QueueLimit = QueueLimit::None;
+    int64_t m_RefreshNs = 0;
+    int64_t m_BudgetNs = 0;
+
+    std::atomic<int64_t> m_PendingInputNs{ -1 };   // Oldest event not latched yet
+    int64_t m_VblankNs = -1;        // Last swap that returned at a vblank
+    int64_t m_TargetVblankNs = -1;  // Vblank the current frame aims at
+    GLsync m_Fence = nullptr;
+
+    Stats m_Stats;
+    std::vector<double> m_Latencies;
+    size_t m_NextLatency = 0;
+};
@@ -0,0 +1,91 @@
+#include "Material.h"
+
+#include <glad/glad.h>
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace AssetLoader
+{
+	namespace
+	{
+		// Materials by texture per sampler and shininess
+		using MaterialKey = std::pair<std::vector<std::pair<MaterialSampler, unsigned int>>, float>;
+
+		std::mutex s_MaterialMutex;
+		std::map<MaterialKey, std::shared_ptr<const Material>> s_Materials;
+	}
+
+	std::shared_ptr<const Material> Material::Get(const std::vector<MeshTexture>& textures, float shininess)
+	{
+		// The Nth texture of a type goes to the Nth sampler of that type
+		constexpr unsigned int PerType = (unsigned int)MaterialSampler::Specular1;
+		unsigned int diffuseCount = 0, specularCount = 0;
+		std::vector<Slot> slots;
+		for (const auto& texture : textures)
+		{
+			if (texture.Type == "texture_diffuse" && diffuseCount < PerType)
+				slots.push_back({ (MaterialSampler)((unsigned int)MaterialSampler::Diffuse1 + diffuseCount++), texture.Texture });
+			else if (texture.Type == "texture_specular" && specularCount < PerType)
+				slots.push_back({ (MaterialSampler)((unsigned int)MaterialSampler::Specular1 + specularCount++), texture.Texture });
+		}
+
+		MaterialKey key;
+		key.second = shininess;
+		for (const Slot& slot : slots)
+			key.first.emplace_back(slot.Sampler, slot.Texture->GetID());
+
+		std::lock_guard<std::mutex> lock(s_MaterialMutex);
+		auto it = s_Materials.find(key);
+		if (it != s_Materials.end())
+			return it->second;
+
+		std::shared_ptr<const Material> material(new Material((unsigned int)s_Materials.size(), std::move(slots), shininess));
+		s_Materials.emplace(std::move(key), material);
+		return material;
+	}
+
+	unsigned int Material::GetCount()
+	{
+		std::lock_guard<std::mutex> lock(s_MaterialMutex);
+		return (unsigned int)s_Materials.size();
+	}
+
+	void Material::Clear()
+	{
+		std::lock_guard<std::mutex> lock(s_MaterialMutex);
+		s_Materials.clear();
+	}
+
+	Material::Material(unsigned int id, std::vector<Slot> slots, float shininess)
+		: m_ID(id), m_Slots(std::move(slots)), m_Shininess(shininess)
+	{
+	}
+
+	void Material::Bind(const ShaderLayout& layout) const
+	{
+		for (const Slot& slot : m_Slots)
+		{
+			const int unit = layout.GetMaterialUnit(slot.Sampler);
+			if (unit >= 0)
+				slot.Texture->Bind((unsigned int)unit);
+		}
+
+		if (layout.GetMaterialShininess() >= 0)
+			ShaderLayout::UploadValue(GL_FLOAT, layout.GetMaterialShininess(), 1, &m_Shininess);
+	}
+
+	void Material::Record(CommandBuffer& commands, const ShaderLayout& layout) const
+	{
+		for (const Slot& slot : m_Slots)
+		{
+			const int unit = layout.GetMaterialUnit(slot.Sampler);
+			if (unit >= 0)
+				commands.BindTexture((unsigned int)unit, GL_TEXTURE_2D, slot.Texture->GetID());
+		}
+
+		if (layout.GetMaterialShininess() >= 0)
+			commands.SetUniform(GL_FLOAT, layout.GetMaterialShininess(), 1, &m_Shininess);
+	}
+}
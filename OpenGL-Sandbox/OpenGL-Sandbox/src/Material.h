@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "ShaderLayout.h"
+#include "Texture.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AssetLoader
+{
+	struct MeshTexture
+	{
+		std::shared_ptr<Texture> Texture;
+		std::string Type;
+	};
+
+	// Textures and scalar parameters of a mesh, resolved when the mesh is imported. Every texture knows the material
+	// sampler it goes to and every program knows the unit of each sampler (see ShaderLayout), so binding a material is a
+	// loop over a few pairs. Meshes with the same textures and parameters share one material, whose ID sorts the draws.
+	class Material
+	{
+	public:
+		static constexpr float DefaultShininess = 32.0f;
+
+		// The material with these textures and parameters, created on first use. Only "texture_diffuse" and
+		// "texture_specular" textures are kept, up to the number of samplers of their type.
+		static std::shared_ptr<const Material> Get(const std::vector<MeshTexture>& textures, float shininess = DefaultShininess);
+		static unsigned int GetCount();
+		// Forgets every material, their textures go with the last mesh using them. Called before the context goes.
+		static void Clear();
+
+		Material(const Material&) = delete;
+		Material& operator=(const Material&) = delete;
+
+		unsigned int GetID() const { return m_ID; } // Dense, from 0
+		float GetShininess() const { return m_Shininess; }
+
+		// Binds the textures to the units of the program of 'layout' and sets its shininess, the program must be in use
+		void Bind(const ShaderLayout& layout) const;
+		// Same, recorded into a command buffer instead (safe on any thread)
+		void Record(CommandBuffer& commands, const ShaderLayout& layout) const;
+	private:
+		struct Slot
+		{
+			MaterialSampler Sampler;
+			std::shared_ptr<Texture> Texture;
+		};
+
+		Material(unsigned int id, std::vector<Slot> slots, float shininess);
+	private:
+		unsigned int m_ID;
+		std::vector<Slot> m_Slots;
+		float m_Shininess;
+	};
+}
@@ -1,9 +1,78 @@
 #include "Mesh.h"
+#include "GLState.h"
 
 #include <glad/glad.h>
 
+#include <algorithm>
+
 namespace AssetLoader
 {
+	namespace
+	{
+		// Dense identifiers used in render queue sort keys
+		unsigned int s_NextMeshID = 1;
+
+		std::unique_ptr<GeometryArena> s_MeshArena;
+	}
+
+	GeometryArena& GetMeshArena()
+	{
+		if (s_MeshArena)
+			return *s_MeshArena;
+
+		s_MeshArena = std::make_unique<GeometryArena>(sizeof(Vertex), []
+		{
+			// Vertex Positions
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+			// Vertex Normals
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+
+			// Vertex Texture Coordinates
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+		}, 1 << 18, 1 << 20, (int)offsetof(Vertex, Position)); // Positions are also kept on their own for the depth prepass
+		return *s_MeshArena;
+	}
+
+	void ShutdownMeshArena()
+	{
+		s_MeshArena.reset();
+	}
+
+	void SetupInstanceAttributes(unsigned int buffer, unsigned int offset)
+	{
+		GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		// Model matrix, a mat4 attribute takes 4 consecutive locations
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(uintptr_t)(offset + offsetof(InstanceData, Model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + column, 1);
+		}
+
+		// Instance color
+		glEnableVertexAttribArray(7);
+		glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(uintptr_t)(offset + offsetof(InstanceData, Color)));
+		glVertexAttribDivisor(7, 1);
+
+		// Custom data
+		glEnableVertexAttribArray(8);
+		glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(uintptr_t)(offset + offsetof(InstanceData, Custom)));
+		glVertexAttribDivisor(8, 1);
+
+		// Normal matrix, 3 columns
+		for (unsigned int column = 0; column < 3; column++)
+		{
+			glEnableVertexAttribArray(9 + column);
+			glVertexAttribPointer(9 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(uintptr_t)(offset + offsetof(InstanceData, Normal) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(9 + column, 1);
+		}
+	}
+
     Mesh::Mesh(const float* vertices, int verticesCount, int stride)
     {
         m_Vertices.reserve(verticesCount);
@@ -15,82 +84,88 @@ namespace AssetLoader
             vertex.TexCoords = glm::vec2(vertices[i + 6], vertices[i + 7]);
             m_Vertices.push_back(vertex);
         }
+        m_Material = Material::Get({});
         SetupMesh();
     }
 
-	Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<MeshTexture>& textures)
-		: m_Vertices(vertices), m_Indices(indices), m_Textures(textures)
+	Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<MeshTexture>& textures, float shininess)
+		: m_Material(Material::Get(textures, shininess)), m_Vertices(vertices), m_Indices(indices)
 	{
 		SetupMesh();
 	}
 
     void Mesh::Draw(const Shader& shader) const
 	{
-		unsigned int diffuseNr = 1;
-		unsigned int specularNr = 1;
-		for (unsigned int i = 0; i < m_Textures.size(); i++)
-		{
-			//glActiveTexture(GL_TEXTURE0 + i); // Activate proper texture unit before binding
-			// Retrieve texture number (the "N" in diffuse_textureN)
-			std::string number;
-			std::string name = std::string(m_Textures[i].Type);
-			if (name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if (name == "texture_specular")
-				number = std::to_string(specularNr++);
-			else
-				continue; // Skip other types
-
-			shader.SetUniformInt("u_Material." + name + number, i);
-			m_Textures[i].Texture->Bind(i);
-			//glBindTexture(GL_TEXTURE_2D, m_Textures[i].GetID());
-		}
-		glActiveTexture(GL_TEXTURE0); // Reset to default texture unit
+		BindTextures(shader);
+		DrawGeometry();
+	}
 
-		// Draw mesh
-		glBindVertexArray(m_VAO);
+	void Mesh::BindTextures(const Shader& shader) const
+	{
+		m_Material->Bind(*shader.GetLayout());
+	}
 
-		// Draw elements using indices - ONE draw call per mesh
-		// There is room for optimization here, as we could batch draw calls if multiple meshes share the same textures
-		if (!m_Indices.empty())
-			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(m_Indices.size()), GL_UNSIGNED_INT, nullptr);
-		else
-			glDrawArrays(GL_TRIANGLES, 0, static_cast<unsigned int>(m_Vertices.size()));
+	void Mesh::RecordTextures(CommandBuffer& commands, const Shader& shader) const
+	{
+		m_Material->Record(commands, *shader.GetLayout());
+	}
 
-		glBindVertexArray(0); // Unbind VAO
+	void Mesh::DrawGeometry() const
+	{
+		// Every mesh lives in the shared arena, the vertex array only changes when the vertex format does
+		const GeometryArena& arena = GetMeshArena();
+		const GeometryArena::Range& range = arena.GetRange(m_Geometry);
+		GLState::BindVertexArray(arena.GetVertexArray());
+
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.IndexCount, GL_UNSIGNED_INT, (void*)(uintptr_t)(range.FirstIndex * sizeof(uint32_t)), range.BaseVertex);
 	}
 
-	void Mesh::SetupMesh()
+	void Mesh::RecordGeometry(CommandBuffer& commands, unsigned int instanceBuffer, unsigned int instanceOffset, unsigned int instanceCount) const
 	{
-		glGenVertexArrays(1, &m_VAO);
-		glGenBuffers(1, &m_VBO);
+		const GeometryArena& arena = GetMeshArena();
+		const GeometryArena::Range& range = arena.GetRange(m_Geometry);
+		commands.BindVertexArray(arena.GetVertexArray());
 
-		if (!m_Indices.empty())
-			glGenBuffers(1, &m_EBO);
+		// Instance attributes are vertex array state, they have to be set after binding it
+		if (instanceBuffer != 0)
+			commands.BindInstances(instanceBuffer, instanceOffset);
 
-		glBindVertexArray(m_VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-		glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0], GL_STATIC_DRAW);
+		commands.DrawElements(GL_TRIANGLES, range.IndexCount, GL_UNSIGNED_INT, range.FirstIndex * sizeof(uint32_t), instanceCount, range.BaseVertex);
+	}
 
-		if (!m_Indices.empty())
-		{
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), &m_Indices[0], GL_STATIC_DRAW);
-		}
+	const GeometryArena::Range& Mesh::GetGeometryRange() const
+	{
+		return GetMeshArena().GetRange(m_Geometry);
+	}
 
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	void Mesh::SetupMesh()
+	{
+		m_ID = s_NextMeshID++;
 
-		// Vertex Normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		// Bounding sphere around the center of the axis aligned bounding box
+		if (!m_Vertices.empty())
+		{
+			glm::vec3 minimum = m_Vertices[0].Position, maximum = m_Vertices[0].Position;
+			for (const auto& vertex : m_Vertices)
+			{
+				minimum = glm::min(minimum, vertex.Position);
+				maximum = glm::max(maximum, vertex.Position);
+			}
+
+			m_BoundsCenter = (minimum + maximum) * 0.5f;
+			for (const auto& vertex : m_Vertices)
+				m_BoundsRadius = std::max(m_BoundsRadius, glm::length(vertex.Position - m_BoundsCenter));
+		}
 
-		// Vertex Texture Coordinates
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+		// Meshes without indices get the trivial index list, every mesh of the arena is drawn the same way
+		if (m_Indices.empty())
+		{
+			m_Indices.resize(m_Vertices.size());
+			for (unsigned int i = 0; i < m_Indices.size(); i++)
+				m_Indices[i] = i;
+		}
 
-		glBindVertexArray(0); // Unbind VAO
+		m_Geometry = GetMeshArena().Allocate(m_Vertices.data(), (uint32_t)m_Vertices.size(), m_Indices.data(), (uint32_t)m_Indices.size());
 	}
 }
 
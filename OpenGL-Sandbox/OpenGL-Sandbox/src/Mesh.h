@@ -1,12 +1,13 @@
 #pragma once
 
+#include "CommandBuffer.h"
+#include "GeometryArena.h"
+#include "Material.h"
 #include "Shader.h"
-#include "Texture.h"
 
 #include <glm/glm.hpp>
 
 #include <memory>
-#include <string>
 #include <vector>
 
 namespace AssetLoader
@@ -18,29 +19,66 @@ namespace AssetLoader
 		glm::vec2 TexCoords; // Texture coordinates for mapping textures onto the vertex
 	};
 
-	struct MeshTexture
+	// Per-instance vertex attributes (locations 3 to 11), read by InstancedVertex.glsl
+	struct InstanceData
 	{
-		std::shared_ptr<Texture> Texture;
-		std::string Type;
+		glm::mat4 Model;    // Model matrix, one attribute per column
+		glm::vec4 Color;    // Instance color
+		glm::vec4 Custom;   // Free for the shaders to use
+		glm::mat3x4 Normal; // Inverse transpose of the model matrix for the normals, one attribute per column (w unused)
 	};
 
+	// Shared vertex and index buffers of every mesh using the Vertex format, created with the first mesh.
+	// It has a position stream (GetPositionVertexArray()) for the depth-only passes.
+	GeometryArena& GetMeshArena();
+	// Deletes the buffers of the arena, before the context goes and after the last mesh. The next mesh creates it again.
+	void ShutdownMeshArena();
+
+	// Points the instance attributes of the bound vertex array at 'offset' bytes into 'buffer'
+	void SetupInstanceAttributes(unsigned int buffer, unsigned int offset);
+
 	class Mesh
 	{
 	public:
 		// Constructor
 		Mesh(const float* vertices, int verticesCount, int stride);
-		Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<MeshTexture>& textures);
+		Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<MeshTexture>& textures, float shininess = Material::DefaultShininess);
 
 		// Function to draw the mesh
 		void Draw(const Shader& shader) const;
+
+		// Split version of Draw(), used by the render queue to skip texture binds between draws sharing a material
+		void BindTextures(const Shader& shader) const;
+		void DrawGeometry() const;
+
+		// Same as BindTextures() and DrawGeometry(), recorded into a command buffer instead (safe on any thread)
+		void RecordTextures(CommandBuffer& commands, const Shader& shader) const;
+		// With an instance buffer, draws 'instanceCount' instances whose data starts at 'instanceOffset' bytes
+		void RecordGeometry(CommandBuffer& commands, unsigned int instanceBuffer = 0, unsigned int instanceOffset = 0, unsigned int instanceCount = 1) const;
+
+		// Range of the mesh in GetMeshArena(), every mesh is indexed
+		GeometryArena::Handle GetGeometry() const { return m_Geometry; }
+		const GeometryArena::Range& GetGeometryRange() const;
+
+		unsigned int GetID() const { return m_ID; }
+		const Material& GetMaterial() const { return *m_Material; }
+		unsigned int GetMaterialID() const { return m_Material->GetID(); } // Meshes using the same material share the same ID
+
+		// Bounding sphere in model space
+		const glm::vec3& GetBoundsCenter() const { return m_BoundsCenter; }
+		float GetBoundsRadius() const { return m_BoundsRadius; }
 	private:
-		void SetupMesh(); // Function to set up the mesh's OpenGL buffers and attributes
+		void SetupMesh(); // Function to upload the mesh into the geometry arena
 	private:
-		unsigned int m_VAO, m_VBO, m_EBO; // Vertex Array Object, Vertex Buffer Object, Element Buffer Object IDs
+		GeometryArena::Handle m_Geometry = GeometryArena::InvalidHandle; // Vertices and indices inside the mesh arena
+		unsigned int m_ID = 0;
+		std::shared_ptr<const Material> m_Material; // Textures and parameters, shared with the meshes that look the same
+
+		glm::vec3 m_BoundsCenter{ 0.0f };
+		float m_BoundsRadius = 0.0f;
 
 		// Mesh data
 		std::vector<Vertex> m_Vertices;			// List of vertices in the mesh
 		std::vector<unsigned int> m_Indices;	// List of indices for indexed drawing
-		std::vector<MeshTexture> m_Textures;	// List of textures applied to the mesh
 	};
 }
\ No newline at end of file
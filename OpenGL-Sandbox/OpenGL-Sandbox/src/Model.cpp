@@ -1,8 +1,13 @@
 #include "Model.h"
+#include "CpuProfiler.h"
 #include "TextureManager.h"
+#include "TransformStore.h"
+#include "WorkerPool.h"
 
 #include <stb_image/stb_image.h>
 
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 
 namespace AssetLoader
@@ -14,12 +19,9 @@ namespace AssetLoader
 
     Model::~Model()
     {
-        /*for (const auto& mesh : m_Meshes)
-        {
-            glDeleteVertexArrays(1, &m_VAO);
-            glDeleteBuffers(1, &m_VBO);
-            glDeleteBuffers(1, &m_EBO);
-        }*/
+        // Give the meshes' ranges back to the arena, they are reused by the next allocations
+        for (const auto& mesh : m_Meshes)
+            GetMeshArena().Free(mesh.GetGeometry());
     }
 
     void Model::Draw(const Shader& shader) const
@@ -30,11 +32,35 @@ namespace AssetLoader
 		}
 	}
 
+	void Model::Submit(RenderQueue& queue, RenderQueue::ProgramHandle program, const glm::mat4& transform) const
+	{
+		Submit(queue, 0, program, transform);
+	}
+
+	void Model::Submit(RenderQueue& queue, unsigned int partition, RenderQueue::ProgramHandle program, const glm::mat4& transform) const
+	{
+		Submit(queue, partition, program, transform, TransformStore::ComputeNormalMatrix(transform));
+	}
+
+	void Model::Submit(RenderQueue& queue, unsigned int partition, RenderQueue::ProgramHandle program, const glm::mat4& transform, const glm::mat3x4& normal) const
+	{
+		for (const auto& mesh : m_Meshes)
+		{
+			queue.Submit(partition, mesh, program, transform, normal);
+		}
+	}
+
 	void Model::LoadModel(const std::string& path)
 	{
+		PROFILE_SCOPE("Load model");
+
 		// Load the model using Assimp
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+		const aiScene* scene = nullptr;
+		{
+			PROFILE_SCOPE("Import scene");
+			scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+		}
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 		{
 			std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
@@ -43,32 +69,77 @@ namespace AssetLoader
 
 		m_Directory = path.substr(0, path.find_last_of('/'));
 
-		ProcessNode(scene->mRootNode, scene);
+		// The meshes in node order, converted in parallel on the worker pool
+		std::vector<const aiMesh*> meshes;
+		ProcessNode(scene->mRootNode, scene, meshes);
+
+		std::vector<MeshData> meshData(meshes.size());
+		WorkerPool::Instance().ParallelFor((unsigned int)meshes.size(), [&](unsigned int index, unsigned int)
+		{
+			PROFILE_SCOPE("Process mesh");
+			meshData[index] = ProcessMesh(meshes[index], scene);
+		}, 1);
+
+		// Every texture of the model is decoded in parallel, then the meshes are uploaded in order on this thread
+		std::vector<std::string> texturePaths;
+		for (const MeshData& data : meshData)
+		{
+			for (const auto& [texturePath, type] : data.Textures)
+				texturePaths.push_back(texturePath);
+		}
+		TextureManager::Instance().Load(texturePaths);
+
+		m_Meshes.reserve(meshData.size());
+		for (const MeshData& data : meshData)
+		{
+			// If the texture is not loaded, load it
+			// Otherwise it will get it from TextureManager memory
+			std::vector<MeshTexture> textures;
+			textures.reserve(data.Textures.size());
+			for (const auto& [texturePath, type] : data.Textures)
+				textures.push_back({ TextureManager::Instance().Get(texturePath), type });
+
+			m_Meshes.emplace_back(data.Vertices, data.Indices, textures);
+		}
+
+		// Sphere around the center of the box of the mesh spheres, reaching the far side of each of them
+		if (!m_Meshes.empty())
+		{
+			glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+			for (const Mesh& mesh : m_Meshes)
+			{
+				minimum = glm::min(minimum, mesh.GetBoundsCenter() - mesh.GetBoundsRadius());
+				maximum = glm::max(maximum, mesh.GetBoundsCenter() + mesh.GetBoundsRadius());
+			}
+
+			m_BoundsCenter = (minimum + maximum) * 0.5f;
+			for (const Mesh& mesh : m_Meshes)
+				m_BoundsRadius = std::max(m_BoundsRadius, glm::length(mesh.GetBoundsCenter() - m_BoundsCenter) + mesh.GetBoundsRadius());
+		}
 	}
 
-	void Model::ProcessNode(aiNode* node, const aiScene* scene)
+	void Model::ProcessNode(aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes)
 	{
 		// Process all the node's meshes (if any)
 		for (unsigned int i = 0; i < node->mNumMeshes; i++)
 		{
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			m_Meshes.push_back(ProcessMesh(mesh, scene));
+			meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
 		}
 
 		// Recursively process all the children nodes
 		for (unsigned int i = 0; i < node->mNumChildren; i++)
 		{
-			ProcessNode(node->mChildren[i], scene);
+			ProcessNode(node->mChildren[i], scene, meshes);
 		}
 	}
 
-	Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
+	Model::MeshData Model::ProcessMesh(const aiMesh* mesh, const aiScene* scene) const
 	{
-		std::vector<Vertex> vertices;
+		MeshData data;
+		std::vector<Vertex>& vertices = data.Vertices;
 		vertices.reserve(mesh->mNumVertices);
 
-		std::vector<unsigned int> indices;
-		std::vector<MeshTexture> textures;
+		std::vector<unsigned int>& indices = data.Indices;
 
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -119,37 +190,24 @@ namespace AssetLoader
 		// Materials
 		if (mesh->mMaterialIndex >= 0)
 		{
-			aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+			const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-			std::vector<MeshTexture> diffuseMaps = LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-			std::vector<MeshTexture> specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+			GetMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data);
+			GetMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data);
 		}
 
-		return { vertices, indices, textures };
+		return data;
 	}
 
-	std::vector<MeshTexture> Model::LoadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName)
+	void Model::GetMaterialTextures(const aiMaterial* mat, aiTextureType type, const std::string& typeName, MeshData& data) const
 	{
-		int textureCount = mat->GetTextureCount(type);
-		std::vector<MeshTexture> textures;
-		textures.reserve(textureCount);
-
+		const int textureCount = mat->GetTextureCount(type);
 		for (int i = 0; i < textureCount; i++)
 		{
 			aiString str;
 			mat->GetTexture(type, i, &str);
-
-			// If the texture is not loaded, load it
-			// Otherwise it will get it from TextureManager memory
-			const std::string texturePath = m_Directory + '/' + std::string(str.C_Str());
-			auto texture = TextureManager::Instance().Get(texturePath);
-			textures.push_back({ texture, typeName });
+			data.Textures.push_back({ m_Directory + '/' + std::string(str.C_Str()), typeName });
 		}
-
-		return textures;
 	}
 }
 
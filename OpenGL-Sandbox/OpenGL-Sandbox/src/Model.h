@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Mesh.h"
+#include "RenderQueue.h"
 #include "Shader.h"
 #include "Texture.h"
 
@@ -19,14 +20,39 @@ namespace AssetLoader
         Model(const std::string& path);
 		~Model();
 
+		// The meshes' geometry is released with the model, it cannot be shared by copies
+		Model(const Model&) = delete;
+		Model& operator=(const Model&) = delete;
+
 		void Draw(const Shader& shader) const;
+
+		// Adds one draw per mesh to the queue (to the given partition of the queue, see RenderQueue::Begin())
+		void Submit(RenderQueue& queue, RenderQueue::ProgramHandle program, const glm::mat4& transform) const;
+		void Submit(RenderQueue& queue, unsigned int partition, RenderQueue::ProgramHandle program, const glm::mat4& transform) const;
+		// Same with the normal matrix of the transform already computed (see TransformStore)
+		void Submit(RenderQueue& queue, unsigned int partition, RenderQueue::ProgramHandle program, const glm::mat4& transform, const glm::mat3x4& normal) const;
+
+		// Bounding sphere of every mesh, in model space
+		const glm::vec3& GetBoundsCenter() const { return m_BoundsCenter; }
+		float GetBoundsRadius() const { return m_BoundsRadius; }
 	private:
+		// Geometry and texture paths of a mesh, converted on a worker before the upload
+		struct MeshData
+		{
+			std::vector<Vertex> Vertices;
+			std::vector<unsigned int> Indices;
+			std::vector<std::pair<std::string, std::string>> Textures; // Path and type
+		};
+
 		void LoadModel(const std::string& path);
-		void ProcessNode(aiNode* node, const aiScene* scene);
-		Mesh ProcessMesh(aiMesh* mesh, const aiScene* scene);
-		std::vector<MeshTexture> LoadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName);
+		void ProcessNode(aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes);
+		MeshData ProcessMesh(const aiMesh* mesh, const aiScene* scene) const;
+		void GetMaterialTextures(const aiMaterial* mat, aiTextureType type, const std::string& typeName, MeshData& data) const;
 	private:
 		std::vector<Mesh> m_Meshes;
 		std::string m_Directory;
+
+		glm::vec3 m_BoundsCenter{ 0.0f };
+		float m_BoundsRadius = 0.0f;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "OffscreenTarget.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static uint32_t table[256] = {};
+        if (table[1] == 0)
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++)
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                table[i] = value;
+            }
+        }
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void AppendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    // Length, type, data and the CRC of type and data
+    void AppendChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+    {
+        AppendBigEndian(out, (uint32_t)data.size());
+        const size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        AppendBigEndian(out, Crc32(out.data() + typeOffset, data.size() + 4));
+    }
+}
+
+OffscreenTarget::OffscreenTarget(unsigned int width, unsigned int height)
+    : m_Width(width), m_Height(height)
+{
+    glGenRenderbuffers(1, &m_Color);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_Color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_Width, m_Height);
+
+    glGenRenderbuffers(1, &m_DepthStencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_DepthStencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GpuMemory& memory = GpuMemory::Instance();
+    memory.OnRenderbufferAllocated(m_Color, GpuMemory::GetTextureBytes(GL_RGBA8, m_Width, m_Height), GL_RGBA8, GpuMemory::Category::RenderTargets, "Offscreen target");
+    memory.OnRenderbufferAllocated(m_DepthStencil, GpuMemory::GetTextureBytes(GL_DEPTH24_STENCIL8, m_Width, m_Height), GL_DEPTH24_STENCIL8,
+        GpuMemory::Category::RenderTargets, "Offscreen target");
+
+    glGenFramebuffers(1, &m_Framebuffer);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_DepthStencil);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "[ERROR]: Offscreen framebuffer is incomplete (" << m_Width << "x" << m_Height << ")" << std::endl;
+
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+    GLState::OnFramebufferDeleted(m_Framebuffer);
+    glDeleteFramebuffers(1, &m_Framebuffer);
+    GpuMemory::Instance().OnRenderbufferDeleted(m_Color);
+    GpuMemory::Instance().OnRenderbufferDeleted(m_DepthStencil);
+    glDeleteRenderbuffers(1, &m_Color);
+    glDeleteRenderbuffers(1, &m_DepthStencil);
+}
+
+namespace Image
+{
+    std::vector<uint8_t> ReadPixels(unsigned int framebuffer, unsigned int width, unsigned int height)
+    {
+        std::vector<uint8_t> pixels((size_t)width * height * 4);
+
+        GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        // GL rows go bottom to top
+        const size_t rowSize = (size_t)width * 4;
+        std::vector<uint8_t> row(rowSize);
+        for (unsigned int y = 0; y < height / 2; y++)
+        {
+            uint8_t* top = pixels.data() + y * rowSize;
+            uint8_t* bottom = pixels.data() + (height - 1 - y) * rowSize;
+            std::memcpy(row.data(), top, rowSize);
+            std::memcpy(top, bottom, rowSize);
+            std::memcpy(bottom, row.data(), rowSize);
+        }
+        return pixels;
+    }
+
+    bool WritePng(const std::string& path, unsigned int width, unsigned int height, const std::vector<uint8_t>& pixels)
+    {
+        const size_t rowSize = (size_t)width * 4;
+        if (pixels.size() < rowSize * height)
+        {
+            std::cerr << "[ERROR]: Not enough pixels for a " << width << "x" << height << " image" << std::endl;
+            return false;
+        }
+
+        std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+        // 8 bits per channel, RGBA, no interlacing
+        std::vector<uint8_t> header;
+        AppendBigEndian(header, width);
+        AppendBigEndian(header, height);
+        header.insert(header.end(), { 8, 6, 0, 0, 0 });
+        AppendChunk(png, "IHDR", header);
+
+        // Every row starts with its filter type (0, none)
+        std::vector<uint8_t> raw;
+        raw.reserve((rowSize + 1) * height);
+        for (unsigned int y = 0; y < height; y++)
+        {
+            raw.push_back(0);
+            raw.insert(raw.end(), pixels.begin() + y * rowSize, pixels.begin() + (y + 1) * rowSize);
+        }
+
+        // zlib stream made of stored deflate blocks (at most 65535 bytes each), then the Adler-32 of the raw data
+        std::vector<uint8_t> data = { 0x78, 0x01 };
+        size_t offset = 0;
+        do
+        {
+            const size_t blockSize = std::min<size_t>(raw.size() - offset, 65535);
+            const bool last = offset + blockSize == raw.size();
+            data.push_back(last ? 1 : 0);
+            data.push_back((uint8_t)blockSize);
+            data.push_back((uint8_t)(blockSize >> 8));
+            data.push_back((uint8_t)~blockSize);
+            data.push_back((uint8_t)(~blockSize >> 8));
+            data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+            offset += blockSize;
+        } while (offset < raw.size());
+
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        AppendBigEndian(data, (b << 16) | a);
+
+        AppendChunk(png, "IDAT", data);
+        AppendChunk(png, "IEND", {});
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "[ERROR]: Could not open '" << path << "' for writing" << std::endl;
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(png.data()), png.size());
+        return (bool)file;
+    }
+}
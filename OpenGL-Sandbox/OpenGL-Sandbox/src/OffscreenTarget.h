@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Color and depth/stencil framebuffer the frame is drawn into instead of the window, for headless runs (no visible
+// window, or no display at all) and for reading frames back. The depth/stencil format is the one of the G-buffer
+// (DEPTH24_STENCIL8) so that the deferred path can blit into it like into the default framebuffer.
+class OffscreenTarget
+{
+public:
+    OffscreenTarget(unsigned int width, unsigned int height);
+    ~OffscreenTarget();
+
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    unsigned int GetFramebuffer() const { return m_Framebuffer; }
+    unsigned int GetWidth() const { return m_Width; }
+    unsigned int GetHeight() const { return m_Height; }
+private:
+    unsigned int m_Width, m_Height;
+    unsigned int m_Framebuffer = 0;
+    unsigned int m_Color = 0, m_DepthStencil = 0; // Renderbuffers
+};
+
+namespace Image
+{
+    // Reads the color buffer of 'framebuffer' as RGBA8, top row first (waits for the GPU)
+    std::vector<uint8_t> ReadPixels(unsigned int framebuffer, unsigned int width, unsigned int height);
+
+    // Uncompressed (stored deflate blocks) RGBA8 PNG, pixels top row first. Large but needs no zlib, and every
+    // image viewer and diff tool reads it.
+    bool WritePng(const std::string& path, unsigned int width, unsigned int height, const std::vector<uint8_t>& pixels);
+}
@@ -0,0 +1,138 @@
+#include "ParameterBlock.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+ParameterBlock::ParameterBlock(std::shared_ptr<const ShaderLayout> layout)
+    : m_Layout(std::move(layout))
+{
+    m_Data.resize(m_Layout->GetDataSize());
+    m_Dirty.resize(m_Layout->GetParameters().size());
+    m_Written.resize(m_Layout->GetParameters().size());
+}
+
+ParameterBlock::Handle ParameterBlock::GetHandle(const std::string& name)
+{
+    for (size_t i = 0; i < m_Slots.size(); i++)
+    {
+        if (m_Slots[i].Name == name)
+            return (Handle)i;
+    }
+
+    const int parameter = m_Layout->Find(name);
+#if SHADER_PARAMETER_VALIDATION
+    if (parameter < 0)
+        std::cerr << "[WARNING]: Shader parameter '" << name << "' does not exist in the program, writes will be ignored" << std::endl;
+#endif
+
+    m_Slots.push_back({ name, parameter });
+    return (Handle)(m_Slots.size() - 1);
+}
+
+bool ParameterBlock::Accepts(unsigned int parameterType, ValueType type)
+{
+    switch (type)
+    {
+    case ValueType::Float:  return parameterType == GL_FLOAT;
+    case ValueType::Int:    return parameterType == GL_INT || parameterType == GL_BOOL || ShaderLayout::IsSampler(parameterType);
+    case ValueType::Vec2:   return parameterType == GL_FLOAT_VEC2;
+    case ValueType::Vec3:   return parameterType == GL_FLOAT_VEC3;
+    case ValueType::Vec4:   return parameterType == GL_FLOAT_VEC4;
+    case ValueType::Mat4:   return parameterType == GL_FLOAT_MAT4;
+    default:                return false;
+    }
+}
+
+void ParameterBlock::Write(Handle handle, const void* data, unsigned int size, ValueType type)
+{
+    if (handle == InvalidHandle)
+        return;
+
+    const int parameterIndex = m_Slots[handle].Parameter;
+    if (parameterIndex < 0)
+        return; // Missing in the program, nothing would reach the GPU anyway
+
+    // A value of another type would be uploaded as the parameter's type, or fill it partially
+    const ShaderParameter& parameter = m_Layout->GetParameter(parameterIndex);
+#if SHADER_PARAMETER_VALIDATION
+    if (!Accepts(parameter.Type, type))
+    {
+        std::cerr << "[WARNING]: Writing a value of another type to shader parameter '" << parameter.Name << "' (GL type 0x"
+            << std::hex << parameter.Type << std::dec << "), the write is ignored" << std::endl;
+        return;
+    }
+#else
+    (void)type; // Release builds only check the size
+#endif
+    if (size != parameter.Size)
+    {
+#if SHADER_PARAMETER_VALIDATION
+        std::cerr << "[WARNING]: Writing " << size << " bytes to shader parameter '" << parameter.Name << "' of " << parameter.Size << " bytes" << std::endl;
+#endif
+        return;
+    }
+
+    // Unchanged values do not need to be uploaded again
+    uint8_t* destination = m_Data.data() + parameter.Offset;
+    if (m_Written[parameterIndex] && std::memcmp(destination, data, size) == 0)
+        return;
+
+    std::memcpy(destination, data, size);
+    m_Written[parameterIndex] = true;
+    m_Dirty[parameterIndex] = true;
+    m_AnyDirty = true;
+}
+
+void ParameterBlock::Rebind(std::shared_ptr<const ShaderLayout> layout)
+{
+    const size_t parameterCount = layout->GetParameters().size();
+    std::vector<uint8_t> data(layout->GetDataSize());
+    std::vector<bool> written(parameterCount);
+
+    for (size_t i = 0; i < parameterCount; i++)
+    {
+        const ShaderParameter& parameter = layout->GetParameter((int)i);
+        const int previous = m_Layout->Find(parameter.Name);
+        if (previous < 0 || !m_Written[previous])
+            continue;
+
+        const ShaderParameter& old = m_Layout->GetParameter(previous);
+        if (old.Type != parameter.Type)
+            continue;
+
+        std::memcpy(data.data() + parameter.Offset, m_Data.data() + old.Offset, std::min(old.Size, parameter.Size));
+        written[i] = true;
+    }
+
+    for (auto& slot : m_Slots)
+        slot.Parameter = layout->Find(slot.Name);
+
+    m_Layout = std::move(layout);
+    m_Data = std::move(data);
+    m_Written = std::move(written);
+    m_Dirty = m_Written; // A relinked program starts with default values, everything known has to be sent again
+    m_AnyDirty = true;
+
+#if SHADER_PARAMETER_VALIDATION
+    m_ReportedUnset = false;
+#endif
+}
+
+#if SHADER_PARAMETER_VALIDATION
+void ParameterBlock::ReportUnset(const std::string& programName)
+{
+    if (m_ReportedUnset)
+        return;
+
+    m_ReportedUnset = true;
+    for (size_t i = 0; i < m_Written.size(); i++)
+    {
+        const ShaderParameter& parameter = m_Layout->GetParameter((int)i);
+        // Samplers and the material shininess are set by the materials of the meshes
+        if (!m_Written[i] && parameter.SamplerUnit < 0 && parameter.Location != m_Layout->GetMaterialShininess())
+            std::cerr << "[WARNING]: Shader parameter '" << parameter.Name << "' of '" << programName << "' is never set" << std::endl;
+    }
+}
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ShaderLayout.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Packed copy of the parameter values of one program, written by the CPU and uploaded by Shader::Upload() in one step.
+// Handles stay valid when the program is hot reloaded, values are carried over to the new layout by name.
+class ParameterBlock
+{
+public:
+    using Handle = int;
+    static constexpr Handle InvalidHandle = -1;
+
+    ParameterBlock(std::shared_ptr<const ShaderLayout> layout);
+
+    Handle GetHandle(const std::string& name);
+
+    // The value must have the type of the parameter (int also sets bools and samplers), other writes are ignored
+    void Set(Handle handle, float value) { Write(handle, &value, sizeof(value), ValueType::Float); }
+    void Set(Handle handle, int value) { Write(handle, &value, sizeof(value), ValueType::Int); }
+    void Set(Handle handle, const glm::vec2& value) { Write(handle, &value[0], sizeof(value), ValueType::Vec2); }
+    void Set(Handle handle, const glm::vec3& value) { Write(handle, &value[0], sizeof(value), ValueType::Vec3); }
+    void Set(Handle handle, const glm::vec4& value) { Write(handle, &value[0], sizeof(value), ValueType::Vec4); }
+    void Set(Handle handle, const glm::mat4& value) { Write(handle, &value[0][0], sizeof(value), ValueType::Mat4); }
+
+    template<typename T>
+    void Set(const std::string& name, const T& value) { Set(GetHandle(name), value); }
+
+    // Moves the values over to the layout of a relinked program, every known value gets uploaded again
+    void Rebind(std::shared_ptr<const ShaderLayout> layout);
+
+    const std::shared_ptr<const ShaderLayout>& GetLayout() const { return m_Layout; }
+    const uint8_t* GetData() const { return m_Data.data(); }
+
+    bool IsDirty(int parameter) const { return m_Dirty[parameter]; }
+    bool IsWritten(int parameter) const { return m_Written[parameter]; }
+    void ClearDirty() { std::fill(m_Dirty.begin(), m_Dirty.end(), false); m_AnyDirty = false; }
+    bool HasDirty() const { return m_AnyDirty; }
+
+#if SHADER_PARAMETER_VALIDATION
+    // Reports the parameters of the program that were never written, once per layout
+    void ReportUnset(const std::string& programName);
+#endif
+private:
+    // Type of the Set() overload, checked against the GL type of the parameter
+    enum class ValueType : uint8_t { Float, Int, Vec2, Vec3, Vec4, Mat4 };
+
+    static bool Accepts(unsigned int parameterType, ValueType type);
+    void Write(Handle handle, const void* data, unsigned int size, ValueType type);
+private:
+    struct Slot
+    {
+        std::string Name;
+        int Parameter; // Index into the layout, -1 if the current program does not use this name
+    };
+
+    std::shared_ptr<const ShaderLayout> m_Layout;
+    std::vector<uint8_t> m_Data;
+    std::vector<bool> m_Dirty, m_Written;
+    std::vector<Slot> m_Slots;
+    bool m_AnyDirty = false;
+
+#if SHADER_PARAMETER_VALIDATION
+    bool m_ReportedUnset = false;
+#endif
+};
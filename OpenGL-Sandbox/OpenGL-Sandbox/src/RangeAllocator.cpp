@@ -0,0 +1,133 @@
+#include "RangeAllocator.h"
+
+#include <iterator>
+#include <iostream>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+    : m_Capacity(capacity)
+{
+    if (capacity > 0)
+        AddFreeBlock(0, capacity);
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+    if (size == 0)
+        return InvalidOffset;
+
+    // Smallest free block that fits, large blocks stay available for large allocations
+    auto best = m_FreeBySize.lower_bound(size);
+    if (best == m_FreeBySize.end())
+        return InvalidOffset;
+
+    // Take the front of the block, the rest stays free
+    const uint32_t offset = best->second, remaining = best->first - size;
+    RemoveFreeBlock(m_Free.find(offset));
+    if (remaining > 0)
+        AddFreeBlock(offset + size, remaining);
+
+    m_Allocated.emplace(offset, size);
+    m_Used += size;
+    return offset;
+}
+
+void RangeAllocator::Free(uint32_t offset)
+{
+    auto it = m_Allocated.find(offset);
+    if (it == m_Allocated.end())
+    {
+        std::cerr << "[ERROR]: Freeing offset " << offset << " which is not allocated" << std::endl;
+        return;
+    }
+
+    const uint32_t size = it->second;
+    m_Allocated.erase(it);
+    m_Used -= size;
+    AddFreeBlock(offset, size);
+}
+
+void RangeAllocator::Grow(uint32_t capacity)
+{
+    if (capacity <= m_Capacity)
+        return;
+
+    const uint32_t offset = m_Capacity;
+    m_Capacity = capacity;
+    AddFreeBlock(offset, capacity - offset);
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::Compact()
+{
+    std::vector<Move> moves;
+    moves.reserve(m_Allocated.size());
+
+    std::map<uint32_t, uint32_t> allocated;
+    uint32_t cursor = 0;
+    for (const auto& [offset, size] : m_Allocated)
+    {
+        moves.push_back({ offset, cursor, size });
+        allocated.emplace_hint(allocated.end(), cursor, size);
+        cursor += size;
+    }
+
+    m_Allocated.swap(allocated);
+    m_Free.clear();
+    m_FreeBySize.clear();
+    if (cursor < m_Capacity)
+        AddFreeBlock(cursor, m_Capacity - cursor);
+
+    return moves;
+}
+
+uint32_t RangeAllocator::GetLargestFreeBlock() const
+{
+    return m_FreeBySize.empty() ? 0 : m_FreeBySize.rbegin()->first;
+}
+
+float RangeAllocator::GetFragmentation() const
+{
+    const uint32_t free = m_Capacity - m_Used;
+    return free == 0 ? 0.0f : 1.0f - (float)GetLargestFreeBlock() / (float)free;
+}
+
+void RangeAllocator::AddFreeBlock(uint32_t offset, uint32_t size)
+{
+    auto next = m_Free.lower_bound(offset);
+
+    // Merge with the block right after
+    if (next != m_Free.end() && offset + size == next->first)
+    {
+        size += next->second;
+        auto merged = next++;
+        RemoveFreeBlock(merged);
+    }
+
+    // Merge with the block right before
+    if (next != m_Free.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            RemoveFreeBlock(previous);
+        }
+    }
+
+    m_Free.emplace(offset, size);
+    m_FreeBySize.emplace(size, offset);
+}
+
+void RangeAllocator::RemoveFreeBlock(std::map<uint32_t, uint32_t>::iterator block)
+{
+    auto range = m_FreeBySize.equal_range(block->second);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == block->first)
+        {
+            m_FreeBySize.erase(it);
+            break;
+        }
+    }
+    m_Free.erase(block);
+}
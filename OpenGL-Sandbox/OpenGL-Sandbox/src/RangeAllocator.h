@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Best-fit allocator over the range [0, capacity), in arbitrary units (vertices, indices, bytes...).
+// Only bookkeeping, the owner of the actual storage applies growth and compaction to its buffers.
+class RangeAllocator
+{
+public:
+    static constexpr uint32_t InvalidOffset = 0xFFFFFFFF;
+
+    // New location of an allocation after Compact()
+    struct Move
+    {
+        uint32_t From, To, Size;
+    };
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    uint32_t Allocate(uint32_t size); // InvalidOffset if no free block is large enough
+    void Free(uint32_t offset);
+
+    // Extends the range, the new space is merged with a free block at the end of the range
+    void Grow(uint32_t capacity);
+
+    // Packs every allocation at the start of the range, keeping their order. Returns the old and new offset of every
+    // allocation (including the ones that did not move), sorted by offset.
+    std::vector<Move> Compact();
+
+    uint32_t GetCapacity() const { return m_Capacity; }
+    uint32_t GetUsed() const { return m_Used; }
+    uint32_t GetAllocationCount() const { return (uint32_t)m_Allocated.size(); }
+    uint32_t GetFreeBlockCount() const { return (uint32_t)m_Free.size(); }
+    uint32_t GetLargestFreeBlock() const;
+
+    // 0 when all the free space is one block, close to 1 when it is scattered in small blocks
+    float GetFragmentation() const;
+private:
+    void AddFreeBlock(uint32_t offset, uint32_t size); // Coalesces with the neighbouring free blocks
+    void RemoveFreeBlock(std::map<uint32_t, uint32_t>::iterator block);
+private:
+    std::map<uint32_t, uint32_t> m_Free;      // Offset -> size, never two adjacent blocks
+    std::multimap<uint32_t, uint32_t> m_FreeBySize; // Size -> offset, same blocks as m_Free
+    std::map<uint32_t, uint32_t> m_Allocated; // Offset -> size
+    uint32_t m_Capacity = 0, m_Used = 0;
+};
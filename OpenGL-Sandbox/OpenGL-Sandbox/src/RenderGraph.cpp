@@ -0,0 +1,645 @@
+#include "RenderGraph.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <tuple>
+
+namespace
+{
+    // Pooled textures unused for this many frames are deleted (resizes, a path that is no longer taken)
+    constexpr uint64_t UnusedFrames = 60;
+
+    // Client format and type to allocate a texture of the internal format with glTexImage2D
+    void GetAllocationFormat(unsigned int internalFormat, unsigned int& format, unsigned int& type)
+    {
+        switch (internalFormat)
+        {
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+        case GL_DEPTH24_STENCIL8:   format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+        case GL_R8:
+        case GL_R16F:
+        case GL_R32F:               format = GL_RED; type = GL_FLOAT; break;
+        case GL_RG8:
+        case GL_RG16:
+        case GL_RG16F:              format = GL_RG; type = GL_FLOAT; break;
+        case GL_R11F_G11F_B10F:     format = GL_RGB; type = GL_FLOAT; break;
+        default:                    format = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+        }
+    }
+}
+
+bool RenderGraph::TextureDesc::operator<(const TextureDesc& other) const
+{
+    return std::tie(Width, Height, Format, Renderbuffer) < std::tie(other.Width, other.Height, other.Format, other.Renderbuffer);
+}
+
+RenderGraph::Handle RenderGraph::Builder::Create(const std::string& name, const TextureDesc& desc)
+{
+    Resource resource;
+    resource.Name = name;
+    resource.Desc = desc;
+    m_Graph.m_Resources.push_back(std::move(resource));
+    return m_Graph.AddVersion((uint32_t)m_Graph.m_Resources.size() - 1, None);
+}
+
+RenderGraph::Handle RenderGraph::Builder::Read(Handle resource)
+{
+    if (resource >= m_Graph.m_Versions.size())
+    {
+        std::cerr << "[ERROR]: Render graph pass '" << m_Graph.m_Passes[m_Pass].Name << "' reads an invalid resource" << std::endl;
+        return InvalidHandle;
+    }
+
+    m_Graph.m_Passes[m_Pass].Reads.push_back(resource);
+    return resource;
+}
+
+RenderGraph::Handle RenderGraph::Builder::Write(Handle resource, unsigned int attachment)
+{
+    if (resource >= m_Graph.m_Versions.size())
+    {
+        std::cerr << "[ERROR]: Render graph pass '" << m_Graph.m_Passes[m_Pass].Name << "' writes an invalid resource" << std::endl;
+        return InvalidHandle;
+    }
+
+    const Version& version = m_Graph.m_Versions[resource];
+    const Resource& target = m_Graph.m_Resources[version.Resource];
+    if (version.Number + 1 != target.Versions)
+        std::cerr << "[WARNING]: Render graph pass '" << m_Graph.m_Passes[m_Pass].Name << "' writes an old version of '" << target.Name << "'" << std::endl;
+
+    // Written content is kept, the previous writer has to run first
+    Pass& pass = m_Graph.m_Passes[m_Pass];
+    if (version.Writer != None)
+        pass.Reads.push_back(resource);
+
+    const Handle written = m_Graph.AddVersion(version.Resource, m_Pass);
+    pass.Writes.push_back(written);
+    if (attachment != 0)
+        pass.Attachments.emplace_back(attachment, written);
+    return written;
+}
+
+void RenderGraph::Builder::SideEffect()
+{
+    m_Graph.m_Passes[m_Pass].SideEffect = true;
+}
+
+unsigned int RenderGraph::Context::GetTexture(Handle resource) const
+{
+    return m_Graph.GetName(resource);
+}
+
+RenderGraph::~RenderGraph()
+{
+    for (const auto& [key, framebuffer] : m_Framebuffers)
+    {
+        GLState::OnFramebufferDeleted(framebuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    for (const PooledTexture& texture : m_Pool)
+    {
+        if (texture.Desc.Renderbuffer)
+        {
+            GpuMemory::Instance().OnRenderbufferDeleted(texture.Name);
+            glDeleteRenderbuffers(1, &texture.Name);
+        }
+        else
+        {
+            GLState::OnTextureDeleted(texture.Name);
+            GpuMemory::Instance().OnTextureDeleted(texture.Name);
+            glDeleteTextures(1, &texture.Name);
+        }
+    }
+}
+
+void RenderGraph::Reset()
+{
+    m_Passes.clear();
+    m_Resources.clear();
+    m_Versions.clear();
+    m_Order.clear();
+    m_Slots.clear();
+    m_Compiled = false;
+}
+
+RenderGraph::Handle RenderGraph::ImportFramebuffer(const std::string& name, unsigned int framebuffer, unsigned int width, unsigned int height)
+{
+    Resource resource;
+    resource.Name = name;
+    resource.Desc.Width = width;
+    resource.Desc.Height = height;
+    resource.Imported = true;
+    resource.Output = true;
+    resource.External = framebuffer;
+    m_Resources.push_back(std::move(resource));
+    return AddVersion((uint32_t)m_Resources.size() - 1, None);
+}
+
+RenderGraph::Handle RenderGraph::ImportTexture(const std::string& name, unsigned int texture, const TextureDesc& desc)
+{
+    Resource resource;
+    resource.Name = name;
+    resource.Desc = desc;
+    resource.Imported = true;
+    resource.External = texture;
+    m_Resources.push_back(std::move(resource));
+    return AddVersion((uint32_t)m_Resources.size() - 1, None);
+}
+
+void RenderGraph::AddPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute)
+{
+    Pass pass;
+    pass.Name = name;
+    pass.Execute = std::move(execute);
+    m_Passes.push_back(std::move(pass));
+
+    Builder builder(*this, (uint32_t)m_Passes.size() - 1);
+    setup(builder);
+}
+
+RenderGraph::Handle RenderGraph::AddVersion(uint32_t resource, uint32_t writer)
+{
+    Version version;
+    version.Resource = resource;
+    version.Number = m_Resources[resource].Versions++;
+    version.Writer = writer;
+    m_Versions.push_back(version);
+    return (Handle)m_Versions.size() - 1;
+}
+
+void RenderGraph::Compile()
+{
+    m_Stats.Passes = (uint32_t)m_Passes.size();
+    Cull();
+    Sort();
+    Place();
+    m_Compiled = true;
+}
+
+void RenderGraph::Cull()
+{
+    // Reference counts: a pass is needed while something reads one of its writes, a version while a needed pass reads it
+    for (Version& version : m_Versions)
+        version.Readers = 0;
+    for (const Pass& pass : m_Passes)
+    {
+        for (Handle read : pass.Reads)
+            m_Versions[read].Readers++;
+    }
+
+    auto isRoot = [this](const Pass& pass)
+    {
+        if (pass.SideEffect)
+            return true;
+        for (Handle written : pass.Writes)
+        {
+            if (m_Resources[m_Versions[written].Resource].Output)
+                return true;
+        }
+        return false;
+    };
+
+    std::vector<Handle> unread;
+    auto cull = [&](Pass& pass)
+    {
+        pass.Culled = true;
+        for (Handle read : pass.Reads)
+        {
+            if (--m_Versions[read].Readers == 0 && m_Versions[read].Writer != None)
+                unread.push_back(read);
+        }
+    };
+
+    for (Pass& pass : m_Passes)
+    {
+        pass.Culled = false;
+        pass.References = (uint32_t)pass.Writes.size();
+    }
+    // Every version goes on the list once: unread from the start, or when its last reader is culled
+    for (Handle handle = 0; handle < m_Versions.size(); handle++)
+    {
+        if (m_Versions[handle].Readers == 0 && m_Versions[handle].Writer != None)
+            unread.push_back(handle);
+    }
+    for (Pass& pass : m_Passes)
+    {
+        if (pass.References == 0 && !isRoot(pass))
+            cull(pass);
+    }
+
+    // Writers of what nobody reads go, and what they read loses a reader
+    while (!unread.empty())
+    {
+        const Handle handle = unread.back();
+        unread.pop_back();
+
+        Pass& writer = m_Passes[m_Versions[handle].Writer];
+        if (writer.Culled || isRoot(writer))
+            continue;
+        if (--writer.References == 0)
+            cull(writer);
+    }
+
+    m_Stats.CulledPasses = 0;
+    for (const Pass& pass : m_Passes)
+        m_Stats.CulledPasses += pass.Culled ? 1 : 0;
+}
+
+void RenderGraph::Sort()
+{
+    // Edges: the writer of a version runs before its readers, and the readers of a version before the writer of the next
+    const uint32_t passCount = (uint32_t)m_Passes.size();
+    std::vector<std::vector<uint32_t>> next(passCount);
+    std::vector<uint32_t> incoming(passCount, 0);
+    auto addEdge = [&](uint32_t from, uint32_t to)
+    {
+        if (from == None || from == to || m_Passes[from].Culled || m_Passes[to].Culled)
+            return;
+        next[from].push_back(to);
+        incoming[to]++;
+    };
+
+    // Versions of each resource in order
+    std::vector<std::vector<Handle>> versions(m_Resources.size());
+    for (Handle handle = 0; handle < m_Versions.size(); handle++)
+        versions[m_Versions[handle].Resource].push_back(handle);
+
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        for (Handle read : m_Passes[pass].Reads)
+        {
+            addEdge(m_Versions[read].Writer, pass);
+
+            const std::vector<Handle>& history = versions[m_Versions[read].Resource];
+            const uint32_t following = m_Versions[read].Number + 1;
+            if (following < history.size())
+                addEdge(pass, m_Versions[history[following]].Writer);
+        }
+    }
+
+    // Kahn's algorithm, the passes that are ready run in declaration order
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+    uint32_t remaining = 0;
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        if (m_Passes[pass].Culled)
+            continue;
+        remaining++;
+        if (incoming[pass] == 0)
+            ready.push(pass);
+    }
+
+    m_Order.clear();
+    while (!ready.empty())
+    {
+        const uint32_t pass = ready.top();
+        ready.pop();
+        m_Order.push_back(pass);
+        for (uint32_t following : next[pass])
+        {
+            if (--incoming[following] == 0)
+                ready.push(following);
+        }
+    }
+
+    if (m_Order.size() != remaining)
+    {
+        std::cerr << "[ERROR]: Render graph has a dependency cycle, the passes run in declaration order" << std::endl;
+        m_Order.clear();
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            if (!m_Passes[pass].Culled)
+                m_Order.push_back(pass);
+        }
+    }
+}
+
+void RenderGraph::Place()
+{
+    // Lifetime of every transient resource, in positions of the execution order
+    for (Resource& resource : m_Resources)
+    {
+        resource.First = resource.Last = resource.Slot = None;
+    }
+    for (uint32_t position = 0; position < m_Order.size(); position++)
+    {
+        const Pass& pass = m_Passes[m_Order[position]];
+        for (const std::vector<Handle>* handles : { &pass.Reads, &pass.Writes })
+        {
+            for (Handle handle : *handles)
+            {
+                Resource& resource = m_Resources[m_Versions[handle].Resource];
+                if (resource.Imported)
+                    continue;
+                if (resource.First == None)
+                    resource.First = position;
+                resource.Last = position;
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> starts(m_Order.size()), ends(m_Order.size());
+    m_Stats.TransientResources = 0;
+    m_Stats.TransientBytes = 0;
+    for (uint32_t index = 0; index < m_Resources.size(); index++)
+    {
+        const Resource& resource = m_Resources[index];
+        if (resource.First == None)
+            continue;
+        starts[resource.First].push_back(index);
+        ends[resource.Last].push_back(index);
+        m_Stats.TransientResources++;
+        m_Stats.TransientBytes += (size_t)resource.Desc.Width * resource.Desc.Height * GpuMemory::GetFormatBytes(resource.Desc.Format);
+    }
+
+    // Greedy: a resource takes a free slot of its description when there is one, and frees it after its last pass
+    m_Slots.clear();
+    std::multimap<TextureDesc, uint32_t> free;
+    for (uint32_t position = 0; position < m_Order.size(); position++)
+    {
+        for (uint32_t index : starts[position])
+        {
+            Resource& resource = m_Resources[index];
+            auto it = m_Aliasing ? free.find(resource.Desc) : free.end();
+            if (it != free.end())
+            {
+                resource.Slot = it->second;
+                free.erase(it);
+            }
+            else
+            {
+                resource.Slot = (uint32_t)m_Slots.size();
+                m_Slots.push_back({ resource.Desc, None });
+            }
+        }
+
+        for (uint32_t index : ends[position])
+            free.emplace(m_Resources[index].Desc, m_Resources[index].Slot);
+    }
+
+    m_Stats.PhysicalResources = (uint32_t)m_Slots.size();
+    m_Stats.AliasedBytes = 0;
+    for (const Slot& slot : m_Slots)
+        m_Stats.AliasedBytes += (size_t)slot.Desc.Width * slot.Desc.Height * GpuMemory::GetFormatBytes(slot.Desc.Format);
+}
+
+void RenderGraph::Execute()
+{
+    if (!m_Compiled)
+        Compile();
+    m_Frame++;
+    ReleaseUnused();
+
+    // Every slot takes a pooled texture of its description that no other slot took this frame
+    for (Slot& slot : m_Slots)
+    {
+        slot.Pooled = None;
+        for (uint32_t index = 0; index < m_Pool.size() && slot.Pooled == None; index++)
+        {
+            if (m_Pool[index].LastFrame != m_Frame && m_Pool[index].Desc == slot.Desc)
+                slot.Pooled = index;
+        }
+
+        if (slot.Pooled == None)
+        {
+            PooledTexture texture;
+            texture.Desc = slot.Desc;
+            if (slot.Desc.Renderbuffer)
+            {
+                glGenRenderbuffers(1, &texture.Name);
+                glBindRenderbuffer(GL_RENDERBUFFER, texture.Name);
+                glRenderbufferStorage(GL_RENDERBUFFER, slot.Desc.Format, slot.Desc.Width, slot.Desc.Height);
+                glBindRenderbuffer(GL_RENDERBUFFER, 0);
+                GpuMemory::Instance().OnRenderbufferAllocated(texture.Name, GpuMemory::GetTextureBytes(slot.Desc.Format, slot.Desc.Width, slot.Desc.Height),
+                    slot.Desc.Format, GpuMemory::Category::RenderTargets, "Render graph");
+            }
+            else
+            {
+                unsigned int format, type;
+                GetAllocationFormat(slot.Desc.Format, format, type);
+                glGenTextures(1, &texture.Name);
+                GLState::BindTexture(GLState::GetActiveTextureUnit(), GL_TEXTURE_2D, texture.Name);
+                glTexImage2D(GL_TEXTURE_2D, 0, slot.Desc.Format, slot.Desc.Width, slot.Desc.Height, 0, format, type, nullptr);
+                GpuMemory::Instance().OnTextureAllocated(texture.Name, GpuMemory::GetTextureBytes(slot.Desc.Format, slot.Desc.Width, slot.Desc.Height),
+                    slot.Desc.Format, GpuMemory::Category::RenderTargets, "Render graph");
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            slot.Pooled = (uint32_t)m_Pool.size();
+            m_Pool.push_back(texture);
+        }
+        m_Pool[slot.Pooled].LastFrame = m_Frame;
+    }
+
+    for (uint32_t index : m_Order)
+    {
+        Pass& pass = m_Passes[index];
+
+        Context context(*this);
+        if (!pass.Attachments.empty())
+        {
+            context.m_Framebuffer = AcquireFramebuffer(pass, context.m_Width, context.m_Height);
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, context.m_Framebuffer);
+            GLState::Viewport(0, 0, context.m_Width, context.m_Height);
+        }
+
+        if (pass.Execute)
+            pass.Execute(context);
+    }
+
+    m_Stats.Framebuffers = (uint32_t)m_Framebuffers.size();
+    m_Stats.PoolTextures = (uint32_t)m_Pool.size();
+    m_Stats.PoolBytes = 0;
+    for (const PooledTexture& texture : m_Pool)
+        m_Stats.PoolBytes += (size_t)texture.Desc.Width * texture.Desc.Height * GpuMemory::GetFormatBytes(texture.Desc.Format);
+}
+
+unsigned int RenderGraph::GetName(Handle handle) const
+{
+    if (handle >= m_Versions.size())
+        return 0;
+
+    const Resource& resource = m_Resources[m_Versions[handle].Resource];
+    if (resource.Imported)
+        return resource.External;
+    if (resource.Slot == None || m_Slots[resource.Slot].Pooled == None)
+        return 0;
+    return m_Pool[m_Slots[resource.Slot].Pooled].Name;
+}
+
+unsigned int RenderGraph::AcquireFramebuffer(const Pass& pass, unsigned int& width, unsigned int& height)
+{
+    // Imported framebuffers are attached as a whole
+    const Resource& first = m_Resources[m_Versions[pass.Attachments[0].second].Resource];
+    width = first.Desc.Width;
+    height = first.Desc.Height;
+    if (first.Output)
+        return first.External;
+
+    FramebufferKey key;
+    key.reserve(pass.Attachments.size());
+    for (const auto& [attachment, handle] : pass.Attachments)
+        key.emplace_back(attachment, GetName(handle));
+    std::sort(key.begin(), key.end());
+
+    auto it = m_Framebuffers.find(key);
+    if (it != m_Framebuffers.end())
+        return it->second;
+
+    unsigned int framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    std::vector<GLenum> drawBuffers;
+    for (const auto& [attachment, handle] : pass.Attachments)
+    {
+        const Resource& resource = m_Resources[m_Versions[handle].Resource];
+        if (resource.Output)
+            std::cerr << "[ERROR]: Render graph pass '" << pass.Name << "' attaches '" << resource.Name << "' with other targets" << std::endl;
+        else if (resource.Desc.Renderbuffer)
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, GetName(handle));
+        else
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, GetName(handle), 0);
+
+        if (attachment >= GL_COLOR_ATTACHMENT0 && attachment <= GL_COLOR_ATTACHMENT15)
+            drawBuffers.push_back(attachment);
+    }
+
+    // Color outputs in attachment order, fragment output i goes to GL_COLOR_ATTACHMENTi
+    std::sort(drawBuffers.begin(), drawBuffers.end());
+    if (drawBuffers.empty())
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    else
+    {
+        glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "[ERROR]: Render graph framebuffer of pass '" << pass.Name << "' is incomplete (" << width << "x" << height << ")" << std::endl;
+
+    m_Framebuffers.emplace(std::move(key), framebuffer);
+    return framebuffer;
+}
+
+void RenderGraph::ReleaseUnused()
+{
+    for (size_t index = 0; index < m_Pool.size();)
+    {
+        const PooledTexture texture = m_Pool[index];
+        if (m_Frame - texture.LastFrame < UnusedFrames)
+        {
+            index++;
+            continue;
+        }
+
+        // The framebuffers it is attached to go with it
+        for (auto it = m_Framebuffers.begin(); it != m_Framebuffers.end();)
+        {
+            const bool attached = std::any_of(it->first.begin(), it->first.end(), [&](const auto& pair) { return pair.second == texture.Name; });
+            if (attached)
+            {
+                GLState::OnFramebufferDeleted(it->second);
+                glDeleteFramebuffers(1, &it->second);
+                it = m_Framebuffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (texture.Desc.Renderbuffer)
+        {
+            GpuMemory::Instance().OnRenderbufferDeleted(texture.Name);
+            glDeleteRenderbuffers(1, &texture.Name);
+        }
+        else
+        {
+            GLState::OnTextureDeleted(texture.Name);
+            GpuMemory::Instance().OnTextureDeleted(texture.Name);
+            glDeleteTextures(1, &texture.Name);
+        }
+
+        // Before the slots of the frame take their textures, the indices can still change
+        m_Pool[index] = m_Pool.back();
+        m_Pool.pop_back();
+    }
+}
+
+void RenderGraph::Dump(std::ostream& out) const
+{
+    out << "digraph RenderGraph\n{\n";
+    out << "    rankdir=LR;\n";
+    out << "    node [fontname=\"Helvetica\", fontsize=10];\n";
+    out << "    label=\"" << m_Stats.Passes - m_Stats.CulledPasses << "/" << m_Stats.Passes << " passes, "
+        << m_Stats.TransientResources << " transient resources in " << m_Stats.PhysicalResources << " textures, "
+        << m_Stats.AliasedBytes / 1024 << " KiB with aliasing, " << m_Stats.TransientBytes / 1024 << " KiB without\";\n";
+
+    // Passes that run are numbered in execution order
+    std::vector<uint32_t> positions(m_Passes.size(), None);
+    for (uint32_t position = 0; position < m_Order.size(); position++)
+        positions[m_Order[position]] = position;
+
+    for (uint32_t index = 0; index < m_Passes.size(); index++)
+    {
+        const Pass& pass = m_Passes[index];
+        out << "    pass" << index << " [shape=box, style=\"" << (pass.Culled ? "dashed" : "filled") << "\", fillcolor=\"#d0e4f5\", label=\"";
+        if (positions[index] != None)
+            out << positions[index] << ": ";
+        out << pass.Name << (pass.Culled ? "\\n(culled)" : "") << "\"];\n";
+    }
+
+    for (uint32_t index = 0; index < m_Resources.size(); index++)
+    {
+        const Resource& resource = m_Resources[index];
+        out << "    resource" << index << " [shape=ellipse, style=\"" << (resource.Imported ? "bold" : "solid") << "\", label=\"" << resource.Name;
+        if (resource.Desc.Width != 0)
+            out << "\\n" << resource.Desc.Width << "x" << resource.Desc.Height;
+        if (resource.Desc.Format != 0)
+            out << " " << GpuMemory::GetFormatName(resource.Desc.Format) << (resource.Desc.Renderbuffer ? " renderbuffer" : "");
+        if (resource.Imported)
+            out << "\\nimported";
+        else if (resource.Slot != None)
+            out << "\\ntexture " << resource.Slot << ", passes " << resource.First << " to " << resource.Last;
+        else
+            out << "\\nunused";
+        out << "\"];\n";
+    }
+
+    for (uint32_t index = 0; index < m_Passes.size(); index++)
+    {
+        const Pass& pass = m_Passes[index];
+        for (Handle read : pass.Reads)
+            out << "    resource" << m_Versions[read].Resource << " -> pass" << index << ";\n";
+        for (Handle written : pass.Writes)
+            out << "    pass" << index << " -> resource" << m_Versions[written].Resource << " [color=\"#c0392b\"];\n";
+    }
+    out << "}\n";
+}
+
+bool RenderGraph::WriteDot(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "[ERROR]: Could not open '" << path << "' for writing" << std::endl;
+        return false;
+    }
+
+    Dump(file);
+    return (bool)file;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Passes of a frame and the render targets they read and write, declared anew every frame. Compile() drops the passes
+// whose results nobody uses, orders the others by their dependencies (declaration order otherwise) and places the
+// transient targets: two targets of the same description whose lifetimes do not overlap share one texture. GL has no way
+// to alias the memory of different formats, so sharing is limited to identical descriptions. Execute() takes the textures
+// from a pool kept across frames, binds a cached framebuffer of the attachments of each pass and runs it.
+//
+//     RenderGraph::Handle output = graph.ImportFramebuffer("Output", 0, width, height);
+//     RenderGraph::Handle color;
+//     graph.AddPass("Scene", [&](RenderGraph::Builder& builder) { color = builder.Write(builder.Create("Color", desc), GL_COLOR_ATTACHMENT0); },
+//         [&](const RenderGraph::Context&) { queue.Execute(); });
+//     graph.AddPass("Post", [&](RenderGraph::Builder& builder) { builder.Read(color); output = builder.Write(output, GL_COLOR_ATTACHMENT0); },
+//         [&](const RenderGraph::Context& context) { Fullscreen(context.GetTexture(color)); });
+//     graph.Compile();
+//     graph.Execute();
+//
+// Compile() does not touch GL, Execute() and the destructor run on the GL thread.
+class RenderGraph
+{
+public:
+    // A version of a resource: every write gives a new handle, passes declared later read what the writer left
+    using Handle = uint32_t;
+    static constexpr Handle InvalidHandle = ~0u;
+
+    struct TextureDesc
+    {
+        unsigned int Width = 0, Height = 0;
+        unsigned int Format = 0;    // Sized internal format (GL_RGBA8, GL_DEPTH24_STENCIL8, ...)
+        bool Renderbuffer = false;  // Never sampled, attached only
+
+        bool operator==(const TextureDesc& other) const { return Width == other.Width && Height == other.Height && Format == other.Format && Renderbuffer == other.Renderbuffer; }
+        bool operator<(const TextureDesc& other) const;
+    };
+
+    struct Stats
+    {
+        uint32_t Passes = 0;              // Declared
+        uint32_t CulledPasses = 0;
+        uint32_t TransientResources = 0;  // Created by the passes that run
+        uint32_t PhysicalResources = 0;   // Textures and renderbuffers they were placed in
+        size_t TransientBytes = 0;        // Every transient resource in its own texture
+        size_t AliasedBytes = 0;          // Peak of the frame, with the textures shared
+        uint32_t Framebuffers = 0;        // Cached
+        uint32_t PoolTextures = 0;        // Kept across frames, in use or not
+        size_t PoolBytes = 0;
+    };
+
+    // What a pass declares in its setup function
+    class Builder
+    {
+    public:
+        // A transient texture, its content is undefined until written
+        Handle Create(const std::string& name, const TextureDesc& desc);
+        // Sampled, or read in any other way (blit source)
+        Handle Read(Handle resource);
+        // Written as the framebuffer attachment 'attachment' (GL_COLOR_ATTACHMENTi, GL_DEPTH_ATTACHMENT,
+        // GL_DEPTH_STENCIL_ATTACHMENT) or, with 0, in another way (blit destination, own framebuffers).
+        // The previous content is kept, the pass depends on its writer. Returns the new version.
+        Handle Write(Handle resource, unsigned int attachment = 0);
+        // The pass has effects outside the graph, it is never culled
+        void SideEffect();
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph& graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+
+        RenderGraph& m_Graph;
+        uint32_t m_Pass;
+    };
+
+    // What a pass finds when it runs: its framebuffer is bound with a viewport covering it
+    class Context
+    {
+    public:
+        unsigned int GetTexture(Handle resource) const;    // Texture or renderbuffer name
+        unsigned int GetFramebuffer() const { return m_Framebuffer; }
+        unsigned int GetWidth() const { return m_Width; }
+        unsigned int GetHeight() const { return m_Height; }
+    private:
+        friend class RenderGraph;
+        Context(const RenderGraph& graph) : m_Graph(graph) {}
+
+        const RenderGraph& m_Graph;
+        unsigned int m_Framebuffer = 0, m_Width = 0, m_Height = 0;
+    };
+
+    using SetupFunction = std::function<void(Builder&)>;
+    using ExecuteFunction = std::function<void(const Context&)>;
+
+    RenderGraph() = default;
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Forgets the passes and resources of the previous frame, the pooled textures and framebuffers stay
+    void Reset();
+
+    // A framebuffer made outside of the graph (the window, an offscreen target), the passes writing it are never culled
+    Handle ImportFramebuffer(const std::string& name, unsigned int framebuffer, unsigned int width, unsigned int height);
+    // A texture made outside of the graph (shadow maps), the passes writing it are culled like any other
+    Handle ImportTexture(const std::string& name, unsigned int texture, const TextureDesc& desc);
+
+    // Calls 'setup' right away, 'execute' from Execute() if the pass is not culled
+    void AddPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute);
+
+    // Shares the transient textures between resources with disjoint lifetimes, on by default
+    void SetAliasing(bool aliasing) { m_Aliasing = aliasing; }
+    bool IsAliasing() const { return m_Aliasing; }
+
+    // Culls, orders and places the resources of the passes added since Reset()
+    void Compile();
+    // Runs the passes in order, GL thread only
+    void Execute();
+
+    // Graphviz description of the compiled graph: passes in execution order (culled ones dashed), resources with their
+    // placement, read and write edges
+    void Dump(std::ostream& out) const;
+    bool WriteDot(const std::string& path) const;
+
+    const Stats& GetStats() const { return m_Stats; }
+
+    // Order of the passes that run, by index of declaration
+    const std::vector<uint32_t>& GetOrder() const { return m_Order; }
+    const std::string& GetPassName(uint32_t pass) const { return m_Passes[pass].Name; }
+    bool IsCulled(uint32_t pass) const { return m_Passes[pass].Culled; }
+private:
+    static constexpr uint32_t None = ~0u;
+
+    struct Resource
+    {
+        std::string Name;
+        TextureDesc Desc;
+        bool Imported = false;
+        bool Output = false;            // Imported framebuffer
+        unsigned int External = 0;      // Imported texture or framebuffer
+        uint32_t Versions = 0;
+        // Placement, for the transient resources that are used
+        uint32_t First = None, Last = None; // Positions in m_Order
+        uint32_t Slot = None;
+    };
+
+    // One version of a resource, written by one pass and read by any number
+    struct Version
+    {
+        uint32_t Resource;
+        uint32_t Number;
+        uint32_t Writer = None;
+        uint32_t Readers = 0;   // Reference count while culling
+    };
+
+    struct Pass
+    {
+        std::string Name;
+        ExecuteFunction Execute;
+        std::vector<Handle> Reads, Writes;
+        std::vector<std::pair<unsigned int, Handle>> Attachments;
+        bool SideEffect = false;
+        bool Culled = false;
+        uint32_t References = 0; // Versions written that something still reads, while culling
+    };
+
+    // A texture the transient resources of this frame were placed in
+    struct Slot
+    {
+        TextureDesc Desc;
+        uint32_t Pooled = None; // Index in m_Pool, set by Execute()
+    };
+
+    struct PooledTexture
+    {
+        TextureDesc Desc;
+        unsigned int Name = 0;
+        uint64_t LastFrame = 0;
+    };
+
+    // Attachment points and texture (or renderbuffer) names
+    using FramebufferKey = std::vector<std::pair<unsigned int, unsigned int>>;
+
+    Handle AddVersion(uint32_t resource, uint32_t writer);
+    void Cull();
+    void Sort();
+    void Place();
+
+    unsigned int GetName(Handle handle) const;
+    unsigned int AcquireFramebuffer(const Pass& pass, unsigned int& width, unsigned int& height);
+    void ReleaseUnused();
+private:
+    std::vector<Pass> m_Passes;
+    std::vector<Resource> m_Resources;
+    std::vector<Version> m_Versions;
+    std::vector<uint32_t> m_Order;
+    std::vector<Slot> m_Slots;
+    bool m_Aliasing = true;
+    bool m_Compiled = false;
+
+    std::vector<PooledTexture> m_Pool;
+    std::map<FramebufferKey, unsigned int> m_Framebuffers;
+    uint64_t m_Frame = 0;
+
+    Stats m_Stats;
+};
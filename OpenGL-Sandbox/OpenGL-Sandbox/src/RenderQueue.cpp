@@ -0,0 +1,574 @@
+#include "RenderQueue.h"
+#include "CpuProfiler.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "TransformStore.h"
+#include "WorkerPool.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // Replaces the content of a per-frame buffer, orphaning the previous storage lets the driver hand out new memory
+    // instead of waiting for last frame's draws
+    void UploadFrameData(unsigned int target, unsigned int buffer, size_t& capacity, const void* data, size_t size)
+    {
+        if (size == 0)
+            return;
+
+        const bool grown = size > capacity;
+        if (grown)
+            capacity = size + size / 2;
+
+        GLState::BindBuffer(target, buffer);
+        glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, size, data);
+        if (grown)
+            GpuMemory::Instance().OnBufferAllocated(buffer, capacity, GpuMemory::Category::Streaming, "Render queues");
+    }
+}
+
+namespace SortKey
+{
+    constexpr unsigned int PassShift = 60;
+    constexpr unsigned int TranslucentShift = 59;
+
+    uint16_t QuantizeDepth(float depth)
+    {
+        return (uint16_t)(std::min(std::max(depth, 0.0f), 1.0f) * 65535.0f);
+    }
+
+    uint64_t Opaque(RenderPass pass, uint16_t program, uint16_t material, uint16_t mesh, float depth)
+    {
+        return ((uint64_t)pass << PassShift)
+            | ((uint64_t)(program & 0x7FF) << 48)
+            | ((uint64_t)material << 32)
+            | ((uint64_t)mesh << 16)
+            | (uint64_t)QuantizeDepth(depth);
+    }
+
+    uint64_t Translucent(RenderPass pass, uint16_t program, uint16_t material, uint16_t mesh, float depth)
+    {
+        // Far draws first, so that blending composes back to front
+        const uint16_t invertedDepth = (uint16_t)(65535 - QuantizeDepth(depth));
+
+        return ((uint64_t)pass << PassShift)
+            | (1ull << TranslucentShift)
+            | ((uint64_t)invertedDepth << 43)
+            | ((uint64_t)(program & 0x7FF) << 32)
+            | ((uint64_t)material << 16)
+            | (uint64_t)mesh;
+    }
+}
+
+void RadixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch)
+{
+    // 6 passes at most instead of 8 with bytes, the histograms still fit in the L1 cache
+    constexpr unsigned int DigitBits = 11;
+    constexpr unsigned int DigitCount = (64 + DigitBits - 1) / DigitBits;
+    constexpr uint32_t BucketCount = 1u << DigitBits;
+    constexpr uint64_t DigitMask = BucketCount - 1;
+
+    const size_t count = packets.size();
+    if (count < 2)
+        return;
+
+    scratch.resize(count);
+
+    // All the histograms are built in a single read of the keys, along with the bits that differ between any two keys.
+    // Written out, a loop over the digits is not unrolled by every compiler and costs a fifth of the sort.
+    static_assert(DigitCount == 6, "one histogram increment per digit below");
+    uint32_t histograms[DigitCount][BucketCount] = {};
+    const uint64_t firstKey = packets[0].Key;
+    uint64_t varyingBits = 0;
+    for (const auto& packet : packets)
+    {
+        const uint64_t key = packet.Key;
+        varyingBits |= key ^ firstKey;
+        histograms[0][key & DigitMask]++;
+        histograms[1][(key >> DigitBits) & DigitMask]++;
+        histograms[2][(key >> 2 * DigitBits) & DigitMask]++;
+        histograms[3][(key >> 3 * DigitBits) & DigitMask]++;
+        histograms[4][(key >> 4 * DigitBits) & DigitMask]++;
+        histograms[5][(key >> 5 * DigitBits) & DigitMask]++;
+    }
+
+    DrawPacket* source = packets.data();
+    DrawPacket* destination = scratch.data();
+    for (unsigned int digit = 0; digit < DigitCount; digit++)
+    {
+        const unsigned int shift = digit * DigitBits;
+
+        // Skip the digits that are the same for every key (e.g. the pass, or the program in a small scene)
+        if (((varyingBits >> shift) & DigitMask) == 0)
+            continue;
+
+        uint32_t* histogram = histograms[digit];
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < BucketCount; bucket++)
+        {
+            const uint32_t bucketSize = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketSize;
+        }
+
+        // Four packets are loaded ahead of their stores, the scatter is bound by the latency of the loads otherwise
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const DrawPacket a = source[i], b = source[i + 1], c = source[i + 2], d = source[i + 3];
+            destination[histogram[(a.Key >> shift) & DigitMask]++] = a;
+            destination[histogram[(b.Key >> shift) & DigitMask]++] = b;
+            destination[histogram[(c.Key >> shift) & DigitMask]++] = c;
+            destination[histogram[(d.Key >> shift) & DigitMask]++] = d;
+        }
+        for (; i < count; i++)
+        {
+            const DrawPacket& packet = source[i];
+            destination[histogram[(packet.Key >> shift) & DigitMask]++] = packet;
+        }
+
+        std::swap(source, destination);
+    }
+
+    if (source != packets.data())
+        packets.swap(scratch);
+}
+
+RenderQueue::RenderQueue(UploadRing* ring)
+    : m_Ring(ring), m_UseMultiDrawIndirect(GLExtensions::HasMultiDrawIndirect())
+{
+    glGenBuffers(1, &m_InstanceBuffer);
+    glGenBuffers(1, &m_IndirectBuffer);
+    for (auto& frame : m_FragmentQueries)
+        glGenQueries(FragmentQueryCount, frame);
+}
+
+RenderQueue::~RenderQueue()
+{
+    GLState::OnBufferDeleted(m_InstanceBuffer);
+    GLState::OnBufferDeleted(m_IndirectBuffer);
+    GpuMemory::Instance().OnBufferDeleted(m_InstanceBuffer);
+    GpuMemory::Instance().OnBufferDeleted(m_IndirectBuffer);
+    glDeleteBuffers(1, &m_InstanceBuffer);
+    glDeleteBuffers(1, &m_IndirectBuffer);
+    for (auto& frame : m_FragmentQueries)
+        glDeleteQueries(FragmentQueryCount, frame);
+}
+
+RenderQueue::ProgramHandle RenderQueue::RegisterProgram(const Shader& shader, ParameterBlock& parameters)
+{
+    m_Programs.push_back({ &shader, &parameters });
+    return (ProgramHandle)(m_Programs.size() - 1);
+}
+
+void RenderQueue::Begin(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, unsigned int partitionCount)
+{
+    m_View = view;
+    m_NearPlane = nearPlane;
+    m_FarPlane = farPlane;
+
+    // Frustum planes extracted from the rows of the view projection matrix, pointing inwards
+    const glm::mat4 m = glm::transpose(projection * view);
+    m_FrustumPlanes[0] = m[3] + m[0]; // Left
+    m_FrustumPlanes[1] = m[3] - m[0]; // Right
+    m_FrustumPlanes[2] = m[3] + m[1]; // Bottom
+    m_FrustumPlanes[3] = m[3] - m[1]; // Top
+    m_FrustumPlanes[4] = m[3] + m[2]; // Near
+    m_FrustumPlanes[5] = m[3] - m[2]; // Far
+    for (auto& plane : m_FrustumPlanes)
+        plane /= glm::length(glm::vec3(plane));
+
+    if (partitionCount > MaxPartitions)
+    {
+        std::cerr << "[WARNING]: Render queue supports at most " << MaxPartitions << " partitions, " << partitionCount << " requested" << std::endl;
+        partitionCount = MaxPartitions;
+    }
+
+    // Partitions keep their memory from one frame to the next
+    m_Partitions.resize(std::max(partitionCount, 1u));
+    for (auto& partition : m_Partitions)
+    {
+        partition.Draws.clear();
+        partition.Packets.clear();
+        partition.Culled = 0;
+    }
+
+    m_Packets.clear();
+    m_Instances = FrameStream();
+    m_Indirect = FrameStream();
+    m_RecordedBuffers = 0;
+}
+
+void RenderQueue::Submit(unsigned int partition, const AssetLoader::Mesh& mesh, ProgramHandle program, const glm::mat4& model, const glm::vec4& color, const glm::vec4& custom, RenderPass pass, bool translucent)
+{
+    Submit(partition, mesh, program, model, TransformStore::ComputeNormalMatrix(model), color, custom, pass, translucent);
+}
+
+void RenderQueue::Submit(unsigned int partition, const AssetLoader::Mesh& mesh, ProgramHandle program, const glm::mat4& model, const glm::mat3x4& normal, const glm::vec4& color, const glm::vec4& custom, RenderPass pass, bool translucent)
+{
+    Partition& target = m_Partitions[partition];
+
+    // Bounding sphere against the frustum, the radius follows the largest scale of the transform
+    const glm::vec3 worldCenter = glm::vec3(model * glm::vec4(mesh.GetBoundsCenter(), 1.0f));
+    const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    if (!IsVisible(worldCenter, mesh.GetBoundsRadius() * scale))
+    {
+        target.Culled++;
+        return;
+    }
+
+    // Distance along the view direction of the mesh bounds center, normalized between the clip planes
+    const glm::vec4 center = m_View * glm::vec4(worldCenter, 1.0f);
+    const float depth = (-center.z - m_NearPlane) / (m_FarPlane - m_NearPlane);
+
+    const uint16_t material = (uint16_t)mesh.GetMaterialID();
+    const uint16_t meshID = (uint16_t)mesh.GetID();
+
+    DrawPacket packet;
+    packet.Key = translucent
+        ? SortKey::Translucent(pass, program, material, meshID, depth)
+        : SortKey::Opaque(pass, program, material, meshID, depth);
+    packet.Draw = (partition << PartitionShift) | (uint32_t)target.Draws.size();
+
+    target.Draws.push_back({ &mesh, program, { model, color, custom, normal } });
+    target.Packets.push_back(packet);
+}
+
+bool RenderQueue::IsVisible(const glm::vec3& center, float radius) const
+{
+    for (const auto& plane : m_FrustumPlanes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+void RenderQueue::Sort()
+{
+    PROFILE_SCOPE("Sort render queue");
+
+    m_Stats = Stats();
+
+    size_t count = 0;
+    for (const auto& partition : m_Partitions)
+    {
+        count += partition.Packets.size();
+        m_Stats.Culled += partition.Culled;
+    }
+
+    m_Packets.clear();
+    m_Packets.reserve(count);
+    for (const auto& partition : m_Partitions)
+        m_Packets.insert(m_Packets.end(), partition.Packets.begin(), partition.Packets.end());
+
+    RadixSort(m_Packets, m_Scratch);
+}
+
+void RenderQueue::Record()
+{
+    PROFILE_SCOPE("Record render queue");
+
+    // Instance i belongs to the i-th sorted draw, so every worker knows where its instances go without synchronizing.
+    // A range of draws never has more groups than draws, the indirect commands of a range start at the same index.
+    m_Instances = AllocateStream(m_Packets.size() * sizeof(AssetLoader::InstanceData), 16, m_InstanceStaging, m_InstanceBuffer);
+    if (m_UseMultiDrawIndirect)
+        m_Indirect = AllocateStream(m_Packets.size() * sizeof(GLExtensions::DrawElementsIndirectCommand), 4, m_IndirectStaging, m_IndirectBuffer);
+
+    // One contiguous range of the sorted draws per worker, small frames are not worth waking the workers up for
+    constexpr size_t MinDrawsPerBuffer = 64;
+    const size_t maxBuffers = (m_Packets.size() + MinDrawsPerBuffer - 1) / MinDrawsPerBuffer;
+    const size_t bufferCount = std::max<size_t>(1, std::min<size_t>(WorkerPool::Instance().GetThreadCount(), maxBuffers));
+
+    if (m_CommandBuffers.size() < bufferCount)
+        m_CommandBuffers.resize(bufferCount);
+    m_RecordStats.assign(bufferCount, Stats());
+    m_RecordedBuffers = bufferCount;
+
+    m_RecordedDepth = m_DepthShader != nullptr;
+    if (m_RecordedDepth && m_DepthCommandBuffers.size() < bufferCount)
+        m_DepthCommandBuffers.resize(bufferCount);
+
+    const size_t drawsPerBuffer = (m_Packets.size() + bufferCount - 1) / bufferCount;
+    WorkerPool::Instance().ParallelFor((unsigned int)bufferCount, [&](unsigned int index, unsigned int)
+    {
+        PROFILE_SCOPE("Record command buffer");
+
+        const size_t begin = std::min(m_Packets.size(), index * drawsPerBuffer);
+        const size_t end = std::min(m_Packets.size(), begin + drawsPerBuffer);
+
+        CommandBuffer* depthCommands = m_RecordedDepth ? &m_DepthCommandBuffers[index] : nullptr;
+        if (depthCommands)
+            depthCommands->Clear();
+
+        // Depth-only queues have no main pass to record
+        m_CommandBuffers[index].Clear();
+        RecordRange(m_DepthOnly ? nullptr : &m_CommandBuffers[index], depthCommands, m_RecordStats[index], begin, end);
+    });
+
+    const uint32_t culled = m_Stats.Culled;
+    m_Stats = Stats();
+    m_Stats.Culled = culled;
+    for (size_t i = 0; i < bufferCount; i++)
+    {
+        const Stats& stats = m_RecordStats[i];
+        m_Stats.Draws += stats.Draws;
+        m_Stats.Groups += stats.Groups;
+        m_Stats.Instances += stats.Instances;
+        m_Stats.ProgramChanges += stats.ProgramChanges;
+        m_Stats.MaterialChanges += stats.MaterialChanges;
+        m_Stats.MeshChanges += stats.MeshChanges;
+        m_Stats.Commands += m_CommandBuffers[i].GetCommandCount();
+        m_Stats.CommandBytes += m_CommandBuffers[i].GetSize();
+        m_Stats.DepthDraws += stats.DepthDraws;
+        m_Stats.Triangles += stats.Triangles;
+        if (m_RecordedDepth)
+        {
+            m_Stats.Commands += m_DepthCommandBuffers[i].GetCommandCount();
+            m_Stats.CommandBytes += m_DepthCommandBuffers[i].GetSize();
+        }
+    }
+}
+
+RenderQueue::FrameStream RenderQueue::AllocateStream(size_t size, size_t alignment, std::vector<uint8_t>& staging, unsigned int buffer)
+{
+    FrameStream stream;
+    if (size == 0)
+        return stream;
+
+    if (m_Ring)
+    {
+        if (const UploadRing::Allocation allocation = m_Ring->Allocate(size, alignment))
+        {
+            stream.Data = allocation.Data;
+            stream.Buffer = allocation.Buffer;
+            stream.Offset = allocation.Offset;
+            return stream;
+        }
+    }
+
+    staging.resize(size);
+    stream.Data = staging.data();
+    stream.Buffer = buffer;
+    stream.Staged = true;
+    return stream;
+}
+
+void RenderQueue::RecordRange(CommandBuffer* commands, CommandBuffer* depthCommands, Stats& stats, size_t begin, size_t end)
+{
+    // Every buffer starts from unknown state so that it can be replayed on its own, GLState elides the redundant binds
+    constexpr unsigned int None = 0xFFFFFFFF;
+    unsigned int currentProgram = None, currentMaterial = None, currentMesh = None;
+
+    auto* instances = reinterpret_cast<AssetLoader::InstanceData*>(m_Instances.Data);
+    auto* indirect = reinterpret_cast<GLExtensions::DrawElementsIndirectCommand*>(m_Indirect.Data);
+
+    // With multi-draw indirect, the groups sharing program and material are written next to each other in the indirect
+    // buffer and drawn by one call. Base instance selects their instance data, the attributes point at the start of the buffer.
+    size_t batchBegin = begin, batchEnd = begin;
+    auto flush = [&]()
+    {
+        if (commands && batchEnd > batchBegin)
+        {
+            const unsigned int offset = (unsigned int)(m_Indirect.Offset + batchBegin * sizeof(GLExtensions::DrawElementsIndirectCommand));
+            commands->MultiDrawIndirect(m_Indirect.Buffer, GL_TRIANGLES, GL_UNSIGNED_INT, offset, (unsigned int)(batchEnd - batchBegin));
+            stats.Draws++;
+        }
+        batchBegin = batchEnd;
+    };
+
+    if (commands && m_UseMultiDrawIndirect && begin < end)
+    {
+        commands->BindVertexArray(AssetLoader::GetMeshArena().GetVertexArray());
+        commands->BindInstances(m_Instances.Buffer, (unsigned int)m_Instances.Offset);
+    }
+
+    // The prepass has a single program and no textures, it draws from the position stream with the instances of the main pass
+    if (depthCommands && begin < end)
+    {
+        depthCommands->BindProgram(m_DepthShader->GetID());
+        depthCommands->BindVertexArray(AssetLoader::GetMeshArena().GetPositionVertexArray());
+        if (m_UseMultiDrawIndirect)
+            depthCommands->BindInstances(m_Instances.Buffer, (unsigned int)m_Instances.Offset);
+    }
+
+    size_t i = begin;
+    while (i < end)
+    {
+        const Draw& draw = GetDraw(m_Packets[i].Draw);
+        const ProgramBinding& program = m_Programs[draw.Program];
+
+        if (draw.Program != currentProgram || draw.Mesh->GetMaterialID() != currentMaterial)
+            flush();
+
+        if (draw.Program != currentProgram)
+        {
+            if (commands)
+                commands->BindProgram(program.Program->GetID());
+            currentProgram = draw.Program;
+            currentMaterial = None; // Sampler units belong to the program
+            stats.ProgramChanges++;
+        }
+
+        if (draw.Mesh->GetMaterialID() != currentMaterial)
+        {
+            if (commands)
+                draw.Mesh->RecordTextures(*commands, *program.Program);
+            currentMaterial = draw.Mesh->GetMaterialID();
+            stats.MaterialChanges++;
+        }
+
+        if (draw.Mesh->GetID() != currentMesh)
+        {
+            currentMesh = draw.Mesh->GetID();
+            stats.MeshChanges++;
+        }
+
+        // The sort keeps the draws of a mesh together, all of them go in a single instanced draw
+        size_t groupEnd = i;
+        for (; groupEnd < end; groupEnd++)
+        {
+            const Draw& instance = GetDraw(m_Packets[groupEnd].Draw);
+            if (instance.Mesh != draw.Mesh || instance.Program != draw.Program)
+                break;
+
+            instances[groupEnd] = instance.Instance;
+        }
+
+        const unsigned int instanceCount = (unsigned int)(groupEnd - i);
+        const GeometryArena::Range& range = draw.Mesh->GetGeometryRange();
+        if (m_UseMultiDrawIndirect)
+        {
+            indirect[batchEnd++] = { range.IndexCount, instanceCount, range.FirstIndex, (int)range.BaseVertex, (unsigned int)i };
+        }
+        else
+        {
+            const unsigned int instanceOffset = (unsigned int)(m_Instances.Offset + i * sizeof(AssetLoader::InstanceData));
+            if (commands)
+            {
+                draw.Mesh->RecordGeometry(*commands, m_Instances.Buffer, instanceOffset, instanceCount);
+                stats.Draws++;
+            }
+
+            if (depthCommands)
+            {
+                depthCommands->BindInstances(m_Instances.Buffer, instanceOffset);
+                depthCommands->DrawElements(GL_TRIANGLES, range.IndexCount, GL_UNSIGNED_INT, range.FirstIndex * sizeof(uint32_t), instanceCount, range.BaseVertex);
+                stats.DepthDraws++;
+            }
+        }
+
+        stats.Groups++;
+        stats.Instances += instanceCount;
+        stats.Triangles += (uint64_t)(range.IndexCount / 3) * instanceCount * ((commands ? 1 : 0) + (depthCommands ? 1 : 0));
+
+        i = groupEnd;
+    }
+
+    flush();
+
+    // The indirect commands of the range are contiguous, the prepass draws all of them with a single call
+    if (depthCommands && m_UseMultiDrawIndirect && end > begin)
+    {
+        const unsigned int offset = (unsigned int)(m_Indirect.Offset + begin * sizeof(GLExtensions::DrawElementsIndirectCommand));
+        depthCommands->MultiDrawIndirect(m_Indirect.Buffer, GL_TRIANGLES, GL_UNSIGNED_INT, offset, (unsigned int)(batchEnd - begin));
+        stats.DepthDraws++;
+    }
+}
+
+void RenderQueue::Execute()
+{
+    PROFILE_SCOPE("Execute render queue");
+
+    if (!m_DepthOnly)
+        ResolveFragmentQueries();
+
+    // Data written into the ring is already where the draws read it, only the staged streams need a copy
+    if (m_Instances.Staged)
+        UploadFrameData(GL_ARRAY_BUFFER, m_InstanceBuffer, m_InstanceCapacity, m_InstanceStaging.data(), m_InstanceStaging.size());
+    if (m_Indirect.Staged)
+        UploadFrameData(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer, m_IndirectCapacity, m_IndirectStaging.data(), m_IndirectStaging.size());
+
+    // Per-view parameters are uploaded once per program, the recorded buffers only carry per-draw values
+    for (const auto& binding : m_Programs)
+    {
+        binding.Program->Use();
+        binding.Program->Upload(*binding.Parameters);
+    }
+
+    // Shadow maps and other depth targets: the depth commands are the whole pass, drawn with the current state
+    if (m_DepthOnly)
+    {
+        for (size_t i = 0; i < m_RecordedBuffers; i++)
+            m_DepthCommandBuffers[i].Execute();
+        return;
+    }
+
+    if (m_RecordedDepth)
+    {
+        // Depth only: no color writes, and the null fragment shader has nothing to compute
+        GLState::ColorMask(false);
+        GpuProfiler::Instance().Begin("Depth prepass");
+        glBeginQuery(GL_SAMPLES_PASSED, m_FragmentQueries[m_QueryFrame][PrepassQuery]);
+        m_FragmentQueryIssued[m_QueryFrame][PrepassQuery] = true;
+
+        for (size_t i = 0; i < m_RecordedBuffers; i++)
+            m_DepthCommandBuffers[i].Execute();
+
+        glEndQuery(GL_SAMPLES_PASSED);
+        GpuProfiler::Instance().End();
+        GLState::ColorMask(true);
+
+        // The depth buffer already holds the closest surface, only the fragments that match it get shaded.
+        // Both vertex shaders declare gl_Position invariant, so the depths compare equal bit for bit.
+        GLState::DepthFunc(GL_EQUAL);
+        GLState::DepthMask(false);
+    }
+
+    glBeginQuery(GL_SAMPLES_PASSED, m_FragmentQueries[m_QueryFrame][ShadedQuery]);
+    m_FragmentQueryIssued[m_QueryFrame][ShadedQuery] = true;
+
+    for (size_t i = 0; i < m_RecordedBuffers; i++)
+        m_CommandBuffers[i].Execute();
+
+    glEndQuery(GL_SAMPLES_PASSED);
+
+    if (m_RecordedDepth)
+    {
+        GLState::DepthFunc(GL_LESS);
+        GLState::DepthMask(true);
+    }
+}
+
+void RenderQueue::ResolveFragmentQueries()
+{
+    // The oldest set was issued QueryLatency - 1 frames ago, its results are normally available by now
+    m_QueryFrame = (m_QueryFrame + 1) % QueryLatency;
+
+    uint64_t* const results[FragmentQueryCount] = { &m_FragmentStats.Shaded, &m_FragmentStats.Prepass };
+    for (int query = 0; query < FragmentQueryCount; query++)
+    {
+        if (!m_FragmentQueryIssued[m_QueryFrame][query])
+        {
+            *results[query] = 0;
+            continue;
+        }
+
+        m_FragmentQueryIssued[m_QueryFrame][query] = false;
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_FragmentQueries[m_QueryFrame][query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 samples = 0;
+        glGetQueryObjectui64v(m_FragmentQueries[m_QueryFrame][query], GL_QUERY_RESULT, &samples);
+        *results[query] = samples;
+    }
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "GLExtensions.h"
+#include "Mesh.h"
+#include "ParameterBlock.h"
+#include "Shader.h"
+#include "UploadRing.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+enum class RenderPass : uint8_t
+{
+    Opaque = 0,
+    Count
+};
+
+// 64-bit draw sort key, most significant bits first:
+//   opaque      : pass (4) | translucent = 0 (1) | program (11) | material (16) | mesh (16) | depth (16)
+//   translucent : pass (4) | translucent = 1 (1) | inverted depth (16) | program (11) | material (16) | mesh (16)
+// Opaque draws are grouped by state first and sorted front to back inside each group for early-z,
+// translucent draws are sorted back to front.
+namespace SortKey
+{
+    uint64_t Opaque(RenderPass pass, uint16_t program, uint16_t material, uint16_t mesh, float depth);
+    uint64_t Translucent(RenderPass pass, uint16_t program, uint16_t material, uint16_t mesh, float depth);
+
+    uint16_t QuantizeDepth(float depth); // depth is normalized to [0, 1]
+}
+
+// 12 bytes instead of 16: the sort moves every packet once per digit, the padding would be a third of the traffic
+#pragma pack(push, 4)
+struct DrawPacket
+{
+    uint64_t Key;
+    uint32_t Draw; // Index of the draw data inside the queue
+};
+#pragma pack(pop)
+
+// Sorts 'packets' by key (stable, LSD radix sort on 11 bit digits), 'scratch' is resized as needed
+void RadixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+// Collects the draws of a frame, sorts them to minimize program, texture and vertex array changes and executes them in one pass.
+// The CPU side of the frame is spread across the worker pool: partitions of the scene are culled and submitted in parallel,
+// then the sorted draws are recorded into one command buffer per worker and replayed in order on the GL thread.
+// Every draw is an instance: consecutive draws of the same mesh with the same program become a single instanced draw call,
+// and when multi-draw indirect is available, consecutive groups sharing program and material become a single API call.
+// Instance data and indirect commands are written by the workers straight into the upload ring when one is given.
+// With a depth prepass, the draws are first replayed depth-only from the mesh arena's position stream, reusing the
+// same instance data and indirect commands, and the main pass then only shades the fragments that end up visible.
+class RenderQueue
+{
+public:
+    struct Stats
+    {
+        uint32_t Draws = 0;     // Draw API calls
+        uint32_t Groups = 0;    // Instanced draws of one mesh, several of them per API call with multi-draw indirect
+        uint32_t Instances = 0; // Draws submitted and not culled
+        uint32_t Culled = 0;
+        uint32_t ProgramChanges = 0;
+        uint32_t MaterialChanges = 0;
+        uint32_t MeshChanges = 0;
+        uint32_t Commands = 0;
+        size_t CommandBytes = 0;
+        uint32_t DepthDraws = 0; // Draw API calls of the depth prepass
+        uint64_t Triangles = 0;  // Of the instances drawn, once per pass that draws them
+    };
+
+    // Fragments that passed the depth test, counted with occlusion queries read back a few frames later
+    struct FragmentStats
+    {
+        uint64_t Shaded = 0;  // Main pass, the fragments its programs actually ran for
+        uint64_t Prepass = 0; // Depth prepass, roughly what the main pass shades without it (0 when it is off)
+    };
+
+    using ProgramHandle = uint16_t;
+
+    // Without a ring (or when the ring is full) the frame data is staged in memory and copied into the queue's own buffers
+    explicit RenderQueue(UploadRing* ring = nullptr);
+    ~RenderQueue();
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // The parameter block holds the per-view values of the program, per-draw values come from the instance attributes
+    // (the vertex shader has to read them, see InstancedVertex.glsl)
+    ProgramHandle RegisterProgram(const Shader& shader, ParameterBlock& parameters);
+
+    // Each partition can be submitted from its own thread, at most MaxPartitions
+    void Begin(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, unsigned int partitionCount = 1);
+    // 'normal' is the normal matrix of 'model' (see TransformStore), without it the queue computes one per draw
+    void Submit(unsigned int partition, const AssetLoader::Mesh& mesh, ProgramHandle program, const glm::mat4& model, const glm::mat3x4& normal, const glm::vec4& color = glm::vec4(1.0f), const glm::vec4& custom = glm::vec4(0.0f), RenderPass pass = RenderPass::Opaque, bool translucent = false);
+    void Submit(unsigned int partition, const AssetLoader::Mesh& mesh, ProgramHandle program, const glm::mat4& model, const glm::vec4& color = glm::vec4(1.0f), const glm::vec4& custom = glm::vec4(0.0f), RenderPass pass = RenderPass::Opaque, bool translucent = false);
+    void Submit(const AssetLoader::Mesh& mesh, ProgramHandle program, const glm::mat4& model, const glm::vec4& color = glm::vec4(1.0f), const glm::vec4& custom = glm::vec4(0.0f), RenderPass pass = RenderPass::Opaque, bool translucent = false)
+    {
+        Submit(0, mesh, program, model, color, custom, pass, translucent);
+    }
+
+    // Bounding sphere against the frustum of the view of Begin(), Submit() runs the same test on every draw
+    bool IsVisible(const glm::vec3& center, float radius) const;
+
+    // Position-only program (e.g. DepthVertex.glsl with NullFragment.glsl) for the depth prepass, nullptr turns it off.
+    // Applies from the next Record(), the main pass then runs with GL_EQUAL and without depth writes.
+    // Every draw of the queue goes through it, it is meant for queues of opaque draws.
+    void SetDepthPrepass(const Shader* shader) { m_DepthShader = shader; m_DepthOnly = false; }
+    const Shader* GetDepthPrepass() const { return m_DepthShader; }
+
+    // Queues that only fill a depth target (shadow maps) record and replay the depth commands of 'shader' and nothing else.
+    // The programs of the submitted draws only matter for the sort, their parameter blocks are still uploaded.
+    void SetDepthOnly(const Shader* shader) { m_DepthShader = shader; m_DepthOnly = shader != nullptr; }
+    bool IsDepthOnly() const { return m_DepthOnly; }
+
+    // Merges the partitions and sorts their draws
+    void Sort();
+    // Records the sorted draws into command buffers, in parallel, without touching GL (the ring must be between BeginFrame() and Flush())
+    void Record();
+    // Uploads the staged frame data and the per-view parameters and replays the command buffers, GL thread only
+    void Execute();
+
+    unsigned int GetPartitionCount() const { return (unsigned int)m_Partitions.size(); }
+    const std::vector<DrawPacket>& GetPackets() const { return m_Packets; }
+    const std::vector<CommandBuffer>& GetCommandBuffers() const { return m_CommandBuffers; }
+    const Stats& GetStats() const { return m_Stats; }
+    const FragmentStats& GetFragmentStats() const { return m_FragmentStats; }
+
+    static constexpr unsigned int MaxPartitions = 256;
+private:
+    struct ProgramBinding
+    {
+        const Shader* Program;
+        ParameterBlock* Parameters;
+    };
+
+    struct Draw
+    {
+        const AssetLoader::Mesh* Mesh;
+        ProgramHandle Program;
+        AssetLoader::InstanceData Instance;
+    };
+
+    // Where the instance data or the indirect commands of the frame go: a region of the upload ring,
+    // or the staging vector when the ring has no room left
+    struct FrameStream
+    {
+        uint8_t* Data = nullptr;
+        unsigned int Buffer = 0;
+        size_t Offset = 0; // Of the first element in the buffer, in bytes
+        bool Staged = false;
+    };
+
+    struct Partition
+    {
+        std::vector<Draw> Draws;
+        std::vector<DrawPacket> Packets;
+        uint32_t Culled = 0;
+    };
+
+    // DrawPacket::Draw holds the partition in its top bits and the index of the draw inside the partition below
+    static constexpr unsigned int PartitionShift = 24;
+
+    const Draw& GetDraw(uint32_t packetDraw) const
+    {
+        return m_Partitions[packetDraw >> PartitionShift].Draws[packetDraw & ((1u << PartitionShift) - 1)];
+    }
+
+    // Records the main pass of the sorted draws in [begin, end) into 'commands' and their depth prepass into 'depthCommands', either can be null
+    void RecordRange(CommandBuffer* commands, CommandBuffer* depthCommands, Stats& stats, size_t begin, size_t end);
+
+    // Occlusion queries of the passes, the oldest set is read back at the start of Execute()
+    enum FragmentQuery { ShadedQuery = 0, PrepassQuery, FragmentQueryCount };
+    void ResolveFragmentQueries();
+
+    FrameStream AllocateStream(size_t size, size_t alignment, std::vector<uint8_t>& staging, unsigned int buffer);
+private:
+    UploadRing* m_Ring;
+
+    std::vector<ProgramBinding> m_Programs;
+    std::vector<Partition> m_Partitions;
+    std::vector<DrawPacket> m_Packets, m_Scratch;
+
+    // Instance data of the frame in sorted draw order, a group of instances is a contiguous range of it
+    FrameStream m_Instances;
+    std::vector<uint8_t> m_InstanceStaging;
+    unsigned int m_InstanceBuffer = 0;
+    size_t m_InstanceCapacity = 0; // Size of the GL buffer in bytes
+
+    // Multi-draw indirect commands, the commands of a range of draws start at the index of its first draw
+    FrameStream m_Indirect;
+    std::vector<uint8_t> m_IndirectStaging;
+    unsigned int m_IndirectBuffer = 0;
+    size_t m_IndirectCapacity = 0;
+    bool m_UseMultiDrawIndirect = false;
+
+    std::vector<CommandBuffer> m_CommandBuffers;
+    std::vector<Stats> m_RecordStats;
+    size_t m_RecordedBuffers = 0;
+
+    // Depth prepass, one command buffer per main pass command buffer
+    const Shader* m_DepthShader = nullptr;
+    bool m_DepthOnly = false;
+    std::vector<CommandBuffer> m_DepthCommandBuffers;
+    bool m_RecordedDepth = false;
+
+    static constexpr unsigned int QueryLatency = 4;
+    unsigned int m_FragmentQueries[QueryLatency][FragmentQueryCount] = {};
+    bool m_FragmentQueryIssued[QueryLatency][FragmentQueryCount] = {};
+    unsigned int m_QueryFrame = 0;
+    FragmentStats m_FragmentStats;
+
+    glm::mat4 m_View{ 1.0f };
+    glm::vec4 m_FrustumPlanes[6];
+    float m_NearPlane = 0.1f, m_FarPlane = 100.0f;
+
+    Stats m_Stats;
+};
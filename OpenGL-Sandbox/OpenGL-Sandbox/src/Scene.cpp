@@ -0,0 +1,135 @@
+#include "Scene.h"
+#include "CpuProfiler.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "ShadowCascades.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+void Scene::Reserve(size_t count)
+{
+    m_Registry.Reserve(count);
+    m_Registry.GetPool<TransformComponent>().Reserve(count);
+    m_Registry.GetPool<RenderableComponent>().Reserve(count);
+    m_Registry.GetPool<BoundsComponent>().Reserve(count);
+    m_Transforms.Reserve(count);
+}
+
+Scene::Entity Scene::CreateModel(const AssetLoader::Model& model, const glm::vec3& position, const glm::vec3& scale, bool isStatic)
+{
+    const Entity entity = m_Registry.Create();
+    m_Registry.Add<TransformComponent>(entity, m_Transforms.Create(position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), scale));
+    m_Registry.Add<RenderableComponent>(entity, &model, nullptr, glm::vec4(1.0f), true, isStatic);
+    m_Registry.Add<BoundsComponent>(entity, model.GetBoundsCenter(), model.GetBoundsRadius());
+    return entity;
+}
+
+Scene::Entity Scene::CreateMesh(const AssetLoader::Mesh& mesh, const glm::vec3& position, const glm::vec3& scale, const glm::vec4& color, bool lit, bool isStatic)
+{
+    const Entity entity = m_Registry.Create();
+    m_Registry.Add<TransformComponent>(entity, m_Transforms.Create(position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), scale));
+    m_Registry.Add<RenderableComponent>(entity, nullptr, &mesh, color, lit, isStatic);
+    m_Registry.Add<BoundsComponent>(entity, mesh.GetBoundsCenter(), mesh.GetBoundsRadius());
+    return entity;
+}
+
+Scene::Entity Scene::CreatePointLight(const glm::vec3& position, const PointLightComponent& light)
+{
+    const Entity entity = m_Registry.Create();
+    m_Registry.Add<TransformComponent>(entity, m_Transforms.Create(position));
+    m_Registry.Add<PointLightComponent>(entity, light);
+    return entity;
+}
+
+void Scene::Destroy(Entity entity)
+{
+    if (!m_Registry.IsAlive(entity))
+        return;
+
+    if (const TransformComponent* transform = m_Registry.TryGet<TransformComponent>(entity))
+        m_Transforms.Destroy(transform->Handle);
+    m_Registry.Destroy(entity);
+}
+
+void Scene::SetPosition(Entity entity, const glm::vec3& position)
+{
+    m_Transforms.SetPosition(m_Registry.Get<TransformComponent>(entity).Handle, position);
+}
+
+void Scene::Update(WorkerPool& workers)
+{
+    PROFILE_SCOPE("Update scene");
+
+    m_Transforms.Update(nullptr, &workers);
+
+    // World bounding spheres: the local center through the world matrix, the radius by the largest scale
+    m_Registry.ParallelEach<BoundsComponent, TransformComponent>(workers, [this](Entity, BoundsComponent& bounds, const TransformComponent& transform, unsigned int)
+    {
+        const glm::vec3 scale = glm::abs(m_Transforms.GetScale(transform.Handle));
+        bounds.Center = glm::vec3(m_Transforms.GetWorld(transform.Handle) * glm::vec4(bounds.LocalCenter, 1.0f));
+        bounds.Radius = bounds.LocalRadius * std::max(scale.x, std::max(scale.y, scale.z));
+    });
+}
+
+void Scene::GatherPointLights(std::vector<ClusteredLights::PointLight>& lights)
+{
+    lights.clear();
+    lights.reserve(m_Registry.GetPool<PointLightComponent>().GetSize());
+    m_Registry.Each<PointLightComponent, TransformComponent>([&](Entity, const PointLightComponent& light, const TransformComponent& transform)
+    {
+        lights.push_back({ m_Transforms.GetPosition(transform.Handle), light.Radius, light.Color, light.Intensity });
+    });
+}
+
+void Scene::Submit(RenderQueue& queue, ShadowCascades& shadows, RenderQueue::ProgramHandle litProgram, RenderQueue::ProgramHandle unlitProgram, WorkerPool& workers)
+{
+    // Every renderable has a transform and bounds, the dense arrays of the renderables drive the loop
+    EntityRegistry::Pool<RenderableComponent>& renderables = m_Registry.GetPool<RenderableComponent>();
+    EntityRegistry::Pool<TransformComponent>& transforms = m_Registry.GetPool<TransformComponent>();
+    EntityRegistry::Pool<BoundsComponent>& bounds = m_Registry.GetPool<BoundsComponent>();
+    const std::vector<Entity>& entities = renderables.GetEntities();
+    const std::vector<RenderableComponent>& components = renderables.GetComponents();
+
+    const unsigned int partitionCount = queue.GetPartitionCount();
+    const size_t perPartition = (entities.size() + partitionCount - 1) / partitionCount;
+    workers.ParallelFor(partitionCount, [&](unsigned int partition, unsigned int)
+    {
+        PROFILE_SCOPE("Cull and submit");
+
+        const size_t begin = std::min(entities.size(), partition * perPartition);
+        const size_t end = std::min(entities.size(), begin + perPartition);
+        for (size_t i = begin; i < end; i++)
+        {
+            const RenderableComponent& renderable = components[i];
+            const BoundsComponent& sphere = bounds.Get(entities[i]);
+            const TransformStore::Handle transform = transforms.Get(entities[i]).Handle;
+            const glm::mat4& world = m_Transforms.GetWorld(transform);
+
+            // Whole objects out of the view skip the per-mesh tests of the queue
+            if (queue.IsVisible(sphere.Center, sphere.Radius))
+            {
+                const RenderQueue::ProgramHandle program = renderable.Lit ? litProgram : unlitProgram;
+                if (renderable.Model)
+                    renderable.Model->Submit(queue, partition, program, world, m_Transforms.GetNormal(transform));
+                else
+                    queue.Submit(partition, *renderable.Mesh, program, world, m_Transforms.GetNormal(transform), renderable.Color);
+            }
+
+            for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+            {
+                if (!shadows.Accepts(cascade, renderable.Static))
+                    continue;
+
+                RenderQueue& cascadeQueue = shadows.GetQueue(cascade);
+                if (!cascadeQueue.IsVisible(sphere.Center, sphere.Radius))
+                    continue;
+
+                if (renderable.Model)
+                    renderable.Model->Submit(cascadeQueue, partition, shadows.GetProgram(), world, glm::mat3x4(1.0f)); // Depth only, no normals
+                else
+                    cascadeQueue.Submit(partition, *renderable.Mesh, shadows.GetProgram(), world, glm::mat3x4(1.0f));
+            }
+        }
+    });
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ClusteredLights.h"
+#include "EntityRegistry.h"
+#include "RenderQueue.h"
+#include "TransformStore.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace AssetLoader
+{
+    class Mesh;
+    class Model;
+}
+class ShadowCascades;
+class WorkerPool;
+
+// Components of the scene entities
+struct TransformComponent
+{
+    TransformStore::Handle Handle; // In the scene's transform store
+};
+
+struct RenderableComponent
+{
+    const AssetLoader::Model* Model = nullptr; // A whole model,
+    const AssetLoader::Mesh* Mesh = nullptr;   // or a single mesh
+    glm::vec4 Color{ 1.0f };                   // Instance color
+    bool Lit = true;                           // Lit program, otherwise the flat color one
+    bool Static = true;                        // Never moves, it may be drawn into the cached shadow cascades
+};
+
+// Bounding sphere of a renderable, in model space and in world space as of the last Scene::Update()
+struct BoundsComponent
+{
+    glm::vec3 LocalCenter{ 0.0f };
+    float LocalRadius = 0.0f;
+    glm::vec3 Center{ 0.0f };
+    float Radius = 0.0f;
+};
+
+// The position comes from the transform
+struct PointLightComponent
+{
+    glm::vec3 Color{ 1.0f };
+    float Radius = 50.0f;
+    float Intensity = 20.0f;
+};
+
+// Objects of the scene as entities, their transforms in a TransformStore and their other components in the registry.
+// The systems run once per frame on the thread that renders, spreading their work across the worker pool.
+class Scene
+{
+public:
+    using Entity = EntityRegistry::Entity;
+
+    void Reserve(size_t count);
+
+    Entity CreateModel(const AssetLoader::Model& model, const glm::vec3& position, const glm::vec3& scale = glm::vec3(1.0f), bool isStatic = true);
+    Entity CreateMesh(const AssetLoader::Mesh& mesh, const glm::vec3& position, const glm::vec3& scale, const glm::vec4& color, bool lit, bool isStatic = true);
+    Entity CreatePointLight(const glm::vec3& position, const PointLightComponent& light);
+    void Destroy(Entity entity);
+
+    void SetPosition(Entity entity, const glm::vec3& position);
+
+    EntityRegistry& GetRegistry() { return m_Registry; }
+    TransformStore& GetTransforms() { return m_Transforms; }
+
+    // Transform system: world and normal matrices of every transform, then the world bounds of the renderables
+    void Update(WorkerPool& workers);
+
+    // Light gathering: the point lights in world space, for the light assignment of the clusters and the deferred volumes
+    void GatherPointLights(std::vector<ClusteredLights::PointLight>& lights);
+
+    // Draw packet generation: the renderables in the view frustum of 'queue' go to it, with the lit or unlit program, and
+    // the shadow casters to the cascades that take them. Each worker submits a slice of the renderables to its own
+    // partition of the queues (RenderQueue::Begin() and ShadowCascades::Begin() come first).
+    void Submit(RenderQueue& queue, ShadowCascades& shadows, RenderQueue::ProgramHandle litProgram, RenderQueue::ProgramHandle unlitProgram, WorkerPool& workers);
+private:
+    EntityRegistry m_Registry;
+    TransformStore m_Transforms;
+};
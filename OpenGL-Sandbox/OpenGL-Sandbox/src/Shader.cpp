@@ -1,109 +1,214 @@
 #include "Shader.h"
+#include "CpuProfiler.h"
+#include "GLState.h"
+#include "ShaderManager.h"
 
 #include <glad/glad.h>
 
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <sstream>
 
-namespace File
+namespace
 {
-    static std::string Load(const std::string& filePath)
+    // Included files are compiled as GLSL source strings N > 0, print which file each number refers to
+    void PrintSourceFiles(const ShaderSource& source)
     {
-        std::ifstream fileStream(filePath, std::ifstream::in);
-
-        if (!fileStream.is_open())
-        {
-            std::cerr << "Failed to open file: " << filePath << std::endl;
-            return {};
-        }
-
-        std::string line;
-        std::stringstream outStream;
-        while (std::getline(fileStream, line))
-        {
-            outStream << line << std::endl;
-        }
-
-        fileStream.close();
-
-        return outStream.str();
+        for (size_t i = 0; i < source.Dependencies.size(); i++)
+            std::cerr << "    Source string " << i << ": " << source.Dependencies[i] << std::endl;
     }
 }
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
+    : m_ID(0), m_VertexPath(vertexPath), m_FragmentPath(fragmentPath)
 {
-    std::string vertexSource = File::Load(vertexPath);
-    std::string fragmentSource = File::Load(fragmentPath);
+    ShaderSource vertexSource = ShaderManager::Instance().Load(m_VertexPath);
+    ShaderSource fragmentSource = ShaderManager::Instance().Load(m_FragmentPath);
     m_ID = CreateShader(vertexSource, fragmentSource);
+    m_Layout = ShaderLayout::Reflect(m_ID);
+
+    // Track every file both stages were built from, editing any of them rebuilds this program
+    std::vector<std::string> dependencies = vertexSource.Dependencies;
+    dependencies.insert(dependencies.end(), fragmentSource.Dependencies.begin(), fragmentSource.Dependencies.end());
+    ShaderManager::Instance().Register(this, dependencies);
 }
 
 Shader::~Shader()
 {
+    ShaderManager::Instance().Unregister(this);
+    glDeleteProgram(m_ID);
+    GLState::OnProgramDeleted(m_ID);
+}
+
+bool Shader::Reload(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+    unsigned int program = CreateShader(vertexSource, fragmentSource);
+    if (program == 0)
+        return false;
+
     glDeleteProgram(m_ID);
+    GLState::OnProgramDeleted(m_ID);
+    m_ID = program;
+    m_Layout = ShaderLayout::Reflect(m_ID);
+
+#if SHADER_PARAMETER_VALIDATION
+    m_ReportedMissing.clear();
+#endif
+
+    return true;
 }
 
 void Shader::Use() const
 {
-    glUseProgram(m_ID);
+    GLState::UseProgram(m_ID);
 }
 
 void Shader::SetUniformBool(const std::string& name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(m_ID, name.c_str()), (int)value);
+    int location = GetUniformLocation(name);
+    if (location == -1)
+        return;
+
+    glUniform1i(location, (int)value);
 }
 
 void Shader::SetUniformInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(m_ID, name.c_str()), value);
+    int location = GetUniformLocation(name);
+    if (location == -1)
+        return;
+
+    glUniform1i(location, value);
 }
 
 void Shader::SetUniformFloat(const std::string& name, float value) const
 {
-    glUniform1f(glGetUniformLocation(m_ID, name.c_str()), value);
+    int location = GetUniformLocation(name);
+    if (location == -1)
+        return;
+
+    glUniform1f(location, value);
 }
 
 void Shader::SetUniform3f(const std::string& name, float v0, float v1, float v2) const
 {
-    glUniform3f(glGetUniformLocation(m_ID, name.c_str()), v0, v1, v2);
+    int location = GetUniformLocation(name);
+    if (location == -1)
+        return;
+
+    glUniform3f(location, v0, v1, v2);
 }
 
 void Shader::SetUniform4f(const std::string& name, float v0, float v1, float v2, float v3) const
 {
-    glUniform4f(glGetUniformLocation(m_ID, name.c_str()), v0, v1, v2, v3);
+    int location = GetUniformLocation(name);
+    if (location == -1)
+        return;
+
+    glUniform4f(location, v0, v1, v2, v3);
 }
 
 void Shader::SetVector2f(const std::string& name, const glm::vec2& value) const
 {
-	glUniform2fv(glGetUniformLocation(m_ID, name.c_str()), 1, &value[0]);
+	int location = GetUniformLocation(name);
+	if (location == -1)
+		return;
+
+	glUniform2fv(location, 1, &value[0]);
 }
 
 void Shader::SetVector3f(const std::string& name, const glm::vec3& value) const
 {
-	glUniform3fv(glGetUniformLocation(m_ID, name.c_str()), 1, &value[0]);
+	int location = GetUniformLocation(name);
+	if (location == -1)
+		return;
+
+	glUniform3fv(location, 1, &value[0]);
 }
 
 void Shader::SetVector4f(const std::string& name, const glm::vec4& value) const
 {
-	glUniform4fv(glGetUniformLocation(m_ID, name.c_str()), 1, &value[0]);
+	int location = GetUniformLocation(name);
+	if (location == -1)
+		return;
+
+	glUniform4fv(location, 1, &value[0]);
 }
 
 void Shader::SetUniformMat4f(const std::string& name, const float* value) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(m_ID, name.c_str()), 1, GL_FALSE, value);
+	int location = GetUniformLocation(name);
+	if (location == -1)
+		return;
+
+	glUniformMatrix4fv(location, 1, GL_FALSE, value);
 }
 
 void Shader::SetMatrix4f(const std::string& name, const glm::mat4& matrix) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(m_ID, name.c_str()), 1, GL_FALSE, &matrix[0][0]);
+	int location = GetUniformLocation(name);
+	if (location == -1)
+		return;
+
+	glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]);
 }
 
-unsigned int Shader::CreateShader(const std::string& vertexSource, const std::string& fragmentSource)
+int Shader::GetSamplerUnit(const std::string& name) const
 {
+    int index = m_Layout->Find(name);
+    return index >= 0 ? m_Layout->GetParameter(index).SamplerUnit : -1;
+}
+
+void Shader::Upload(ParameterBlock& block) const
+{
+    if (block.GetLayout() != m_Layout)
+        block.Rebind(m_Layout);
+
+#if SHADER_PARAMETER_VALIDATION
+    block.ReportUnset(m_FragmentPath);
+#endif
+
+    if (!block.HasDirty())
+        return;
+
+    const uint8_t* data = block.GetData();
+    const auto& parameters = m_Layout->GetParameters();
+    for (size_t i = 0; i < parameters.size(); i++)
+    {
+        if (!block.IsDirty((int)i))
+            continue;
+
+        const ShaderParameter& parameter = parameters[i];
+        ShaderLayout::UploadValue(parameter.Type, parameter.Location, parameter.Count, data + parameter.Offset);
+    }
+
+    block.ClearDirty();
+}
+
+int Shader::GetUniformLocation(const std::string& name) const
+{
+    // Resolved against the reflected layout, names the program does not use never reach the driver
+    int index = m_Layout->Find(name);
+    if (index >= 0)
+        return m_Layout->GetParameter(index).Location;
+
+#if SHADER_PARAMETER_VALIDATION
+    if (m_ReportedMissing.insert(name).second)
+        std::cerr << "[WARNING]: Shader parameter '" << name << "' does not exist in '" << m_FragmentPath << "'" << std::endl;
+#endif
+
+    return -1;
+}
+
+unsigned int Shader::CreateShader(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+    PROFILE_SCOPE("Compile shader");
+
+    if (vertexSource.Code.empty() || fragmentSource.Code.empty())
+        return 0;
+
     // Vertex shader
-    const char* vertexStr = vertexSource.c_str();
-    const char* fragmentStr = fragmentSource.c_str();
+    const char* vertexStr = vertexSource.Code.c_str();
+    const char* fragmentStr = fragmentSource.Code.c_str();
 
     unsigned int vertexShader, fragmentShader;
     vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -112,13 +217,15 @@ unsigned int Shader::CreateShader(const std::string& vertexSource, const std::st
     glCompileShader(vertexShader);
 
     // Vertex shader compilation errors
-    int success;
+    int success, compiled = 1;
     char infoLog[512];
     glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
         glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
         std::cerr << "[ERROR]: Vertex shader compilation failed: " << infoLog << std::endl;
+        PrintSourceFiles(vertexSource);
+        compiled = 0;
     }
 
     // Fragment shader
@@ -133,6 +240,8 @@ unsigned int Shader::CreateShader(const std::string& vertexSource, const std::st
     {
         glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
         std::cerr << "[ERROR]: Fragment shader compilation failed: " << infoLog << std::endl;
+        PrintSourceFiles(fragmentSource);
+        compiled = 0;
     }
 
     // Link shaders together
@@ -154,6 +263,12 @@ unsigned int Shader::CreateShader(const std::string& vertexSource, const std::st
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    if (!success || !compiled)
+    {
+        glDeleteProgram(shaderProgram);
+        return 0;
+    }
+
     return shaderProgram;
 }
 
@@ -1,8 +1,14 @@
 #pragma once
 
+#include "ParameterBlock.h"
+#include "ShaderLayout.h"
+#include "ShaderPreprocessor.h"
+
 #include <glm/glm.hpp>
 
+#include <memory>
 #include <string>
+#include <unordered_set>
 
 class Shader
 {
@@ -10,7 +16,24 @@ public:
     Shader(const char* vertexPath, const char* fragmentPath);
     ~Shader();
 
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     void Use() const;
+    unsigned int GetID() const { return m_ID; }
+
+    // Rebuilds the program from already preprocessed sources, the current program is kept if anything fails
+    bool Reload(const ShaderSource& vertexSource, const ShaderSource& fragmentSource);
+
+    const std::string& GetVertexPath() const { return m_VertexPath; }
+    const std::string& GetFragmentPath() const { return m_FragmentPath; }
+
+    // Parameters reflected from the currently linked program
+    const std::shared_ptr<const ShaderLayout>& GetLayout() const { return m_Layout; }
+    int GetSamplerUnit(const std::string& name) const;
+
+    // Sends every parameter of the block that changed since its last upload
+    void Upload(ParameterBlock& block) const;
 
     void SetUniformBool(const std::string& name, bool value) const;
     void SetUniformInt(const std::string& name, int value) const;
@@ -26,7 +49,14 @@ public:
 	void SetUniformMat4f(const std::string& name, const float* value) const;
 	void SetMatrix4f(const std::string& name, const glm::mat4& matrix) const;
 private:
-    unsigned int CreateShader(const std::string& vertexSource, const std::string& fragmentSource);
+    unsigned int CreateShader(const ShaderSource& vertexSource, const ShaderSource& fragmentSource);
+    int GetUniformLocation(const std::string& name) const;
 private:
     unsigned int m_ID;
+    std::string m_VertexPath, m_FragmentPath;
+    std::shared_ptr<const ShaderLayout> m_Layout;
+
+#if SHADER_PARAMETER_VALIDATION
+    mutable std::unordered_set<std::string> m_ReportedMissing;
+#endif
 };
\ No newline at end of file
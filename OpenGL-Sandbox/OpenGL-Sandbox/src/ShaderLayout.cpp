@@ -0,0 +1,219 @@
+#include "ShaderLayout.h"
+#include "GLState.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+std::shared_ptr<const ShaderLayout> ShaderLayout::Reflect(unsigned int program)
+{
+    auto layout = std::make_shared<ShaderLayout>();
+    std::fill_n(layout->m_MaterialUnits, (size_t)MaterialSampler::Count, -1);
+    if (program == 0)
+        return layout;
+
+    GLState::UseProgram(program);
+
+    int uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+    int nextSamplerUnit = 0;
+
+    for (int i = 0; i < uniformCount; i++)
+    {
+        int count = 0, nameLength = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, (GLsizei)nameBuffer.size(), &nameLength, &count, &type, nameBuffer.data());
+
+        // Members of uniform blocks are backed by buffers, not by the packed parameter data
+        const GLuint index = (GLuint)i;
+        int blockIndex = -1;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+        if (blockIndex >= 0)
+            continue;
+
+        ShaderParameter parameter;
+        parameter.Name.assign(nameBuffer.data(), nameLength);
+        parameter.Type = type;
+        parameter.Count = count;
+        parameter.Location = glGetUniformLocation(program, parameter.Name.c_str());
+        parameter.Offset = layout->m_DataSize;
+        parameter.Size = GetTypeSize(type) * count;
+        parameter.SamplerUnit = -1;
+
+        // Samplers get a fixed texture unit for the lifetime of the program
+        if (IsSampler(type))
+        {
+            std::vector<int> units(count);
+            for (int element = 0; element < count; element++)
+                units[element] = nextSamplerUnit++;
+
+            parameter.SamplerUnit = units[0];
+            glUniform1iv(parameter.Location, count, units.data());
+        }
+
+        layout->m_DataSize += parameter.Size;
+
+        // Arrays are reported as "name[0]", also make them reachable through their plain name
+        const int parameterIndex = (int)layout->m_Parameters.size();
+        layout->m_Lookup[parameter.Name] = parameterIndex;
+        const size_t bracket = parameter.Name.size() > 3 ? parameter.Name.rfind("[0]") : std::string::npos;
+        if (bracket != std::string::npos && bracket == parameter.Name.size() - 3)
+            layout->m_Lookup[parameter.Name.substr(0, bracket)] = parameterIndex;
+
+        layout->m_Parameters.push_back(std::move(parameter));
+    }
+
+    // Material values, so that binding a material does not build any name
+    for (size_t sampler = 0; sampler < (size_t)MaterialSampler::Count; sampler++)
+    {
+        const size_t perType = (size_t)MaterialSampler::Specular1;
+        const std::string name = std::string(sampler < perType ? "u_Material.texture_diffuse" : "u_Material.texture_specular") + std::to_string(sampler % perType + 1);
+        const int index = layout->Find(name);
+        layout->m_MaterialUnits[sampler] = index >= 0 ? layout->m_Parameters[index].SamplerUnit : -1;
+    }
+    const int shininess = layout->Find("u_Material.shininess");
+    layout->m_MaterialShininess = shininess >= 0 ? layout->m_Parameters[shininess].Location : -1;
+
+    int blockCount = 0, maxBlockNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+    nameBuffer.resize(std::max(maxBlockNameLength, 1));
+
+    for (int i = 0; i < blockCount; i++)
+    {
+        int nameLength = 0, size = 0;
+        glGetActiveUniformBlockName(program, i, (GLsizei)nameBuffer.size(), &nameLength, nameBuffer.data());
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+
+        ShaderBlock block;
+        block.Name.assign(nameBuffer.data(), nameLength);
+        block.Index = (unsigned int)i;
+        block.Binding = GetBlockBinding(block.Name);
+        block.Size = (unsigned int)size;
+
+        glUniformBlockBinding(program, block.Index, block.Binding);
+        layout->m_Blocks.push_back(std::move(block));
+    }
+
+    return layout;
+}
+
+unsigned int ShaderLayout::GetBlockBinding(const std::string& blockName)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, unsigned int> bindings;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = bindings.find(blockName);
+    if (it != bindings.end())
+        return it->second;
+
+    const unsigned int binding = (unsigned int)bindings.size();
+    bindings[blockName] = binding;
+    return binding;
+}
+
+int ShaderLayout::Find(const std::string& name) const
+{
+    auto it = m_Lookup.find(name);
+    return it != m_Lookup.end() ? it->second : -1;
+}
+
+bool ShaderLayout::IsSampler(unsigned int type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW:
+    case GL_SAMPLER_2D_SHADOW:
+    case GL_SAMPLER_1D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_1D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE:
+    case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_BUFFER:
+    case GL_SAMPLER_2D_RECT:
+    case GL_SAMPLER_2D_RECT_SHADOW:
+    case GL_INT_SAMPLER_1D:
+    case GL_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_3D:
+    case GL_INT_SAMPLER_CUBE:
+    case GL_INT_SAMPLER_1D_ARRAY:
+    case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_1D:
+    case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_UNSIGNED_INT_SAMPLER_3D:
+    case GL_UNSIGNED_INT_SAMPLER_CUBE:
+    case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+unsigned int ShaderLayout::GetTypeSize(unsigned int type)
+{
+    switch (type)
+    {
+    case GL_FLOAT:              return 4;
+    case GL_FLOAT_VEC2:         return 4 * 2;
+    case GL_FLOAT_VEC3:         return 4 * 3;
+    case GL_FLOAT_VEC4:         return 4 * 4;
+    case GL_INT:                return 4;
+    case GL_INT_VEC2:           return 4 * 2;
+    case GL_INT_VEC3:           return 4 * 3;
+    case GL_INT_VEC4:           return 4 * 4;
+    case GL_UNSIGNED_INT:       return 4;
+    case GL_UNSIGNED_INT_VEC2:  return 4 * 2;
+    case GL_UNSIGNED_INT_VEC3:  return 4 * 3;
+    case GL_UNSIGNED_INT_VEC4:  return 4 * 4;
+    case GL_BOOL:               return 4;
+    case GL_BOOL_VEC2:          return 4 * 2;
+    case GL_BOOL_VEC3:          return 4 * 3;
+    case GL_BOOL_VEC4:          return 4 * 4;
+    case GL_FLOAT_MAT2:         return 4 * 4;
+    case GL_FLOAT_MAT3:         return 4 * 9;
+    case GL_FLOAT_MAT4:         return 4 * 16;
+    default:                    return IsSampler(type) ? 4 : 0;
+    }
+}
+
+void ShaderLayout::UploadValue(unsigned int type, int location, int count, const void* value)
+{
+    switch (type)
+    {
+    case GL_FLOAT:              glUniform1fv(location, count, (const float*)value); break;
+    case GL_FLOAT_VEC2:         glUniform2fv(location, count, (const float*)value); break;
+    case GL_FLOAT_VEC3:         glUniform3fv(location, count, (const float*)value); break;
+    case GL_FLOAT_VEC4:         glUniform4fv(location, count, (const float*)value); break;
+    case GL_INT:
+    case GL_BOOL:               glUniform1iv(location, count, (const int*)value); break;
+    case GL_INT_VEC2:
+    case GL_BOOL_VEC2:          glUniform2iv(location, count, (const int*)value); break;
+    case GL_INT_VEC3:
+    case GL_BOOL_VEC3:          glUniform3iv(location, count, (const int*)value); break;
+    case GL_INT_VEC4:
+    case GL_BOOL_VEC4:          glUniform4iv(location, count, (const int*)value); break;
+    case GL_UNSIGNED_INT:       glUniform1uiv(location, count, (const unsigned int*)value); break;
+    case GL_UNSIGNED_INT_VEC2:  glUniform2uiv(location, count, (const unsigned int*)value); break;
+    case GL_UNSIGNED_INT_VEC3:  glUniform3uiv(location, count, (const unsigned int*)value); break;
+    case GL_UNSIGNED_INT_VEC4:  glUniform4uiv(location, count, (const unsigned int*)value); break;
+    case GL_FLOAT_MAT2:         glUniformMatrix2fv(location, count, GL_FALSE, (const float*)value); break;
+    case GL_FLOAT_MAT3:         glUniformMatrix3fv(location, count, GL_FALSE, (const float*)value); break;
+    case GL_FLOAT_MAT4:         glUniformMatrix4fv(location, count, GL_FALSE, (const float*)value); break;
+    default:                    break; // Samplers keep the texture unit assigned at link time
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reports parameters that are written but do not exist in the program, and parameters that are never written
+#ifndef SHADER_PARAMETER_VALIDATION
+    #ifdef _DEBUG
+        #define SHADER_PARAMETER_VALIDATION 1
+    #else
+        #define SHADER_PARAMETER_VALIDATION 0
+    #endif
+#endif
+
+// A uniform of the default block, as reported by the driver after linking
+struct ShaderParameter
+{
+    std::string Name;       // Full name, e.g. "u_PointLights[0].position"
+    unsigned int Type;      // GL type, e.g. GL_FLOAT_VEC3
+    int Count;              // Number of array elements (1 for non arrays)
+    int Location;           // Uniform location of the first element
+    unsigned int Offset;    // Byte offset of the value inside a packed ParameterBlock
+    unsigned int Size;      // Size of the value in bytes (all elements)
+    int SamplerUnit;        // Texture unit assigned at link time, -1 if the parameter is not a sampler
+};
+
+// A uniform block, every block with the same name shares one binding point across all programs
+struct ShaderBlock
+{
+    std::string Name;
+    unsigned int Index;
+    unsigned int Binding;
+    unsigned int Size;      // Minimum buffer size required by the block, in bytes
+};
+
+// Samplers of the u_Material struct that mesh materials bind their textures to, "u_Material.texture_diffuse1" and so on
+enum class MaterialSampler : uint8_t
+{
+    Diffuse1, Diffuse2, Diffuse3, Diffuse4,
+    Specular1, Specular2, Specular3, Specular4,
+    Count
+};
+
+// Typed description of every parameter a linked program actually uses
+class ShaderLayout
+{
+public:
+    // Queries the program and assigns fixed texture units to samplers and binding points to blocks (the program gets bound)
+    static std::shared_ptr<const ShaderLayout> Reflect(unsigned int program);
+
+    static unsigned int GetBlockBinding(const std::string& blockName);
+
+    int Find(const std::string& name) const; // Index of the parameter, -1 if the program does not use it
+
+    const ShaderParameter& GetParameter(int index) const { return m_Parameters[index]; }
+    const std::vector<ShaderParameter>& GetParameters() const { return m_Parameters; }
+    const std::vector<ShaderBlock>& GetBlocks() const { return m_Blocks; }
+
+    unsigned int GetDataSize() const { return m_DataSize; }
+
+    // Where the values of a Material go in this program, resolved once when it is linked: the texture unit of each
+    // material sampler and the location of the shininess, -1 for the ones the program does not use
+    int GetMaterialUnit(MaterialSampler sampler) const { return m_MaterialUnits[(size_t)sampler]; }
+    int GetMaterialShininess() const { return m_MaterialShininess; }
+
+    static bool IsSampler(unsigned int type);
+    static unsigned int GetTypeSize(unsigned int type);
+
+    // Sends 'count' elements of a value of GL type 'type' to 'location' of the bound program
+    static void UploadValue(unsigned int type, int location, int count, const void* value);
+private:
+    std::vector<ShaderParameter> m_Parameters;
+    std::vector<ShaderBlock> m_Blocks;
+    std::unordered_map<std::string, int> m_Lookup;
+    unsigned int m_DataSize = 0;
+
+    int m_MaterialUnits[(size_t)MaterialSampler::Count];
+    int m_MaterialShininess = -1;
+};
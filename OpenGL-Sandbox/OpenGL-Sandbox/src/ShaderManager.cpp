@@ -0,0 +1,111 @@
+#include "ShaderManager.h"
+#include "CpuProfiler.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <iostream>
+
+ShaderManager& ShaderManager::Instance()
+{
+    static ShaderManager instance;
+    return instance;
+}
+
+ShaderManager::ShaderManager()
+    : m_Watcher(std::make_unique<FileWatcher>([this](const std::string& filePath) { OnFileChanged(filePath); }))
+{
+}
+
+ShaderSource ShaderManager::Load(const std::string& filePath)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Preprocessor.Process(filePath);
+}
+
+void ShaderManager::Register(Shader* shader, const std::vector<std::string>& dependencies)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    SetDependencies(shader, dependencies);
+}
+
+void ShaderManager::Unregister(Shader* shader)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    SetDependencies(shader, {});
+    m_Dependencies.erase(shader);
+
+    m_PendingReloads.erase(std::remove_if(m_PendingReloads.begin(), m_PendingReloads.end(),
+        [shader](const PendingReload& reload) { return reload.Target == shader; }), m_PendingReloads.end());
+}
+
+void ShaderManager::Update()
+{
+    std::vector<PendingReload> reloads;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        reloads.swap(m_PendingReloads);
+    }
+
+    for (auto& reload : reloads)
+    {
+        // The previous program stays in use if the new sources fail to compile or link
+        if (!reload.Target->Reload(reload.VertexSource, reload.FragmentSource))
+            continue;
+
+        std::cout << "[INFO]: Reloaded shader '" << reload.Target->GetFragmentPath() << "'" << std::endl;
+
+        std::vector<std::string> dependencies = reload.VertexSource.Dependencies;
+        dependencies.insert(dependencies.end(), reload.FragmentSource.Dependencies.begin(), reload.FragmentSource.Dependencies.end());
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Dependencies.count(reload.Target))
+            SetDependencies(reload.Target, dependencies);
+    }
+}
+
+void ShaderManager::OnFileChanged(const std::string& filePath)
+{
+    PROFILE_SCOPE("Preprocess shaders");
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Preprocessor.Invalidate(filePath);
+
+    auto dependents = m_Dependents.find(filePath);
+    if (dependents == m_Dependents.end())
+        return;
+
+    // Only the programs built from the modified file are rebuilt, their other files come from the cache
+    for (Shader* shader : dependents->second)
+    {
+        PendingReload reload{ shader, m_Preprocessor.Process(shader->GetVertexPath()), m_Preprocessor.Process(shader->GetFragmentPath()) };
+        if (reload.VertexSource.Code.empty() || reload.FragmentSource.Code.empty())
+            continue;
+
+        // A newer version of the same program replaces the one that was not picked up yet
+        auto pending = std::find_if(m_PendingReloads.begin(), m_PendingReloads.end(),
+            [shader](const PendingReload& other) { return other.Target == shader; });
+        if (pending != m_PendingReloads.end())
+            *pending = std::move(reload);
+        else
+            m_PendingReloads.push_back(std::move(reload));
+    }
+}
+
+void ShaderManager::SetDependencies(Shader* shader, const std::vector<std::string>& dependencies)
+{
+    auto& current = m_Dependencies[shader];
+    for (const auto& filePath : current)
+        m_Dependents[filePath].erase(shader);
+
+    current.clear();
+    for (const auto& filePath : dependencies)
+    {
+        const std::string path = ShaderPreprocessor::NormalizePath(filePath);
+        if (!m_Dependents[path].insert(shader).second)
+            continue; // Already listed, e.g. an include shared by both stages
+
+        current.push_back(path);
+        m_Watcher->Watch(path);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "FileWatcher.h"
+#include "ShaderPreprocessor.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Shader;
+
+// Owns the shader include cache and the file -> program dependency graph used for hot reloading.
+// Sources are re-preprocessed on the watcher thread, programs are rebuilt on the GL thread in Update().
+class ShaderManager
+{
+public:
+    static ShaderManager& Instance();
+
+    ShaderSource Load(const std::string& filePath);
+
+    void Register(Shader* shader, const std::vector<std::string>& dependencies);
+    void Unregister(Shader* shader);
+
+    // Must be called from the thread owning the GL context, swaps in every program that finished reloading
+    void Update();
+private:
+    ShaderManager();
+
+    void OnFileChanged(const std::string& filePath);
+    void SetDependencies(Shader* shader, const std::vector<std::string>& dependencies);
+private:
+    struct PendingReload
+    {
+        Shader* Target;
+        ShaderSource VertexSource;
+        ShaderSource FragmentSource;
+    };
+
+    std::mutex m_Mutex;
+    ShaderPreprocessor m_Preprocessor;
+
+    std::unordered_map<std::string, std::unordered_set<Shader*>> m_Dependents; // File -> programs built from it
+    std::unordered_map<Shader*, std::vector<std::string>> m_Dependencies;      // Program -> files it is built from
+    std::vector<PendingReload> m_PendingReloads;
+
+    std::unique_ptr<FileWatcher> m_Watcher; // Declared last so the watcher thread stops before the rest is destroyed
+};
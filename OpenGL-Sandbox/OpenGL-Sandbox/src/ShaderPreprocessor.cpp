@@ -0,0 +1,160 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace File
+{
+    // Reads the whole file in one go instead of rebuilding it line by line
+    static bool Load(const std::string& filePath, std::string& outContents)
+    {
+        std::ifstream fileStream(filePath, std::ios::in | std::ios::binary);
+
+        if (!fileStream.is_open())
+        {
+            std::cerr << "Failed to open file: " << filePath << std::endl;
+            return false;
+        }
+
+        fileStream.seekg(0, std::ios::end);
+        outContents.resize(static_cast<size_t>(fileStream.tellg()));
+        fileStream.seekg(0, std::ios::beg);
+        fileStream.read(&outContents[0], outContents.size());
+
+        return true;
+    }
+}
+
+namespace
+{
+    // Returns true and fills 'outName' if the line is an include directive, e.g. #include "Lighting.glsl"
+    bool ParseIncludeDirective(const std::string& text, size_t lineStart, size_t lineEnd, std::string& outName)
+    {
+        size_t cursor = text.find_first_not_of(" \t", lineStart);
+        if (cursor >= lineEnd || text[cursor] != '#')
+            return false;
+
+        cursor = text.find_first_not_of(" \t", cursor + 1);
+        if (cursor >= lineEnd || text.compare(cursor, 7, "include") != 0)
+            return false;
+
+        size_t open = text.find_first_of("\"<", cursor + 7);
+        if (open >= lineEnd)
+            return false;
+
+        const char closing = text[open] == '"' ? '"' : '>';
+        size_t close = text.find(closing, open + 1);
+        if (close >= lineEnd)
+            return false;
+
+        outName = text.substr(open + 1, close - open - 1);
+        return true;
+    }
+}
+
+ShaderSource ShaderPreprocessor::Process(const std::string& filePath)
+{
+    ShaderSource source;
+    std::unordered_set<std::string> included;
+    if (!Expand(NormalizePath(filePath), source, included))
+        source.Code.clear();
+
+    return source;
+}
+
+void ShaderPreprocessor::Invalidate(const std::string& filePath)
+{
+    m_Cache.erase(NormalizePath(filePath));
+}
+
+std::string ShaderPreprocessor::NormalizePath(const std::string& filePath)
+{
+    return std::filesystem::path(filePath).lexically_normal().generic_string();
+}
+
+const ShaderPreprocessor::ParsedFile& ShaderPreprocessor::Parse(const std::string& filePath)
+{
+    ParsedFile& parsed = m_Cache[filePath];
+    if (parsed.Loaded)
+        return parsed;
+
+    std::string contents;
+    if (!File::Load(filePath, contents))
+        return parsed; // Not marked as loaded, the next request will try again
+
+    const std::filesystem::path directory = std::filesystem::path(filePath).parent_path();
+
+    parsed.Segments.clear();
+    size_t segmentStart = 0, lineStart = 0;
+    unsigned int lineNumber = 1;
+    while (lineStart < contents.size())
+    {
+        size_t lineEnd = contents.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = contents.size();
+
+        std::string includeName;
+        if (ParseIncludeDirective(contents, lineStart, lineEnd, includeName))
+        {
+            ParsedFile::Segment segment;
+            segment.Text = contents.substr(segmentStart, lineStart - segmentStart);
+            segment.IncludePath = NormalizePath((directory / includeName).string());
+            segment.NextLine = lineNumber + 1;
+            parsed.Segments.push_back(std::move(segment));
+
+            segmentStart = std::min(lineEnd + 1, contents.size());
+        }
+
+        lineStart = lineEnd + 1;
+        lineNumber++;
+    }
+
+    // Trailing text after the last include directive (or the whole file if there is none)
+    ParsedFile::Segment tail;
+    tail.Text = contents.substr(segmentStart);
+    tail.NextLine = lineNumber;
+    parsed.Segments.push_back(std::move(tail));
+
+    parsed.Loaded = true;
+    return parsed;
+}
+
+bool ShaderPreprocessor::Expand(const std::string& filePath, ShaderSource& source, std::unordered_set<std::string>& included)
+{
+    // Every file is pasted at most once per stage, which also breaks include cycles
+    if (!included.insert(filePath).second)
+        return true;
+
+    const unsigned int fileIndex = static_cast<unsigned int>(source.Dependencies.size());
+    source.Dependencies.push_back(filePath);
+
+    const ParsedFile& parsed = Parse(filePath);
+    if (!parsed.Loaded)
+        return false;
+
+    // Keep compiler errors pointing at the right file: the root file holds the #version line, so it cannot be prefixed
+    if (fileIndex > 0)
+        source.Code += "#line 1 " + std::to_string(fileIndex) + "\n";
+
+    for (const auto& segment : parsed.Segments)
+    {
+        source.Code += segment.Text;
+        if (segment.IncludePath.empty())
+            continue;
+
+        if (!Expand(segment.IncludePath, source, included))
+        {
+            std::cerr << "[ERROR]: Failed to include '" << segment.IncludePath << "' from '" << filePath << "'" << std::endl;
+            return false;
+        }
+
+        source.Code += "#line " + std::to_string(segment.NextLine) + " " + std::to_string(fileIndex) + "\n";
+    }
+
+    if (!source.Code.empty() && source.Code.back() != '\n')
+        source.Code += '\n';
+
+    return true;
+}
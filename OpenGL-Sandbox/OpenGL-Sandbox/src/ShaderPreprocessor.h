@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Result of preprocessing a shader stage: the expanded GLSL code and every file it was built from
+struct ShaderSource
+{
+    std::string Code;
+    std::vector<std::string> Dependencies; // Index N is the GLSL "source string number" used by #line directives
+};
+
+class ShaderPreprocessor
+{
+public:
+    // Expands every #include "file" directive (paths are relative to the including file)
+    ShaderSource Process(const std::string& filePath);
+
+    // Drops the cached copy of a file so that the next Process() call reads it from disk again
+    void Invalidate(const std::string& filePath);
+
+    static std::string NormalizePath(const std::string& filePath);
+private:
+    // A file is cached as a list of raw text chunks separated by include directives
+    struct ParsedFile
+    {
+        struct Segment
+        {
+            std::string Text;         // Text that precedes the include directive
+            std::string IncludePath;  // Resolved path of the included file, empty for the trailing segment
+            unsigned int NextLine;    // Line number (1-based) that follows the include directive
+        };
+
+        bool Loaded = false;
+        std::vector<Segment> Segments;
+    };
+
+    const ParsedFile& Parse(const std::string& filePath);
+    bool Expand(const std::string& filePath, ShaderSource& source, std::unordered_set<std::string>& included);
+private:
+    std::unordered_map<std::string, ParsedFile> m_Cache;
+};
@@ -0,0 +1,262 @@
+#include "ShadowCascades.h"
+#include "CpuProfiler.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "ShaderLayout.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // Slope scaled and constant depth offset of the casters, against shadow acne
+    constexpr float SlopeBias = 2.0f, ConstantBias = 4.0f;
+    // Receiver side: depth bias in shadow map depth units, and offset along the normal in texels
+    constexpr float DepthBias = 0.0005f, NormalOffset = 1.5f;
+
+    // GPU profiler scopes of the cascades
+    const char* const CascadeScopes[] = { "Shadow cascade 0", "Shadow cascade 1", "Shadow cascade 2", "Shadow cascade 3" };
+    static_assert(sizeof(CascadeScopes) / sizeof(CascadeScopes[0]) == ShadowCascades::CascadeCount, "One scope name per cascade");
+
+    // Radii are rounded up to this step so that the fitted cascades keep their size from one frame to the next
+    constexpr float RadiusStep = 1.0f / 16.0f;
+
+    // Shadow map texture space from clip space
+    const glm::mat4 TextureSpace = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+}
+
+ShadowCascades::ShadowCascades(UploadRing* ring, unsigned int resolution, unsigned int cachedCascades)
+    : m_Resolution(resolution), m_CachedCascades(std::min(cachedCascades, CascadeCount - 1)),
+      m_Shader("resources/shaders/ShadowVertex.glsl", "resources/shaders/NullFragment.glsl"),
+      m_Parameters(m_Shader.GetLayout())
+{
+    m_LightViewProjection = m_Parameters.GetHandle("u_LightViewProjection");
+
+    // One layer per cascade, sampled with hardware depth comparison (sampler2DArrayShadow)
+    glGenTextures(1, &m_ShadowMap);
+    GLState::BindTexture(GLState::GetActiveTextureUnit(), GL_TEXTURE_2D_ARRAY, m_ShadowMap);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_Resolution, m_Resolution, CascadeCount, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    GpuMemory::Instance().OnTextureAllocated(m_ShadowMap, GetTextureBytes(), GL_DEPTH_COMPONENT24, GpuMemory::Category::RenderTargets, "Shadow cascades");
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    // Outside of the map is lit
+    const float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+    for (unsigned int i = 0; i < CascadeCount; i++)
+    {
+        Cascade& cascade = m_Cascades[i];
+
+        glGenFramebuffers(1, &cascade.Framebuffer);
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, cascade.Framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_ShadowMap, 0, i);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "[ERROR]: Shadow cascade " << i << " framebuffer is incomplete (" << m_Resolution << "x" << m_Resolution << ")" << std::endl;
+
+        // The program only sets the sort order, every cascade draws with the shadow program and its own light matrix
+        cascade.Queue = std::make_unique<RenderQueue>(ring);
+        cascade.Queue->SetDepthOnly(&m_Shader);
+        m_Program = cascade.Queue->RegisterProgram(m_Shader, m_Parameters);
+    }
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowCascades::~ShadowCascades()
+{
+    for (auto& cascade : m_Cascades)
+    {
+        GLState::OnFramebufferDeleted(cascade.Framebuffer);
+        glDeleteFramebuffers(1, &cascade.Framebuffer);
+    }
+
+    GLState::OnTextureDeleted(m_ShadowMap);
+    GpuMemory::Instance().OnTextureDeleted(m_ShadowMap);
+    glDeleteTextures(1, &m_ShadowMap);
+}
+
+void ShadowCascades::SetLightDirection(const glm::vec3& direction)
+{
+    m_LightDirection = glm::normalize(direction);
+}
+
+void ShadowCascades::Begin(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane, unsigned int partitionCount)
+{
+    const float shadowDistance = std::min(m_ShadowDistance, farPlane);
+
+    m_ShaderData.Parameters = glm::vec4(1.0f / m_Resolution, DepthBias, NormalOffset, m_Enabled ? 1.0f : 0.0f);
+    for (auto& cascade : m_Cascades)
+        cascade.Drawn = false;
+
+    if (!m_Enabled)
+        return;
+
+    const glm::mat4 inverseView = glm::inverse(view);
+    const glm::vec3 cameraPosition = glm::vec3(inverseView[3]);
+    const glm::vec3 forward = -glm::vec3(inverseView[2]);
+
+    // Squared distance from the view axis to the corners of the frustum, at a depth of 1
+    const float tanHalfFov = std::tan(fovY * 0.5f);
+    const float cornerScale = tanHalfFov * tanHalfFov * (1.0f + aspect * aspect);
+
+    float sliceNear = nearPlane;
+    for (unsigned int i = 0; i < CascadeCount; i++)
+    {
+        Cascade& cascade = m_Cascades[i];
+
+        // Practical split scheme: logarithmic splits near the camera, closer to uniform ones far away
+        const float t = (float)(i + 1) / CascadeCount;
+        const float uniformSplit = nearPlane + (shadowDistance - nearPlane) * t;
+        const float logarithmicSplit = nearPlane * std::pow(shadowDistance / nearPlane, t);
+        const float sliceFar = glm::mix(uniformSplit, logarithmicSplit, m_SplitLambda);
+        m_ShaderData.Splits[i] = sliceFar;
+
+        // Bounding sphere of the slice: its center on the view axis is as far from the near corners as from the far ones,
+        // unless that is past the far plane (wide field of view), then the far plane's center is used
+        const float centerDepth = std::min(sliceFar, 0.5f * (sliceNear + sliceFar) * (1.0f + cornerScale));
+        const float farDistance = (sliceFar - centerDepth) * (sliceFar - centerDepth) + sliceFar * sliceFar * cornerScale;
+        const float nearDistance = (centerDepth - sliceNear) * (centerDepth - sliceNear) + sliceNear * sliceNear * cornerScale;
+        const float radius = std::ceil(std::sqrt(std::max(farDistance, nearDistance)) / RadiusStep) * RadiusStep;
+        const glm::vec3 center = cameraPosition + forward * centerDepth;
+        sliceNear = sliceFar;
+
+        if (IsCached(i))
+        {
+            // The cached shadow map is reused as long as the slice stays inside the area it covers
+            m_Stats.CacheLookups++;
+            const bool hit = cascade.Valid
+                && cascade.StaticVersion == m_StaticVersion
+                && cascade.LightDirection == m_LightDirection
+                && glm::length(center - cascade.Center) + radius <= cascade.Radius;
+
+            if (hit)
+            {
+                m_Stats.CacheHits++;
+                continue;
+            }
+
+            Fit(cascade, center, std::ceil(radius * m_CachePadding / RadiusStep) * RadiusStep);
+            cascade.Valid = true;
+            cascade.StaticVersion = m_StaticVersion;
+            cascade.LightDirection = m_LightDirection;
+        }
+        else
+        {
+            Fit(cascade, center, radius);
+        }
+
+        cascade.Drawn = true;
+        cascade.Queue->Begin(cascade.View, cascade.Projection, 0.0f, cascade.Radius * 2.0f + m_CasterDistance, partitionCount);
+
+        m_ShaderData.Matrices[i] = TextureSpace * cascade.Projection * cascade.View;
+        m_ShaderData.TexelSizes[i] = cascade.Radius * 2.0f / m_Resolution;
+    }
+}
+
+void ShadowCascades::Fit(Cascade& cascade, const glm::vec3& center, float radius) const
+{
+    // The light looks at the center of the sphere from far enough to see the casters in front of it
+    const float eyeDistance = radius + m_CasterDistance;
+    const glm::vec3 up = std::abs(m_LightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+    cascade.Center = center;
+    cascade.Radius = radius;
+    cascade.View = glm::lookAt(center - m_LightDirection * eyeDistance, center, up);
+    cascade.Projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, eyeDistance + radius);
+
+    // Snap the world origin to a texel, the map then only moves by whole texels and static edges stay put
+    const glm::vec4 origin = cascade.Projection * cascade.View * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    const glm::vec2 texels = glm::vec2(origin) * (m_Resolution * 0.5f);
+    const glm::vec2 offset = (glm::round(texels) - texels) * (2.0f / m_Resolution);
+    cascade.Projection[3][0] += offset.x;
+    cascade.Projection[3][1] += offset.y;
+}
+
+void ShadowCascades::Submit(unsigned int partition, const AssetLoader::Mesh& mesh, const glm::mat4& model, bool isStatic)
+{
+    for (unsigned int i = 0; i < CascadeCount; i++)
+    {
+        if (Accepts(i, isStatic))
+            m_Cascades[i].Queue->Submit(partition, mesh, m_Program, model, glm::mat3x4(1.0f)); // Depth only, no normals
+    }
+}
+
+void ShadowCascades::Record()
+{
+    PROFILE_SCOPE("Record shadow cascades");
+
+    m_Stats.DrawnCascades = 0;
+    for (unsigned int i = 0; i < CascadeCount; i++)
+    {
+        Cascade& cascade = m_Cascades[i];
+        if (!cascade.Drawn)
+        {
+            m_Stats.Casters[i] = 0;
+            continue;
+        }
+
+        cascade.Queue->Sort();
+        cascade.Queue->Record();
+        m_Stats.Casters[i] = cascade.Queue->GetStats().Instances;
+        m_Stats.DrawnCascades++;
+    }
+}
+
+void ShadowCascades::Render()
+{
+    if (m_Stats.DrawnCascades == 0)
+        return;
+
+    GPU_SCOPE("Shadows");
+
+    // Casters are always filled, and pushed away from the light a little
+    GLState::PolygonMode(GL_FILL);
+    GLState::DepthMask(true);
+    GLState::Enable(GL_POLYGON_OFFSET_FILL);
+    GLState::PolygonOffset(SlopeBias, ConstantBias);
+    GLState::Viewport(0, 0, m_Resolution, m_Resolution);
+
+    for (unsigned int i = 0; i < CascadeCount; i++)
+    {
+        Cascade& cascade = m_Cascades[i];
+        if (!cascade.Drawn)
+            continue;
+
+        GPU_SCOPE(CascadeScopes[i]);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, cascade.Framebuffer);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        // The queue uploads the block before replaying its draws
+        m_Parameters.Set(m_LightViewProjection, cascade.Projection * cascade.View);
+        cascade.Queue->Execute();
+    }
+
+    GLState::Disable(GL_POLYGON_OFFSET_FILL);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCascades::Bind(const ShaderLayout& layout) const
+{
+    const int parameter = layout.Find("u_ShadowMap");
+    if (parameter >= 0)
+        GLState::BindTexture(layout.GetParameter(parameter).SamplerUnit, GL_TEXTURE_2D_ARRAY, m_ShadowMap);
+}
+
+double ShadowCascades::GetCascadeMs(unsigned int cascade) const
+{
+    const GpuProfiler::Summary summary = GpuProfiler::Instance().GetSummary(CascadeScopes[cascade]);
+    return summary.Active ? summary.Last : 0.0;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Mesh.h"
+#include "ParameterBlock.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "UploadRing.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+
+class ShaderLayout;
+
+// Cascaded shadow maps of the directional light. The view frustum up to the shadow distance is split into cascades, each
+// one covered by a square orthographic shadow map stored in one layer of a depth texture array (see include/Shadows.glsl).
+// A cascade is fitted to the bounding sphere of its slice of the frustum, so its size does not change when the camera
+// turns, and its origin is snapped to whole shadow map texels, so static shadows do not shimmer when the camera moves.
+// Every cascade has its own render queue: casters are culled against the cascade and drawn depth-only from the position
+// stream of the mesh arena. The far cascades are cached, they only hold static casters and cover a bit more than needed,
+// and they are drawn again only when the camera leaves that area, the light turns or the static content changes.
+class ShadowCascades
+{
+public:
+    static constexpr unsigned int CascadeCount = 4; // SHADOW_CASCADE_COUNT in include/Shadows.glsl
+
+    // std140 layout of the ShadowBlock uniform block
+    struct ShaderData
+    {
+        glm::mat4 Matrices[CascadeCount]; // World space to shadow map texture space
+        glm::vec4 Splits;       // View space far depth of every cascade
+        glm::vec4 TexelSizes;   // Size of a shadow map texel in world units, per cascade
+        glm::vec4 Parameters;   // 1 / resolution, depth bias, normal offset in texels, 1 if enabled
+    };
+
+    struct Stats
+    {
+        uint32_t DrawnCascades = 0;             // Last frame
+        uint32_t Casters[CascadeCount] = {};    // Instances drawn into each cascade last frame
+        uint64_t CacheLookups = 0;              // Cached cascades times frames, since the start
+        uint64_t CacheHits = 0;                 // Lookups that kept the shadow map of the previous frame
+
+        double GetHitRate() const { return CacheLookups ? (double)CacheHits / CacheLookups : 0.0; }
+    };
+
+    // The last 'cachedCascades' cascades are cached, the queues write their instance data into 'ring'
+    ShadowCascades(UploadRing* ring, unsigned int resolution = 2048, unsigned int cachedCascades = 2);
+    ~ShadowCascades();
+
+    ShadowCascades(const ShadowCascades&) = delete;
+    ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+    // Direction the light travels in, the cached cascades are drawn again when it changes
+    void SetLightDirection(const glm::vec3& direction);
+    // The static casters changed (added, removed or moved), the cached cascades are drawn again
+    void InvalidateStatic() { m_StaticVersion++; }
+    void SetEnabled(bool enabled) { m_Enabled = enabled; }
+    bool IsEnabled() const { return m_Enabled; }
+
+    // Fits the cascades to the camera and begins the queues of the cascades drawn this frame
+    void Begin(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane, unsigned int partitionCount = 1);
+
+    // Casters only go to the cascades drawn this frame, and dynamic ones never go to the cached cascades.
+    // Any thread, one partition per thread (see RenderQueue::Submit()).
+    bool IsDrawn(unsigned int cascade) const { return m_Cascades[cascade].Drawn; }
+    bool IsCached(unsigned int cascade) const { return cascade >= CascadeCount - m_CachedCascades; }
+    bool Accepts(unsigned int cascade, bool isStatic) const { return IsDrawn(cascade) && (isStatic || !IsCached(cascade)); }
+    void Submit(unsigned int partition, const AssetLoader::Mesh& mesh, const glm::mat4& model, bool isStatic = true);
+
+    // Queue and program to submit whole models with (Model::Submit()), check Accepts() first
+    RenderQueue& GetQueue(unsigned int cascade) { return *m_Cascades[cascade].Queue; }
+    RenderQueue::ProgramHandle GetProgram() const { return m_Program; }
+
+    // Sorts and records the queues of the drawn cascades (the ring must be between BeginFrame() and Flush())
+    void Record();
+    // Draws the cascades into the shadow map, GL thread only. Framebuffer 0 is bound afterwards, the caller restores
+    // its viewport and polygon mode.
+    void Render();
+
+    // Binds the shadow map to the unit the program assigned to u_ShadowMap, GL thread only
+    void Bind(const ShaderLayout& layout) const;
+
+    // GPU time of each cascade in the last frame read back by the GpuProfiler, 0 when it came from the cache
+    double GetCascadeMs(unsigned int cascade) const;
+
+    const ShaderData& GetShaderData() const { return m_ShaderData; }
+    const Stats& GetStats() const { return m_Stats; }
+    unsigned int GetResolution() const { return m_Resolution; }
+    unsigned int GetShadowMap() const { return m_ShadowMap; } // GL_DEPTH_COMPONENT24 array, one layer per cascade
+    size_t GetTextureBytes() const { return (size_t)m_Resolution * m_Resolution * CascadeCount * 4; }
+private:
+    struct Cascade
+    {
+        std::unique_ptr<RenderQueue> Queue;
+        unsigned int Framebuffer = 0;
+        bool Drawn = false;
+
+        // Area the shadow map covers, kept while the cascade comes from the cache
+        glm::vec3 Center{ 0.0f };
+        float Radius = 0.0f;
+        glm::mat4 View{ 1.0f }, Projection{ 1.0f };
+
+        // What the cached shadow map was drawn with
+        bool Valid = false;
+        glm::vec3 LightDirection{ 0.0f };
+        uint64_t StaticVersion = 0;
+    };
+
+    // Light view and texel snapped projection of a cascade covering the sphere
+    void Fit(Cascade& cascade, const glm::vec3& center, float radius) const;
+private:
+    unsigned int m_Resolution;
+    unsigned int m_CachedCascades;
+    unsigned int m_ShadowMap = 0;
+
+    Shader m_Shader;
+    ParameterBlock m_Parameters;
+    ParameterBlock::Handle m_LightViewProjection;
+    RenderQueue::ProgramHandle m_Program = 0;
+
+    Cascade m_Cascades[CascadeCount];
+
+    glm::vec3 m_LightDirection{ 0.0f, -1.0f, 0.0f };
+    uint64_t m_StaticVersion = 0;
+    bool m_Enabled = true;
+
+    float m_ShadowDistance = 100.0f;    // Clamped to the far plane
+    float m_SplitLambda = 0.8f;         // Blend between uniform (0) and logarithmic (1) splits
+    float m_CasterDistance = 50.0f;     // How far towards the light casters outside of the view still cast into it
+    float m_CachePadding = 1.25f;       // Radius of a cached cascade relative to the area it has to cover
+
+    ShaderData m_ShaderData{};
+    Stats m_Stats;
+};
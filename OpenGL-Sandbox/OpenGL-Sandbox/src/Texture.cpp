@@ -1,18 +1,38 @@
 #include "Texture.h"
+#include "CpuProfiler.h"
+#include "GLState.h"
+#include "GpuMemory.h"
 
 #include <glad/glad.h>
 #include <stb_image/stb_image.h>
 
 #include <iostream>
 
+Texture::Pixels Texture::Decode(const char* filePath)
+{
+	PROFILE_SCOPE("Decode texture");
+
+	// Per thread setting, the decoding threads do not race on it
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	Pixels pixels;
+	pixels.Data = stbi_load(filePath, &pixels.Width, &pixels.Height, &pixels.Channels, 0);
+	return pixels;
+}
+
 Texture::Texture(const char* filePath)
-	: m_FilePath(filePath), m_ID(0), m_Width(0), m_Height(0), m_NbChannels(0)
+	: Texture(filePath, Decode(filePath))
+{
+}
+
+Texture::Texture(const char* filePath, Pixels pixels)
+	: m_ID(0), m_Width(pixels.Width), m_Height(pixels.Height), m_NbChannels(pixels.Channels), m_FilePath(filePath)
 {
-	stbi_set_flip_vertically_on_load(true);
+	PROFILE_SCOPE("Load texture");
 
 	// Load the texture from the file path
 	glGenTextures(1, &m_ID);
-	glBindTexture(GL_TEXTURE_2D, m_ID);
+	GLState::BindTexture(GLState::GetActiveTextureUnit(), GL_TEXTURE_2D, m_ID);
 
 	// Set texture parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -20,8 +40,8 @@ Texture::Texture(const char* filePath)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	// Load image data
-	unsigned char* data = stbi_load(filePath, &m_Width, &m_Height, &m_NbChannels, 0);
+	// Image data, decoded beforehand
+	unsigned char* data = pixels.Data;
 
 	// Support both RGB and RGBA
 	GLenum internalFormat = 0, dataFormat = 0;
@@ -42,6 +62,8 @@ Texture::Texture(const char* filePath)
 	    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_Width, m_Height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
 	    glGenerateMipmap(GL_TEXTURE_2D);
 	    stbi_image_free(data);
+	    GpuMemory::Instance().OnTextureAllocated(m_ID, GpuMemory::GetTextureBytes(internalFormat, m_Width, m_Height, 1, true), internalFormat,
+	        GpuMemory::Category::Textures, m_FilePath);
 	}
 	else // otherwise, print an error message
 	{
@@ -52,16 +74,17 @@ Texture::Texture(const char* filePath)
 Texture::~Texture()
 {
 	glDeleteTextures(1, &m_ID);
+	GLState::OnTextureDeleted(m_ID);
+	GpuMemory::Instance().OnTextureDeleted(m_ID);
 }
 
 void Texture::Bind(unsigned int slot) const
 {
-	// Bind the texture to the specified slot
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_2D, m_ID);
+	// Bind the texture to the specified slot, skipped if it is already bound there
+	GLState::BindTexture(slot, GL_TEXTURE_2D, m_ID);
 }
 
 void Texture::Unbind() const
 {
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::BindTexture(GLState::GetActiveTextureUnit(), GL_TEXTURE_2D, 0);
 }
@@ -3,7 +3,16 @@
 class Texture 
 {
 public:
+	// Pixels of an image file. Decode() runs on any thread, the constructor taking the pixels uploads and frees them.
+	struct Pixels
+	{
+		unsigned char* Data = nullptr;
+		int Width = 0, Height = 0, Channels = 0;
+	};
+	static Pixels Decode(const char* filePath);
+
 	Texture(const char* filePath);
+	Texture(const char* filePath, Pixels pixels);
 	~Texture();
 
 	void Bind(unsigned int slot = 0) const;
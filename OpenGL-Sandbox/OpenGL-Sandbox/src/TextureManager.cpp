@@ -1,4 +1,8 @@
 #include "TextureManager.h"
+#include "CpuProfiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
 
 TextureManager& TextureManager::Instance()
 {
@@ -8,6 +12,14 @@ TextureManager& TextureManager::Instance()
 
 std::shared_ptr<Texture> TextureManager::Get(const std::string& path)
 {
+    auto preloaded = m_Preloaded.find(path);
+    if (preloaded != m_Preloaded.end())
+    {
+        std::shared_ptr<Texture> texture = std::move(preloaded->second);
+        m_Preloaded.erase(preloaded);
+        return texture;
+    }
+
     auto it = m_Textures.find(path);
     if (it != m_Textures.end())
     {
@@ -19,3 +31,31 @@ std::shared_ptr<Texture> TextureManager::Get(const std::string& path)
     m_Textures[path] = texture;
     return texture;
 }
+
+void TextureManager::Load(const std::vector<std::string>& paths)
+{
+    PROFILE_SCOPE("Load textures");
+
+    // Each file once, and only the ones not loaded yet
+    std::vector<std::string> missing;
+    for (const std::string& path : paths)
+    {
+        auto it = m_Textures.find(path);
+        const bool loaded = it != m_Textures.end() && !it->second.expired();
+        if (!loaded && std::find(missing.begin(), missing.end(), path) == missing.end())
+            missing.push_back(path);
+    }
+
+    std::vector<Texture::Pixels> pixels(missing.size());
+    WorkerPool::Instance().ParallelFor((unsigned int)missing.size(), [&](unsigned int index, unsigned int)
+    {
+        pixels[index] = Texture::Decode(missing[index].c_str());
+    }, 1);
+
+    for (size_t i = 0; i < missing.size(); i++)
+    {
+        auto texture = std::make_shared<Texture>(missing[i].c_str(), pixels[i]);
+        m_Textures[missing[i]] = texture;
+        m_Preloaded[missing[i]] = texture;
+    }
+}
@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class TextureManager
 {
@@ -12,7 +13,13 @@ public:
     static TextureManager& Instance();
 
     std::shared_ptr<Texture> Get(const std::string& path);
+
+    // Loads the textures of 'paths' that are not loaded yet: the files are decoded in parallel on the worker pool, then
+    // uploaded in order on the calling (GL) thread. Get() then finds them.
+    void Load(const std::vector<std::string>& paths);
 private:
     TextureManager() = default;
     std::unordered_map<std::string, std::weak_ptr<Texture>> m_Textures;
+    // Loaded by Load(), until the first Get() of each takes it over
+    std::unordered_map<std::string, std::shared_ptr<Texture>> m_Preloaded;
 };
\ No newline at end of file
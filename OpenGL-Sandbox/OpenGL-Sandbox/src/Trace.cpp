@@ -0,0 +1,61 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace Trace
+{
+    std::string EscapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            if ((unsigned char)c >= 0x20)
+                escaped += c;
+        }
+        return escaped;
+    }
+
+    int64_t Now()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    bool WriteChromeJson(const std::string& path, const std::vector<Event>& events, const std::vector<std::pair<uint32_t, std::string>>& threads)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cerr << "[ERROR]: Could not open '" << path << "' for writing" << std::endl;
+            return false;
+        }
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        bool first = true;
+        for (const auto& [thread, name] : threads)
+        {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+                << ",\"args\":{\"name\":\"" << EscapeJson(name) << "\"}}";
+            first = false;
+        }
+
+        // Timestamps and durations are in microseconds, kept to the nanosecond
+        char line[64];
+        for (const Event& event : events)
+        {
+            std::snprintf(line, sizeof(line), "\"ts\":%.3f,\"dur\":%.3f}", event.StartNs / 1000.0, event.DurationNs / 1000.0);
+            file << (first ? "" : ",\n") << "{\"name\":\"" << EscapeJson(event.Name) << "\",\"cat\":\"" << event.Category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.Thread << "," << line;
+            first = false;
+        }
+
+        file << "\n]}\n";
+        return (bool)file;
+    }
+}
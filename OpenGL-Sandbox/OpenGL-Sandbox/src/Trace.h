@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Set to 0 to compile the profiler scopes (PROFILE_SCOPE, GPU_SCOPE) out entirely
+#ifndef PROFILING_ENABLED
+    #define PROFILING_ENABLED 1
+#endif
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+// Timeline events shared by the profilers, written in the Chrome trace event format (chrome://tracing, Perfetto).
+namespace Trace
+{
+    struct Event
+    {
+        const char* Name;       // Static string, the profilers only take string literals
+        const char* Category;
+        uint32_t Thread;        // Track of the event in the viewer
+        int64_t StartNs;        // On the Now() clock
+        int64_t DurationNs;
+    };
+
+    // Nanoseconds of the steady clock since the first call, the time base of every event
+    int64_t Now();
+
+    // Quotes and backslashes escaped, control characters dropped
+    std::string EscapeJson(const std::string& text);
+
+    // Complete events ("X") on one process, 'threads' names the tracks
+    bool WriteChromeJson(const std::string& path, const std::vector<Event>& events, const std::vector<std::pair<uint32_t, std::string>>& threads);
+}
@@ -0,0 +1,515 @@
+#include "TransformStore.h"
+#include "CpuProfiler.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_STORE_SSE 1
+#endif
+
+// The AVX2 path is compiled whatever the target of the build and only runs once the CPU has been checked for it
+#if defined(TRANSFORM_STORE_SSE) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#define TRANSFORM_STORE_AVX2 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TRANSFORM_STORE_TARGET_AVX2
+#else
+#define TRANSFORM_STORE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+#include <algorithm>
+
+namespace
+{
+    // Transforms per job when the update is spread across the worker pool
+    constexpr size_t TransformsPerJob = 4096;
+
+    // From this many transforms on (7 MB of world and normal matrices) the matrices are written with streaming stores: they
+    // would not stay in the caches anyway, and writing around them saves reading every line before it is overwritten
+    constexpr size_t StreamingTransforms = 1 << 16;
+
+    // Arrays of the transforms a kernel goes through, 'Count' is a multiple of its batch size
+    struct KernelData
+    {
+        const float* PositionX; const float* PositionY; const float* PositionZ;
+        const float* RotationX; const float* RotationY; const float* RotationZ; const float* RotationW;
+        const float* ScaleX; const float* ScaleY; const float* ScaleZ;
+        float* World;               // 16 floats per transform
+        float* Normal;              // 12 floats per transform
+        float* WorldViewProjection; // 16 floats per transform, nullptr when not wanted
+        const glm::mat4* ViewProjection;
+        size_t Count;
+        bool Stream;                // Writes the matrices around the caches, SIMD paths only
+    };
+
+    void UpdateScalar(const KernelData& data)
+    {
+        for (size_t i = 0; i < data.Count; i++)
+        {
+            const float x = data.RotationX[i], y = data.RotationY[i], z = data.RotationZ[i], w = data.RotationW[i];
+            const float x2 = x + x, y2 = y + y, z2 = z + z;
+            const float xx = x * x2, yy = y * y2, zz = z * z2, xy = x * y2, xz = x * z2, yz = y * z2, wx = w * x2, wy = w * y2, wz = w * z2;
+            const glm::vec3 rotation[3] =
+            {
+                { 1.0f - (yy + zz), xy + wz, xz - wy },
+                { xy - wz, 1.0f - (xx + zz), yz + wx },
+                { xz + wy, yz - wx, 1.0f - (xx + yy) }
+            };
+            const float scale[3] = { data.ScaleX[i], data.ScaleY[i], data.ScaleZ[i] };
+
+            glm::mat4& world = reinterpret_cast<glm::mat4*>(data.World)[i];
+            for (int column = 0; column < 3; column++)
+                world[column] = glm::vec4(rotation[column] * scale[column], 0.0f);
+            world[3] = glm::vec4(data.PositionX[i], data.PositionY[i], data.PositionZ[i], 1.0f);
+
+            if (scale[0] != scale[1] || scale[0] != scale[2])
+            {
+                glm::mat3x4& normal = reinterpret_cast<glm::mat3x4*>(data.Normal)[i];
+                for (int column = 0; column < 3; column++)
+                    normal[column] = glm::vec4(rotation[column] / scale[column], 0.0f);
+            }
+
+            if (data.WorldViewProjection)
+                reinterpret_cast<glm::mat4*>(data.WorldViewProjection)[i] = *data.ViewProjection * world;
+        }
+    }
+
+#ifdef TRANSFORM_STORE_SSE
+    // Transposes the first 'columnCount' columns of 4 matrices, columns[column][component] holding that component for each
+    // of them, and stores the matrices one after the other, 'stride' floats apart. Every matrix is written in order, so that
+    // the streaming stores fill whole cache lines.
+    inline void StoreMatrices(float* first, size_t stride, bool stream, __m128 (&columns)[4][4], int columnCount)
+    {
+        for (int column = 0; column < columnCount; column++)
+            _MM_TRANSPOSE4_PS(columns[column][0], columns[column][1], columns[column][2], columns[column][3]);
+
+        for (int matrix = 0; matrix < 4; matrix++)
+        {
+            for (int column = 0; column < columnCount; column++)
+            {
+                float* target = first + matrix * stride + column * 4;
+                if (stream)
+                    _mm_stream_ps(target, columns[column][matrix]);
+                else
+                    _mm_storeu_ps(target, columns[column][matrix]);
+            }
+        }
+    }
+
+    void UpdateSSE(const KernelData& data)
+    {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+        // Every element of the view projection in its own register, column by column
+        __m128 viewProjection[4][4];
+        if (data.WorldViewProjection)
+        {
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    viewProjection[column][row] = _mm_set1_ps((*data.ViewProjection)[column][row]);
+        }
+
+        for (size_t i = 0; i < data.Count; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(data.RotationX + i), y = _mm_loadu_ps(data.RotationY + i);
+            const __m128 z = _mm_loadu_ps(data.RotationZ + i), w = _mm_loadu_ps(data.RotationW + i);
+            const __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+            const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+            const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+            const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+            // rotation[column][row]
+            const __m128 rotation[3][3] =
+            {
+                { _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy) },
+                { _mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx) },
+                { _mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)) }
+            };
+            const __m128 scale[3] = { _mm_loadu_ps(data.ScaleX + i), _mm_loadu_ps(data.ScaleY + i), _mm_loadu_ps(data.ScaleZ + i) };
+
+            // The rotation columns times the scale for the world matrix, divided by it for the normal matrix. A batch of uniformly
+            // scaled transforms gets no normal matrices, GetNormal() derives them from the world matrices. Partial batches are
+            // written whole: the streaming stores are only fast on whole cache lines.
+            const int stretched = _mm_movemask_ps(_mm_or_ps(_mm_cmpneq_ps(scale[0], scale[1]), _mm_cmpneq_ps(scale[0], scale[2])));
+            __m128 world[4][4], normal[4][4];
+            for (int column = 0; column < 3; column++)
+            {
+                for (int row = 0; row < 3; row++)
+                    world[column][row] = _mm_mul_ps(rotation[column][row], scale[column]);
+                world[column][3] = zero;
+            }
+            world[3][0] = _mm_loadu_ps(data.PositionX + i);
+            world[3][1] = _mm_loadu_ps(data.PositionY + i);
+            world[3][2] = _mm_loadu_ps(data.PositionZ + i);
+            world[3][3] = one;
+
+            // The last row of the world matrix is (0, 0, 0, 1): three products per element, plus the translation of the view projection
+            if (data.WorldViewProjection)
+            {
+                __m128 result[4][4];
+                for (int column = 0; column < 4; column++)
+                {
+                    for (int row = 0; row < 4; row++)
+                    {
+                        result[column][row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(viewProjection[0][row], world[column][0]), _mm_mul_ps(viewProjection[1][row], world[column][1])),
+                            _mm_mul_ps(viewProjection[2][row], world[column][2]));
+                        if (column == 3)
+                            result[column][row] = _mm_add_ps(result[column][row], viewProjection[3][row]);
+                    }
+                }
+                StoreMatrices(data.WorldViewProjection + i * 16, 16, data.Stream, result, 4);
+            }
+
+            StoreMatrices(data.World + i * 16, 16, data.Stream, world, 4);
+            if (stretched != 0)
+            {
+                for (int column = 0; column < 3; column++)
+                {
+                    const __m128 inverseScale = _mm_div_ps(one, scale[column]);
+                    for (int row = 0; row < 3; row++)
+                        normal[column][row] = _mm_mul_ps(rotation[column][row], inverseScale);
+                    normal[column][3] = zero;
+                }
+                StoreMatrices(data.Normal + i * 12, 12, data.Stream, normal, 3);
+            }
+        }
+
+        if (data.Stream)
+            _mm_sfence(); // The streaming stores are weakly ordered, they are done before the job counts as done
+    }
+#endif
+
+#ifdef TRANSFORM_STORE_AVX2
+    // Same as above for 8 matrices. The unpacks and shuffles of the transposition work inside the 128 bit halves, the low
+    // half ends up with the columns of matrices 0 to 3 and the high half with those of 4 to 7. Two columns of a matrix
+    // go together in a 32 byte store when the matrices are 32 byte aligned (4 columns).
+    TRANSFORM_STORE_TARGET_AVX2 inline void StoreMatrices(float* first, size_t stride, bool stream, __m256 (&columns)[4][4], int columnCount)
+    {
+        for (int column = 0; column < columnCount; column++)
+        {
+            __m256* components = columns[column];
+            const __m256 xy0 = _mm256_unpacklo_ps(components[0], components[1]), xy1 = _mm256_unpackhi_ps(components[0], components[1]);
+            const __m256 zw0 = _mm256_unpacklo_ps(components[2], components[3]), zw1 = _mm256_unpackhi_ps(components[2], components[3]);
+            components[0] = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(1, 0, 1, 0)); // Matrices 0 and 4
+            components[1] = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(3, 2, 3, 2)); // 1 and 5
+            components[2] = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(1, 0, 1, 0)); // 2 and 6
+            components[3] = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(3, 2, 3, 2)); // 3 and 7
+        }
+
+        for (int matrix = 0; matrix < 8; matrix++)
+        {
+            const int lane = matrix & 3;
+            float* target = first + matrix * stride;
+            if (columnCount == 4)
+            {
+                for (int column = 0; column < 4; column += 2)
+                {
+                    const __m256 pair = matrix < 4
+                        ? _mm256_permute2f128_ps(columns[column][lane], columns[column + 1][lane], 0x20)
+                        : _mm256_permute2f128_ps(columns[column][lane], columns[column + 1][lane], 0x31);
+                    if (stream)
+                        _mm256_stream_ps(target + column * 4, pair);
+                    else
+                        _mm256_storeu_ps(target + column * 4, pair);
+                }
+                continue;
+            }
+
+            for (int column = 0; column < columnCount; column++)
+            {
+                const __m128 half = matrix < 4 ? _mm256_castps256_ps128(columns[column][lane]) : _mm256_extractf128_ps(columns[column][lane], 1);
+                if (stream)
+                    _mm_stream_ps(target + column * 4, half);
+                else
+                    _mm_storeu_ps(target + column * 4, half);
+            }
+        }
+    }
+
+    TRANSFORM_STORE_TARGET_AVX2 void UpdateAVX2(const KernelData& data)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+
+        __m256 viewProjection[4][4];
+        if (data.WorldViewProjection)
+        {
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    viewProjection[column][row] = _mm256_set1_ps((*data.ViewProjection)[column][row]);
+        }
+
+        for (size_t i = 0; i < data.Count; i += 8)
+        {
+            const __m256 x = _mm256_loadu_ps(data.RotationX + i), y = _mm256_loadu_ps(data.RotationY + i);
+            const __m256 z = _mm256_loadu_ps(data.RotationZ + i), w = _mm256_loadu_ps(data.RotationW + i);
+            const __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+            const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+            const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+            const __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+            const __m256 rotation[3][3] =
+            {
+                { _mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz), _mm256_sub_ps(xz, wy) },
+                { _mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, wx) },
+                { _mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy)) }
+            };
+            const __m256 scale[3] = { _mm256_loadu_ps(data.ScaleX + i), _mm256_loadu_ps(data.ScaleY + i), _mm256_loadu_ps(data.ScaleZ + i) };
+
+            const int stretched = _mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(scale[0], scale[1], _CMP_NEQ_UQ), _mm256_cmp_ps(scale[0], scale[2], _CMP_NEQ_UQ)));
+            __m256 world[4][4], normal[4][4];
+            for (int column = 0; column < 3; column++)
+            {
+                for (int row = 0; row < 3; row++)
+                    world[column][row] = _mm256_mul_ps(rotation[column][row], scale[column]);
+                world[column][3] = zero;
+            }
+            world[3][0] = _mm256_loadu_ps(data.PositionX + i);
+            world[3][1] = _mm256_loadu_ps(data.PositionY + i);
+            world[3][2] = _mm256_loadu_ps(data.PositionZ + i);
+            world[3][3] = one;
+
+            if (data.WorldViewProjection)
+            {
+                __m256 result[4][4];
+                for (int column = 0; column < 4; column++)
+                {
+                    for (int row = 0; row < 4; row++)
+                    {
+                        result[column][row] = _mm256_fmadd_ps(viewProjection[2][row], world[column][2],
+                            _mm256_fmadd_ps(viewProjection[1][row], world[column][1], _mm256_mul_ps(viewProjection[0][row], world[column][0])));
+                        if (column == 3)
+                            result[column][row] = _mm256_add_ps(result[column][row], viewProjection[3][row]);
+                    }
+                }
+                StoreMatrices(data.WorldViewProjection + i * 16, 16, data.Stream, result, 4);
+            }
+
+            StoreMatrices(data.World + i * 16, 16, data.Stream, world, 4);
+            if (stretched != 0)
+            {
+                for (int column = 0; column < 3; column++)
+                {
+                    const __m256 inverseScale = _mm256_div_ps(one, scale[column]);
+                    for (int row = 0; row < 3; row++)
+                        normal[column][row] = _mm256_mul_ps(rotation[column][row], inverseScale);
+                    normal[column][3] = zero;
+                }
+                StoreMatrices(data.Normal + i * 12, 12, data.Stream, normal, 3);
+            }
+        }
+
+        if (data.Stream)
+            _mm_sfence();
+    }
+
+    bool SupportsAVX2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        // AVX2 and FMA, and the OS saves the YMM registers (OSXSAVE, then XCR0 bits 1 and 2)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+        if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+}
+
+TransformStore::TransformStore()
+    : m_Simd(GetSupportedSimd())
+{
+}
+
+TransformStore::Simd TransformStore::GetSupportedSimd()
+{
+#if defined(TRANSFORM_STORE_AVX2)
+    static const Simd supported = SupportsAVX2() ? Simd::AVX2 : Simd::SSE;
+    return supported;
+#elif defined(TRANSFORM_STORE_SSE)
+    return Simd::SSE;
+#else
+    return Simd::Scalar;
+#endif
+}
+
+const char* TransformStore::GetSimdName(Simd simd)
+{
+    switch (simd)
+    {
+    case Simd::SSE: return "SSE";
+    case Simd::AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+void TransformStore::SetSimd(Simd simd)
+{
+    m_Simd = std::min(simd, GetSupportedSimd());
+}
+
+glm::mat3x4 TransformStore::ComputeNormalMatrix(const glm::mat4& world)
+{
+    // The inverse transpose is the cofactor matrix over the determinant, the columns are cross products of the others
+    const glm::vec3 a(world[0]), b(world[1]), c(world[2]);
+    const glm::vec3 bc = glm::cross(b, c), ca = glm::cross(c, a), ab = glm::cross(a, b);
+    const float inverseDeterminant = 1.0f / glm::dot(a, bc);
+    return glm::mat3x4(glm::vec4(bc * inverseDeterminant, 0.0f), glm::vec4(ca * inverseDeterminant, 0.0f), glm::vec4(ab * inverseDeterminant, 0.0f));
+}
+
+glm::mat3x4 TransformStore::GetNormal(Handle handle) const
+{
+    const float scale = m_ScaleX[handle];
+    if (scale != m_ScaleY[handle] || scale != m_ScaleZ[handle])
+        return m_Normal[handle];
+
+    // The rotation over the scale, which is the world matrix over the square of the scale
+    const glm::mat4& world = m_World[handle];
+    const float inverseSquare = 1.0f / (scale * scale);
+    return glm::mat3x4(world[0] * inverseSquare, world[1] * inverseSquare, world[2] * inverseSquare);
+}
+
+void TransformStore::Reserve(size_t count)
+{
+    count = (count + BatchSize - 1) / BatchSize * BatchSize;
+    for (auto* component : { &m_PositionX, &m_PositionY, &m_PositionZ, &m_RotationX, &m_RotationY, &m_RotationZ, &m_RotationW, &m_ScaleX, &m_ScaleY, &m_ScaleZ })
+        component->reserve(count);
+    m_World.reserve(count);
+    m_Normal.reserve(count);
+}
+
+TransformStore::Handle TransformStore::Create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+    Handle handle;
+    if (!m_Free.empty())
+    {
+        handle = m_Free.back();
+        m_Free.pop_back();
+    }
+    else
+        handle = (Handle)m_Count++;
+
+    if (m_Count > m_PositionX.size())
+    {
+        // A batch of identity transforms, the padding stays valid input for the kernels
+        const size_t size = m_PositionX.size() + BatchSize;
+        for (auto* component : { &m_PositionX, &m_PositionY, &m_PositionZ, &m_RotationX, &m_RotationY, &m_RotationZ })
+            component->resize(size, 0.0f);
+        for (auto* component : { &m_RotationW, &m_ScaleX, &m_ScaleY, &m_ScaleZ })
+            component->resize(size, 1.0f);
+    }
+
+    SetPosition(handle, position);
+    SetRotation(handle, rotation);
+    SetScale(handle, scale);
+    return handle;
+}
+
+void TransformStore::Destroy(Handle handle)
+{
+    SetPosition(handle, glm::vec3(0.0f));
+    SetRotation(handle, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    SetScale(handle, glm::vec3(1.0f));
+    m_Free.push_back(handle);
+}
+
+void TransformStore::Clear()
+{
+    m_Count = 0;
+    m_Free.clear();
+    for (auto* component : { &m_PositionX, &m_PositionY, &m_PositionZ, &m_RotationX, &m_RotationY, &m_RotationZ, &m_RotationW, &m_ScaleX, &m_ScaleY, &m_ScaleZ })
+        component->clear();
+    m_World.clear();
+    m_Normal.clear();
+    m_WorldViewProjection.clear();
+}
+
+void TransformStore::SetPosition(Handle handle, const glm::vec3& position)
+{
+    m_PositionX[handle] = position.x;
+    m_PositionY[handle] = position.y;
+    m_PositionZ[handle] = position.z;
+}
+
+void TransformStore::SetRotation(Handle handle, const glm::quat& rotation)
+{
+    const glm::quat unit = glm::normalize(rotation);
+    m_RotationX[handle] = unit.x;
+    m_RotationY[handle] = unit.y;
+    m_RotationZ[handle] = unit.z;
+    m_RotationW[handle] = unit.w;
+}
+
+void TransformStore::SetScale(Handle handle, const glm::vec3& scale)
+{
+    m_ScaleX[handle] = scale.x;
+    m_ScaleY[handle] = scale.y;
+    m_ScaleZ[handle] = scale.z;
+}
+
+void TransformStore::Update(const glm::mat4* viewProjection, WorkerPool* workers)
+{
+    PROFILE_SCOPE("Update transforms");
+
+    const size_t size = m_PositionX.size();
+    if (size == 0)
+        return;
+
+    m_World.resize(size);
+    m_Normal.resize(size);
+    if (viewProjection)
+        m_WorldViewProjection.resize(size);
+
+    const bool stream = size >= StreamingTransforms;
+    const size_t jobCount = (size + TransformsPerJob - 1) / TransformsPerJob;
+    if (!workers || jobCount < 2)
+    {
+        UpdateRange(0, size, viewProjection, stream);
+        return;
+    }
+
+    workers->ParallelFor((unsigned int)jobCount, [&](unsigned int job, unsigned int)
+    {
+        const size_t begin = job * TransformsPerJob;
+        UpdateRange(begin, std::min(size, begin + TransformsPerJob), viewProjection, stream);
+    }, 1);
+}
+
+void TransformStore::UpdateRange(size_t begin, size_t end, const glm::mat4* viewProjection, bool stream)
+{
+    const KernelData data =
+    {
+        m_PositionX.data() + begin, m_PositionY.data() + begin, m_PositionZ.data() + begin,
+        m_RotationX.data() + begin, m_RotationY.data() + begin, m_RotationZ.data() + begin, m_RotationW.data() + begin,
+        m_ScaleX.data() + begin, m_ScaleY.data() + begin, m_ScaleZ.data() + begin,
+        &m_World[begin][0][0], &m_Normal[begin][0][0], viewProjection ? &m_WorldViewProjection[begin][0][0] : nullptr,
+        viewProjection, end - begin, stream
+    };
+
+    switch (m_Simd)
+    {
+#ifdef TRANSFORM_STORE_AVX2
+    case Simd::AVX2:
+        UpdateAVX2(data);
+        break;
+#endif
+#ifdef TRANSFORM_STORE_SSE
+    case Simd::SSE:
+        UpdateSSE(data);
+        break;
+#endif
+    default:
+        UpdateScalar(data);
+        break;
+    }
+}
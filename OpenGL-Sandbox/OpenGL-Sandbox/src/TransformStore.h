@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+class WorkerPool;
+
+// Transforms of the scene objects, stored as structures of arrays: every component of the positions, rotations
+// (unit quaternions) and scales has its own array, so that a SIMD register holds the same component of 4 (SSE) or 8 (AVX2)
+// transforms. Update() computes the world matrix of every transform, the normal matrix of the instance data (the inverse
+// transpose of its upper 3x3, which the vertex shader no longer computes per vertex) and, when given a view projection,
+// the world-view-projection matrix, one batch of transforms at a time with the widest instruction set the CPU supports.
+// The matrices are written as arrays of structures, in the layout of the instance attributes. Big updates are bound by
+// the memory written, the normal matrix of a uniformly scaled transform is left out and derived when it is asked for.
+class TransformStore
+{
+public:
+    using Handle = uint32_t;
+
+    enum class Simd
+    {
+        Scalar,
+        SSE,    // 4 transforms per batch
+        AVX2    // 8 transforms per batch, with fused multiply-adds
+    };
+
+    // Transforms per batch of the widest path, the arrays are padded to a multiple of it
+    static constexpr unsigned int BatchSize = 8;
+
+    TransformStore();
+
+    // Widest path this CPU (and OS) runs, detected once
+    static Simd GetSupportedSimd();
+    static const char* GetSimdName(Simd simd);
+    // Path of Update(), SIMD paths the CPU lacks fall back to the widest it has (the benchmarks compare them)
+    void SetSimd(Simd simd);
+    Simd GetSimd() const { return m_Simd; }
+
+    // Inverse transpose of the upper 3x3 of any model matrix (cofactors over the determinant), columns padded to vec4
+    static glm::mat3x4 ComputeNormalMatrix(const glm::mat4& world);
+
+    void Reserve(size_t count);
+    Handle Create(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+    // The slot becomes an identity transform, the next Create() reuses it
+    void Destroy(Handle handle);
+    void Clear();
+    // Slots in use or free, the handles go from 0 to GetCount() - 1
+    size_t GetCount() const { return m_Count; }
+
+    void SetPosition(Handle handle, const glm::vec3& position);
+    // Normalized here, the matrices assume unit quaternions
+    void SetRotation(Handle handle, const glm::quat& rotation);
+    // Components must not be zero, the normal matrix divides by them
+    void SetScale(Handle handle, const glm::vec3& scale);
+
+    glm::vec3 GetPosition(Handle handle) const { return { m_PositionX[handle], m_PositionY[handle], m_PositionZ[handle] }; }
+    glm::quat GetRotation(Handle handle) const { return { m_RotationW[handle], m_RotationX[handle], m_RotationY[handle], m_RotationZ[handle] }; }
+    glm::vec3 GetScale(Handle handle) const { return { m_ScaleX[handle], m_ScaleY[handle], m_ScaleZ[handle] }; }
+
+    // Computes the matrices of every transform, the world-view-projection ones only when 'viewProjection' is given.
+    // With 'workers' the batches are spread across the pool, otherwise they all run on the calling thread.
+    void Update(const glm::mat4* viewProjection = nullptr, WorkerPool* workers = nullptr);
+
+    // Valid after Update(), until the next Create() or SetScale()
+    const glm::mat4& GetWorld(Handle handle) const { return m_World[handle]; }
+    glm::mat3x4 GetNormal(Handle handle) const;
+    const glm::mat4& GetWorldViewProjection(Handle handle) const { return m_WorldViewProjection[handle]; }
+private:
+    // Computes the matrices of the transforms in [begin, end), both multiples of BatchSize
+    void UpdateRange(size_t begin, size_t end, const glm::mat4* viewProjection, bool stream);
+
+    // The matrices start on a cache line, which the streaming stores need (16 byte alignment) and which keeps every
+    // world matrix in a line of its own
+    template<typename T>
+    struct CacheLineAllocator
+    {
+        using value_type = T;
+
+        CacheLineAllocator() = default;
+        template<typename U> CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+        T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(64))); }
+        void deallocate(T* pointer, size_t) { ::operator delete(pointer, std::align_val_t(64)); }
+
+        bool operator==(const CacheLineAllocator&) const { return true; }
+        bool operator!=(const CacheLineAllocator&) const { return false; }
+    };
+private:
+    Simd m_Simd;
+    size_t m_Count = 0;
+    std::vector<Handle> m_Free;
+
+    // Inputs, padded with identity transforms to a multiple of BatchSize
+    std::vector<float> m_PositionX, m_PositionY, m_PositionZ;
+    std::vector<float> m_RotationX, m_RotationY, m_RotationZ, m_RotationW;
+    std::vector<float> m_ScaleX, m_ScaleY, m_ScaleZ;
+
+    // Outputs, as many as the padded inputs
+    std::vector<glm::mat4, CacheLineAllocator<glm::mat4>> m_World;
+    std::vector<glm::mat3x4, CacheLineAllocator<glm::mat3x4>> m_Normal;
+    std::vector<glm::mat4, CacheLineAllocator<glm::mat4>> m_WorldViewProjection;
+};
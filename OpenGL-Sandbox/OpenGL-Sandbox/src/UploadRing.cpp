@@ -0,0 +1,217 @@
+#include "UploadRing.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    // Every region starts on a boundary that satisfies any uniform buffer offset alignment
+    constexpr size_t RegionAlignment = 256;
+
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+UploadRing::UploadRing(size_t frameSize, unsigned int framesInFlight, bool coherent)
+    : m_FramesInFlight(std::min(std::max(framesInFlight, 1u), MaxFramesInFlight))
+{
+    if (GLExtensions::HasBufferStorage())
+        m_Mode = coherent ? Mode::PersistentCoherent : Mode::PersistentFlush;
+    else
+        m_Mode = Mode::Orphaning;
+
+    if (framesInFlight != m_FramesInFlight)
+        std::cerr << "[WARNING]: " << framesInFlight << " frames in flight requested, using " << m_FramesInFlight << std::endl;
+
+    Create(frameSize);
+    std::cout << "[INFO]: Upload ring: " << GetModeName(m_Mode) << ", " << m_FramesInFlight << " frames in flight, " << m_FrameSize / 1024 << " KiB per frame" << std::endl;
+}
+
+UploadRing::~UploadRing()
+{
+    Destroy();
+}
+
+void UploadRing::BeginFrame()
+{
+    // Grow once every region is idle when the last frame did not fit, that frame fell back to slower paths
+    const size_t requested = m_Requested.load();
+    if (requested > m_FrameSize)
+    {
+        m_Stats.Overflows++;
+        const size_t frameSize = AlignUp(requested + requested / 2, RegionAlignment);
+        std::cout << "[INFO]: Upload ring grows from " << m_FrameSize / 1024 << " KiB to " << frameSize / 1024 << " KiB per frame" << std::endl;
+
+        Destroy();
+        Create(frameSize);
+    }
+
+    m_Region = (m_Region + 1) % m_FramesInFlight;
+    WaitForFence(m_Region, true);
+
+    m_Head = 0;
+    m_Requested = 0;
+
+    if (m_Mode == Mode::Orphaning)
+    {
+        // Orphan the storage, the unsynchronized map can then never stall on draws still reading the old one
+        GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_FrameSize, nullptr, GL_STREAM_DRAW);
+        m_Mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_FrameSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    }
+
+    m_Stats.Frames++;
+}
+
+UploadRing::Allocation UploadRing::Allocate(size_t size, size_t alignment)
+{
+    m_Requested.fetch_add(size + alignment);
+    if (!m_Mapped || size == 0)
+        return {};
+
+    // Lock-free bump allocation, workers allocate concurrently while recording
+    size_t head = m_Head.load(), offset;
+    do
+    {
+        offset = AlignUp(head, alignment);
+        if (offset + size > m_FrameSize)
+            return {};
+    } while (!m_Head.compare_exchange_weak(head, offset + size));
+
+    const size_t regionOffset = m_Mode == Mode::Orphaning ? 0 : (size_t)m_Region * m_FrameSize;
+
+    Allocation allocation;
+    allocation.Data = m_Mapped + regionOffset + offset;
+    allocation.Buffer = m_Buffer;
+    allocation.Offset = regionOffset + offset;
+    allocation.Size = size;
+    return allocation;
+}
+
+void UploadRing::Flush()
+{
+    const size_t used = m_Head.load();
+    switch (m_Mode)
+    {
+    case Mode::PersistentCoherent:
+        break;
+    case Mode::PersistentFlush:
+        if (used > 0)
+        {
+            GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+            glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, (size_t)m_Region * m_FrameSize, used);
+        }
+        break;
+    case Mode::Orphaning:
+        if (m_Mapped)
+        {
+            GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            m_Mapped = nullptr;
+        }
+        break;
+    }
+
+    m_Stats.LastFrameBytes = used;
+    m_Stats.PeakFrameBytes = std::max(m_Stats.PeakFrameBytes, used);
+}
+
+void UploadRing::EndFrame()
+{
+    if (m_Fences[m_Region])
+        glDeleteSync(m_Fences[m_Region]);
+    m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+const char* UploadRing::GetModeName(Mode mode)
+{
+    switch (mode)
+    {
+    case Mode::PersistentCoherent:  return "persistent coherent mapping";
+    case Mode::PersistentFlush:     return "persistent mapping with explicit flush";
+    case Mode::Orphaning:           return "orphaning";
+    default:                        return "unknown";
+    }
+}
+
+void UploadRing::Create(size_t frameSize)
+{
+    m_FrameSize = AlignUp(std::max(frameSize, RegionAlignment), RegionAlignment);
+
+    glGenBuffers(1, &m_Buffer);
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+
+    if (m_Mode == Mode::Orphaning)
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, m_FrameSize, nullptr, GL_STREAM_DRAW);
+        GpuMemory::Instance().OnBufferAllocated(m_Buffer, m_FrameSize, GpuMemory::Category::Streaming, "Upload ring");
+        return;
+    }
+
+    const size_t size = m_FrameSize * m_FramesInFlight;
+    const GLbitfield coherency = m_Mode == Mode::PersistentCoherent ? GL_MAP_COHERENT_BIT : 0;
+    GLExtensions::BufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | coherency);
+    GpuMemory::Instance().OnBufferAllocated(m_Buffer, size, GpuMemory::Category::Streaming, "Upload ring");
+
+    const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+        | (m_Mode == Mode::PersistentCoherent ? GL_MAP_COHERENT_BIT : GL_MAP_FLUSH_EXPLICIT_BIT);
+    m_Mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, mapFlags));
+    if (!m_Mapped)
+        std::cerr << "[ERROR]: Failed to map the upload ring (" << size / 1024 << " KiB)" << std::endl;
+}
+
+void UploadRing::Destroy()
+{
+    // The GPU may still read any region
+    for (unsigned int region = 0; region < m_FramesInFlight; region++)
+        WaitForFence(region, false);
+
+    if (m_Mapped)
+    {
+        GLState::BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        m_Mapped = nullptr;
+    }
+
+    GLState::OnBufferDeleted(m_Buffer);
+    GpuMemory::Instance().OnBufferDeleted(m_Buffer);
+    glDeleteBuffers(1, &m_Buffer);
+    m_Buffer = 0;
+}
+
+void UploadRing::WaitForFence(unsigned int region, bool measure)
+{
+    GLsync& fence = m_Fences[region];
+    if (!fence)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Poll first, the common case is a region the GPU finished with long ago
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    const bool waited = result == GL_TIMEOUT_EXPIRED;
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+
+    if (result == GL_WAIT_FAILED)
+        std::cerr << "[ERROR]: Waiting on the upload ring fence failed" << std::endl;
+
+    glDeleteSync(fence);
+    fence = nullptr;
+
+    if (measure)
+    {
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_Stats.LastWaitMs = milliseconds;
+        m_Stats.TotalWaitMs += milliseconds;
+        m_Stats.MaxWaitMs = std::max(m_Stats.MaxWaitMs, milliseconds);
+        m_Stats.WaitedFrames += waited ? 1 : 0;
+    }
+}
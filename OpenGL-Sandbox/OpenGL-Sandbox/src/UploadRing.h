@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Per-frame dynamic data (instance data, indirect commands, uniform blocks) is written straight into this buffer.
+// The buffer holds one region per frame in flight, a fence inserted after the frame's draws protects each region,
+// so the CPU only waits when it gets more than 'framesInFlight' frames ahead of the GPU.
+// With GL_ARB_buffer_storage the buffer stays mapped for its whole life, on plain GL 3.3 it is orphaned and mapped again
+// every frame (the driver hands out fresh memory, the fences then only limit the frames in flight).
+class UploadRing
+{
+public:
+    enum class Mode
+    {
+        PersistentCoherent, // Writes are visible to GL without any call
+        PersistentFlush,    // Writes are made visible with glFlushMappedBufferRange
+        Orphaning
+    };
+
+    struct Allocation
+    {
+        uint8_t* Data = nullptr;
+        unsigned int Buffer = 0;
+        size_t Offset = 0; // From the start of the buffer, what GL calls take
+        size_t Size = 0;
+
+        explicit operator bool() const { return Data != nullptr; }
+    };
+
+    struct Stats
+    {
+        uint64_t Frames = 0;
+        uint64_t WaitedFrames = 0;     // Frames that found their region still in use by the GPU
+        double LastWaitMs = 0.0;       // Time BeginFrame() spent waiting on the fence, last frame
+        double TotalWaitMs = 0.0;
+        double MaxWaitMs = 0.0;
+        size_t LastFrameBytes = 0;
+        size_t PeakFrameBytes = 0;
+        uint32_t Overflows = 0;        // Frames that asked for more than a region, the ring grows after each of them
+    };
+
+    static constexpr unsigned int MaxFramesInFlight = 4;
+
+    // 'frameSize' is the size of one region in bytes, it grows if a frame needs more
+    UploadRing(size_t frameSize, unsigned int framesInFlight = 3, bool coherent = true);
+    ~UploadRing();
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // GL thread, waits until the GPU is done with the region of the frame 'framesInFlight' frames ago
+    void BeginFrame();
+
+    // Any thread, between BeginFrame() and Flush(). Returns an empty allocation when the region is full.
+    Allocation Allocate(size_t size, size_t alignment = 16);
+
+    // GL thread, makes this frame's writes visible to GL, before the draws reading them
+    void Flush();
+
+    // GL thread, fences this frame's region, after the last draw reading it
+    void EndFrame();
+
+    unsigned int GetBuffer() const { return m_Buffer; }
+    Mode GetMode() const { return m_Mode; }
+    unsigned int GetFramesInFlight() const { return m_FramesInFlight; }
+    size_t GetFrameSize() const { return m_FrameSize; }
+    const Stats& GetStats() const { return m_Stats; }
+
+    static const char* GetModeName(Mode mode);
+private:
+    void Create(size_t frameSize);
+    void Destroy();
+    void WaitForFence(unsigned int region, bool measure);
+private:
+    unsigned int m_Buffer = 0;
+    Mode m_Mode;
+    uint8_t* m_Mapped = nullptr; // Whole buffer when persistent, the current frame when orphaning (null outside of the frame)
+
+    size_t m_FrameSize = 0;
+    unsigned int m_FramesInFlight;
+    unsigned int m_Region = 0;
+
+    GLsync m_Fences[MaxFramesInFlight] = {};
+
+    std::atomic<size_t> m_Head{ 0 };      // Bytes allocated in the current region
+    std::atomic<size_t> m_Requested{ 0 }; // Bytes asked for in the current frame, including failed allocations
+
+    Stats m_Stats;
+};
@@ -0,0 +1,367 @@
+#include "WorkerPool.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <string>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace
+{
+    // Settings of Instance(), see Configure()
+    WorkerPool::Settings s_Settings;
+
+    // Pool and index of the pool thread running this code, for the threads outside of any pool the caller slot (0)
+    thread_local const WorkerPool* t_Pool = nullptr;
+    thread_local unsigned int t_Thread = 0;
+
+    // Steal attempts over every other deque before a worker goes to sleep
+    constexpr unsigned int SpinRounds = 64;
+
+    void PinCurrentThread(unsigned int core)
+    {
+#if defined(_WIN32)
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (core % (8 * sizeof(DWORD_PTR))));
+#elif defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core % CPU_SETSIZE, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+        (void)core; // Not supported, the scheduler places the thread
+#endif
+    }
+}
+
+bool WorkerPool::Deque::Push(Job* job)
+{
+    const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+    const int64_t top = m_Top.load(std::memory_order_acquire);
+    if (bottom - top >= (int64_t)DequeCapacity)
+        return false;
+
+    m_Jobs[bottom & (DequeCapacity - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+WorkerPool::Job* WorkerPool::Deque::Pop()
+{
+    const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+    m_Bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_Top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        // Empty
+        m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_Jobs[bottom & (DequeCapacity - 1)].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // Last job, a thief may be taking it at the same time
+        if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+WorkerPool::Job* WorkerPool::Deque::Steal()
+{
+    int64_t top = m_Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+        return nullptr;
+
+    Job* job = m_Jobs[top & (DequeCapacity - 1)].load(std::memory_order_relaxed);
+    if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr; // Lost to the owner or another thief
+    return job;
+}
+
+bool WorkerPool::Deque::IsEmpty() const
+{
+    return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+}
+
+void WorkerPool::Configure(const Settings& settings)
+{
+    s_Settings = settings;
+}
+
+WorkerPool& WorkerPool::Instance()
+{
+    static WorkerPool instance(s_Settings);
+    return instance;
+}
+
+WorkerPool::WorkerPool(const Settings& settings)
+{
+    // One thread per core by default, the reserved ones are for the threads outside the pool (the caller among them)
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned int workerCount = settings.Workers != 0 ? settings.Workers : cores - std::min(cores, std::max(settings.ReservedThreads, 1u));
+
+    m_ThreadData.reserve(workerCount + 1);
+    for (unsigned int i = 0; i <= workerCount; i++)
+    {
+        m_ThreadData.push_back(std::make_unique<ThreadData>());
+        m_ThreadData.back()->Random = 0x9E3779B9u * (i + 1);
+    }
+
+    m_Threads.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        const unsigned int core = settings.PinThreads ? (settings.ReservedThreads + i) % cores : ~0u;
+        m_Threads.emplace_back(&WorkerPool::WorkerLoop, this, i + 1, core);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Running = false;
+        m_Epoch++;
+    }
+    m_WorkAvailable.notify_all();
+
+    for (auto& thread : m_Threads)
+        thread.join();
+}
+
+unsigned int WorkerPool::GetThreadIndex() const
+{
+    return t_Pool == this ? t_Thread : 0;
+}
+
+WorkerPool::Job* WorkerPool::AllocateJob(unsigned int thread)
+{
+    // The jobs are reused in order, one created DequeCapacity jobs ago may still be running: help until it is done
+    ThreadData& data = *m_ThreadData[thread];
+    Job* job = &data.Storage[data.NextJob++ % DequeCapacity];
+    while (!job->Free.load(std::memory_order_acquire))
+    {
+        if (Job* other = FindJob(thread))
+            Execute(other, thread);
+        else
+            std::this_thread::yield();
+    }
+    job->Free.store(false, std::memory_order_relaxed);
+    return job;
+}
+
+void WorkerPool::Push(unsigned int thread, Job* job)
+{
+    job->Batch->m_Pending.fetch_add(1, std::memory_order_relaxed);
+    if (!m_ThreadData[thread]->Jobs.Push(job))
+    {
+        // Deque full, nobody is stealing fast enough: run it now
+        Execute(job, thread);
+        return;
+    }
+
+    // Pairs with the fence of a worker going to sleep, one of the two sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_Sleeping.load(std::memory_order_relaxed) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Epoch++;
+        }
+        m_WorkAvailable.notify_one();
+    }
+}
+
+WorkerPool::Job* WorkerPool::FindJob(unsigned int thread)
+{
+    ThreadData& data = *m_ThreadData[thread];
+    if (Job* job = data.Jobs.Pop())
+        return job;
+
+    // Other deques from a random one on, so that thieves spread over the victims
+    const unsigned int threadCount = (unsigned int)m_ThreadData.size();
+    data.Random ^= data.Random << 13;
+    data.Random ^= data.Random >> 17;
+    data.Random ^= data.Random << 5;
+    const unsigned int first = data.Random % threadCount;
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        const unsigned int victim = (first + i) % threadCount;
+        if (victim == thread)
+            continue;
+        if (Job* job = m_ThreadData[victim]->Jobs.Steal())
+        {
+            data.Steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void WorkerPool::Execute(Job* job, unsigned int thread)
+{
+    if (job->Range)
+        RunRange(*job->Range, job->Begin, job->End, job->Grain, *job->Batch, thread);
+    else
+        job->Function();
+    m_ThreadData[thread]->Executed.fetch_add(1, std::memory_order_relaxed);
+
+    // Done with the job before its counter drops, the waiter may return and its creator reuse it right after
+    Counter* batch = job->Batch;
+    job->Function = nullptr;
+    job->Free.store(true, std::memory_order_release);
+    batch->m_Pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void WorkerPool::Run(Counter& counter, std::function<void()> function)
+{
+    const unsigned int thread = GetThreadIndex();
+    if (m_Threads.empty())
+    {
+        function();
+        return;
+    }
+
+    Job* job = AllocateJob(thread);
+    job->Function = std::move(function);
+    job->Range = nullptr;
+    job->Batch = &counter;
+    Push(thread, job);
+}
+
+void WorkerPool::Wait(Counter& counter)
+{
+    const unsigned int thread = GetThreadIndex();
+    while (!counter.IsDone())
+    {
+        if (Job* job = FindJob(thread))
+            Execute(job, thread);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void WorkerPool::ParallelFor(unsigned int count, const Task& task, unsigned int grain)
+{
+    if (count == 0)
+        return;
+
+    const unsigned int thread = GetThreadIndex();
+    if (count == 1 || m_Threads.empty())
+    {
+        for (unsigned int i = 0; i < count; i++)
+            task(i, thread);
+        return;
+    }
+
+    if (grain == 0)
+        grain = std::max(1u, count / (GetThreadCount() * 8));
+
+    // The caller starts on the whole range and gives parts away as thieves show up, then helps until they are done
+    Counter counter;
+    RunRange(task, 0, count, grain, counter, thread);
+    Wait(counter);
+}
+
+void WorkerPool::RunRange(const Task& task, unsigned int begin, unsigned int end, unsigned int grain, Counter& counter, unsigned int thread)
+{
+    Deque& deque = m_ThreadData[thread]->Jobs;
+    while (begin < end)
+    {
+        // Lazy binary splitting: an empty deque means the jobs given away were stolen, there is demand for more
+        if (end - begin >= 2 * grain && deque.IsEmpty())
+        {
+            const unsigned int middle = begin + (end - begin) / 2;
+            Job* job = AllocateJob(thread);
+            job->Range = &task;
+            job->Begin = middle;
+            job->End = end;
+            job->Grain = grain;
+            job->Batch = &counter;
+            end = middle;
+            Push(thread, job);
+            continue;
+        }
+
+        const unsigned int chunkEnd = std::min(end, begin + grain);
+        for (unsigned int i = begin; i < chunkEnd; i++)
+            task(i, thread);
+        begin = chunkEnd;
+    }
+}
+
+WorkerPool::Stats WorkerPool::GetStats() const
+{
+    Stats stats;
+    for (const auto& data : m_ThreadData)
+    {
+        stats.Jobs += data->Executed.load(std::memory_order_relaxed);
+        stats.Steals += data->Steals.load(std::memory_order_relaxed);
+        stats.Sleeps += data->Sleeps.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void WorkerPool::WorkerLoop(unsigned int thread, unsigned int core)
+{
+    PROFILE_THREAD("Worker " + std::to_string(thread));
+    t_Pool = this;
+    t_Thread = thread;
+    if (core != ~0u)
+        PinCurrentThread(core);
+
+    ThreadData& data = *m_ThreadData[thread];
+    unsigned int idleRounds = 0;
+    while (true)
+    {
+        if (Job* job = FindJob(thread))
+        {
+            Execute(job, thread);
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < SpinRounds)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Announce the sleep, then look once more: a push either sees the sleeper or is seen here
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (!m_Running)
+            return;
+        const uint64_t epoch = m_Epoch;
+        m_Sleeping.fetch_add(1, std::memory_order_relaxed);
+        lock.unlock();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (Job* job = FindJob(thread))
+        {
+            m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+            Execute(job, thread);
+            idleRounds = 0;
+            continue;
+        }
+
+        data.Sleeps.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+        m_WorkAvailable.wait(lock, [&] { return !m_Running || m_Epoch != epoch; });
+        m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+        if (!m_Running)
+            return;
+        idleRounds = 0;
+    }
+}
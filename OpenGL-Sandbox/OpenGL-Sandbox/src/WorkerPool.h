@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job system spreading CPU work (culling, command recording, asset loading) across cores.
+// Every thread has a Chase-Lev deque: it pushes and pops jobs at the bottom of its own, idle threads steal from the top
+// of the others'. Jobs count down a Counter when they are done, Wait() runs other jobs until a counter reaches zero, so
+// jobs can spawn and wait for jobs of their own. ParallelFor() splits its range lazily: the running thread only gives
+// half of what is left away when its deque is empty, that is when a thief took everything it had queued.
+// The thread outside the pool that calls in (the GL thread) takes part in the work as thread 0. Only one such thread
+// may use the pool at a time.
+class WorkerPool
+{
+public:
+    using Task = std::function<void(unsigned int index, unsigned int thread)>;
+
+    // Jobs of a batch still running
+    class Counter
+    {
+    public:
+        bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+    private:
+        friend class WorkerPool;
+        std::atomic<uint32_t> m_Pending{ 0 };
+    };
+
+    struct Settings
+    {
+        unsigned int Workers = 0;           // 0 for one per core, minus the reserved ones
+        unsigned int ReservedThreads = 1;   // Cores left to the threads outside the pool (GL and main threads)
+        bool PinThreads = false;            // Worker i runs on core ReservedThreads + i - 1 only
+    };
+
+    struct Stats
+    {
+        uint64_t Jobs = 0;      // Run, stolen ones included
+        uint64_t Steals = 0;
+        uint64_t Sleeps = 0;    // A worker found nothing to do and went to sleep
+    };
+
+    static constexpr unsigned int DequeCapacity = 4096;    // Jobs queued per thread, more run inline
+
+    // Settings of Instance(), before its first use
+    static void Configure(const Settings& settings);
+    static WorkerPool& Instance();
+
+    explicit WorkerPool(const Settings& settings);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Number of threads taking part in the work, including the caller (thread index 0)
+    unsigned int GetThreadCount() const { return (unsigned int)m_Threads.size() + 1; }
+
+    // Queues a job on the calling thread's deque, 'counter' drops back once it has run
+    void Run(Counter& counter, std::function<void()> job);
+    // Returns once every job of 'counter' is done, runs queued jobs (of any counter) in the meantime
+    void Wait(Counter& counter);
+
+    // Runs task(index, thread) for every index in [0, count) and returns once all of them are done. Indices go by
+    // 'grain' at least, 0 picks a grain that leaves about 8 splits per thread.
+    void ParallelFor(unsigned int count, const Task& task, unsigned int grain = 0);
+
+    Stats GetStats() const;
+private:
+    struct Job
+    {
+        std::function<void()> Function;
+        const Task* Range = nullptr;    // ParallelFor: task over [Begin, End)
+        unsigned int Begin = 0, End = 0, Grain = 1;
+        Counter* Batch = nullptr;
+        std::atomic<bool> Free{ true };
+    };
+
+    // Chase-Lev deque of a fixed capacity (Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for
+    // Weak Memory Models", 2013). The owner pushes and pops at the bottom, the other threads steal at the top.
+    class Deque
+    {
+    public:
+        bool Push(Job* job);
+        Job* Pop();
+        Job* Steal();
+        bool IsEmpty() const;
+    private:
+        alignas(64) std::atomic<int64_t> m_Top{ 0 };
+        alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+        std::atomic<Job*> m_Jobs[DequeCapacity];
+    };
+
+    struct alignas(64) ThreadData
+    {
+        Deque Jobs;
+        std::unique_ptr<Job[]> Storage = std::make_unique<Job[]>(DequeCapacity); // Jobs this thread created, reused in turn
+        uint32_t NextJob = 0;
+        uint32_t Random = 0;            // Victim selection
+        std::atomic<uint64_t> Executed{ 0 }, Steals{ 0 }, Sleeps{ 0 };
+    };
+
+    unsigned int GetThreadIndex() const;
+    Job* AllocateJob(unsigned int thread);
+    void Push(unsigned int thread, Job* job);
+    Job* FindJob(unsigned int thread);
+    void Execute(Job* job, unsigned int thread);
+    void RunRange(const Task& task, unsigned int begin, unsigned int end, unsigned int grain, Counter& counter, unsigned int thread);
+
+    void WorkerLoop(unsigned int thread, unsigned int core);
+private:
+    std::vector<std::unique_ptr<ThreadData>> m_ThreadData; // One per thread, 0 for the caller
+    std::vector<std::thread> m_Threads;
+
+    // Sleeping workers wait for a new epoch, pushes only take the lock when somebody sleeps
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::atomic<unsigned int> m_Sleeping{ 0 };
+    uint64_t m_Epoch = 0;
+    bool m_Running = true;
+};